@@ -619,6 +619,7 @@ bool ClusterState::updateAddressIfNeeded(CNodePtr node,
     node->setNodeCport(cport);
     node->freeClusterSession();
     node->_flags &= ~CLUSTER_NODE_NOADDR;
+    invalidateRoute();
     isMyMaster =
       (_myself->nodeIsSlave() && _myself->getMaster() == node) ? true : false;
   }
@@ -714,6 +715,8 @@ ClusterState::ClusterState(std::shared_ptr<ServerEntry> server)
     _failoverAuthSent(0),
     _failoverAuthRank(0),
     _failoverAuthEpoch(0),
+    _routeVersion(newRouteVersion()),
+    _route(nullptr),
     _state(ClusterHealth::CLUSTER_FAIL),
     _size(1),
     _migratingSlots(),
@@ -730,6 +733,8 @@ ClusterState::ClusterState(std::shared_ptr<ServerEntry> server)
   _statsMessagesSent.fill(0);
 }
 
+ClusterState::~ClusterState() {}
+
 bool ClusterState::clusterHandshakeInProgress(const std::string& host,
                                               uint32_t port,
                                               uint32_t cport) {
@@ -1121,37 +1126,102 @@ CNodePtr ClusterState::getNodeBySlot(uint32_t slot) const {
   return _allSlots[slot];
 }
 
-Expected<CNodePtr> ClusterState::clusterHandleRedirect(uint32_t slot,
-                                                       Session* sess) const {
-  std::lock_guard<myMutex> lk(_mutex);
-  if (_state == ClusterHealth::CLUSTER_FAIL) {
+Expected<CNodePtr> ClusterRoute::redirect(uint32_t slot) const {
+  if (state == ClusterHealth::CLUSTER_FAIL) {
     return {ErrorCodes::ERR_CLUSTER_REDIR_DOWN_STATE, ""};
   }
 
-  auto node = getNodeBySlot(slot);
-  if (!node) {
+  const auto& target = targets[slots[slot]];
+  if (!target.node) {
     return {ErrorCodes::ERR_CLUSTER_REDIR_DOWN_UNBOUND, ""};
   }
 
-  if ((sess->getCtx()->getFlags() & CLIENT_READONLY) && isMyselfSlave() &&
-      _myself->_slaveOf == node) {
-    auto cmd = Command::getCommand(sess);
-    if (cmd != nullptr && (cmd->getFlags() & CMD_READONLY)) {
-      // cmd == evalCom || cmd == evalShaCommand
-      return _myself;
+  if (!target.myself) {
+    return {ErrorCodes::ERR_MOVED,
+            "-MOVED " + std::to_string(slot) + target.addr};
+  }
+
+  return target.node;
+}
+
+uint64_t ClusterState::newRouteVersion() {
+  static std::atomic<uint64_t> version(0);
+  return version.fetch_add(1) + 1;
+}
+
+// rebuild the route if it is stale. The old one is freed by the last
+// reader holding it.
+void ClusterState::refreshRoute() const {
+  std::lock_guard<myMutex> lk(_mutex);
+  // read the version first, the changes after it invalidate the new route
+  uint64_t version = _routeVersion.load();
+  auto old = std::atomic_load(&_route);
+  if (old != nullptr && old->version == version) {
+    return;
+  }
+
+  auto route = std::make_unique<ClusterRoute>();
+  route->version = version;
+  route->state = _state;
+  route->targets.emplace_back();
+  std::unordered_map<const ClusterNode*, uint16_t> index;
+  for (uint32_t i = 0; i < CLUSTER_SLOTS; i++) {
+    const auto& node = _allSlots[i];
+    if (!node) {
+      route->slots[i] = 0;
+      continue;
+    }
+    auto it = index.find(node.get());
+    if (it == index.end()) {
+      ClusterRoute::Target target;
+      target.node = node;
+      target.myself = node == _myself;
+      target.addr = " " + node->getNodeIp() + ":" +
+        std::to_string(node->getPort()) + "\r\n";
+      it = index.emplace(node.get(), route->targets.size()).first;
+      route->targets.emplace_back(std::move(target));
     }
+    route->slots[i] = it->second;
   }
 
-  if (node != _myself) {
-    std::stringstream ss;
-    ss << "-"
-       << "MOVED"
-       << " " << slot << " " << node->getNodeIp() << ":" << node->getPort()
-       << "\r\n";
-    return {ErrorCodes::ERR_MOVED, ss.str()};
+  std::atomic_store(&_route,
+                    std::shared_ptr<const ClusterRoute>(std::move(route)));
+}
+
+Expected<CNodePtr> ClusterState::clusterHandleRedirect(uint32_t slot,
+                                                       Session* sess) const {
+  // a readonly client of a slave reads the slots of its master, which
+  // is not in the route, so check it with the lock.
+  if (sess->getCtx()->getFlags() & CLIENT_READONLY) {
+    std::lock_guard<myMutex> lk(_mutex);
+    if (_state == ClusterHealth::CLUSTER_FAIL) {
+      return {ErrorCodes::ERR_CLUSTER_REDIR_DOWN_STATE, ""};
+    }
+
+    auto node = getNodeBySlot(slot);
+    if (node && isMyselfSlave() && _myself->_slaveOf == node) {
+      auto cmd = Command::getCommand(sess);
+      if (cmd != nullptr && (cmd->getFlags() & CMD_READONLY)) {
+        // cmd == evalCom || cmd == evalShaCommand
+        return _myself;
+      }
+    }
   }
 
-  return node;
+  // the route used last by this thread, nothing is written to the shared
+  // cache lines until the route changes
+  thread_local std::shared_ptr<const ClusterRoute> lastRoute;
+  while (true) {
+    uint64_t version = _routeVersion.load();
+    if (lastRoute != nullptr && lastRoute->version == version) {
+      return lastRoute->redirect(slot);
+    }
+    lastRoute = std::atomic_load(&_route);
+    if (lastRoute != nullptr && lastRoute->version == version) {
+      return lastRoute->redirect(slot);
+    }
+    refreshRoute();
+  }
 }
 
 bool ClusterState::isContainSlot(uint32_t slotId) {
@@ -1169,6 +1239,7 @@ void ClusterState::setMyselfNode(CNodePtr node) {
   INVARIANT(node != nullptr);
   if (!_myself) {
     _myself = node;
+    invalidateRoute();
   }
 }
 
@@ -1914,6 +1985,7 @@ bool ClusterState::clusterAddSlotNoLock(CNodePtr node, const uint32_t slot) {
       return false;
     }
     _allSlots[slot] = node;
+    invalidateRoute();
     DLOG(INFO) << "node:" << node->getNodeName() << "add slot:" << slot
                << "finish";
     return true;
@@ -1946,6 +2018,7 @@ bool ClusterState::clusterDelSlotNoLock(const uint32_t slot) {
   bool old = n->clearSlotBit(slot);
   INVARIANT(old);
   _allSlots[slot] = nullptr;
+  invalidateRoute();
   return true;
 }
 
@@ -4307,6 +4380,7 @@ void ClusterState::clusterUpdateState() {
               "Cluster state changed: %s",
               new_state == ClusterHealth::CLUSTER_OK ? "ok" : "fail");
     _state = new_state;
+    invalidateRoute();
   }
 }
 uint64_t ClusterState::getMfEnd() const {
@@ -4492,23 +4566,29 @@ uint64_t ClusterManager::countKeysInSlot(uint32_t slot) {
     return 0;
   }
   auto kvstore = std::move(expdb.value().store);
-  auto ptxn = kvstore->createTransaction(nullptr);
-  INVARIANT_D(ptxn.ok());
-  auto slotCursor = std::move(ptxn.value()->createSlotCursor(slot));
+  auto keyNum = kvstore->getSlotKeyCount(slot);
+  if (keyNum.ok()) {
+    return keyNum.value();
+  }
+  keyNum = kvstore->recountSlotKeys(slot);
+  if (!keyNum.ok()) {
+    LOG(ERROR) << "count keys of slot:" << slot
+               << " failed:" << keyNum.status().toString();
+    return 0;
+  }
+  return keyNum.value();
+}
 
-  uint64_t keyNum = 0;
-  while (true) {
-    Expected<Record> expRcd = slotCursor->next();
-    if (expRcd.status().code() == ErrorCodes::ERR_EXHAUST) {
-      break;
-    }
-    if (!expRcd.ok()) {
-      LOG(ERROR) << "get slot cursor error:" << expRcd.status().toString();
-      return keyNum;
-    }
-    keyNum++;
+uint64_t ClusterManager::getSlotApproximateSize(uint32_t slot) {
+  uint32_t storeId = _svr->getSegmentMgr()->getStoreid(slot);
+  LocalSessionGuard g(_svr.get());
+  auto expdb = _svr->getSegmentMgr()->getDb(
+    g.getSession(), storeId, mgl::LockMode::LOCK_IS);
+  if (!expdb.ok()) {
+    return 0;
   }
-  return keyNum;
+  auto size = expdb.value().store->getSlotApproximateSize(slot);
+  return size.ok() ? size.value() : 0;
 }
 
 std::vector<std::string> ClusterManager::getKeyBySlot(uint32_t slot,
@@ -4790,6 +4870,7 @@ bool ClusterState::clusterProcessGossipSection(
         node->setNodePort(g._gossipPort);
         node->setNodeCport(g._gossipCport);
         node->_flags &= ~CLUSTER_NODE_NOADDR;
+        invalidateRoute();
       }
     } else {
       /* If it's not in NOADDR state and we don't have it, we
@@ -5005,6 +5086,7 @@ Status ClusterState::clusterProcessPacket(std::shared_ptr<ClusterSession> sess,
         sessNode->setNodePort(0);
         sessNode->setNodeCport(0);
         sessNode->freeClusterSession();
+        invalidateRoute();
         save = true;
         //  std::string nodeName = hdr->_sender;
         return {ErrorCodes::ERR_CLUSTER,
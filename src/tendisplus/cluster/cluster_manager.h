@@ -7,6 +7,7 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <bitset>
 #include <list>
 #include <memory>
@@ -528,6 +529,25 @@ class ClusterSession : public NetSession {
   CNodePtr _node;
 };
 
+// An immutable snapshot of the slots routing of ClusterState. It is
+// rebuilt after the slots, the nodes' address or the cluster health
+// change, so that clusterHandleRedirect() reads it without the lock.
+struct ClusterRoute {
+  struct Target {
+    CNodePtr node;
+    bool myself = false;
+    // " ip:port\r\n", the tail of the MOVED reply
+    std::string addr;
+  };
+  Expected<CNodePtr> redirect(uint32_t slot) const;
+
+  uint64_t version;
+  ClusterHealth state;
+  // the index in targets of the slots, 0 is for the unassigned ones
+  std::array<uint16_t, CLUSTER_SLOTS> slots;
+  std::vector<Target> targets;
+};
+
 class ClusterState : public std::enable_shared_from_this<ClusterState> {
   friend class ClusterNode;
 
@@ -535,6 +555,7 @@ class ClusterState : public std::enable_shared_from_this<ClusterState> {
   explicit ClusterState(std::shared_ptr<ServerEntry> server);
   ClusterState(const ClusterState&) = delete;
   ClusterState(ClusterState&&) = delete;
+  ~ClusterState();
   // get epoch
   uint64_t getCurrentEpoch() const;
   uint64_t getLastVoteEpoch() const;
@@ -619,6 +640,10 @@ class ClusterState : public std::enable_shared_from_this<ClusterState> {
 
   Expected<CNodePtr> clusterHandleRedirect(uint32_t slot, Session* sess) const;
   CNodePtr getNodeBySlot(uint32_t slot) const;
+  // the route is rebuilt by the next clusterHandleRedirect()
+  void invalidateRoute() {
+    _routeVersion.store(newRouteVersion());
+  }
 
   void clusterUpdateSlotsConfigWith(CNodePtr sender,
                                     uint64_t senderConfigEpoch,
@@ -788,6 +813,17 @@ class ClusterState : public std::enable_shared_from_this<ClusterState> {
 
   uint32_t clusterMastersHaveSlavesNoLock();
   Status clusterBlockMyself(uint64_t time);
+  void refreshRoute() const;
+  // unique in the process, so a route is never taken for the one of
+  // another ClusterState
+  static uint64_t newRouteVersion();
+
+  // _route is rebuilt under _mutex and published by std::atomic_store().
+  // Each thread keeps the route it used last, see clusterHandleRedirect(),
+  // and loads _route again only after _routeVersion changes. An old
+  // route is freed once the last thread holding it moves on.
+  std::atomic<uint64_t> _routeVersion;
+  mutable std::shared_ptr<const ClusterRoute> _route;
 
  public:
   ClusterHealth _state;
@@ -898,7 +934,9 @@ class ClusterManager {
   bool isRunning() const;
   Status clusterReset(uint16_t hard);
   bool hasDirtyKey(uint32_t storeid);
+  // the key number is kept by the store, it's recounted only if unknown
   uint64_t countKeysInSlot(uint32_t slot);
+  uint64_t getSlotApproximateSize(uint32_t slot);
   std::vector<std::string> getKeyBySlot(uint32_t slot, uint32_t count);
   bool emptySlot(uint32_t slot);
   Status clusterDelNodeMeta(const std::string& key);
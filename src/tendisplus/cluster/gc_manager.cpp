@@ -364,6 +364,26 @@ Status DeleteRangeTask::deleteSlotRange() {
     return expdb.status();
   }
   PStore kvstore = expdb.value().store;
+  if (_svr->getParams()->garbageDeleteByCompaction) {
+    // NOTE: no range tombstone is left on the master, so the reads of the
+    // neighbour slots don't slow down after migration
+    auto s = kvstore->deleteSlotsByCompaction(_slotStart, _slotEnd + 1);
+    if (!s.ok()) {
+      serverLog(LL_NOTICE,
+                "DeleteRangeTask::deleteSlotsByCompaction failed,"
+                "from [startSlot:%u] to [endSlot:%u] [bad response:%s]",
+                _slotStart,
+                _slotEnd,
+                s.toString().c_str());
+      return s;
+    }
+    serverLog(LL_VERBOSE,
+              "DeleteRangeTask::deleteSlotsByCompaction finished,"
+              "from [startSlot: %u] to [endSlot: %u]",
+              _slotStart,
+              _slotEnd);
+    return {ErrorCodes::ERR_OK, ""};
+  }
   RecordKey rkStart(_slotStart, 0, RecordType::RT_INVALID, "", "");
   RecordKey rkEnd(_slotEnd + 1, 0, RecordType::RT_INVALID, "", "");
   string start = rkStart.prefixChunkid();
@@ -0,0 +1,157 @@
+// Copyright (C) 2020 THL A29 Limited, a Tencent company.  All rights reserved.
+// Please refer to the license text that comes with this tendis open source
+// project for additional information.
+
+#include <string>
+
+#include "snappy.h"
+
+#include "tendisplus/cluster/migrate_frame.h"
+#include "tendisplus/utils/redis_port.h"
+
+namespace tendisplus {
+
+namespace {
+void putFixed32(std::string* dst, uint32_t v) {
+  char buf[4];
+  for (size_t i = 0; i < sizeof(buf); i++) {
+    buf[i] = static_cast<char>((v >> (8 * i)) & 0xff);
+  }
+  dst->append(buf, sizeof(buf));
+}
+
+void putFixed64(std::string* dst, uint64_t v) {
+  putFixed32(dst, static_cast<uint32_t>(v));
+  putFixed32(dst, static_cast<uint32_t>(v >> 32));
+}
+
+uint32_t getFixed32(const char* p) {
+  auto u = reinterpret_cast<const unsigned char*>(p);
+  return static_cast<uint32_t>(u[0]) | (static_cast<uint32_t>(u[1]) << 8) |
+    (static_cast<uint32_t>(u[2]) << 16) | (static_cast<uint32_t>(u[3]) << 24);
+}
+
+uint64_t getFixed64(const char* p) {
+  return static_cast<uint64_t>(getFixed32(p)) |
+    (static_cast<uint64_t>(getFixed32(p + 4)) << 32);
+}
+
+uint64_t frameCrc(const char* data, size_t len) {
+  return redis_port::crc64(
+    0, reinterpret_cast<const unsigned char*>(data), len);
+}
+}  // namespace
+
+void MigrateFrameEncoder::append(const std::string& key,
+                                 const std::string& value) {
+  putFixed32(&_raw, key.size());
+  _raw.append(key);
+  putFixed32(&_raw, value.size());
+  _raw.append(value);
+  _count++;
+}
+
+void MigrateFrameEncoder::finish(bool compress, std::string* out) {
+  std::string compressed;
+  if (compress) {
+    snappy::Compress(_raw.data(), _raw.size(), &compressed);
+  }
+  bool useSnappy = compress && compressed.size() < _raw.size();
+  const std::string& payload = useSnappy ? compressed : _raw;
+
+  out->reserve(out->size() + MIGRATE_FRAME_HEADER_LEN + payload.size());
+  out->push_back(static_cast<char>(MIGRATE_FRAME_VERSION));
+  out->push_back(static_cast<char>(useSnappy ? MIGRATE_FRAME_FLAG_SNAPPY : 0));
+  putFixed32(out, _raw.size());
+  putFixed32(out, payload.size());
+  putFixed64(out, frameCrc(payload.data(), payload.size()));
+  out->append(payload);
+
+  _raw.clear();
+  _count = 0;
+}
+
+Expected<MigrateFrameHeader> decodeMigrateFrameHeader(const std::string& buf) {
+  if (buf.size() != MIGRATE_FRAME_HEADER_LEN) {
+    return {ErrorCodes::ERR_DECODE, "invalid frame header length"};
+  }
+  MigrateFrameHeader header;
+  header.version = static_cast<uint8_t>(buf[0]);
+  header.flags = static_cast<uint8_t>(buf[1]);
+  header.rawLen = getFixed32(buf.data() + 2);
+  header.payloadLen = getFixed32(buf.data() + 6);
+  header.crc = getFixed64(buf.data() + 10);
+  if (header.version != MIGRATE_FRAME_VERSION) {
+    return {ErrorCodes::ERR_DECODE,
+            "unsupported frame version:" + std::to_string(header.version)};
+  }
+  if (header.flags & ~MIGRATE_FRAME_FLAG_SNAPPY) {
+    return {ErrorCodes::ERR_DECODE,
+            "unknown frame flags:" + std::to_string(header.flags)};
+  }
+  if (header.rawLen > MIGRATE_FRAME_MAX_LEN ||
+      header.payloadLen > MIGRATE_FRAME_MAX_LEN) {
+    return {ErrorCodes::ERR_DECODE, "frame too large"};
+  }
+  return header;
+}
+
+Expected<uint32_t> decodeMigrateFrame(const MigrateFrameHeader& header,
+                                      const std::string& payload,
+                                      const MigrateFrameCb& cb) {
+  if (payload.size() != header.payloadLen) {
+    return {ErrorCodes::ERR_DECODE, "invalid frame payload length"};
+  }
+  if (frameCrc(payload.data(), payload.size()) != header.crc) {
+    return {ErrorCodes::ERR_DECODE, "frame checksum mismatch"};
+  }
+
+  // the uncompressed records are decoded from the payload directly
+  std::string uncompressed;
+  const std::string* raw = &payload;
+  if (header.flags & MIGRATE_FRAME_FLAG_SNAPPY) {
+    size_t len = 0;
+    if (!snappy::GetUncompressedLength(payload.data(), payload.size(), &len) ||
+        len != header.rawLen ||
+        !snappy::Uncompress(payload.data(), payload.size(), &uncompressed)) {
+      return {ErrorCodes::ERR_DECODE, "frame uncompress failed"};
+    }
+    raw = &uncompressed;
+  } else if (payload.size() != header.rawLen) {
+    return {ErrorCodes::ERR_DECODE, "invalid frame raw length"};
+  }
+
+  const char* p = raw->data();
+  const char* end = p + raw->size();
+  std::string key;
+  std::string value;
+  uint32_t count = 0;
+  while (p < end) {
+    if (end - p < 4) {
+      return {ErrorCodes::ERR_DECODE, "truncated frame record"};
+    }
+    uint32_t keylen = getFixed32(p);
+    p += 4;
+    if (static_cast<size_t>(end - p) < static_cast<size_t>(keylen) + 4) {
+      return {ErrorCodes::ERR_DECODE, "truncated frame record"};
+    }
+    key.assign(p, keylen);
+    p += keylen;
+    uint32_t valuelen = getFixed32(p);
+    p += 4;
+    if (static_cast<size_t>(end - p) < valuelen) {
+      return {ErrorCodes::ERR_DECODE, "truncated frame record"};
+    }
+    value.assign(p, valuelen);
+    p += valuelen;
+
+    auto s = cb(key, value);
+    if (!s.ok()) {
+      return s;
+    }
+    count++;
+  }
+  return count;
+}
+
+}  // namespace tendisplus
@@ -0,0 +1,79 @@
+// Copyright (C) 2020 THL A29 Limited, a Tencent company.  All rights reserved.
+// Please refer to the license text that comes with this tendis open source
+// project for additional information.
+
+#ifndef SRC_TENDISPLUS_CLUSTER_MIGRATE_FRAME_H_
+#define SRC_TENDISPLUS_CLUSTER_MIGRATE_FRAME_H_
+
+#include <functional>
+#include <string>
+
+#include "tendisplus/utils/status.h"
+
+namespace tendisplus {
+
+// The snapshot records of a migration are packed into frames if the
+// receiver asks for it by "readymigrate ... frame". A frame is sent as
+// the tag "5", the header and the payload:
+//   version(1) flags(1) rawLen(4) payloadLen(4) crc64(8)
+// The raw payload is the records of keylen(4) key valuelen(4) value,
+// the payload is the raw one or its snappy compression, and crc64 is
+// of the payload. The integers are little-endian.
+constexpr uint8_t MIGRATE_FRAME_VERSION = 1;
+constexpr size_t MIGRATE_FRAME_HEADER_LEN = 18;
+constexpr uint8_t MIGRATE_FRAME_FLAG_SNAPPY = 0x01;
+// The sender flushes a frame once its raw payload reaches
+// MIGRATE_FRAME_SIZE, and never lets it grow beyond MIGRATE_FRAME_MAX_LEN
+// with the last record. A record too large for any frame is sent alone
+// in the old format, so the receiver rejects a larger frame header before
+// allocating its payload.
+constexpr uint32_t MIGRATE_FRAME_SIZE = 1024 * 1024;
+constexpr uint32_t MIGRATE_FRAME_MAX_LEN = MIGRATE_FRAME_SIZE + 64 * 1024;
+
+struct MigrateFrameHeader {
+  uint8_t version;
+  uint8_t flags;
+  uint32_t rawLen;
+  uint32_t payloadLen;
+  uint64_t crc;
+};
+
+class MigrateFrameEncoder {
+ public:
+  MigrateFrameEncoder() : _count(0) {}
+  void append(const std::string& key, const std::string& value);
+  // the raw size of a record in a frame
+  static size_t recordSize(size_t keylen, size_t valuelen) {
+    return 2 * sizeof(uint32_t) + keylen + valuelen;
+  }
+  // append the header and the payload of the records to out, and reset.
+  // The payload is compressed only if it gets smaller.
+  void finish(bool compress, std::string* out);
+  size_t rawSize() const {
+    return _raw.size();
+  }
+  uint32_t count() const {
+    return _count;
+  }
+  bool empty() const {
+    return _count == 0;
+  }
+
+ private:
+  std::string _raw;
+  uint32_t _count;
+};
+
+Expected<MigrateFrameHeader> decodeMigrateFrameHeader(const std::string& buf);
+
+// verify the payload and call cb on its records in order,
+// return the number of the records.
+using MigrateFrameCb =
+  std::function<Status(const std::string& key, const std::string& value)>;
+Expected<uint32_t> decodeMigrateFrame(const MigrateFrameHeader& header,
+                                      const std::string& payload,
+                                      const MigrateFrameCb& cb);
+
+}  // namespace tendisplus
+
+#endif  // SRC_TENDISPLUS_CLUSTER_MIGRATE_FRAME_H_
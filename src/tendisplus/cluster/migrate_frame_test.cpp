@@ -0,0 +1,95 @@
+// Copyright (C) 2020 THL A29 Limited, a Tencent company.  All rights reserved.
+// Please refer to the license text that comes with this tendis open source
+// project for additional information.
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "tendisplus/cluster/migrate_frame.h"
+
+namespace tendisplus {
+
+using KVs = std::vector<std::pair<std::string, std::string>>;
+
+static Expected<KVs> decodeAll(const std::string& frame) {
+  auto header =
+    decodeMigrateFrameHeader(frame.substr(0, MIGRATE_FRAME_HEADER_LEN));
+  if (!header.ok()) {
+    return header.status();
+  }
+  KVs kvs;
+  auto cnt = decodeMigrateFrame(
+    header.value(),
+    frame.substr(MIGRATE_FRAME_HEADER_LEN),
+    [&kvs](const std::string& key, const std::string& value) -> Status {
+      kvs.emplace_back(key, value);
+      return {ErrorCodes::ERR_OK, ""};
+    });
+  if (!cnt.ok()) {
+    return cnt.status();
+  }
+  EXPECT_EQ(cnt.value(), kvs.size());
+  return kvs;
+}
+
+TEST(MigrateFrame, EncodeDecode) {
+  KVs kvs = {{"k1", "v1"}, {"", ""}, {"k3", std::string(1000, 'a')}};
+  for (bool compress : {false, true}) {
+    MigrateFrameEncoder encoder;
+    for (const auto& kv : kvs) {
+      encoder.append(kv.first, kv.second);
+    }
+    EXPECT_EQ(encoder.count(), 3U);
+    std::string frame;
+    encoder.finish(compress, &frame);
+    EXPECT_TRUE(encoder.empty());
+    EXPECT_EQ(frame[1] == MIGRATE_FRAME_FLAG_SNAPPY, compress);
+    if (compress) {
+      EXPECT_LT(frame.size(), 1000U);
+    }
+
+    auto decoded = decodeAll(frame);
+    ASSERT_TRUE(decoded.ok());
+    EXPECT_EQ(decoded.value(), kvs);
+  }
+
+  // incompressible records are sent raw
+  MigrateFrameEncoder encoder;
+  encoder.append("k", "v");
+  std::string frame;
+  encoder.finish(true, &frame);
+  EXPECT_EQ(frame[1], 0);
+  EXPECT_TRUE(decodeAll(frame).ok());
+}
+
+TEST(MigrateFrame, Corrupted) {
+  MigrateFrameEncoder encoder;
+  encoder.append("key", std::string(100, 'b'));
+  std::string frame;
+  encoder.finish(true, &frame);
+
+  std::string bad = frame;
+  bad.back() ^= 0x01;
+  EXPECT_EQ(decodeAll(bad).status().code(), ErrorCodes::ERR_DECODE);
+
+  bad = frame;
+  bad[0] = MIGRATE_FRAME_VERSION + 1;
+  EXPECT_EQ(decodeAll(bad).status().code(), ErrorCodes::ERR_DECODE);
+
+  bad = frame.substr(0, frame.size() - 1);
+  EXPECT_EQ(decodeAll(bad).status().code(), ErrorCodes::ERR_DECODE);
+
+  // rawLen beyond what a sender ever packs
+  bad = frame;
+  uint32_t len = MIGRATE_FRAME_MAX_LEN + 1;
+  for (size_t i = 0; i < sizeof(len); i++) {
+    bad[2 + i] = static_cast<char>((len >> (8 * i)) & 0xff);
+  }
+  auto header =
+    decodeMigrateFrameHeader(bad.substr(0, MIGRATE_FRAME_HEADER_LEN));
+  EXPECT_EQ(header.status().code(), ErrorCodes::ERR_DECODE);
+}
+
+}  // namespace tendisplus
@@ -369,6 +369,8 @@ bool MigrateManager::senderSchedule(const SCLOCK::time_point& now) {
         }
       }
       if (taskPtr->_state == MigrateSendState::SUCC) {
+        // the sessions blocked on the keys of the slots get MOVED now
+        _svr->getBlockingMgr()->signalSlots(taskPtr->_slots);
         _succSenderTask.push_back(slot);
         taskPtr->_pTask->_succStateMap[taskPtr->_taskid] = taskPtr->toString();
       } else {
@@ -991,7 +993,9 @@ void MigrateManager::dstReadyMigrate(asio::ip::tcp::socket sock,
                                      const std::string& slotsArg,
                                      const std::string& StoreidArg,
                                      const std::string& nodeidArg,
-                                     const std::string& taskidArg) {
+                                     const std::string& taskidArg,
+                                     bool sstMode,
+                                     bool frameMode) {
   std::shared_ptr<BlockingTcpClient> client =
     std::move(_svr->getNetwork()->createBlockingClient(std::move(sock),
                                                        64 * 1024 * 1024));
@@ -1022,6 +1026,8 @@ void MigrateManager::dstReadyMigrate(asio::ip::tcp::socket sock,
     _migrateSendTaskMap[taskidArg]->_sender->setClient(client);
     _migrateSendTaskMap[taskidArg]->_sender->setDstNode(nodeidArg);
     _migrateSendTaskMap[taskidArg]->_sender->setDstStoreid(dstStoreid);
+    _migrateSendTaskMap[taskidArg]->_sender->setSstMode(sstMode);
+    _migrateSendTaskMap[taskidArg]->_sender->setFrameMode(frameMode);
     _migrateSendTaskMap[taskidArg]->_sender->start();
     _migrateSendTaskMap[taskidArg]->_state = MigrateSendState::START;
     LOG(INFO) << "sender task marked start on taskid:" << taskidArg;
@@ -190,7 +190,9 @@ class MigrateManager {
                        const std::string& chunkidArg,
                        const std::string& StoreidArg,
                        const std::string& nodeidArg,
-                       const std::string& taskidArg);
+                       const std::string& taskidArg,
+                       bool sstMode,
+                       bool frameMode);
 
   void dstPrepareMigrate(asio::ip::tcp::socket sock,
                          const std::string& chunkidArg,
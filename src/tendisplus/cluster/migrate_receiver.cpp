@@ -2,9 +2,15 @@
 // Please refer to the license text that comes with this tendis open source
 // project for additional information.
 
+#include <string>
+#include <vector>
 #include "glog/logging.h"
+#include "tendisplus/cluster/migrate_frame.h"
 #include "tendisplus/cluster/migrate_receiver.h"
 #include "tendisplus/commands/command.h"
+#include "tendisplus/replication/repl_util.h"
+#include "tendisplus/utils/scopeguard.h"
+#include "tendisplus/utils/string.h"
 
 namespace tendisplus {
 
@@ -37,6 +43,12 @@ Status ChunkMigrateReceiver::receiveSnapshot() {
   std::string bitmapStr = _slots.to_string();
   ss << "readymigrate " << bitmapStr << " " << _storeid << " " << nodename
      << " " << _taskid;
+  if (_cfg->migrateSstEnabled) {
+    ss << " sst";
+  }
+  if (_cfg->migrateFrameEnabled) {
+    ss << " frame";
+  }
   Status s = _client->writeLine(ss.str());
   if (!s.ok()) {
     LOG(ERROR) << "readymigrate srcDb failed:" << s.toString();
@@ -59,6 +71,38 @@ Status ChunkMigrateReceiver::receiveSnapshot() {
   setStartTime(timePointRepr(SCLOCK::now()));
   uint32_t timeoutSec = 5;
   uint32_t readNum = 0;
+  // the records between the flush points of the sender ("1", "2" and "3")
+  // are written in one transaction, committed before replying +OK
+  std::unique_ptr<Transaction> txn;
+  auto commitBatch = [&txn]() -> Status {
+    if (!txn) {
+      return {ErrorCodes::ERR_OK, ""};
+    }
+    auto eCommit = txn->commit();
+    txn.reset();
+    if (!eCommit.ok()) {
+      LOG(ERROR) << "commit migrate batch failed:"
+                 << eCommit.status().toString();
+      return eCommit.status();
+    }
+    return {ErrorCodes::ERR_OK, ""};
+  };
+  auto ensureTxn = [this, &txn]() -> Status {
+    if (!txn) {
+      auto eTxn = _dbWithLock->store->createTransaction(nullptr);
+      if (!eTxn.ok()) {
+        LOG(ERROR) << "createTransaction failed:" << eTxn.status().toString();
+        return eTxn.status();
+      }
+      txn = std::move(eTxn.value());
+    }
+    return {ErrorCodes::ERR_OK, ""};
+  };
+  const auto guard = MakeGuard([&txn] {
+    if (txn) {
+      txn->rollback();
+    }
+  });
   while (true) {
     if (!isRunning()) {
       LOG(ERROR) << "stop receiver task on taskid:" << _taskid;
@@ -90,18 +134,58 @@ Status ChunkMigrateReceiver::receiveSnapshot() {
         return {ErrorCodes::ERR_TIMEOUT, "receive value data fail"};
       }
 
-      auto s = supplySetKV(keyData.value(), valueData.value());
+      s = ensureTxn();
+      if (!s.ok()) {
+        return s;
+      }
+      s = supplySetKV(keyData.value(), valueData.value(), txn.get());
       if (!s.ok()) {
         LOG(ERROR) << "supply set key: " << keyData.value() << "fail";
         return s;
       }
       readNum++;
-    } else if (exptData.value()[0] == '1') {
+    } else if (exptData.value()[0] == '5') {
+      SyncReadData(headerData, MIGRATE_FRAME_HEADER_LEN, timeoutSec);
+      auto expHeader = decodeMigrateFrameHeader(headerData.value());
+      if (!expHeader.ok()) {
+        LOG(ERROR) << "decode frame header fail:"
+                   << expHeader.status().toString();
+        return expHeader.status();
+      }
+      SyncReadData(payloadData, expHeader.value().payloadLen, timeoutSec);
+      s = ensureTxn();
+      if (!s.ok()) {
+        return s;
+      }
+      auto expNum = decodeMigrateFrame(
+        expHeader.value(),
+        payloadData.value(),
+        [this, &txn](const std::string& key, const std::string& value) {
+          return supplySetKV(key, value, txn.get());
+        });
+      if (!expNum.ok()) {
+        LOG(ERROR) << "supply frame fail:" << expNum.status().toString();
+        return expNum.status();
+      }
+      readNum += expNum.value();
+    } else if (exptData.value()[0] == '1' || exptData.value()[0] == '2' ||
+               exptData.value()[0] == '3') {
+      s = commitBatch();
+      if (!s.ok()) {
+        return s;
+      }
       SyncWriteData("+OK")
-    } else if (exptData.value()[0] == '2') {
+      if (exptData.value()[0] == '3') {
+        break;
+      }
+    } else if (exptData.value()[0] == '4') {
+      auto expNum = receiveSst();
+      if (!expNum.ok()) {
+        LOG(ERROR) << "receive sst fail:" << expNum.status().toString();
+        return expNum.status();
+      }
+      readNum += expNum.value();
       SyncWriteData("+OK")
-    } else if (exptData.value()[0] == '3') {
-      SyncWriteData("+OK") break;
     }
   }
   LOG(INFO) << "migrate snapshot transfer done, readnum:" << readNum;
@@ -111,7 +195,8 @@ Status ChunkMigrateReceiver::receiveSnapshot() {
 }
 
 Status ChunkMigrateReceiver::supplySetKV(const string& key,
-                                         const string& value) {
+                                         const string& value,
+                                         Transaction* txn) {
   Expected<RecordKey> expRk = RecordKey::decode(key);
   if (!expRk.ok()) {
     return expRk.status();
@@ -129,45 +214,170 @@ Status ChunkMigrateReceiver::supplySetKV(const string& key,
   }
 
   PStore kvstore = _dbWithLock->store;
-  auto eTxn = kvstore->createTransaction(nullptr);
-  if (!eTxn.ok()) {
-    LOG(ERROR) << "createTransaction failed:" << eTxn.status().toString();
-    return eTxn.status();
-  }
-  std::unique_ptr<Transaction> txn = std::move(eTxn.value());
-
-  Status s = kvstore->setKV(expRk.value(), expRv.value(), txn.get());
+  Status s = kvstore->setKV(expRk.value(), expRv.value(), txn);
 
   if (!s.ok()) {
     LOG(ERROR) << "setKV failed:" << s.toString();
     return s;
   }
+  return addTTLIndex(txn, expRk.value(), expRv.value());
+}
+
+Status ChunkMigrateReceiver::addTTLIndex(Transaction* txn,
+                                         const RecordKey& rk,
+                                         const RecordValue& rv) {
   // NOTE(takenliu) TTLIndex's chunkid is diffrent from key's chunkid,
   // so need to recover TTLIndex.
   // only RT_*_META need recover, it's saved as RT_DATA_META in RecordKey
   // if RecordValue's type is RT_KV need ignore recovering.
-  if (expRk.value().getRecordType() == RecordType::RT_DATA_META) {
-    if (!Command::noExpire() && expRv.value().getTtl() > 0 &&
-        expRv.value().getRecordType() != RecordType::RT_KV) {
+  if (rk.getRecordType() == RecordType::RT_DATA_META) {
+    if (!Command::noExpire() && rv.getTtl() > 0 &&
+        rv.getRecordType() != RecordType::RT_KV) {
       // add new index entry
-      TTLIndex n_ictx(expRk.value().getPrimaryKey(),
-                      expRv.value().getRecordType(),
-                      expRk.value().getDbId(),
-                      expRv.value().getTtl());
-      s = txn->setKV(n_ictx.encode(),
-                     RecordValue(RecordType::RT_TTL_INDEX).encode());
-      if (!s.ok()) {
-        return s;
-      }
+      TTLIndex n_ictx(
+        rk.getPrimaryKey(), rv.getRecordType(), rk.getDbId(), rv.getTtl());
+      return txn->setKV(n_ictx.encode(),
+                        RecordValue(RecordType::RT_TTL_INDEX).encode());
     }
   }
+  return {ErrorCodes::ERR_OK, ""};
+}
 
-  auto commitStatus = txn->commit();
-  if (!commitStatus.ok()) {
-    return commitStatus.status();
+// read "begin end filenum\r\n" and the files sent by sendFileStream(),
+// ingest the files and return the number of records in them.
+Expected<uint64_t> ChunkMigrateReceiver::receiveSst() {
+  auto secs = std::chrono::seconds(100);
+  const size_t batch = 1024 * 1024;
+  auto header = _client->readLine(secs);
+  if (!header.ok()) {
+    return header.status();
+  }
+  auto args = stringSplit(header.value(), " ");
+  if (args.size() != 3) {
+    return {ErrorCodes::ERR_PARSEPKT, "invalid sst header:" + header.value()};
+  }
+  auto begin = ::tendisplus::stoul(args[0]);
+  auto end = ::tendisplus::stoul(args[1]);
+  auto fileNum = ::tendisplus::stoul(args[2]);
+  if (!begin.ok() || !end.ok() || !fileNum.ok() ||
+      begin.value() >= end.value() || end.value() > CLUSTER_SLOTS) {
+    return {ErrorCodes::ERR_PARSEPKT, "invalid sst header:" + header.value()};
+  }
+  for (auto i = begin.value(); i < end.value(); i++) {
+    if (!_slots.test(i)) {
+      LOG(ERROR) << "slotid:" << i << " is not a member in bitmap";
+      return {ErrorCodes::ERR_INTERNAL, "slotid not match"};
+    }
   }
 
-  return {ErrorCodes::ERR_OK, ""};
+  PStore kvstore = _dbWithLock->store;
+  std::string dir =
+    kvstore->dbPath() + "/" + kvstore->dbId() + "_migrecv_" + _taskid;
+  const auto guard = MakeGuard([&dir] {
+    std::error_code ec;
+    filesystem::remove_all(dir, ec);
+  });
+  std::vector<std::string> files;
+  for (size_t i = 0; i < fileNum.value(); i++) {
+    auto fileHeader = _client->readLine(secs);
+    if (!fileHeader.ok()) {
+      return fileHeader.status();
+    }
+    auto fargs = stringSplit(fileHeader.value(), " ");
+    if (fargs.size() != 2 || fargs[0].find('/') != std::string::npos) {
+      return {ErrorCodes::ERR_PARSEPKT,
+              "invalid sst file:" + fileHeader.value()};
+    }
+    auto size = ::tendisplus::stoul(fargs[1]);
+    if (!size.ok()) {
+      return size.status();
+    }
+    std::string fullFileName = dir + "/" + fargs[0];
+    auto crc = recvFileStream(
+      _client.get(), fullFileName, size.value(), batch, secs);
+    if (!crc.ok()) {
+      return crc.status();
+    }
+    files.emplace_back(std::move(fullFileName));
+  }
+
+  auto s = kvstore->ingestSst(files);
+  if (!s.ok()) {
+    return s;
+  }
+  // the ingested keys are not counted, recount them when asked
+  kvstore->invalidateSlotKeys(begin.value(), end.value());
+  return supplySstRange(begin.value(), end.value());
+}
+
+// the ingested records have no binlog and TTL index, scan them to add the
+// binlogs for the slaves of this store, and rebuild the TTL index.
+Expected<uint64_t> ChunkMigrateReceiver::supplySstRange(uint32_t begin,
+                                                        uint32_t end) {
+  const uint32_t batch = 1000;
+  PStore kvstore = _dbWithLock->store;
+  auto eReadTxn = kvstore->createTransaction(nullptr);
+  if (!eReadTxn.ok()) {
+    return eReadTxn.status();
+  }
+  auto cursor = eReadTxn.value()->createSlotsCursor(begin, end);
+  std::unique_ptr<Transaction> txn;
+  const auto guard = MakeGuard([&txn] {
+    if (txn) {
+      txn->rollback();
+    }
+  });
+  uint32_t curSlot = begin;
+  uint32_t curNum = 0;
+  uint64_t total = 0;
+  while (true) {
+    auto expRcd = cursor->next();
+    if (expRcd.status().code() == ErrorCodes::ERR_EXHAUST) {
+      break;
+    } else if (!expRcd.ok()) {
+      return expRcd.status();
+    }
+    const auto& rk = expRcd.value().getRecordKey();
+    // commit per slot, so that the binlogs belong to one chunk
+    if (txn && (curNum >= batch || rk.getChunkId() != curSlot)) {
+      auto eCommit = txn->commit();
+      txn.reset();
+      if (!eCommit.ok()) {
+        return eCommit.status();
+      }
+    }
+    if (!txn) {
+      if (!isRunning()) {
+        return {ErrorCodes::ERR_INTERNAL, "stop running"};
+      }
+      auto eTxn = kvstore->createTransaction(nullptr);
+      if (!eTxn.ok()) {
+        return eTxn.status();
+      }
+      txn = std::move(eTxn.value());
+      curSlot = rk.getChunkId();
+      curNum = 0;
+    }
+    auto kv = expRcd.value().encode();
+    auto s = txn->addSetBinlog(kv.first, kv.second);
+    if (!s.ok()) {
+      return s;
+    }
+    s = addTTLIndex(txn.get(), rk, expRcd.value().getRecordValue());
+    if (!s.ok()) {
+      return s;
+    }
+    curNum++;
+    total++;
+  }
+  if (txn) {
+    auto eCommit = txn->commit();
+    txn.reset();
+    if (!eCommit.ok()) {
+      return eCommit.status();
+    }
+  }
+  return total;
 }
 
 void ChunkMigrateReceiver::stop() {
@@ -91,7 +91,15 @@ class ChunkMigrateReceiver {
   bool isRunning();
 
  private:
-  Status supplySetKV(const string& key, const string& value);
+  // write the record into txn, which is committed by the caller
+  Status supplySetKV(const string& key,
+                     const string& value,
+                     Transaction* txn);
+  Status addTTLIndex(Transaction* txn,
+                     const RecordKey& rk,
+                     const RecordValue& rv);
+  Expected<uint64_t> receiveSst();
+  Expected<uint64_t> supplySstRange(uint32_t begin, uint32_t end);
   mutable std::mutex _mutex;
   std::shared_ptr<ServerEntry> _svr;
   const std::shared_ptr<ServerParams> _cfg;
@@ -2,9 +2,12 @@
 // Please refer to the license text that comes with this tendis open source
 // project for additional information.
 
+#include <sstream>
+#include <string>
 #include <utility>
 #include <vector>
 #include "glog/logging.h"
+#include "tendisplus/cluster/migrate_frame.h"
 #include "tendisplus/cluster/migrate_sender.h"
 #include "tendisplus/commands/command.h"
 #include "tendisplus/replication/repl_util.h"
@@ -23,6 +26,8 @@ ChunkMigrateSender::ChunkMigrateSender(const std::bitset<CLUSTER_SLOTS>& slots,
     _cfg(cfg),
     _isRunning(false),
     _isFake(is_fake),
+    _sstMode(false),
+    _frameMode(false),
     _taskid(taskid),
     _clusterState(svr->getClusterMgr()->getClusterState()),
     _sendstate(MigrateSenderStatus::SNAPSHOT_BEGIN),
@@ -202,6 +207,20 @@ Expected<uint64_t> ChunkMigrateSender::sendRange(Transaction* txn,
   uint32_t curWriteNum = 0;
   uint32_t timeoutSec = 5;
   Status s;
+  MigrateFrameEncoder encoder;
+  // the subkeys of a deleted key are left for the compaction filter
+  SubKeyVersionChecker versionChecker(txn);
+  // write the records packed in frame mode as one frame
+  auto flushFrame = [this, &encoder, &s]() -> Status {
+    if (encoder.empty()) {
+      return {ErrorCodes::ERR_OK, ""};
+    }
+    std::string frame("5");
+    encoder.finish(_cfg->migrateFrameCompress, &frame);
+    _svr->getMigrateManager()->requestRateLimit(frame.size());
+    SyncWriteData(frame);
+    return {ErrorCodes::ERR_OK, ""};
+  };
   while (true) {
     Expected<Record> expRcd = cursor->next();
     if (expRcd.status().code() == ErrorCodes::ERR_EXHAUST) {
@@ -219,34 +238,70 @@ Expected<uint64_t> ChunkMigrateSender::sendRange(Transaction* txn,
     }
     Record& rcd = expRcd.value();
     const RecordKey& rcdKey = rcd.getRecordKey();
+    auto stale = versionChecker.isStale(rcdKey);
+    if (!stale.ok()) {
+      return stale.status();
+    }
+    if (stale.value()) {
+      continue;
+    }
 
     std::string key = rcdKey.encode();
     const RecordValue& rcdValue = rcd.getRecordValue();
     std::string value = rcdValue.encode();
 
-    SyncWriteData("0");
-
     uint32_t keylen = key.size();
-    SyncWriteData(string(reinterpret_cast<char*>(&keylen), sizeof(uint32_t)));
+    uint32_t valuelen = value.size();
+    uint64_t sendBytes =
+      1 + sizeof(uint32_t) + keylen + sizeof(uint32_t) + valuelen;
+    size_t rcdSize = MigrateFrameEncoder::recordSize(keylen, valuelen);
+    if (_frameMode && rcdSize <= MIGRATE_FRAME_MAX_LEN) {
+      // the frames are rate limited by their size on the wire
+      if (encoder.rawSize() + rcdSize > MIGRATE_FRAME_MAX_LEN) {
+        s = flushFrame();
+        if (!s.ok()) {
+          return s;
+        }
+      }
+      encoder.append(key, value);
+      if (encoder.rawSize() >= MIGRATE_FRAME_SIZE) {
+        s = flushFrame();
+        if (!s.ok()) {
+          return s;
+        }
+      }
+    } else {
+      // NOTE: a record too large for a frame follows the frame before it
+      s = flushFrame();
+      if (!s.ok()) {
+        return s;
+      }
+      SyncWriteData("0");
 
-    SyncWriteData(key);
+      SyncWriteData(
+        string(reinterpret_cast<char*>(&keylen), sizeof(uint32_t)));
 
-    uint32_t valuelen = value.size();
-    SyncWriteData(string(reinterpret_cast<char*>(&valuelen), sizeof(uint32_t)));
-    SyncWriteData(value);
+      SyncWriteData(key);
+
+      SyncWriteData(
+        string(reinterpret_cast<char*>(&valuelen), sizeof(uint32_t)));
+      SyncWriteData(value);
+
+      /* *
+       * rate limit for migration
+       */
+      _svr->getMigrateManager()->requestRateLimit(sendBytes);
+    }
 
     curWriteNum++;
     totalWriteNum++;
-    uint64_t sendBytes =
-      1 + sizeof(uint32_t) + keylen + sizeof(uint32_t) + valuelen;
-    curWriteNum += sendBytes;
-
-    /* *
-     * rate limit for migration
-     */
-    _svr->getMigrateManager()->requestRateLimit(sendBytes);
+    curWriteLen += sendBytes;
 
     if (curWriteNum >= 10000 || curWriteLen > 10 * 1024 * 1024) {
+      s = flushFrame();
+      if (!s.ok()) {
+        return s;
+      }
       SyncWriteData("1");
       SyncReadData(exptData, _OKSTR.length(), timeoutSec);
       if (exptData.value() != _OKSTR) {
@@ -260,6 +315,10 @@ Expected<uint64_t> ChunkMigrateSender::sendRange(Transaction* txn,
       curWriteLen = 0;
     }
   }
+  s = flushFrame();
+  if (!s.ok()) {
+    return s;
+  }
   // send over of one slot
   SyncWriteData("2");
   SyncReadData(exptData, _OKSTR.length(), timeoutSec);
@@ -272,6 +331,79 @@ Expected<uint64_t> ChunkMigrateSender::sendRange(Transaction* txn,
   return totalWriteNum;
 }
 
+// send the records of slots in [begin, end) as sst files:
+// "4", "begin end filenum\r\n", then the files by sendFileStream(),
+// the receiver replies +OK after ingesting them.
+Expected<uint64_t> ChunkMigrateSender::sendRangeSst(Transaction* txn,
+                                                    uint32_t begin,
+                                                    uint32_t end) {
+  // the receiver ingests the files and scans the range before replying
+  uint32_t timeoutSec = 3600;
+  const uint64_t maxFileSize = 256 * 1024 * 1024;
+  const size_t batch = 1024 * 1024;
+  auto kvstore = _dbWithLock->store;
+  std::string dir =
+    kvstore->dbPath() + "/" + kvstore->dbId() + "_migsend_" + _taskid;
+  const auto guard = MakeGuard([&dir] {
+    std::error_code ec;
+    filesystem::remove_all(dir, ec);
+  });
+
+  RecordKey beginRk(begin, 0, RecordType::RT_KV, "", "");
+  RecordKey endRk(end, 0, RecordType::RT_KV, "", "");
+  uint64_t keyNum = 0;
+  auto files = kvstore->exportSst(txn,
+                                  beginRk.prefixChunkid(),
+                                  endRk.prefixChunkid(),
+                                  dir,
+                                  maxFileSize,
+                                  &keyNum);
+  if (!files.ok()) {
+    LOG(ERROR) << "export sst failed storeid:" << _storeid
+               << " err:" << files.status().toString();
+    return files.status();
+  }
+  if (!isRunning()) {
+    LOG(ERROR) << "stop sender send snapshot on taskid:" << _taskid;
+    return {ErrorCodes::ERR_INTERNAL, "stop running"};
+  }
+
+  Status s;
+  std::stringstream ss;
+  ss << begin << " " << end << " " << files.value().size();
+  SyncWriteData("4");
+  s = _client->writeLine(ss.str());
+  if (!s.ok()) {
+    return s;
+  }
+  auto mgr = _svr->getMigrateManager();
+  for (const auto& file : files.value()) {
+    std::error_code ec;
+    auto size = filesystem::file_size(file, ec);
+    if (ec) {
+      return {ErrorCodes::ERR_INTERNAL, file + " " + ec.message()};
+    }
+    s = sendFileStream(_client.get(),
+                       [mgr](uint64_t n) { mgr->requestRateLimit(n); },
+                       dir,
+                       filesystem::path(file).filename().string(),
+                       size,
+                       batch,
+                       std::chrono::seconds(timeoutSec));
+    if (!s.ok()) {
+      LOG(ERROR) << "send sst:" << file << " failed:" << s.toString();
+      return s;
+    }
+  }
+  SyncReadData(exptData, _OKSTR.length(), timeoutSec);
+  if (exptData.value() != _OKSTR) {
+    LOG(ERROR) << "read receiver data is not +OK on slots:" << begin << "-"
+               << end;
+    return {ErrorCodes::ERR_INTERNAL, "read +OK failed"};
+  }
+  return keyNum;
+}
+
 // deal with slots that is not continuous
 Status ChunkMigrateSender::sendSnapshot() {
   Status s;
@@ -286,7 +418,7 @@ Status ChunkMigrateSender::sendSnapshot() {
   _curBinlogid.store(kvstore->getHighestBinlogId(), std::memory_order_relaxed);
 
   LOG(INFO) << "sendSnapshot begin, storeid:" << _storeid
-            << " _curBinlogid:" << _curBinlogid
+            << " _curBinlogid:" << _curBinlogid << " sstMode:" << _sstMode
             << " slots:" << bitsetStrEncode(_slots);
   uint32_t startTime = sinceEpoch();
   auto eTxn = initTxn();
@@ -298,15 +430,23 @@ Status ChunkMigrateSender::sendSnapshot() {
   setSnapShotStartTime(msSinceEpoch());
 
   for (size_t i = 0; i < CLUSTER_SLOTS; i++) {
-    if (_slots.test(i)) {
-      sendSlotNum++;
-      auto ret = sendRange(eTxn.value().get(), i, i + 1);
-      if (!ret.ok()) {
-        LOG(ERROR) << "sendRange failed, slot:" << i << "-" << i + 1;
-        return ret.status();
-      }
-      _snapshotKeyNum.fetch_add(ret.value(), std::memory_order_relaxed);
+    if (!_slots.test(i)) {
+      continue;
+    }
+    // the continuous slots are sent together in sst mode
+    size_t end = i + 1;
+    while (_sstMode && end < CLUSTER_SLOTS && _slots.test(end)) {
+      end++;
+    }
+    sendSlotNum += end - i;
+    auto ret = _sstMode ? sendRangeSst(eTxn.value().get(), i, end)
+                        : sendRange(eTxn.value().get(), i, end);
+    if (!ret.ok()) {
+      LOG(ERROR) << "sendRange failed, slot:" << i << "-" << end;
+      return ret.status();
     }
+    _snapshotKeyNum.fetch_add(ret.value(), std::memory_order_relaxed);
+    i = end - 1;
   }
   SyncWriteData("3");  // send over of all
   SyncReadData(exptData, _OKSTR.length(), timeoutSec);
@@ -75,6 +75,14 @@ class ChunkMigrateSender {
   void setDstStoreid(uint32_t dstStoreid) {
     _dstStoreid = dstStoreid;
   }
+  // send the snapshot as sst files, asked by the receiver
+  void setSstMode(bool sstMode) {
+    _sstMode = sstMode;
+  }
+  // pack the snapshot records into frames, asked by the receiver
+  void setFrameMode(bool frameMode) {
+    _frameMode = frameMode;
+  }
   void setDstNode(const std::string nodeid);
 
   uint32_t getStoreid() const {
@@ -153,6 +161,9 @@ class ChunkMigrateSender {
   Expected<std::unique_ptr<Transaction>> initTxn();
   Status sendBinlog();
   Expected<uint64_t> sendRange(Transaction* txn, uint32_t begin, uint32_t end);
+  Expected<uint64_t> sendRangeSst(Transaction* txn,
+                                  uint32_t begin,
+                                  uint32_t end);
   Status sendSnapshot();
   Status sendLastBinlog();
   Status catchupBinlog(uint64_t end);
@@ -168,6 +179,8 @@ class ChunkMigrateSender {
   const std::shared_ptr<ServerParams> _cfg;
   std::atomic<bool> _isRunning;
   bool _isFake;
+  bool _sstMode;
+  bool _frameMode;
 
   std::unique_ptr<DbWithLock> _dbWithLock;
   std::shared_ptr<BlockingTcpClient> _client;
@@ -419,6 +419,36 @@ class ClusterCommand : public Command {
       }
       uint64_t keyNum = svr->getClusterMgr()->countKeysInSlot(slot);
       return Command::fmtBulk(to_string(keyNum));
+    } else if (arg1 == "slotstats" && argSize == 4) {
+      // cluster slotstats <start> <end>
+      // [slot, keys, approximate bytes] of the slots served in [start, end]
+      auto estart = ::tendisplus::stoul(args[2]);
+      auto eend = ::tendisplus::stoul(args[3]);
+      if (!estart.ok() || !eend.ok() || estart.value() > eend.value() ||
+          eend.value() >= CLUSTER_SLOTS) {
+        return {ErrorCodes::ERR_CLUSTER, "Invalid slot range"};
+      }
+      auto node = myself->nodeIsSlave() ? clusterState->getMyMaster() : myself;
+      if (node == nullptr) {
+        return {ErrorCodes::ERR_CLUSTER, "no master of myself"};
+      }
+      auto slots = node->getSlots();
+      std::vector<uint32_t> served;
+      for (auto slot = estart.value(); slot <= eend.value(); slot++) {
+        if (slots.test(slot)) {
+          served.push_back(slot);
+        }
+      }
+      std::stringstream ss;
+      Command::fmtMultiBulkLen(ss, served.size());
+      for (auto slot : served) {
+        Command::fmtMultiBulkLen(ss, 3);
+        Command::fmtLongLong(ss, slot);
+        Command::fmtLongLong(ss, svr->getClusterMgr()->countKeysInSlot(slot));
+        Command::fmtLongLong(
+          ss, svr->getClusterMgr()->getSlotApproximateSize(slot));
+      }
+      return ss.str();
     } else if (arg1 == "keyslot" && argSize == 3) {
       std::string key = args[2];
       if (key.size() < 1) {
@@ -946,8 +976,9 @@ class ReadymigrateCommand : public Command {
  public:
   ReadymigrateCommand() : Command("readymigrate", "a") {}
 
+  // readymigrate bitmap storeid nodeid taskid [sst] [frame]
   ssize_t arity() const {
-    return 5;
+    return -5;
   }
 
   int32_t firstkey() const {
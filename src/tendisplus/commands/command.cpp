@@ -17,6 +17,7 @@
 #include "tendisplus/utils/scopeguard.h"
 #include "tendisplus/lock/lock.h"
 #include "tendisplus/storage/record.h"
+#include "tendisplus/storage/zinline.h"
 #include "tendisplus/utils/sync_point.h"
 
 namespace tendisplus {
@@ -253,12 +254,48 @@ Expected<Command*> Command::precheck(Session* sess) {
     return {ErrorCodes::ERR_AUTH, "-NOAUTH Authentication required.\r\n"};
   }
 
+  if ((pCtx->getFlags() & CLIENT_PUBSUB) && commandName != "subscribe" &&
+      commandName != "unsubscribe" && commandName != "psubscribe" &&
+      commandName != "punsubscribe" && commandName != "ping" &&
+      commandName != "quit") {
+    return {ErrorCodes::ERR_PARSEOPT,
+            "only (P)SUBSCRIBE / (P)UNSUBSCRIBE / PING / QUIT allowed in this "
+            "context"};
+  }
+
   return it->second;
 }
 
+Status Command::runReply(Session* sess, ReplyBuffer* reply) {
+  auto v = run(sess);
+  if (!v.ok()) {
+    return v.status();
+  }
+  reply->append(std::move(v.value()));
+  return {ErrorCodes::ERR_OK, ""};
+}
+
+Expected<std::string> Command::runReplyToString(Session* sess) {
+  ReplyBuffer reply;
+  auto s = runReply(sess, &reply);
+  if (!s.ok()) {
+    return s;
+  }
+  return reply.toString();
+}
+
+Expected<std::string> Command::runSessionCmd(Session* sess) {
+  ReplyBuffer reply;
+  auto s = runSessionCmd(sess, &reply);
+  if (!s.ok()) {
+    return s;
+  }
+  return reply.toString();
+}
+
 // NOTE(deyukong): call precheck before call runSessionCmd
 // this function does no necessary checks
-Expected<std::string> Command::runSessionCmd(Session* sess) {
+Status Command::runSessionCmd(Session* sess, ReplyBuffer* reply) {
   const auto& args = sess->getArgs();
   std::string commandName = toLower(args[0]);
   auto it = commandMap().find(commandName);
@@ -266,7 +303,6 @@ Expected<std::string> Command::runSessionCmd(Session* sess) {
     LOG(FATAL) << "BUG: command:" << args[0] << " not found!";
   }
 
-  // TODO(vinchen): here there is a copy, it is a waste.
   sess->getCtx()->setArgsBrief(sess->getArgs());
   it->second->incrCallTimes();
   auto now = nsSinceEpoch();
@@ -277,25 +313,26 @@ Expected<std::string> Command::runSessionCmd(Session* sess) {
     sess->getServerEntry()->slowlogPushEntryIfNeeded(
       now / 1000, duration / 1000, sess);
   });
-  auto v = it->second->run(sess);
+  auto v = it->second->runReply(sess, reply);
   if (v.ok()) {
     if (sess->getCtx()->isEp()) {
       sess->getServerEntry()->setTsEp(sess->getCtx()->getTsEP());
     }
   } else {
+    reply->clear();
     if (sess->getCtx()->isReplOnly()) {
       // NOTE(vinchen): If it's a slave, the connection should be closed
       // when there is an error. And the error should be log
-      ServerEntry::logError(v.status().toString(), sess);
+      ServerEntry::logError(v.toString(), sess);
 
       auto vv = dynamic_cast<NetSession*>(sess);
       if (vv) {
           vv->setCloseAfterRsp();
       }
-    } else if (v.status().code() == ErrorCodes::ERR_INTERNAL ||
-               v.status().code() == ErrorCodes::ERR_DECODE ||
-               v.status().code() == ErrorCodes::ERR_LOCK_TIMEOUT) {
-      ServerEntry::logError(v.status().toString(), sess);
+    } else if (v.code() == ErrorCodes::ERR_INTERNAL ||
+               v.code() == ErrorCodes::ERR_DECODE ||
+               v.code() == ErrorCodes::ERR_LOCK_TIMEOUT) {
+      ServerEntry::logError(v.toString(), sess);
     }
   }
   return v;
@@ -339,8 +376,10 @@ Status Command::delKeyPessimisticInLock(Session* sess,
       return ptxn.status();
     }
     std::unique_ptr<Transaction> txn = std::move(ptxn.value());
+    // NOTE: the big keys with versioned subkeys are deleted by
+    // delVersionedKeyInLock(), so the version is always 0 here.
     Expected<uint32_t> deleteCount = partialDelSubKeys(
-      sess, storeId, batchSize, mk, valueType, false, txn.get());
+      sess, storeId, batchSize, mk, valueType, 0, false, txn.get());
     if (!deleteCount.ok()) {
       return deleteCount.status();
     }
@@ -421,6 +460,7 @@ Status Command::delKeyOptimismInLock(Session* sess,
                                      uint32_t storeId,
                                      const RecordKey& rk,
                                      RecordType valueType,
+                                     uint64_t version,
                                      Transaction* txn,
                                      const TTLIndex* ictx) {
   auto s = Command::partialDelSubKeys(sess,
@@ -428,17 +468,33 @@ Status Command::delKeyOptimismInLock(Session* sess,
                                       std::numeric_limits<uint32_t>::max(),
                                       rk,
                                       valueType,
+                                      version,
                                       true,
                                       txn,
                                       ictx);
   return s.status();
 }
 
+// requirement: intentionlock held
+Status Command::delVersionedKeyInLock(Session* sess,
+                                      const RecordKey& mk,
+                                      const RecordValue& val,
+                                      Transaction* txn) {
+  INVARIANT_D(rcd_util::isVersionedType(val.getRecordType()));
+  Status s = Command::delKeyAndTTL(sess, mk, val, txn);
+  if (!s.ok()) {
+    return s;
+  }
+  Expected<uint64_t> commitStatus = txn->commit();
+  return commitStatus.status();
+}
+
 Expected<uint32_t> Command::partialDelSubKeys(Session* sess,
                                               uint32_t storeId,
                                               uint32_t subCount,
                                               const RecordKey& mk,
                                               RecordType valueType,
+                                              uint64_t version,
                                               bool deleteMeta,
                                               Transaction* txn,
                                               const TTLIndex* ictx) {
@@ -475,7 +531,8 @@ Expected<uint32_t> Command::partialDelSubKeys(Session* sess,
                       mk.getDbId(),
                       RecordType::RT_HASH_ELE,
                       mk.getPrimaryKey(),
-                      "");
+                      "",
+                      version);
     prefixes.push_back(fakeEle.prefixPk());
   } else if (valueType == RecordType::RT_LIST_META) {
     RecordKey fakeEle(mk.getChunkId(),
@@ -489,20 +546,23 @@ Expected<uint32_t> Command::partialDelSubKeys(Session* sess,
                       mk.getDbId(),
                       RecordType::RT_SET_ELE,
                       mk.getPrimaryKey(),
-                      "");
+                      "",
+                      version);
     prefixes.push_back(fakeEle.prefixPk());
   } else if (valueType == RecordType::RT_ZSET_META) {
     RecordKey fakeEle(mk.getChunkId(),
                       mk.getDbId(),
                       RecordType::RT_ZSET_S_ELE,
                       mk.getPrimaryKey(),
-                      "");
+                      "",
+                      version);
     prefixes.push_back(fakeEle.prefixPk());
     RecordKey fakeEle1(mk.getChunkId(),
                        mk.getDbId(),
                        RecordType::RT_ZSET_H_ELE,
                        mk.getPrimaryKey(),
-                       "");
+                       "",
+                       version);
     prefixes.push_back(fakeEle1.prefixPk());
   } else {
     INVARIANT_D(0);
@@ -574,6 +634,320 @@ Expected<bool> Command::delKeyChkExpire(Session* sess,
   return s;
 }
 
+Status Command::setStringKV(Session* sess,
+                            PStore store,
+                            Transaction* txn,
+                            const RecordKey& mk,
+                            const RecordValue& rv) {
+  INVARIANT_D(rv.getRecordType() == RecordType::RT_KV && !rv.isChunked());
+  const auto& params = sess->getServerEntry()->getParams();
+  const std::string& val = rv.getValue();
+  if (params->kvPieceThreshold == 0 || val.size() <= params->kvPieceThreshold) {
+    return store->setKV(mk, rv, txn);
+  }
+
+  // a new version, so that the pieces of the old string are dropped
+  uint64_t version = rcd_util::genSubKeyVersion();
+  uint64_t pieceSize = params->kvPieceSize;
+  for (uint64_t idx = 0; idx * pieceSize < val.size(); ++idx) {
+    RecordValue piece(val.substr(idx * pieceSize, pieceSize),
+                      RecordType::RT_KV_PIECE,
+                      -1);
+    auto s =
+      store->setKV(rcd_util::makePieceKey(mk, version, idx), piece, txn);
+    RET_IF_ERR(s);
+  }
+  RecordValue meta("",
+                   RecordType::RT_KV,
+                   rv.getVersionEP(),
+                   rv.getTtl(),
+                   rv.getCas(),
+                   version,
+                   pieceSize);
+  meta.setTotalSize(val.size());
+  return store->setKV(mk, meta, txn);
+}
+
+uint64_t Command::getStringSize(const RecordValue& rv) {
+  return rv.isChunked() ? rv.getTotalSize() : rv.getValue().size();
+}
+
+Expected<std::string> Command::getStringRange(PStore store,
+                                              Transaction* txn,
+                                              const RecordKey& mk,
+                                              const RecordValue& rv,
+                                              uint64_t offset,
+                                              uint64_t len) {
+  uint64_t size = getStringSize(rv);
+  if (offset >= size) {
+    return std::string();
+  }
+  len = std::min(len, size - offset);
+  if (!rv.isChunked()) {
+    return rv.getValue().substr(offset, len);
+  }
+
+  std::string result;
+  result.reserve(len);
+  uint64_t pieceSize = rv.getPieceSize();
+  for (uint64_t idx = offset / pieceSize; result.size() < len; ++idx) {
+    uint64_t start = std::max(offset, idx * pieceSize) - idx * pieceSize;
+    uint64_t n = std::min(pieceSize - start, len - result.size());
+    auto piece =
+      store->getKV(rcd_util::makePieceKey(mk, rv.getVersion(), idx), txn);
+    if (piece.ok()) {
+      const std::string& v = piece.value().getValue();
+      if (start < v.size()) {
+        uint64_t m = std::min(n, v.size() - start);
+        result.append(v, start, m);
+        n -= m;
+      }
+    } else if (piece.status().code() != ErrorCodes::ERR_NOTFOUND) {
+      return piece.status();
+    }
+    // NOTE: the pieces beyond the old end are not written by
+    // setStringRange(), they are all zero.
+    result.append(n, '\0');
+  }
+  return result;
+}
+
+Status Command::loadChunkedString(PStore store,
+                                  Transaction* txn,
+                                  const RecordKey& mk,
+                                  RecordValue* rv) {
+  INVARIANT_D(rv->isChunked());
+  auto v = getStringRange(store, txn, mk, *rv, 0, rv->getTotalSize());
+  RET_IF_ERR_EXPECTED(v);
+  *rv = RecordValue(std::move(v.value()),
+                    RecordType::RT_KV,
+                    rv->getVersionEP(),
+                    rv->getTtl(),
+                    rv->getCas());
+  return {ErrorCodes::ERR_OK, ""};
+}
+
+Expected<uint64_t> Command::setStringRange(
+  Session* sess,
+  PStore store,
+  Transaction* txn,
+  const RecordKey& mk,
+  const Expected<RecordValue>& oldValue,
+  uint64_t offset,
+  const std::string& val) {
+  const auto& params = sess->getServerEntry()->getParams();
+  uint64_t versionEP = sess->getCtx()->getVersionEP();
+  uint64_t oldSize = oldValue.ok() ? getStringSize(oldValue.value()) : 0;
+  uint64_t newSize = std::max(oldSize, offset + val.size());
+  bool chunked = oldValue.ok() && oldValue.value().isChunked();
+  if (!chunked &&
+      (params->kvPieceThreshold == 0 || newSize <= params->kvPieceThreshold)) {
+    std::string cat;
+    if (oldValue.ok()) {
+      cat = oldValue.value().getValue();
+    }
+    cat.resize(newSize, 0);
+    cat.replace(offset, val.size(), val);
+    uint64_t ttl = oldValue.ok() ? oldValue.value().getTtl() : 0;
+    RecordValue rv(std::move(cat), RecordType::RT_KV, versionEP, ttl, oldValue);
+    Status s = store->setKV(mk, rv, txn);
+    RET_IF_ERR(s);
+    return newSize;
+  }
+
+  RecordValue meta("", RecordType::RT_KV, versionEP);
+  std::string base;
+  if (chunked) {
+    const RecordValue& old = oldValue.value();
+    meta = RecordValue("",
+                       RecordType::RT_KV,
+                       versionEP,
+                       old.getTtl(),
+                       old.getCas(),
+                       old.getVersion(),
+                       old.getPieceSize());
+  } else {
+    // turn into chunked, all the pieces are new
+    if (oldValue.ok()) {
+      base = oldValue.value().getValue();
+      meta.setTtl(oldValue.value().getTtl());
+      meta.setCas(oldValue.value().getCas());
+    }
+    meta.setVersion(rcd_util::genSubKeyVersion());
+    meta.setPieceSize(params->kvPieceSize);
+  }
+  meta.setTotalSize(newSize);
+
+  // write the pieces overlapping [offset, offset + val.size()), and all
+  // the pieces of base if it's newly chunked. The pieces all zero are
+  // skipped, see getStringRange().
+  uint64_t pieceSize = meta.getPieceSize();
+  uint64_t first = chunked ? offset / pieceSize : 0;
+  uint64_t end = chunked ? offset + val.size() : newSize;
+  for (uint64_t idx = first; idx * pieceSize < end; ++idx) {
+    uint64_t pieceStart = idx * pieceSize;
+    uint64_t pieceEnd = std::min(pieceStart + pieceSize, newSize);
+    bool overlapVal = offset < pieceEnd && offset + val.size() > pieceStart;
+    if (!overlapVal && pieceStart >= base.size()) {
+      continue;
+    }
+    RecordKey pk = rcd_util::makePieceKey(mk, meta.getVersion(), idx);
+    std::string piece;
+    if (chunked) {
+      auto epiece = store->getKV(pk, txn);
+      if (epiece.ok()) {
+        piece = epiece.value().getValue();
+      } else if (epiece.status().code() != ErrorCodes::ERR_NOTFOUND) {
+        return epiece.status();
+      }
+    } else if (pieceStart < base.size()) {
+      piece = base.substr(pieceStart, pieceSize);
+    }
+    if (overlapVal) {
+      uint64_t from = std::max(offset, pieceStart);
+      uint64_t to = std::min(offset + val.size(), pieceEnd);
+      if (piece.size() < to - pieceStart) {
+        piece.resize(to - pieceStart, 0);
+      }
+      piece.replace(
+        from - pieceStart, to - from, val, from - offset, to - from);
+    }
+    Status s = store->setKV(
+      pk, RecordValue(std::move(piece), RecordType::RT_KV_PIECE, -1), txn);
+    RET_IF_ERR(s);
+  }
+  Status s = store->setKV(mk, meta, txn);
+  RET_IF_ERR(s);
+  return newSize;
+}
+
+bool Command::isInlineEnabled(Session* sess, RecordType metaType) {
+  const auto& params = sess->getServerEntry()->getParams();
+  switch (metaType) {
+    case RecordType::RT_HASH_META:
+      return params->hashMaxInlineEntries > 0;
+    case RecordType::RT_SET_META:
+      return params->setMaxInlineEntries > 0;
+    case RecordType::RT_ZSET_META:
+      return params->zsetMaxInlineEntries > 0;
+    default:
+      return false;
+  }
+}
+
+uint8_t Command::getZSetEngine(Session* sess) {
+  const auto& params = sess->getServerEntry()->getParams();
+  if (params->zsetEngine == "index") {
+    return ZSlMetaValue::ENGINE_INDEX;
+  }
+  return ZSlMetaValue::ENGINE_SKIPLIST;
+}
+
+Status Command::spillInlineHash(Session* sess,
+                                PStore store,
+                                Transaction* txn,
+                                const RecordKey& mk,
+                                uint64_t version,
+                                HashMetaValue* meta) {
+  if (!meta->isInline()) {
+    return {ErrorCodes::ERR_OK, ""};
+  }
+  const auto& params = sess->getServerEntry()->getParams();
+  bool fits = meta->getCount() <= params->hashMaxInlineEntries;
+  for (const auto& v : meta->getFields()) {
+    if (!fits) {
+      break;
+    }
+    fits = v.first.size() <= params->hashMaxInlineValue &&
+      v.second.size() <= params->hashMaxInlineValue;
+  }
+  if (fits) {
+    return {ErrorCodes::ERR_OK, ""};
+  }
+  for (const auto& v : meta->getFields()) {
+    RecordKey subRk(mk.getChunkId(),
+                    mk.getDbId(),
+                    RecordType::RT_HASH_ELE,
+                    mk.getPrimaryKey(),
+                    v.first,
+                    version);
+    Status s = store->setKV(
+      subRk, RecordValue(v.second, RecordType::RT_HASH_ELE, -1), txn);
+    RET_IF_ERR(s);
+  }
+  meta->setInline(false);
+  return {ErrorCodes::ERR_OK, ""};
+}
+
+Status Command::spillInlineSet(Session* sess,
+                               PStore store,
+                               Transaction* txn,
+                               const RecordKey& mk,
+                               uint64_t version,
+                               SetMetaValue* meta) {
+  if (!meta->isInline()) {
+    return {ErrorCodes::ERR_OK, ""};
+  }
+  const auto& params = sess->getServerEntry()->getParams();
+  bool fits = meta->getCount() <= params->setMaxInlineEntries;
+  for (const auto& v : meta->getMembers()) {
+    if (!fits) {
+      break;
+    }
+    fits = v.size() <= params->setMaxInlineValue;
+  }
+  if (fits) {
+    return {ErrorCodes::ERR_OK, ""};
+  }
+  for (const auto& v : meta->getMembers()) {
+    RecordKey subRk(mk.getChunkId(),
+                    mk.getDbId(),
+                    RecordType::RT_SET_ELE,
+                    mk.getPrimaryKey(),
+                    v,
+                    version);
+    Status s =
+      store->setKV(subRk, RecordValue("", RecordType::RT_SET_ELE, -1), txn);
+    RET_IF_ERR(s);
+  }
+  meta->setInline(false);
+  return {ErrorCodes::ERR_OK, ""};
+}
+
+Status Command::spillInlineZSet(Session* sess,
+                                PStore store,
+                                Transaction* txn,
+                                const RecordKey& mk,
+                                uint64_t version,
+                                PZSetEngine* zset) {
+  if ((*zset)->getEngine() != ZSlMetaValue::ENGINE_INLINE) {
+    return {ErrorCodes::ERR_OK, ""};
+  }
+  const auto& params = sess->getServerEntry()->getParams();
+  const auto& eles = static_cast<ZInline*>(zset->get())->getEles();
+  bool fits = eles.size() <= params->zsetMaxInlineEntries;
+  for (const auto& v : eles) {
+    if (!fits) {
+      break;
+    }
+    fits = v.second.size() <= params->zsetMaxInlineValue;
+  }
+  if (fits) {
+    return {ErrorCodes::ERR_OK, ""};
+  }
+  auto esl = convertZSet(mk.getChunkId(),
+                         mk.getDbId(),
+                         mk.getPrimaryKey(),
+                         std::move(*zset),
+                         getZSetEngine(sess),
+                         version,
+                         store,
+                         txn);
+  RET_IF_ERR_EXPECTED(esl);
+  *zset = std::move(esl.value());
+  return {ErrorCodes::ERR_OK, ""};
+}
+
 // del meta and it's ttlindex
 Status Command::delKeyAndTTL(Session* sess,
                              const RecordKey& mk,
@@ -636,6 +1010,14 @@ Status Command::delKey(Session* sess, const std::string& key, RecordType tp) {
         (valueType == RecordType::RT_ZSET_META && cnt.value() >= 1024)) {
       LOG(INFO) << "bigkey delete:" << hexlify(mk.getPrimaryKey())
                 << ",rcdType:" << rt2Char(valueType) << ",size:" << cnt.value();
+      if (rcd_util::isVersionedType(valueType)) {
+        Status s =
+          Command::delVersionedKeyInLock(sess, mk, eValue.value(), txn.get());
+        if (s.code() == ErrorCodes::ERR_COMMIT_RETRY && i != RETRY_CNT - 1) {
+          continue;
+        }
+        return s;
+      }
       // reset txn, it is no longer used
       txn.reset();
       return Command::delKeyPessimisticInLock(
@@ -646,6 +1028,7 @@ Status Command::delKey(Session* sess, const std::string& key, RecordType tp) {
                                       storeId,
                                       mk,
                                       valueType,
+                                      eValue.value().getVersion(),
                                       txn.get(),
                                       ictx.getTTL() > 0 ? &ictx : nullptr);
       if (s.code() == ErrorCodes::ERR_COMMIT_RETRY && i != RETRY_CNT - 1) {
@@ -662,7 +1045,8 @@ Status Command::delKey(Session* sess, const std::string& key, RecordType tp) {
 Expected<RecordValue> Command::expireKeyIfNeeded(Session* sess,
                                                  const std::string& key,
                                                  RecordType tp,
-                                                 bool hasVersion) {
+                                                 bool hasVersion,
+                                                 bool loadPieces) {
   auto server = sess->getServerEntry();
   INVARIANT(server != nullptr);
   auto expdb = server->getSegmentMgr()->getDbWithKeyLock(sess, key, RdLock());
@@ -700,6 +1084,12 @@ Expected<RecordValue> Command::expireKeyIfNeeded(Session* sess,
         }
       }
       ++sess->getServerEntry()->getServerStat().keyspaceHits;
+      if (loadPieces && eValue.value().isChunked()) {
+        auto s = loadChunkedString(kvstore, txn.get(), mk, &eValue.value());
+        if (!s.ok()) {
+          return s;
+        }
+      }
       return eValue.value();
     } else if (txn->isReplOnly()) {
       // NOTE(vinchen): if replOnly, it can't delete record, but return
@@ -715,18 +1105,31 @@ Expected<RecordValue> Command::expireKeyIfNeeded(Session* sess,
     if (cnt.value() >= 2048) {
       LOG(INFO) << "bigkey delete:" << hexlify(mk.getPrimaryKey())
                 << ",rcdType:" << rt2Char(valueType) << ",size:" << cnt.value();
-      // reset txn, it is no longer used
-      txn.reset();
-      Status s =
-        Command::delKeyPessimisticInLock(sess, storeId, mk, valueType, &ictx);
+      Status s;
+      if (rcd_util::isVersionedType(valueType)) {
+        s = Command::delVersionedKeyInLock(sess, mk, eValue.value(), txn.get());
+        if (s.code() == ErrorCodes::ERR_COMMIT_RETRY && i != RETRY_CNT - 1) {
+          continue;
+        }
+      } else {
+        // reset txn, it is no longer used
+        txn.reset();
+        s = Command::delKeyPessimisticInLock(
+          sess, storeId, mk, valueType, &ictx);
+      }
       if (s.ok()) {
         return {ErrorCodes::ERR_EXPIRED, ""};
       } else {
         return s;
       }
     } else {
-      Status s = Command::delKeyOptimismInLock(
-        sess, storeId, mk, valueType, txn.get(), &ictx);
+      Status s = Command::delKeyOptimismInLock(sess,
+                                               storeId,
+                                               mk,
+                                               valueType,
+                                               eValue.value().getVersion(),
+                                               txn.get(),
+                                               &ictx);
       if (s.code() == ErrorCodes::ERR_COMMIT_RETRY && i != RETRY_CNT - 1) {
         continue;
       }
@@ -742,6 +1145,101 @@ Expected<RecordValue> Command::expireKeyIfNeeded(Session* sess,
   return {ErrorCodes::ERR_INTERNAL, "not reachable"};
 }
 
+std::vector<Expected<RecordValue>> Command::expireKeysIfNeeded(
+  Session* sess,
+  const std::vector<std::string>& args,
+  const std::vector<int>& index,
+  RecordType tp,
+  bool hasVersion) {
+  auto server = sess->getServerEntry();
+  INVARIANT(server != nullptr);
+  SessionCtx* pCtx = sess->getCtx();
+  INVARIANT(pCtx != nullptr);
+
+  std::vector<Expected<RecordValue>> result;
+  result.reserve(index.size());
+  for (size_t i = 0; i < index.size(); ++i) {
+    result.emplace_back(ErrorCodes::ERR_NOTFOUND, "");
+  }
+
+  struct StoreBatch {
+    PStore store;
+    std::vector<RecordKey> keys;
+    std::vector<size_t> pos;
+  };
+  std::map<uint32_t, StoreBatch> batches;
+  for (size_t i = 0; i < index.size(); ++i) {
+    const std::string& key = args[index[i]];
+    auto expdb = server->getSegmentMgr()->getDbHasLocked(sess, key);
+    if (!expdb.ok()) {
+      result[i] = expdb.status();
+      continue;
+    }
+    auto& batch = batches[expdb.value().dbId];
+    batch.store = expdb.value().store;
+    batch.keys.emplace_back(
+      expdb.value().chunkId, pCtx->getDbId(), tp, key, "");
+    batch.pos.emplace_back(i);
+  }
+
+  std::vector<size_t> expired;
+  uint64_t currentTs = msSinceEpoch();
+  for (auto& kv : batches) {
+    auto& batch = kv.second;
+    auto ptxn = batch.store->createTransaction(sess);
+    if (!ptxn.ok()) {
+      for (auto i : batch.pos) {
+        result[i] = ptxn.status();
+      }
+      continue;
+    }
+    auto values = batch.store->getKVs(batch.keys, ptxn.value().get());
+    INVARIANT_D(values.size() == batch.pos.size());
+    for (size_t j = 0; j < values.size(); ++j) {
+      size_t i = batch.pos[j];
+      auto& eValue = values[j];
+      if (!eValue.ok()) {
+        if (eValue.status().code() == ErrorCodes::ERR_NOTFOUND) {
+          ++server->getServerStat().keyspaceMisses;
+        }
+        result[i] = std::move(eValue);
+        continue;
+      }
+      uint64_t targetTtl = eValue.value().getTtl();
+      if (!_noexpire && targetTtl != 0 && currentTs >= targetTtl) {
+        expired.emplace_back(i);
+        continue;
+      }
+      if (eValue.value().getRecordType() != tp &&
+          tp != RecordType::RT_DATA_META) {
+        result[i] = {ErrorCodes::ERR_WRONG_TYPE, ""};
+        continue;
+      }
+      if (hasVersion && !pCtx->verifyVersion(eValue.value().getVersionEP())) {
+        ++server->getServerStat().keyspaceIncorrectEp;
+        result[i] = {ErrorCodes::ERR_WRONG_VERSION_EP, ""};
+        continue;
+      }
+      ++server->getServerStat().keyspaceHits;
+      if (eValue.value().isChunked()) {
+        auto s = loadChunkedString(
+          batch.store, ptxn.value().get(), batch.keys[j], &eValue.value());
+        if (!s.ok()) {
+          result[i] = s;
+          continue;
+        }
+      }
+      result[i] = std::move(eValue);
+    }
+  }
+
+  // NOTE: expired keys are rare, delete them one by one lazily
+  for (auto i : expired) {
+    result[i] = expireKeyIfNeeded(sess, args[index[i]], tp, hasVersion);
+  }
+  return result;
+}
+
 std::string Command::fmtErr(const std::string& s) {
   if (s.size() != 0 && s[0] == '-') {
     return s;
@@ -755,6 +1253,10 @@ std::string Command::fmtNull() {
   return "$-1\r\n";
 }
 
+std::string Command::fmtNullArray() {
+  return "*-1\r\n";
+}
+
 std::string Command::fmtOK() {
   return "+OK\r\n";
 }
@@ -819,6 +1321,31 @@ std::stringstream& Command::fmtLongLong(std::stringstream& ss, int64_t v) {
   return ss;
 }
 
+ReplyBuffer& Command::fmtMultiBulkLen(ReplyBuffer& rb, uint64_t l) {
+  rb.appendMultiBulkLen(l);
+  return rb;
+}
+
+ReplyBuffer& Command::fmtBulk(ReplyBuffer& rb, const std::string& s) {
+  rb.appendBulk(s);
+  return rb;
+}
+
+ReplyBuffer& Command::fmtStatus(ReplyBuffer& rb, const std::string& s) {
+  rb.appendStatus(s);
+  return rb;
+}
+
+ReplyBuffer& Command::fmtNull(ReplyBuffer& rb) {
+  rb.appendNull();
+  return rb;
+}
+
+ReplyBuffer& Command::fmtLongLong(ReplyBuffer& rb, int64_t v) {
+  rb.appendLongLong(v);
+  return rb;
+}
+
 std::string Command::fmtBulk(const std::string& s) {
   std::stringstream ss;
   ss << "$" << s.size() << "\r\n";
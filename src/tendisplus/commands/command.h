@@ -16,6 +16,7 @@
 #include "tendisplus/network/session_ctx.h"
 #include "tendisplus/lock/lock.h"
 #include "tendisplus/storage/kvstore.h"
+#include "tendisplus/storage/skiplist.h"
 #include "tendisplus/server/server_entry.h"
 
 namespace tendisplus {
@@ -26,6 +27,10 @@ class Command {
   explicit Command(const std::string& name, const char* sflags);
   virtual ~Command() = default;
   virtual Expected<std::string> run(Session* sess) = 0;
+  // commands with big replies may override this to build the reply in
+  // pooled chunks, the default one appends the result of run().
+  // the reply is discarded if an error is returned.
+  virtual Status runReply(Session* sess, ReplyBuffer* reply);
 
   // if arity() > 0, it means the arguments count must equal to arity();
   // else, it means the arguments count must bigger than -arity();
@@ -64,6 +69,7 @@ class Command {
   // precheck returns command name
   static Expected<Command*> precheck(Session* sess);
   static Expected<std::string> runSessionCmd(Session* sess);
+  static Status runSessionCmd(Session* sess, ReplyBuffer* reply);
   static bool isAdminCmd(const std::string& cmd);
   // static bool isKeyLocked(Session *sess,
   //                         uint32_t storeId,
@@ -72,10 +78,24 @@ class Command {
   // return ERR_OK if not expired
   // return ERR_EXPIRED if expired
   // return errors on other unexpected conditions
+  // A chunked string is read as a whole unless loadPieces is false, then
+  // the caller should hold the key lock to read its pieces.
   static Expected<RecordValue> expireKeyIfNeeded(Session* sess,
                                                  const std::string& key,
                                                  RecordType tp,
-                                                 bool hasVersion = true);
+                                                 bool hasVersion = true,
+                                                 bool loadPieces = true);
+  // the batched version of expireKeyIfNeeded() for args[index[i]], the
+  // results are in the same order as index. The keys should have been
+  // locked by the caller, see SegmentMgr::getAllKeysLocked().
+  // Keys are grouped by kvstore and read with one MultiGet per kvstore,
+  // only the expired keys go through expireKeyIfNeeded() afterwards.
+  static std::vector<Expected<RecordValue>> expireKeysIfNeeded(
+    Session* sess,
+    const std::vector<std::string>& args,
+    const std::vector<int>& index,
+    RecordType tp,
+    bool hasVersion = true);
 
   static Expected<std::pair<std::string, std::list<Record>>> scan(
     const std::string& pk,
@@ -96,8 +116,74 @@ class Command {
                                         const std::string& key,
                                         RecordType tp);
 
+  // A string longer than kvPieceThreshold is saved as chunked, see
+  // RecordValue::isChunked(), so that a range of it can be read or
+  // written without touching the other pieces. The key should be locked.
+  // save rv as chunked if it's too long
+  static Status setStringKV(Session* sess,
+                            PStore store,
+                            Transaction* txn,
+                            const RecordKey& mk,
+                            const RecordValue& rv);
+  static uint64_t getStringSize(const RecordValue& rv);
+  // read [offset, offset + len) of the string, truncated at its end
+  static Expected<std::string> getStringRange(PStore store,
+                                              Transaction* txn,
+                                              const RecordKey& mk,
+                                              const RecordValue& rv,
+                                              uint64_t offset,
+                                              uint64_t len);
+  // read the pieces of a chunked string into rv, it's not chunked then
+  static Status loadChunkedString(PStore store,
+                                  Transaction* txn,
+                                  const RecordKey& mk,
+                                  RecordValue* rv);
+  // overwrite [offset, offset + val.size()) of the string, it's padded
+  // with zero if it's shorter than offset. oldValue is the string before,
+  // ERR_NOTFOUND if not exists. Only the pieces in the range are written
+  // if it's chunked. Return the length of the new string.
+  static Expected<uint64_t> setStringRange(
+    Session* sess,
+    PStore store,
+    Transaction* txn,
+    const RecordKey& mk,
+    const Expected<RecordValue>& oldValue,
+    uint64_t offset,
+    const std::string& val);
+
+  // A small hash/set/zset is saved inline in its meta, see HashMetaValue.
+  // whether a new key of metaType is saved inline
+  static bool isInlineEnabled(Session* sess, RecordType metaType);
+  // An inline hash/set is converted to the subkey layout once it grows
+  // beyond hashMaxInlineEntries/hashMaxInlineValue(or the set ones). The
+  // elements are written as the subkeys of version then, and the meta is
+  // no longer inline, which should be saved by the caller.
+  static Status spillInlineHash(Session* sess,
+                                PStore store,
+                                Transaction* txn,
+                                const RecordKey& mk,
+                                uint64_t version,
+                                HashMetaValue* meta);
+  static Status spillInlineSet(Session* sess,
+                               PStore store,
+                               Transaction* txn,
+                               const RecordKey& mk,
+                               uint64_t version,
+                               SetMetaValue* meta);
+  // An inline zset is converted to the configured engine the same way,
+  // see ZInline. The meta is written by ZSetEngine::save() of zset.
+  static Status spillInlineZSet(Session* sess,
+                                PStore store,
+                                Transaction* txn,
+                                const RecordKey& mk,
+                                uint64_t version,
+                                PZSetEngine* zset);
+  // the engine of new zsets, see ZSlMetaValue::getEngine()
+  static uint8_t getZSetEngine(Session* sess);
+
   static std::string fmtErr(const std::string& s);
   static std::string fmtNull();
+  static std::string fmtNullArray();
   static std::string fmtOK();
   static std::string fmtOne();
   static std::string fmtZero();
@@ -114,10 +200,18 @@ class Command {
   static std::stringstream& fmtStatus(std::stringstream&, const std::string&);
   static std::stringstream& fmtNull(std::stringstream&);
   static std::stringstream& fmtLongLong(std::stringstream&, int64_t);
+  static ReplyBuffer& fmtMultiBulkLen(ReplyBuffer&, uint64_t);
+  static ReplyBuffer& fmtBulk(ReplyBuffer&, const std::string&);
+  static ReplyBuffer& fmtStatus(ReplyBuffer&, const std::string&);
+  static ReplyBuffer& fmtNull(ReplyBuffer&);
+  static ReplyBuffer& fmtLongLong(ReplyBuffer&, int64_t);
 
   static constexpr int32_t RETRY_CNT = 3;
 
  protected:
+  // run() of the commands overriding runReply()
+  Expected<std::string> runReplyToString(Session* sess);
+
   static std::mutex _mutex;
   // protected by mutex
   static const uint32_t _maxUnseenCmdNum = 10000;
@@ -137,14 +231,24 @@ class Command {
                                      uint32_t storeId,
                                      const RecordKey& rk,
                                      RecordType valueType,
+                                     uint64_t version,
                                      Transaction* txn,
                                      const TTLIndex* ictx = nullptr);
 
+  // delete a big key whose subkeys are versioned in O(1), only the meta
+  // and its ttlindex are deleted, the subkeys are dropped by the
+  // compaction filter later. txn is committed here.
+  static Status delVersionedKeyInLock(Session* sess,
+                                      const RecordKey& mk,
+                                      const RecordValue& val,
+                                      Transaction* txn);
+
   static Expected<uint32_t> partialDelSubKeys(Session* sess,
                                               uint32_t storeId,
                                               uint32_t subCount,
                                               const RecordKey& mk,
                                               RecordType valueType,
+                                              uint64_t version,
                                               bool deleteMeta,
                                               Transaction* txn,
                                               const TTLIndex* ictx = nullptr);
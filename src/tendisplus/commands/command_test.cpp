@@ -9,6 +9,10 @@
 #include <limits>
 #include <algorithm>
 #include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <chrono>
 #include "gtest/gtest.h"
 #include "tendisplus/utils/status.h"
 #include "tendisplus/utils/scopeguard.h"
@@ -128,14 +132,46 @@ void testDel(std::shared_ptr<ServerEntry> svr) {
     MakeGuard([] { SyncPoint::GetInstance()->ClearAllCallBacks(); });
   std::cout << "begin delete zset" << std::endl;
   SyncPoint::GetInstance()->EnableProcessing();
+  // the subkeys of zset are versioned, only the meta is deleted
+  bool pessimisticDel = false;
   SyncPoint::GetInstance()->SetCallBack(
-    "delKeyPessimistic::TotalCount", [&](void* arg) {
-      uint64_t v = *(static_cast<uint64_t*>(arg));
-      EXPECT_EQ(v, 20001U);
-    });
+    "delKeyPessimistic::TotalCount",
+    [&](void* arg) { pessimisticDel = true; });
+  uint64_t dropped = 0;
+  SyncPoint::GetInstance()->SetCallBack(
+    "InspectSubKeyDroppedCount",
+    [&](void* arg) { dropped += *(static_cast<uint64_t*>(arg)); });
   sess.setArgs({"del", "testzsetdel"});
   auto expect = Command::runSessionCmd(&sess);
   EXPECT_TRUE(expect.ok());
+  EXPECT_EQ(expect.value(), Command::fmtOne());
+  EXPECT_FALSE(pessimisticDel);
+
+  // the stale subkeys are invisible to the new key
+  sess.setArgs({"zcard", "testzsetdel"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  EXPECT_EQ(expect.value(), Command::fmtZero());
+  sess.setArgs({"zadd", "testzsetdel", "1", "1"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  EXPECT_EQ(expect.value(), Command::fmtOne());
+  sess.setArgs({"zrange", "testzsetdel", "0", "-1"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  EXPECT_EQ(expect.value(), "*1\r\n$1\r\n1\r\n");
+
+  // and dropped by the compaction filter: 10000 * 2 + the head node
+  for (auto& store : svr->getStores()) {
+    auto s = store->compactRange(
+      ColumnFamilyNumber::ColumnFamily_Default, nullptr, nullptr);
+    EXPECT_TRUE(s.ok());
+  }
+  EXPECT_EQ(dropped, 20001U);
+  sess.setArgs({"zrange", "testzsetdel", "0", "-1"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  EXPECT_EQ(expect.value(), "*1\r\n$1\r\n1\r\n");
 }
 
 TEST(Command, del) {
@@ -564,6 +600,96 @@ void testScan(std::shared_ptr<ServerEntry> svr) {
   EXPECT_EQ(ss.str(), expect.value());
 }
 
+// parse the reply of scan: *2 $cursor *N $key...
+void parseScanReply(const std::string& reply,
+                    std::string* cursor,
+                    std::vector<std::string>* keys) {
+  size_t pos = reply.find("\r\n") + 2;
+  auto readBulk = [&reply, &pos]() {
+    INVARIANT(reply[pos] == '$');
+    size_t end = reply.find("\r\n", pos);
+    size_t len = std::stoul(reply.substr(pos + 1, end - pos - 1));
+    std::string v = reply.substr(end + 2, len);
+    pos = end + 2 + len + 2;
+    return v;
+  };
+  *cursor = readBulk();
+  INVARIANT(reply[pos] == '*');
+  size_t end = reply.find("\r\n", pos);
+  size_t n = std::stoul(reply.substr(pos + 1, end - pos - 1));
+  pos = end + 2;
+  for (size_t i = 0; i < n; ++i) {
+    keys->emplace_back(readBulk());
+  }
+}
+
+void testKeyspaceScan(std::shared_ptr<ServerEntry> svr) {
+  asio::io_context ioContext;
+  asio::ip::tcp::socket socket(ioContext);
+  NetSession sess(svr, std::move(socket), 1, false, nullptr, nullptr);
+
+  std::set<std::string> kvKeys, hashKeys;
+  for (int i = 0; i < 100; ++i) {
+    std::string key = "scankv_" + std::to_string(i);
+    sess.setArgs({"set", key, "v"});
+    auto expect = Command::runSessionCmd(&sess);
+    EXPECT_TRUE(expect.ok());
+    kvKeys.insert(key);
+  }
+  for (int i = 0; i < 10; ++i) {
+    std::string key = "scanhash_" + std::to_string(i);
+    for (int j = 0; j < 20; ++j) {
+      sess.setArgs({"hset", key, std::to_string(j), "v"});
+      auto expect = Command::runSessionCmd(&sess);
+      EXPECT_TRUE(expect.ok());
+    }
+    hashKeys.insert(key);
+  }
+  sess.setArgs({"set", "scanexpired", "v", "px", "1"});
+  auto expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+  auto scanAll = [&sess](const std::vector<std::string>& opts) {
+    std::set<std::string> result;
+    std::string cursor = "0";
+    uint32_t calls = 0;
+    do {
+      std::vector<std::string> args = {"scan", cursor};
+      args.insert(args.end(), opts.begin(), opts.end());
+      sess.setArgs(args);
+      auto expect = Command::runSessionCmd(&sess);
+      EXPECT_TRUE(expect.ok()) << expect.status().toString();
+      std::vector<std::string> keys;
+      parseScanReply(expect.value(), &cursor, &keys);
+      for (auto& key : keys) {
+        // no duplicated key without writes in between
+        EXPECT_TRUE(result.insert(key).second) << key;
+      }
+      calls++;
+    } while (cursor != "0");
+    EXPECT_GT(calls, 1U);
+    return result;
+  };
+
+  std::set<std::string> all = kvKeys;
+  all.insert(hashKeys.begin(), hashKeys.end());
+  EXPECT_EQ(scanAll({"count", "7"}), all);
+  EXPECT_EQ(scanAll({"count", "3", "type", "hash"}), hashKeys);
+  EXPECT_EQ(scanAll({"match", "scankv_*", "count", "5"}), kvKeys);
+  EXPECT_EQ(scanAll({"type", "zset"}), std::set<std::string>());
+
+  sess.setArgs({"scan", "0", "count", "0"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_FALSE(expect.ok());
+  sess.setArgs({"scan", "0", "count"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_FALSE(expect.ok());
+  sess.setArgs({"scan", "xyz"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_FALSE(expect.ok());
+}
+
 void testMulti(std::shared_ptr<ServerEntry> svr) {
   asio::io_context ioCtx;
   asio::ip::tcp::socket socket(ioCtx), socket1(ioCtx);
@@ -638,6 +764,88 @@ void testMulti(std::shared_ptr<ServerEntry> svr) {
   EXPECT_TRUE(!expect.ok());
 }
 
+void testExec(std::shared_ptr<ServerEntry> svr) {
+  asio::io_context ioCtx;
+  asio::ip::tcp::socket socket(ioCtx), socket1(ioCtx);
+  NetSession sess(svr, std::move(socket), 1, false, nullptr, nullptr);
+  NetSession sess1(svr, std::move(socket1), 1, false, nullptr, nullptr);
+
+  // the commands are queued by ServerEntry::processRequest()
+  sess.setArgs({"multi"});
+  auto expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  EXPECT_TRUE(sess.getCtx()->getFlags() & CLIENT_MULTI_QUEUED);
+  sess.getCtx()->queueMultiCmd({"set", "execkey", "1"});
+  sess.getCtx()->queueMultiCmd({"incr", "execkey"});
+  sess.getCtx()->queueMultiCmd({"hset", "execkey", "f", "v"});
+  sess.getCtx()->queueMultiCmd({"get", "execkey"});
+  sess.setArgs({"exec"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  // the error of a command doesn't stop the others
+  EXPECT_EQ(expect.value(),
+            "*4\r\n+OK\r\n:2\r\n" +
+              Status::getErrStr(ErrorCodes::ERR_WRONG_TYPE) + "$1\r\n2\r\n");
+  EXPECT_FALSE(sess.getCtx()->isInMulti());
+
+  sess.setArgs({"exec"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_FALSE(expect.ok());
+
+  // a watched key written by another session aborts exec
+  sess.setArgs({"watch", "execkey"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  sess1.setArgs({"set", "execkey", "3"});
+  expect = Command::runSessionCmd(&sess1);
+  EXPECT_TRUE(expect.ok());
+  sess.setArgs({"multi"});
+  expect = Command::runSessionCmd(&sess);
+  sess.getCtx()->queueMultiCmd({"incr", "execkey"});
+  sess.setArgs({"exec"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  EXPECT_EQ(expect.value(), Command::fmtNullArray());
+
+  // reading a watched key doesn't abort exec
+  sess.setArgs({"watch", "execkey"});
+  expect = Command::runSessionCmd(&sess);
+  sess1.setArgs({"get", "execkey"});
+  expect = Command::runSessionCmd(&sess1);
+  sess.setArgs({"multi"});
+  expect = Command::runSessionCmd(&sess);
+  sess.getCtx()->queueMultiCmd({"incr", "execkey"});
+  sess.setArgs({"exec"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  EXPECT_EQ(expect.value(), "*1\r\n:4\r\n");
+
+  // the watched key is expired
+  sess.setArgs({"pexpire", "execkey", "10"});
+  expect = Command::runSessionCmd(&sess);
+  sess.setArgs({"watch", "execkey"});
+  expect = Command::runSessionCmd(&sess);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  sess.setArgs({"multi"});
+  expect = Command::runSessionCmd(&sess);
+  sess.getCtx()->queueMultiCmd({"incr", "execkey"});
+  sess.setArgs({"exec"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  EXPECT_EQ(expect.value(), Command::fmtNullArray());
+
+  // discard
+  sess.setArgs({"multi"});
+  expect = Command::runSessionCmd(&sess);
+  sess.getCtx()->queueMultiCmd({"incr", "execkey"});
+  sess.setArgs({"discard"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  sess.setArgs({"exists", "execkey"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_EQ(expect.value(), Command::fmtZero());
+}
+
 void testMaxClients(std::shared_ptr<ServerEntry> svr) {
   asio::io_context ioContext;
   asio::ip::tcp::socket socket(ioContext), socket1(ioContext);
@@ -911,6 +1119,337 @@ void testObject(std::shared_ptr<ServerEntry> svr) {
   EXPECT_TRUE(expect.ok());
 }
 
+void testMget(std::shared_ptr<ServerEntry> svr) {
+  asio::io_context ioContext;
+  asio::ip::tcp::socket socket(ioContext);
+  NetSession sess(svr, std::move(socket), 1, false, nullptr, nullptr);
+
+  // keys spread over all the kvstores
+  std::vector<std::string> args = {"mget"};
+  std::stringstream ss;
+  Command::fmtMultiBulkLen(ss, 103);
+  for (int i = 0; i < 100; ++i) {
+    std::string key = "mgetkey_" + std::to_string(i);
+    sess.setArgs({"set", key, std::to_string(i)});
+    auto expect = Command::runSessionCmd(&sess);
+    EXPECT_TRUE(expect.ok());
+    args.emplace_back(key);
+    Command::fmtBulk(ss, std::to_string(i));
+  }
+  sess.setArgs({"hset", "mgethash", "f1", "v1"});
+  auto expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  sess.setArgs({"set", "mgetexpired", "v", "px", "1"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  for (auto key : {"mgethash", "mgetexpired", "mgetnotfound"}) {
+    args.emplace_back(key);
+    Command::fmtNull(ss);
+  }
+
+  sess.setArgs(args);
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  EXPECT_EQ(ss.str(), expect.value());
+
+  // the expired key is deleted
+  sess.setArgs({"exists", "mgetexpired"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  EXPECT_EQ(Command::fmtZero(), expect.value());
+
+  sess.setArgs({"hset", "mgethash", "f2", "v2"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  sess.setArgs({"hmget", "mgethash", "f2", "f3", "f1", "f2"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  ss.str("");
+  Command::fmtMultiBulkLen(ss, 4);
+  Command::fmtBulk(ss, "v2");
+  Command::fmtNull(ss);
+  Command::fmtBulk(ss, "v1");
+  Command::fmtBulk(ss, "v2");
+  EXPECT_EQ(ss.str(), expect.value());
+}
+
+void testChunkedString(std::shared_ptr<ServerEntry> svr) {
+  asio::io_context ioContext;
+  asio::ip::tcp::socket socket(ioContext);
+  NetSession sess(svr, std::move(socket), 1, false, nullptr, nullptr);
+
+  // kvPieceThreshold is 1000, kvPieceSize is 100
+  std::string value;
+  for (int i = 0; i < 2500; ++i) {
+    value.push_back('a' + i % 26);
+  }
+  auto check = [&sess](const std::string& key, const std::string& expect) {
+    sess.setArgs({"get", key});
+    auto ret = Command::runSessionCmd(&sess);
+    EXPECT_TRUE(ret.ok());
+    EXPECT_EQ(ret.value(), Command::fmtBulk(expect));
+    sess.setArgs({"strlen", key});
+    ret = Command::runSessionCmd(&sess);
+    EXPECT_TRUE(ret.ok());
+    EXPECT_EQ(ret.value(), Command::fmtLongLong(expect.size()));
+  };
+
+  sess.setArgs({"set", "chunked", value});
+  auto expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  check("chunked", value);
+  sess.setArgs({"getrange", "chunked", "150", "349"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  EXPECT_EQ(expect.value(), Command::fmtBulk(value.substr(150, 200)));
+
+  sess.setArgs({"append", "chunked", "xyz"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  EXPECT_EQ(expect.value(), Command::fmtLongLong(2503));
+  value.append("xyz");
+  check("chunked", value);
+
+  // the pieces in the gap are not written
+  sess.setArgs({"setrange", "chunked", "5000", "abc"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  EXPECT_EQ(expect.value(), Command::fmtLongLong(5003));
+  value.resize(5000, 0);
+  value.append("abc");
+  check("chunked", value);
+  sess.setArgs({"getrange", "chunked", "2490", "-1"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  EXPECT_EQ(expect.value(), Command::fmtBulk(value.substr(2490)));
+
+  sess.setArgs({"setbit", "chunked", "3001", "1"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  EXPECT_EQ(expect.value(), Command::fmtZero());
+  value[375] = 0x40;
+  check("chunked", value);
+  sess.setArgs({"getbit", "chunked", "3001"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  EXPECT_EQ(expect.value(), Command::fmtOne());
+  sess.setArgs({"bitpos", "chunked", "1", "300"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  EXPECT_EQ(expect.value(), Command::fmtLongLong(3001));
+  sess.setArgs({"bitcount", "chunked", "300", "4999"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  EXPECT_EQ(expect.value(),
+            Command::fmtLongLong(redis_port::popCount(&value[300], 4700)));
+
+  sess.setArgs({"bitfield", "chunked", "set", "u8", "#4000", "255"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  value[4000] = static_cast<char>(255);
+  check("chunked", value);
+
+  sess.setArgs({"rename", "chunked", "chunked2"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  check("chunked2", value);
+  sess.setArgs({"exists", "chunked"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  EXPECT_EQ(expect.value(), Command::fmtZero());
+
+  // the pieces of the old strings are dropped by the compaction filter
+  sess.setArgs({"set", "chunked2", "small"});
+  expect = Command::runSessionCmd(&sess);
+  EXPECT_TRUE(expect.ok());
+  check("chunked2", "small");
+  uint64_t dropped = 0;
+  for (auto& store : svr->getStores()) {
+    auto s = store->compactRange(
+      ColumnFamilyNumber::ColumnFamily_Default, nullptr, nullptr);
+    EXPECT_TRUE(s.ok());
+    dropped += store->stat.compactSubKeyDroppedCount.load();
+  }
+  EXPECT_GT(dropped, 0U);
+  check("chunked2", "small");
+}
+
+TEST(Command, chunkedString) {
+  const auto guard = MakeGuard([] { destroyEnv(); });
+
+  EXPECT_TRUE(setupEnv());
+  auto cfg = makeServerParam();
+  cfg->kvPieceThreshold = 1000;
+  cfg->kvPieceSize = 100;
+  auto server = makeServerEntry(cfg);
+
+  testChunkedString(server);
+
+#ifndef _WIN32
+  server->stop();
+  EXPECT_EQ(server.use_count(), 1);
+#endif
+}
+
+void testInlineHashSet(std::shared_ptr<ServerEntry> svr) {
+  asio::io_context ioContext;
+  asio::ip::tcp::socket socket(ioContext);
+  NetSession sess(svr, std::move(socket), 1, false, nullptr, nullptr);
+
+  auto run = [&sess](const std::vector<std::string>& args) {
+    sess.setArgs(args);
+    auto ret = Command::runSessionCmd(&sess);
+    EXPECT_TRUE(ret.ok());
+    return ret.value();
+  };
+
+  // hashMaxInlineEntries is 4, hashMaxInlineValue is 8
+  run({"hset", "h", "f1", "v1"});
+  run({"hmset", "h", "f2", "v2", "f3", "v3"});
+  EXPECT_EQ(run({"object", "encoding", "h"}), Command::fmtBulk("ziplist"));
+  EXPECT_EQ(run({"hget", "h", "f2"}), Command::fmtBulk("v2"));
+  EXPECT_EQ(run({"hdel", "h", "f1"}), Command::fmtOne());
+  EXPECT_EQ(run({"hlen", "h"}), Command::fmtLongLong(2));
+  EXPECT_EQ(run({"hincrby", "h", "n", "5"}), Command::fmtLongLong(5));
+
+  // a long value spills the fields out of the meta
+  run({"hset", "h", "f4", "a value longer than 8"});
+  EXPECT_EQ(run({"object", "encoding", "h"}), Command::fmtBulk("hashtable"));
+  EXPECT_EQ(run({"hlen", "h"}), Command::fmtLongLong(4));
+  std::stringstream ss;
+  Command::fmtMultiBulkLen(ss, 2);
+  Command::fmtBulk(ss, "v3");
+  Command::fmtNull(ss);
+  EXPECT_EQ(run({"hmget", "h", "f3", "f1"}), ss.str());
+
+  // setMaxInlineEntries is 4
+  run({"sadd", "s", "a", "b", "c"});
+  EXPECT_EQ(run({"sismember", "s", "b"}), Command::fmtOne());
+  EXPECT_EQ(run({"srem", "s", "b"}), Command::fmtOne());
+  EXPECT_EQ(run({"scard", "s"}), Command::fmtLongLong(2));
+  run({"sadd", "s2", "c", "d"});
+  ss.str("");
+  Command::fmtMultiBulkLen(ss, 1);
+  Command::fmtBulk(ss, "c");
+  EXPECT_EQ(run({"sinter", "s", "s2"}), ss.str());
+
+  // too many members spill
+  run({"sadd", "s", "d", "e", "f"});
+  EXPECT_EQ(run({"scard", "s"}), Command::fmtLongLong(5));
+  EXPECT_EQ(run({"sismember", "s", "a"}), Command::fmtOne());
+  EXPECT_EQ(run({"sismember", "s", "b"}), Command::fmtZero());
+  ss.str("");
+  Command::fmtMultiBulkLen(ss, 2);
+  Command::fmtBulk(ss, "c");
+  Command::fmtBulk(ss, "d");
+  EXPECT_EQ(run({"sinter", "s", "s2"}), ss.str());
+
+  // an inline key is deleted with its meta
+  EXPECT_EQ(run({"del", "s2"}), Command::fmtOne());
+  EXPECT_EQ(run({"exists", "s2"}), Command::fmtZero());
+}
+
+TEST(Command, inlineHashSet) {
+  const auto guard = MakeGuard([] { destroyEnv(); });
+
+  EXPECT_TRUE(setupEnv());
+  auto cfg = makeServerParam();
+  cfg->hashMaxInlineEntries = 4;
+  cfg->hashMaxInlineValue = 8;
+  cfg->setMaxInlineEntries = 4;
+  auto server = makeServerEntry(cfg);
+
+  testInlineHashSet(server);
+
+#ifndef _WIN32
+  server->stop();
+  EXPECT_EQ(server.use_count(), 1);
+#endif
+}
+
+void testInlineZSet(std::shared_ptr<ServerEntry> svr) {
+  asio::io_context ioContext;
+  asio::ip::tcp::socket socket(ioContext);
+  NetSession sess(svr, std::move(socket), 1, false, nullptr, nullptr);
+
+  auto run = [&sess](const std::vector<std::string>& args) {
+    sess.setArgs(args);
+    auto ret = Command::runSessionCmd(&sess);
+    EXPECT_TRUE(ret.ok());
+    return ret.value();
+  };
+
+  // zsetMaxInlineEntries is 4, zsetMaxInlineValue is 8
+  run({"zadd", "z", "3", "c", "1", "a", "2", "b"});
+  EXPECT_EQ(run({"object", "encoding", "z"}), Command::fmtBulk("ziplist"));
+  EXPECT_EQ(run({"zscore", "z", "b"}), Command::fmtBulk("2"));
+  EXPECT_EQ(run({"zrank", "z", "c"}), Command::fmtLongLong(2));
+  EXPECT_EQ(run({"zincrby", "z", "5", "a"}), Command::fmtBulk("6"));
+  EXPECT_EQ(run({"zrevrank", "z", "a"}), Command::fmtLongLong(0));
+  EXPECT_EQ(run({"zrem", "z", "b", "x"}), Command::fmtOne());
+  EXPECT_EQ(run({"zcard", "z"}), Command::fmtLongLong(2));
+  run({"zadd", "z2", "1", "c", "1", "d"});
+  run({"zinterstore", "z3", "2", "z", "z2"});
+  EXPECT_EQ(run({"zscore", "z3", "c"}), Command::fmtBulk("4"));
+
+  // a long member spills the elements out of the meta
+  run({"zadd", "z", "4", "a member longer than 8"});
+  EXPECT_EQ(run({"object", "encoding", "z"}), Command::fmtBulk("skiplist"));
+  EXPECT_EQ(run({"zcard", "z"}), Command::fmtLongLong(3));
+  EXPECT_EQ(run({"zscore", "z", "a"}), Command::fmtBulk("6"));
+  EXPECT_EQ(run({"zrank", "z", "a"}), Command::fmtLongLong(2));
+  std::stringstream ss;
+  Command::fmtMultiBulkLen(ss, 2);
+  Command::fmtBulk(ss, "c");
+  Command::fmtBulk(ss, "a member longer than 8");
+  EXPECT_EQ(run({"zrange", "z", "0", "1"}), ss.str());
+
+  // too many elements spill, and removing them doesn't move it back
+  run({"zadd", "z2", "2", "e", "3", "f", "4", "g"});
+  EXPECT_EQ(run({"object", "encoding", "z2"}), Command::fmtBulk("skiplist"));
+  EXPECT_EQ(run({"zremrangebyscore", "z2", "2", "4"}), Command::fmtLongLong(3));
+  EXPECT_EQ(run({"object", "encoding", "z2"}), Command::fmtBulk("skiplist"));
+  EXPECT_EQ(run({"zscore", "z2", "d"}), Command::fmtBulk("1"));
+  EXPECT_EQ(run({"zscore", "z2", "e"}), Command::fmtNull());
+
+  // an inline key is deleted with its meta
+  EXPECT_EQ(run({"zremrangebyrank", "z3", "0", "-1"}), Command::fmtOne());
+  EXPECT_EQ(run({"exists", "z3"}), Command::fmtZero());
+}
+
+TEST(Command, inlineZSet) {
+  const auto guard = MakeGuard([] { destroyEnv(); });
+
+  EXPECT_TRUE(setupEnv());
+  auto cfg = makeServerParam();
+  cfg->zsetMaxInlineEntries = 4;
+  cfg->zsetMaxInlineValue = 8;
+  auto server = makeServerEntry(cfg);
+
+  testInlineZSet(server);
+
+#ifndef _WIN32
+  server->stop();
+  EXPECT_EQ(server.use_count(), 1);
+#endif
+}
+
+TEST(Command, mget) {
+  const auto guard = MakeGuard([] { destroyEnv(); });
+
+  EXPECT_TRUE(setupEnv());
+  auto cfg = makeServerParam();
+  auto server = makeServerEntry(cfg);
+
+  testMget(server);
+
+#ifndef _WIN32
+  server->stop();
+  EXPECT_EQ(server.use_count(), 1);
+#endif
+}
+
 TEST(Command, common) {
   const auto guard = MakeGuard([] { destroyEnv(); });
 
@@ -951,6 +1490,7 @@ TEST(Command, common_scan) {
   auto server = makeServerEntry(cfg);
 
   testScan(server);
+  testKeyspaceScan(server);
 
 #ifndef _WIN32
   server->stop();
@@ -970,6 +1510,7 @@ TEST(Command, tendisex) {
   testExtendProtocol(server);
   testSync(server);
   testMulti(server);
+  testExec(server);
 
 #ifndef _WIN32
   server->stop();
@@ -573,6 +573,7 @@ class IterAllCommand : public Command {
     std::unordered_map<std::string, uint64_t> lIdx;
     std::list<Record> result;
     uint64_t currentTs = msSinceEpoch();
+    SubKeyVersionChecker versionChecker(txn.get());
     while (true) {
       if (result.size() >= ebatchSize.value() + 1) {
         break;
@@ -595,7 +596,20 @@ class IterAllCommand : public Command {
       }
 
       auto valueType = exptRcd.value().getRecordValue().getRecordType();
-      if (!isRealEleType(keyType, valueType)) {
+      // the elements of an inline hash/set/zset are in its meta
+      bool inlineMeta = keyType == RecordType::RT_DATA_META &&
+        rcd_util::getInlineEles(exptRcd.value().getRecordKey(),
+                                exptRcd.value().getRecordValue())
+          .ok();
+      if (!isRealEleType(keyType, valueType) && !inlineMeta) {
+        continue;
+      }
+      // the subkeys of a deleted key are left for the compaction filter
+      auto stale = versionChecker.isStale(exptRcd.value().getRecordKey());
+      if (!stale.ok()) {
+        return stale.status();
+      }
+      if (stale.value()) {
         continue;
       }
 
@@ -622,7 +636,18 @@ class IterAllCommand : public Command {
         continue;
       }
 
-      result.emplace_back(std::move(exptRcd.value()));
+      if (exptRcd.value().getRecordValue().isChunked()) {
+        // the value of a chunked string is in its pieces
+        const RecordKey& rk = exptRcd.value().getRecordKey();
+        RecordValue rv = exptRcd.value().getRecordValue();
+        auto s = Command::loadChunkedString(kvstore, txn.get(), rk, &rv);
+        if (!s.ok()) {
+          return s;
+        }
+        result.emplace_back(rk, rv);
+      } else {
+        result.emplace_back(std::move(exptRcd.value()));
+      }
     }
 
     std::string nextCursor;
@@ -632,6 +657,20 @@ class IterAllCommand : public Command {
     } else {
       nextCursor = "0";
     }
+    for (auto it = result.begin(); it != result.end();) {
+      if (it->getRecordKey().getRecordType() != RecordType::RT_DATA_META ||
+          it->getRecordValue().getRecordType() == RecordType::RT_KV) {
+        ++it;
+        continue;
+      }
+      auto eles =
+        rcd_util::getInlineEles(it->getRecordKey(), it->getRecordValue());
+      if (!eles.ok()) {
+        return eles.status();
+      }
+      result.splice(it, eles.value());
+      it = result.erase(it);
+    }
     std::stringstream ss;
     Command::fmtMultiBulkLen(ss, 2);
     Command::fmtBulk(ss, nextCursor);
@@ -1881,7 +1920,9 @@ class InfoCommand : public Command {
       auto server = sess->getServerEntry();
       std::stringstream ss;
       ss << "# Clients\r\n"
-         << "connected_clients:" << server->getSessionCount() << "\r\n";
+         << "connected_clients:" << server->getSessionCount() << "\r\n"
+         << "blocked_clients:" << server->getBlockingMgr()->getBlockedCount()
+         << "\r\n";
       ss << "\r\n";
       result << ss.str();
     }
@@ -2206,6 +2247,28 @@ class InfoCommand : public Command {
       ss << "rocksdb.estimate-pending-compaction-bytes:" << compaction_pending
          << "\r\n";
       ss << "rocksdb.compaction-pending:" << numCompaction << "\r\n";
+      if (server->getParams()->slotStatsEnabled) {
+        // the unknown slots are recounted when asked
+        uint64_t slotKeys = 0, unknownSlots = 0;
+        for (uint64_t i = 0; i < server->getKVStoreCount(); i++) {
+          auto expdb = server->getSegmentMgr()->getDb(
+            sess, i, mgl::LockMode::LOCK_IS, false, 0);
+          if (!expdb.ok()) {
+            continue;
+          }
+          for (uint32_t slot = 0; slot < server->getParams()->chunkSize;
+               slot++) {
+            auto keys = expdb.value().store->getSlotKeyCount(slot);
+            if (keys.ok()) {
+              slotKeys += keys.value();
+            } else {
+              unknownSlots++;
+            }
+          }
+        }
+        ss << "slot-stats-keys:" << slotKeys << "\r\n";
+        ss << "slot-stats-unknown-slots:" << unknownSlots << "\r\n";
+      }
       ss << "\r\n";
       result << ss.str();
     }
@@ -2493,6 +2556,26 @@ class ObjectCommand : public Command {
       if (arg1 == "refcount") {
         return Command::fmtOne();
       } else if (arg1 == "encoding") {
+        if (vt == RecordType::RT_HASH_META) {
+          auto hashMeta = HashMetaValue::decode(rv.value().getValue());
+          if (!hashMeta.ok()) {
+            return hashMeta.status();
+          }
+          if (hashMeta.value().isInline()) {
+            return Command::fmtBulk("ziplist");
+          }
+        } else if (vt == RecordType::RT_ZSET_META) {
+          auto zsetMeta = ZSlMetaValue::decode(rv.value().getValue());
+          if (!zsetMeta.ok()) {
+            return zsetMeta.status();
+          }
+          if (zsetMeta.value().getEngine() == ZSlMetaValue::ENGINE_INDEX) {
+            return Command::fmtBulk("index");
+          } else if (zsetMeta.value().getEngine() ==
+                     ZSlMetaValue::ENGINE_INLINE) {
+            return Command::fmtBulk("ziplist");
+          }
+        }
         return Command::fmtBulk(m.at(vt));
       } else if (arg1 == "idletime") {
         return Command::fmtLongLong(0);
@@ -2717,6 +2800,7 @@ class FlushGeneric : public Command {
 
       replMgr->onFlush(i, eflush.value());
     }
+    server->getWatchMgr()->touchAll();
     return {ErrorCodes::ERR_OK, ""};
   }
 };
@@ -3231,98 +3315,6 @@ class EvictCommand : public Command {
   }
 } evictCmd;
 
-class PublishCommand : public Command {
- public:
-  PublishCommand() : Command("publish", "pltF") {}
-
-  ssize_t arity() const {
-    return 3;
-  }
-
-  int32_t firstkey() const {
-    return 0;
-  }
-
-  int32_t lastkey() const {
-    return 0;
-  }
-
-  int32_t keystep() const {
-    return 0;
-  }
-
-  Expected<std::string> run(Session* sess) final {
-    return Command::fmtOK();
-  }
-} publishCmd;
-
-class multiCommand : public Command {
- public:
-  multiCommand() : Command("multi", "sF") {}
-
-  ssize_t arity() const {
-    return 1;
-  }
-
-  int32_t firstkey() const {
-    return 0;
-  }
-
-  int32_t lastkey() const {
-    return 0;
-  }
-
-  int32_t keystep() const {
-    return 0;
-  }
-
-  Expected<std::string> run(Session* sess) final {
-    auto pCtx = sess->getCtx();
-    if (pCtx->isInMulti()) {
-      return {ErrorCodes::ERR_PARSEPKT, "MULTI calls can not be nested"};
-    }
-    pCtx->setMulti();
-    // maybe set txnVersion to multi's version.
-    return Command::fmtOK();
-  }
-} multiCmd;
-
-class execCommand : public Command {
- public:
-  execCommand() : Command("exec", "sM") {}
-
-  ssize_t arity() const {
-    return 1;
-  }
-
-  int32_t firstkey() const {
-    return 0;
-  }
-
-  int32_t lastkey() const {
-    return 0;
-  }
-
-  int32_t keystep() const {
-    return 0;
-  }
-
-  Expected<std::string> run(Session* sess) final {
-    auto pCtx = sess->getCtx();
-    if (!pCtx->isInMulti()) {
-      return {ErrorCodes::ERR_PARSEPKT, "EXEC without MULTI"};
-    }
-    // check version ?
-    if (!pCtx->verifyVersion(pCtx->getVersionEP())) {
-      return {ErrorCodes::ERR_WRONG_VERSION_EP, ""};
-    }
-    pCtx->resetMulti();
-    // TODO(comboqiu): return value should include multiBulkLen and sub
-    // command results
-    return Command::fmtOK();
-  }
-} execCmd;
-
 class slowlogCommand : public Command {
  public:
   slowlogCommand() : Command("slowlog", "sM") {}
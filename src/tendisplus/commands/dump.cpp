@@ -517,6 +517,9 @@ class SetSerializer : public Serializer {
 
   Expected<size_t> dumpObject(std::vector<byte>* payload) {
     Expected<SetMetaValue> expMeta = SetMetaValue::decode(_rv.getValue());
+    if (!expMeta.ok()) {
+      return expMeta.status();
+    }
     size_t len = expMeta.value().getCount();
     INVARIANT_D(len > 0);
     if (len <= 0) {
@@ -540,12 +543,21 @@ class SetSerializer : public Serializer {
     }
     std::unique_ptr<Transaction> txn = std::move(ptxn.value());
 
+    if (expMeta.value().isInline()) {
+      for (const auto& subk : expMeta.value().getMembers()) {
+        Serializer::saveString(payload, &_pos, subk);
+      }
+      _begin = 0;
+      return _pos - _begin;
+    }
+
     auto cursor = txn->createDataCursor();
     RecordKey fakeRk(expdb.value().chunkId,
                      _sess->getCtx()->getDbId(),
                      RecordType::RT_SET_ELE,
                      _key,
-                     "");
+                     "",
+                     _rv.getVersion());
     cursor->seek(fakeRk.prefixPk());
     while (true) {
       Expected<Record> eRcd = cursor->next();
@@ -591,20 +603,22 @@ class ZsetSerializer : public Serializer {
     }
     std::unique_ptr<Transaction> txn = std::move(ptxn.value());
 
-    auto eMeta = ZSlMetaValue::decode(_rv.getValue());
-    if (!eMeta.ok()) {
-      return eMeta.status();
+    auto ezsl = openZSet(expdb.value().chunkId,
+                         _sess->getCtx()->getDbId(),
+                         _key,
+                         _rv,
+                         kvstore);
+    if (!ezsl.ok()) {
+      return ezsl.status();
     }
-    ZSlMetaValue meta = eMeta.value();
-    SkipList zsl(
-      expdb.value().chunkId, _sess->getCtx()->getDbId(), _key, meta, kvstore);
+    PZSetEngine& zsl = ezsl.value();
 
-    auto expwr = saveLen(payload, &_pos, zsl.getCount() - 1);
+    auto expwr = saveLen(payload, &_pos, zsl->getCount() - 1);
     if (!expwr.ok()) {
       return expwr.status();
     }
 
-    auto rev = zsl.scanByRank(0, zsl.getCount() - 1, true, txn.get());
+    auto rev = zsl->scanByRank(0, zsl->getCount() - 1, true, txn.get());
     if (!rev.ok()) {
       return rev.status();
     }
@@ -637,6 +651,14 @@ class HashSerializer : public Serializer {
     if (!expwr.ok()) {
       return expwr.status();
     }
+    if (expHashMeta.value().isInline()) {
+      for (const auto& v : expHashMeta.value().getFields()) {
+        Serializer::saveString(payload, &_pos, v.first);
+        Serializer::saveString(payload, &_pos, v.second);
+      }
+      _begin = 0;
+      return _pos - _begin;
+    }
 
     auto server = _sess->getServerEntry();
     auto expdb = server->getSegmentMgr()->getDbHasLocked(_sess, _key);
@@ -655,7 +677,8 @@ class HashSerializer : public Serializer {
                      _sess->getCtx()->getDbId(),
                      RecordType::RT_HASH_ELE,
                      _key,
-                     "");
+                     "",
+                     _rv.getVersion());
     auto cursor = txn->createDataCursor();
     cursor->seek(fakeRk.prefixPk());
     while (true) {
@@ -691,6 +714,13 @@ Expected<std::unique_ptr<Serializer>> getSerializer(Session* sess,
 
   std::unique_ptr<Serializer> ptr;
   auto type = rv.value().getRecordType();
+  if (type == RecordType::RT_KV && rv.value().isChunked()) {
+    // read the pieces as a whole
+    rv = Command::expireKeyIfNeeded(sess, key, RecordType::RT_KV);
+    if (!rv.ok()) {
+      return rv.status();
+    }
+  }
   switch (type) {
     case RecordType::RT_KV:
       ptr = std::move(std::unique_ptr<Serializer>(
@@ -1015,7 +1045,7 @@ class KvDeserializer : public Deserializer {
       expdb.value().chunkId, pCtx->getDbId(), RecordType::RT_KV, _key, "");
     RecordValue rv(ret, RecordType::RT_KV, pCtx->getVersionEP(), _ttl);
     for (int32_t i = 0; i < Command::RETRY_CNT; ++i) {
-      Status s = kvstore->setKV(rk, rv, txn.get());
+      Status s = Command::setStringKV(_sess, kvstore, txn.get(), rk, rv);
       if (!s.ok()) {
         return s;
       }
@@ -1076,27 +1106,40 @@ class SetDeserializer : public Deserializer {
                      _key,
                      "");
     SetMetaValue sm;
+    uint64_t version = rcd_util::genSubKeyVersion();
+    sm.setInline(Command::isInlineEnabled(_sess, RecordType::RT_SET_META) &&
+                 len <= server->getParams()->setMaxInlineEntries);
 
     for (size_t i = 0; i < len; i++) {
       std::string ele = loadString(_payload, &_pos);
+      if (sm.isInline()) {
+        sm.addMember(ele);
+        continue;
+      }
       RecordKey rk(metaRk.getChunkId(),
                    metaRk.getDbId(),
                    RecordType::RT_SET_ELE,
                    metaRk.getPrimaryKey(),
-                   std::move(ele));
+                   std::move(ele),
+                   version);
       RecordValue rv("", RecordType::RT_SET_ELE, -1);
       Status s = kvstore->setKV(rk, rv, txn.get());
       if (!s.ok()) {
         return s;
       }
     }
-    sm.setCount(len);
-    Status s = kvstore->setKV(metaRk,
-                              RecordValue(sm.encode(),
-                                          RecordType::RT_SET_META,
-                                          _sess->getCtx()->getVersionEP(),
-                                          _ttl),
-                              txn.get());
+    sm.setCount(sm.isInline() ? sm.getMembers().size() : len);
+    Status s =
+      Command::spillInlineSet(_sess, kvstore, txn.get(), metaRk, version, &sm);
+    if (!s.ok()) {
+      return s;
+    }
+    RecordValue metaRv(sm.encode(),
+                       RecordType::RT_SET_META,
+                       _sess->getCtx()->getVersionEP(),
+                       _ttl);
+    metaRv.setVersion(version);
+    s = kvstore->setKV(metaRk, metaRv, txn.get());
     if (!s.ok()) {
       return s;
     }
@@ -1154,25 +1197,31 @@ class ZsetDeserializer : public Deserializer {
       return eMeta.status();
     }
     INVARIANT_D(eMeta.status().code() == ErrorCodes::ERR_NOTFOUND);
+    // an inline zset is spilled by genericZadd() if it's too large
+    uint8_t engine =
+      Command::isInlineEnabled(_sess, RecordType::RT_ZSET_META)
+      ? ZSlMetaValue::ENGINE_INLINE
+      : Command::getZSetEngine(_sess);
     ZSlMetaValue meta(1, 1, 0);
+    meta.setEngine(engine);
     RecordValue rv(meta.encode(),
                    RecordType::RT_ZSET_META,
                    _sess->getCtx()->getVersionEP(),
                    _ttl);
+    rv.setVersion(rcd_util::genSubKeyVersion());
     Status s = kvstore->setKV(rk, rv, txn.get());
     if (!s.ok()) {
       return s;
     }
-    RecordKey headRk(rk.getChunkId(),
-                     rk.getDbId(),
-                     RecordType::RT_ZSET_S_ELE,
-                     rk.getPrimaryKey(),
-                     std::to_string(ZSlMetaValue::HEAD_ID));
-    ZSlEleValue headVal;
-    RecordValue headRv(headVal.encode(), RecordType::RT_ZSET_S_ELE, -1);
-    s = kvstore->setKV(headRk, headRv, txn.get());
-    if (!s.ok()) {
-      return s;
+    auto ezset = createZSet(rk.getChunkId(),
+                            rk.getDbId(),
+                            rk.getPrimaryKey(),
+                            engine,
+                            rv.getVersion(),
+                            kvstore,
+                            txn.get());
+    if (!ezset.ok()) {
+      return ezset.status();
     }
     Expected<uint64_t> expCmt = txn->commit();
     if (!expCmt.ok()) {
@@ -1226,15 +1275,25 @@ class HashDeserializer : public Deserializer {
       return ptxn.status();
     }
     std::unique_ptr<Transaction> txn = std::move(ptxn.value());
+    uint64_t version = rcd_util::genSubKeyVersion();
+    HashMetaValue hashMeta;
+    hashMeta.setInline(
+      Command::isInlineEnabled(_sess, RecordType::RT_HASH_META) &&
+      len <= server->getParams()->hashMaxInlineEntries);
     for (size_t i = 0; i < len; i++) {
       std::string field = loadString(_payload, &_pos);
       std::string value = loadString(_payload, &_pos);
+      if (hashMeta.isInline()) {
+        hashMeta.setField(field, value);
+        continue;
+      }
       // need existence check ?
       RecordKey rk(expdb.value().chunkId,
                    _sess->getCtx()->getDbId(),
                    RecordType::RT_HASH_ELE,
                    _key,
-                   field);
+                   field,
+                   version);
       RecordValue rv(value, RecordType::RT_HASH_ELE, -1);
       Status s = kvstore->setKV(rk, rv, txn.get());
       if (!s.ok()) {
@@ -1247,13 +1306,18 @@ class HashDeserializer : public Deserializer {
                      RecordType::RT_HASH_META,
                      _key,
                      "");
-    HashMetaValue hashMeta;
-    hashMeta.setCount(len);
+    hashMeta.setCount(hashMeta.isInline() ? hashMeta.getFields().size() : len);
+    Status s = Command::spillInlineHash(
+      _sess, kvstore, txn.get(), metaRk, version, &hashMeta);
+    if (!s.ok()) {
+      return s;
+    }
     RecordValue metaRv(std::move(hashMeta.encode()),
                        RecordType::RT_HASH_META,
                        _sess->getCtx()->getVersionEP(),
                        _ttl);
-    Status s = kvstore->setKV(metaRk, metaRv, txn.get());
+    metaRv.setVersion(version);
+    s = kvstore->setKV(metaRk, metaRv, txn.get());
     if (!s.ok()) {
       return s;
     }
@@ -19,6 +19,45 @@
 
 namespace tendisplus {
 
+// the fields of an inline hash are kept in its meta instead of the
+// RT_HASH_ELE records, see HashMetaValue
+Expected<RecordValue> getHashField(PStore kvstore,
+                                   Transaction* txn,
+                                   const HashMetaValue& meta,
+                                   const RecordKey& subRk) {
+  if (!meta.isInline()) {
+    return kvstore->getKV(subRk, txn);
+  }
+  const std::string* v = meta.getField(subRk.getSecondaryKey());
+  if (v == nullptr) {
+    return {ErrorCodes::ERR_NOTFOUND, ""};
+  }
+  return RecordValue(*v, RecordType::RT_HASH_ELE, -1);
+}
+
+Status setHashField(PStore kvstore,
+                    Transaction* txn,
+                    HashMetaValue* meta,
+                    const RecordKey& subRk,
+                    const RecordValue& subRv) {
+  if (!meta->isInline()) {
+    return kvstore->setKV(subRk, subRv, txn);
+  }
+  meta->setField(subRk.getSecondaryKey(), subRv.getValue());
+  return {ErrorCodes::ERR_OK, ""};
+}
+
+Status delHashField(PStore kvstore,
+                    Transaction* txn,
+                    HashMetaValue* meta,
+                    const RecordKey& subRk) {
+  if (!meta->isInline()) {
+    return kvstore->delKV(subRk, txn);
+  }
+  meta->delField(subRk.getSecondaryKey());
+  return {ErrorCodes::ERR_OK, ""};
+}
+
 Expected<std::string> hincrfloatGeneric(Session* sess,
                                         const RecordKey& metaRk,
                                         const Expected<RecordValue>& eValue,
@@ -45,9 +84,13 @@ Expected<std::string> hincrfloatGeneric(Session* sess,
       return exptHashMeta.status();
     }
     hashMeta = std::move(exptHashMeta.value());
-  }  // no else, else not found , so subkeyCount = 0, ttl = 0
+  } else {
+    // not found, so subkeyCount = 0, ttl = 0
+    hashMeta.setInline(
+      Command::isInlineEnabled(sess, RecordType::RT_HASH_META));
+  }
 
-  auto getSubkeyExpt = kvstore->getKV(subRk, txn.get());
+  auto getSubkeyExpt = getHashField(kvstore, txn.get(), hashMeta, subRk);
   long double nowVal = 0;
   if (getSubkeyExpt.ok()) {
     Expected<long double> val =
@@ -66,16 +109,23 @@ Expected<std::string> hincrfloatGeneric(Session* sess,
   nowVal += inc;
   RecordValue newVal(
     ::tendisplus::ldtos(nowVal, true), RecordType::RT_HASH_ELE, -1);
+  Status setStatus =
+    setHashField(kvstore, txn.get(), &hashMeta, subRk, newVal);
+  if (!setStatus.ok()) {
+    return setStatus;
+  }
+  setStatus = Command::spillInlineHash(
+    sess, kvstore, txn.get(), metaRk, subRk.getVersion(), &hashMeta);
+  if (!setStatus.ok()) {
+    return setStatus;
+  }
   RecordValue metaValue(hashMeta.encode(),
                         RecordType::RT_HASH_META,
                         sess->getCtx()->getVersionEP(),
                         ttl,
                         eValue);
-  Status setStatus = kvstore->setKV(metaRk, metaValue, txn.get());
-  if (!setStatus.ok()) {
-    return setStatus;
-  }
-  setStatus = kvstore->setKV(subRk, newVal, txn.get());
+  metaValue.setVersion(subRk.getVersion());
+  setStatus = kvstore->setKV(metaRk, metaValue, txn.get());
   if (!setStatus.ok()) {
     return setStatus;
   }
@@ -113,9 +163,13 @@ Expected<std::string> hincrGeneric(Session* sess,
       return exptHashMeta.status();
     }
     hashMeta = std::move(exptHashMeta.value());
-  }  // no else, else not found , so subkeyCount = 0, ttl = 0
+  } else {
+    // not found, so subkeyCount = 0, ttl = 0
+    hashMeta.setInline(
+      Command::isInlineEnabled(sess, RecordType::RT_HASH_META));
+  }
 
-  auto getSubkeyExpt = kvstore->getKV(subRk, txn.get());
+  auto getSubkeyExpt = getHashField(kvstore, txn.get(), hashMeta, subRk);
   int64_t nowVal = 0;
   if (getSubkeyExpt.ok()) {
     Expected<int64_t> val =
@@ -137,16 +191,23 @@ Expected<std::string> hincrGeneric(Session* sess,
   }
   nowVal += inc;
   RecordValue newVal(std::to_string(nowVal), RecordType::RT_HASH_ELE, -1);
+  Status setStatus =
+    setHashField(kvstore, txn.get(), &hashMeta, subRk, newVal);
+  if (!setStatus.ok()) {
+    return setStatus;
+  }
+  setStatus = Command::spillInlineHash(
+    sess, kvstore, txn.get(), metaRk, subRk.getVersion(), &hashMeta);
+  if (!setStatus.ok()) {
+    return setStatus;
+  }
   RecordValue metaValue(hashMeta.encode(),
                         RecordType::RT_HASH_META,
                         sess->getCtx()->getVersionEP(),
                         ttl,
                         eValue);
-  Status setStatus = kvstore->setKV(metaRk, metaValue, txn.get());
-  if (!setStatus.ok()) {
-    return setStatus;
-  }
-  setStatus = kvstore->setKV(subRk, newVal, txn.get());
+  metaValue.setVersion(subRk.getVersion());
+  setStatus = kvstore->setKV(metaRk, metaValue, txn.get());
   if (!setStatus.ok()) {
     return setStatus;
   }
@@ -252,7 +313,8 @@ class HExistsCommand : public Command {
                     pCtx->getDbId(),
                     RecordType::RT_HASH_ELE,
                     key,
-                    subkey);
+                    subkey,
+                    rv.value().getVersion());
     PStore kvstore = expdb.value().store;
 
     auto ptxn = kvstore->createTransaction(sess);
@@ -260,7 +322,13 @@ class HExistsCommand : public Command {
       return ptxn.status();
     }
     std::unique_ptr<Transaction> txn = std::move(ptxn.value());
-    Expected<RecordValue> eVal = kvstore->getKV(subRk, txn.get());
+    Expected<HashMetaValue> exptHashMeta =
+      HashMetaValue::decode(rv.value().getValue());
+    if (!exptHashMeta.ok()) {
+      return exptHashMeta.status();
+    }
+    Expected<RecordValue> eVal =
+      getHashField(kvstore, txn.get(), exptHashMeta.value(), subRk);
     if (eVal.ok()) {
       return Command::fmtOne();
     } else if (eVal.status().code() == ErrorCodes::ERR_NOTFOUND) {
@@ -321,6 +389,10 @@ class HAllCommand : public Command {
                      RecordType::RT_HASH_META,
                      key,
                      "");
+    auto inlineEles = rcd_util::getInlineEles(metaRk, rv.value());
+    if (inlineEles.status().code() != ErrorCodes::ERR_NOTFOUND) {
+      return inlineEles;
+    }
     // uint32_t storeId = expdb.value().dbId;
     PStore kvstore = expdb.value().store;
 
@@ -333,7 +405,8 @@ class HAllCommand : public Command {
                       metaRk.getDbId(),
                       RecordType::RT_HASH_ELE,
                       metaRk.getPrimaryKey(),
-                      "");
+                      "",
+                      rv.value().getVersion());
     std::string prefix = fakeEle.prefixPk();
     auto cursor = txn->createDataCursor();
     cursor->seek(prefix);
@@ -363,17 +436,20 @@ class HGetAllCommand : public HAllCommand {
   HGetAllCommand() : HAllCommand("hgetall", "r") {}
 
   Expected<std::string> run(Session* sess) final {
+    return runReplyToString(sess);
+  }
+
+  Status runReply(Session* sess, ReplyBuffer* reply) final {
     Expected<std::list<Record>> rcds = getRecords(sess);
     if (!rcds.ok()) {
       return rcds.status();
     }
-    std::stringstream ss;
-    Command::fmtMultiBulkLen(ss, rcds.value().size() * 2);
+    Command::fmtMultiBulkLen(*reply, rcds.value().size() * 2);
     for (const auto& v : rcds.value()) {
-      Command::fmtBulk(ss, v.getRecordKey().getSecondaryKey());
-      Command::fmtBulk(ss, v.getRecordValue().getValue());
+      Command::fmtBulk(*reply, v.getRecordKey().getSecondaryKey());
+      Command::fmtBulk(*reply, v.getRecordValue().getValue());
     }
-    return ss.str();
+    return {ErrorCodes::ERR_OK, ""};
   }
 } hgetAllCmd;
 
@@ -463,7 +539,8 @@ class HGetRecordCommand : public Command {
                     pCtx->getDbId(),
                     RecordType::RT_HASH_ELE,
                     key,
-                    subkey);
+                    subkey,
+                    rv.value().getVersion());
     PStore kvstore = expdb.value().store;
 
     auto ptxn = kvstore->createTransaction(sess);
@@ -471,7 +548,13 @@ class HGetRecordCommand : public Command {
       return ptxn.status();
     }
     std::unique_ptr<Transaction> txn = std::move(ptxn.value());
-    Expected<RecordValue> eVal = kvstore->getKV(subRk, txn.get());
+    Expected<HashMetaValue> exptHashMeta =
+      HashMetaValue::decode(rv.value().getValue());
+    if (!exptHashMeta.ok()) {
+      return exptHashMeta.status();
+    }
+    Expected<RecordValue> eVal =
+      getHashField(kvstore, txn.get(), exptHashMeta.value(), subRk);
     if (eVal.ok()) {
       return std::move(Record(std::move(subRk), std::move(eVal.value())));
     } else {
@@ -603,7 +686,8 @@ class HIncrByFloatCommand : public Command {
                     pCtx->getDbId(),
                     RecordType::RT_HASH_ELE,
                     key,
-                    subkey);
+                    subkey,
+                    rcd_util::getSubKeyVersion(rv));
     PStore kvstore = expdb.value().store;
 
     // now, we have no need to deal with expire, though it may still
@@ -682,7 +766,8 @@ class HIncrByCommand : public Command {
                     pCtx->getDbId(),
                     RecordType::RT_HASH_ELE,
                     key,
-                    subkey);
+                    subkey,
+                    rcd_util::getSubKeyVersion(rv));
     PStore kvstore = expdb.value().store;
 
     // now, we have no need to deal with expire, though it may still
@@ -785,13 +870,35 @@ class HMGetGeneric : public Command {
       Command::fmtMultiBulkLen(ss, args.size() - 2);
     }
 
+    Expected<HashMetaValue> exptHashMeta =
+      HashMetaValue::decode(rv.value().getValue());
+    if (!exptHashMeta.ok()) {
+      return exptHashMeta.status();
+    }
+    if (exptHashMeta.value().isInline()) {
+      for (size_t i = 2; i < args.size(); ++i) {
+        const std::string* v = exptHashMeta.value().getField(args[i]);
+        if (v == nullptr) {
+          Command::fmtNull(ss);
+        } else {
+          Command::fmtBulk(ss, *v);
+        }
+      }
+      return ss.str();
+    }
+
+    std::vector<RecordKey> subKeys;
+    subKeys.reserve(args.size() - 2);
     for (size_t i = 2; i < args.size(); ++i) {
-      RecordKey subKey(expdb.value().chunkId,
-                       pCtx->getDbId(),
-                       RecordType::RT_HASH_ELE,
-                       key,
-                       args[i]);
-      Expected<RecordValue> eValue = kvstore->getKV(subKey, txn.get());
+      subKeys.emplace_back(expdb.value().chunkId,
+                           pCtx->getDbId(),
+                           RecordType::RT_HASH_ELE,
+                           key,
+                           args[i],
+                           rv.value().getVersion());
+    }
+    auto eValues = kvstore->getKVs(subKeys, txn.get());
+    for (const auto& eValue : eValues) {
       if (!eValue.ok()) {
         if (eValue.status().code() == ErrorCodes::ERR_NOTFOUND) {
           Command::fmtNull(ss);
@@ -865,7 +972,11 @@ Status hmcas(Session* sess,
     }
     hashMeta = std::move(exptHashMeta.value());
     cas = eValue.value().getCas();
-  }  // no else, else not found , so subkeyCount = 0, ttl = 0, cas = 0
+  } else {
+    // not found, so subkeyCount = 0, ttl = 0, cas = 0
+    hashMeta.setInline(
+      Command::isInlineEnabled(sess, RecordType::RT_HASH_META));
+  }
 
   if (cmp) {
     // kv should exist for comparison
@@ -874,6 +985,7 @@ Status hmcas(Session* sess,
     }
   }
 
+  uint64_t version = rcd_util::getSubKeyVersion(eValue);
   std::map<std::string, uint64_t> uniqkeys;
   std::map<std::string, std::string> existkvs;
   for (size_t i = 0; i < subargs.size(); i += 3) {
@@ -889,8 +1001,9 @@ Status hmcas(Session* sess,
                  pCtx->getDbId(),
                  RecordType::RT_HASH_ELE,
                  key,
-                 keyPos.first);
-    Expected<RecordValue> rv = kvstore->getKV(rk, txn.get());
+                 keyPos.first,
+                 version);
+    Expected<RecordValue> rv = getHashField(kvstore, txn.get(), hashMeta, rk);
     if (rv.ok()) {
       existkvs[keyPos.first] = rv.value().getValue();
     } else if (rv.status().code() == ErrorCodes::ERR_NOTFOUND) {
@@ -909,11 +1022,12 @@ Status hmcas(Session* sess,
                     pCtx->getDbId(),
                     RecordType::RT_HASH_ELE,
                     key,
-                    keyPos.first);
+                    keyPos.first,
+                    version);
     if (eop.value() == OPSET || (!exists && eop.value() == OPADD)) {
       RecordValue subrv(
         subargs[keyPos.second + 2], RecordType::RT_HASH_ELE, -1);
-      Status s = kvstore->setKV(subrk, subrv, txn.get());
+      Status s = setHashField(kvstore, txn.get(), &hashMeta, subrk, subrv);
       if (!s.ok()) {
         return s;
       }
@@ -928,7 +1042,7 @@ Status hmcas(Session* sess,
       }
       RecordValue subrv(
         std::to_string(ev1.value() + ev.value()), RecordType::RT_HASH_ELE, -1);
-      Status s = kvstore->setKV(subrk, subrv, txn.get());
+      Status s = setHashField(kvstore, txn.get(), &hashMeta, subrk, subrv);
       if (!s.ok()) {
         return s;
       }
@@ -952,13 +1066,19 @@ Status hmcas(Session* sess,
     }
   }
   hashMeta.setCount(hashMeta.getCount() + uniqkeys.size() - existkvs.size());
+  Status s = Command::spillInlineHash(
+    sess, kvstore, txn.get(), metaRk, version, &hashMeta);
+  if (!s.ok()) {
+    return s;
+  }
   RecordValue metaValue(hashMeta.encode(),
                         RecordType::RT_HASH_META,
                         sess->getCtx()->getVersionEP(),
                         ttl,
                         eValue);
   metaValue.setCas(cas);
-  Status s = kvstore->setKV(metaRk, metaValue, txn.get());
+  metaValue.setVersion(version);
+  s = kvstore->setKV(metaRk, metaValue, txn.get());
   if (!s.ok()) {
     return s;
   }
@@ -1138,6 +1258,7 @@ class HMSetGeneric : public Command {
                                      const RecordKey& metaRk,
                                      const Expected<RecordValue>& eValue,
                                      const std::vector<Record>& rcds,
+                                     uint64_t version,
                                      PStore kvstore) {
     auto ptxn = kvstore->createTransaction(sess);
     if (!ptxn.ok()) {
@@ -1156,30 +1277,44 @@ class HMSetGeneric : public Command {
         return exptHashMeta.status();
       }
       hashMeta = std::move(exptHashMeta.value());
-    }  // no else, else not found , so subkeyCount = 0, ttl = 0
+    } else {
+      // not found, so subkeyCount = 0, ttl = 0
+      hashMeta.setInline(
+        Command::isInlineEnabled(sess, RecordType::RT_HASH_META));
+    }
 
     for (const auto& v : rcds) {
-      auto getSubkeyExpt = kvstore->getKV(v.getRecordKey(), txn.get());
+      auto getSubkeyExpt =
+        getHashField(kvstore, txn.get(), hashMeta, v.getRecordKey());
       if (!getSubkeyExpt.ok()) {
         if (getSubkeyExpt.status().code() != ErrorCodes::ERR_NOTFOUND) {
           return getSubkeyExpt.status();
         }
         inserted += 1;
       }
-      Status setStatus =
-        kvstore->setKV(v.getRecordKey(), v.getRecordValue(), txn.get());
+      Status setStatus = setHashField(kvstore,
+                                      txn.get(),
+                                      &hashMeta,
+                                      v.getRecordKey(),
+                                      v.getRecordValue());
       if (!setStatus.ok()) {
         return setStatus;
       }
     }
     hashMeta.setCount(hashMeta.getCount() + inserted);
+    Status setStatus = Command::spillInlineHash(
+      sess, kvstore, txn.get(), metaRk, version, &hashMeta);
+    if (!setStatus.ok()) {
+      return setStatus;
+    }
     RecordValue metaValue(hashMeta.encode(),
                           RecordType::RT_HASH_META,
                           sess->getCtx()->getVersionEP(),
                           ttl,
                           eValue);
     metaValue.setCas(-1);
-    Status setStatus = kvstore->setKV(metaRk, metaValue, txn.get());
+    metaValue.setVersion(version);
+    setStatus = kvstore->setKV(metaRk, metaValue, txn.get());
     if (!setStatus.ok()) {
       return setStatus;
     }
@@ -1227,23 +1362,25 @@ class HMSetGeneric : public Command {
                      "");
     PStore kvstore = expdb.value().store;
 
+    uint64_t version = rcd_util::getSubKeyVersion(rv);
     std::vector<Record> rcds;
     for (size_t i = 2; i < args.size(); i += 2) {
       RecordKey subKey(expdb.value().chunkId,
                        pCtx->getDbId(),
                        RecordType::RT_HASH_ELE,
                        key,
-                       args[i]);
+                       args[i],
+                       version);
       RecordValue subRv(args[i + 1], RecordType::RT_HASH_ELE, -1);
       rcds.emplace_back(Record(std::move(subKey), std::move(subRv)));
     }
     for (int32_t i = 0; i < RETRY_CNT - 1; ++i) {
-      auto result = hmsetGeneric(sess, metaRk, rv, rcds, kvstore);
+      auto result = hmsetGeneric(sess, metaRk, rv, rcds, version, kvstore);
       if (result.status().code() != ErrorCodes::ERR_COMMIT_RETRY) {
         return result;
       }
     }
-    return hmsetGeneric(sess, metaRk, rv, rcds, kvstore);
+    return hmsetGeneric(sess, metaRk, rv, rcds, version, kvstore);
   }
 };
 
@@ -1305,7 +1442,8 @@ class HSetGeneric : public Command {
                      pCtx->getDbId(),
                      RecordType::RT_HASH_ELE,
                      key,
-                     subkey);
+                     subkey,
+                     rcd_util::getSubKeyVersion(rv));
     RecordValue subRv(val, RecordType::RT_HASH_ELE, -1);
 
     // now, we have no need to deal with expire, though it may still
@@ -1347,10 +1485,14 @@ class HSetGeneric : public Command {
         return exptHashMeta.status();
       }
       hashMeta = std::move(exptHashMeta.value());
-    }  // no else, else not found , so subkeyCount = 0, ttl = 0
+    } else {
+      // not found, so subkeyCount = 0, ttl = 0
+      hashMeta.setInline(
+        Command::isInlineEnabled(sess, RecordType::RT_HASH_META));
+    }
 
     bool updated = false;
-    auto getSubkeyExpt = kvstore->getKV(subRk, txn.get());
+    auto getSubkeyExpt = getHashField(kvstore, txn.get(), hashMeta, subRk);
     if (getSubkeyExpt.ok()) {
       updated = true;
     } else if (getSubkeyExpt.status().code() == ErrorCodes::ERR_NOTFOUND) {
@@ -1364,16 +1506,23 @@ class HSetGeneric : public Command {
       return Command::fmtZero();
     }
 
+    Status setStatus =
+      setHashField(kvstore, txn.get(), &hashMeta, subRk, subRv);
+    if (!setStatus.ok()) {
+      return setStatus;
+    }
+    setStatus = Command::spillInlineHash(
+      sess, kvstore, txn.get(), metaRk, subRk.getVersion(), &hashMeta);
+    if (!setStatus.ok()) {
+      return setStatus;
+    }
     RecordValue metaValue(hashMeta.encode(),
                           RecordType::RT_HASH_META,
                           sess->getCtx()->getVersionEP(),
                           ttl,
                           eValue);
-    Status setStatus = kvstore->setKV(metaRk, metaValue, txn.get());
-    if (!setStatus.ok()) {
-      return setStatus;
-    }
-    setStatus = kvstore->setKV(subRk, subRv, txn.get());
+    metaValue.setVersion(subRk.getVersion());
+    setStatus = kvstore->setKV(metaRk, metaValue, txn.get());
     if (!setStatus.ok()) {
       return setStatus;
     }
@@ -1456,15 +1605,17 @@ class HDelCommand : public Command {
                       dbId,
                       RecordType::RT_HASH_ELE,
                       metaKey.getPrimaryKey(),
-                      args[i]);
-      Expected<RecordValue> eVal = kvstore->getKV(subRk, txn);
+                      args[i],
+                      eValue.value().getVersion());
+      Expected<RecordValue> eVal =
+        getHashField(kvstore, txn, hashMeta, subRk);
       if (eVal.status().code() == ErrorCodes::ERR_NOTFOUND) {
         continue;
       }
       if (!eVal.ok()) {
         return eVal.status();
       }
-      Status s = kvstore->delKV(subRk, txn);
+      Status s = delHashField(kvstore, txn, &hashMeta, subRk);
       if (!s.ok()) {
         return s;
       }
@@ -1528,15 +1679,6 @@ class HDelCommand : public Command {
                      "");
     PStore kvstore = expdb.value().store;
 
-    std::vector<RecordKey> rcds;
-    for (size_t i = 2; i < args.size(); ++i) {
-      rcds.emplace_back(RecordKey(expdb.value().chunkId,
-                                  pCtx->getDbId(),
-                                  RecordType::RT_HASH_ELE,
-                                  key,
-                                  args[i]));
-    }
-
     for (uint32_t i = 0; i < RETRY_CNT; ++i) {
       auto ptxn = kvstore->createTransaction(sess);
       if (!ptxn.ok()) {
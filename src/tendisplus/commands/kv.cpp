@@ -11,6 +11,8 @@
 #include <vector>
 #include <queue>
 #include <cmath>
+#include <functional>
+#include <limits>
 #include "glog/logging.h"
 #include "tendisplus/utils/sync_point.h"
 #include "tendisplus/utils/string.h"
@@ -32,10 +34,13 @@ constexpr int32_t REDIS_SET_XX = (1 << 1);
 // set and expire if not exists
 constexpr int32_t REDIS_SET_NXEX = (1 << 2);
 
+// NOTE: key and value refer to the session's args, so that the value is
+// copied only once, into the RecordValue.
 struct SetParams {
-  SetParams() : key(""), value(""), flags(REDIS_SET_NO_FLAGS), expire(0) {}
-  std::string key;
-  std::string value;
+  SetParams()
+    : key(nullptr), value(nullptr), flags(REDIS_SET_NO_FLAGS), expire(0) {}
+  const std::string* key;
+  const std::string* value;
   int32_t flags;
   int64_t expire;
 };
@@ -118,7 +123,7 @@ Expected<std::string> setGeneric(Session* sess,
   }
 
   // here we have no need to check expire since we will overwrite it
-  Status status = store->setKV(key, val, txn);
+  Status status = Command::setStringKV(sess, store, txn, key, val);
   TEST_SYNC_POINT("setGeneric::SetKV::1");
   if (!status.ok()) {
     return status;
@@ -132,6 +137,48 @@ Expected<std::string> setGeneric(Session* sess,
   return okReply == "" ? Command::fmtOK() : okReply;
 }
 
+// read a range of the string key, which is given by rangeOf(length of the
+// string) as (offset, len). Only the pieces in the range are read if the
+// string is chunked.
+Expected<std::string> getStringRangeGeneric(
+  Session* sess,
+  const std::string& key,
+  const std::function<std::pair<uint64_t, uint64_t>(uint64_t)>& rangeOf) {
+  auto server = sess->getServerEntry();
+  INVARIANT(server != nullptr);
+  auto expdb =
+    server->getSegmentMgr()->getDbWithKeyLock(sess, key, Command::RdLock());
+  if (!expdb.ok()) {
+    return expdb.status();
+  }
+  Expected<RecordValue> rv =
+    Command::expireKeyIfNeeded(sess, key, RecordType::RT_KV, true, false);
+  if (!rv.ok()) {
+    return rv.status();
+  }
+  auto range = rangeOf(Command::getStringSize(rv.value()));
+  if (range.second == 0) {
+    return std::string();
+  }
+
+  PStore kvstore = expdb.value().store;
+  std::unique_ptr<Transaction> txn;
+  if (rv.value().isChunked()) {
+    auto ptxn = kvstore->createTransaction(sess);
+    if (!ptxn.ok()) {
+      return ptxn.status();
+    }
+    txn = std::move(ptxn.value());
+  }
+  RecordKey mk(expdb.value().chunkId,
+               sess->getCtx()->getDbId(),
+               RecordType::RT_KV,
+               key,
+               "");
+  return Command::getStringRange(
+    kvstore, txn.get(), mk, rv.value(), range.first, range.second);
+}
+
 class SetCommand : public Command {
  public:
   SetCommand() : Command("set", "wm") {}
@@ -142,8 +189,8 @@ class SetCommand : public Command {
     if (args.size() < 3) {
       return {ErrorCodes::ERR_PARSEPKT, "invalid set params"};
     }
-    result.key = args[1];
-    result.value = args[2];
+    result.key = &args[1];
+    result.value = &args[2];
     try {
       for (size_t i = 3; i < args.size(); i++) {
         const std::string& s = toLower(args[i]);
@@ -202,7 +249,7 @@ class SetCommand : public Command {
     auto server = sess->getServerEntry();
     INVARIANT(server != nullptr);
     auto expdb = server->getSegmentMgr()->getDbWithKeyLock(
-      sess, params.key, mgl::LockMode::LOCK_X);
+      sess, *params.key, mgl::LockMode::LOCK_X);
     if (!expdb.ok()) {
       return expdb.status();
     }
@@ -220,14 +267,14 @@ class SetCommand : public Command {
     RecordKey rk(expdb.value().chunkId,
                  pCtx->getDbId(),
                  RecordType::RT_KV,
-                 params.key,
+                 *params.key,
                  "");
 
     uint64_t ts = 0;
     if (params.expire != 0) {
       ts = msSinceEpoch() + params.expire;
     }
-    RecordValue rv(params.value, RecordType::RT_KV, pCtx->getVersionEP(), ts);
+    RecordValue rv(*params.value, RecordType::RT_KV, pCtx->getVersionEP(), ts);
 
     for (int32_t i = 0; i < RETRY_CNT - 1; ++i) {
       auto result = setGeneric(sess,
@@ -549,7 +596,7 @@ class StrlenCommand : public Command {
     INVARIANT(pCtx != nullptr);
     const std::string& key = sess->getArgs()[1];
     Expected<RecordValue> rv =
-      Command::expireKeyIfNeeded(sess, key, RecordType::RT_KV);
+      Command::expireKeyIfNeeded(sess, key, RecordType::RT_KV, true, false);
     if (rv.status().code() == ErrorCodes::ERR_EXPIRED) {
       return Command::fmtZero();
     } else if (rv.status().code() == ErrorCodes::ERR_NOTFOUND) {
@@ -557,7 +604,7 @@ class StrlenCommand : public Command {
     } else if (!rv.status().ok()) {
       return rv.status();
     } else {
-      return Command::fmtLongLong(rv.value().getValue().size());
+      return Command::fmtLongLong(Command::getStringSize(rv.value()));
     }
   }
 } strlenCmd;
@@ -596,10 +643,59 @@ class BitPosCommand : public Command {
     } else {
       return {ErrorCodes::ERR_PARSEOPT, "The bit argument must be 1 or 0."};
     }
-    Expected<RecordValue> rv =
-      Command::expireKeyIfNeeded(sess, key, RecordType::RT_KV);
-    if (rv.status().code() == ErrorCodes::ERR_EXPIRED ||
-        rv.status().code() == ErrorCodes::ERR_NOTFOUND) {
+    int64_t start = 0;
+    int64_t end = 0;
+    Status s(ErrorCodes::ERR_OK, "");
+    // only [start, end] of the string is read
+    auto rangeOf = [&](uint64_t size) -> std::pair<uint64_t, uint64_t> {
+      ssize_t len = size;
+      end = len - 1;
+      if (args.size() == 4 || args.size() == 5) {
+        Expected<int64_t> estart = ::tendisplus::stoll(args[3]);
+        if (!estart.ok()) {
+          s = estart.status();
+          return {0, 0};
+        }
+        start = estart.value();
+        if (args.size() == 5) {
+          Expected<int64_t> eend = ::tendisplus::stoll(args[4]);
+          if (!eend.ok()) {
+            s = eend.status();
+            return {0, 0};
+          }
+          end = eend.value();
+          endGiven = true;
+        }
+
+        if (start < 0) {
+          start = len + start;
+        }
+        if (end < 0) {
+          end = len + end;
+        }
+        if (start < 0) {
+          start = 0;
+        }
+        if (end < 0) {
+          end = 0;
+        }
+        if (end >= len) {
+          end = len - 1;
+        }
+      } else if (args.size() == 3) {
+        // nothing
+      } else {
+        s = Status(ErrorCodes::ERR_PARSEOPT, "syntax error");
+        return {0, 0};
+      }
+      if (start > end) {
+        return {0, 0};
+      }
+      return {start, end - start + 1};
+    };
+    auto target = getStringRangeGeneric(sess, key, rangeOf);
+    if (target.status().code() == ErrorCodes::ERR_EXPIRED ||
+        target.status().code() == ErrorCodes::ERR_NOTFOUND) {
       /* If the key does not exist, from our point of view it is an
        * infinite array of 0 bits. If the user is looking for the fist
        * clear bit return 0, If the user is looking for the first set bit,
@@ -609,53 +705,17 @@ class BitPosCommand : public Command {
       } else {
         return Command::fmtLongLong(0);
       }
-    } else if (!rv.status().ok()) {
-      return rv.status();
+    } else if (!target.ok()) {
+      return target.status();
     }
-    int64_t start = 0;
-    const std::string& target = rv.value().getValue();
-    int64_t end = target.size() - 1;
-    if (args.size() == 4 || args.size() == 5) {
-      Expected<int64_t> estart = ::tendisplus::stoll(args[3]);
-      if (!estart.ok()) {
-        return estart.status();
-      }
-      start = estart.value();
-      if (args.size() == 5) {
-        Expected<int64_t> eend = ::tendisplus::stoll(args[4]);
-        if (!eend.ok()) {
-          return eend.status();
-        }
-        end = eend.value();
-        endGiven = true;
-      }
-
-      ssize_t len = rv.value().getValue().size();
-      if (start < 0) {
-        start = len + start;
-      }
-      if (end < 0) {
-        end = len + end;
-      }
-      if (start < 0) {
-        start = 0;
-      }
-      if (end < 0) {
-        end = 0;
-      }
-      if (end >= len) {
-        end = len - 1;
-      }
-    } else if (args.size() == 3) {
-      // nothing
-    } else {
-      return {ErrorCodes::ERR_PARSEOPT, "syntax error"};
+    if (!s.ok()) {
+      return s;
     }
     if (start > end) {
       return Command::fmtLongLong(-1);
     }
     int64_t result =
-      redis_port::bitPos(target.c_str() + start, end - start + 1, bit);
+      redis_port::bitPos(target.value().c_str(), end - start + 1, bit);
     if (endGiven && bit == 0 && result == (end - start + 1) * 8) {
       return Command::fmtLongLong(-1);
     }
@@ -689,56 +749,66 @@ class BitCountCommand : public Command {
   Expected<std::string> run(Session* sess) final {
     SessionCtx* pCtx = sess->getCtx();
     INVARIANT(pCtx != nullptr);
-    const std::string& key = sess->getArgs()[1];
-    Expected<RecordValue> rv =
-      Command::expireKeyIfNeeded(sess, key, RecordType::RT_KV);
-    if (rv.status().code() == ErrorCodes::ERR_EXPIRED) {
-      return Command::fmtZero();
-    } else if (rv.status().code() == ErrorCodes::ERR_NOTFOUND) {
-      return Command::fmtZero();
-    } else if (!rv.status().ok()) {
-      return rv.status();
-    }
+    const std::vector<std::string>& args = sess->getArgs();
+    const std::string& key = args[1];
     int64_t start = 0;
-    const std::string& target = rv.value().getValue();
-    int64_t end = target.size() - 1;
-    if (sess->getArgs().size() == 4) {
-      Expected<int64_t> estart = ::tendisplus::stoll(sess->getArgs()[2]);
-      Expected<int64_t> eend = ::tendisplus::stoll(sess->getArgs()[3]);
-      if (!estart.ok() || !eend.ok()) {
-        return estart.ok() ? eend.status() : estart.status();
-      }
-      start = estart.value();
-      end = eend.value();
-      if (start < 0 && end < 0 && start > end) {
-        return Command::fmtZero();
-      }
-      ssize_t len = rv.value().getValue().size();
-      if (start < 0) {
-        start = len + start;
-      }
-      if (end < 0) {
-        end = len + end;
-      }
-      if (start < 0) {
-        start = 0;
-      }
-      if (end < 0) {
-        end = 0;
+    int64_t end = 0;
+    Status s(ErrorCodes::ERR_OK, "");
+    // only [start, end] of the string is read
+    auto rangeOf = [&](uint64_t size) -> std::pair<uint64_t, uint64_t> {
+      ssize_t len = size;
+      end = len - 1;
+      if (args.size() == 4) {
+        Expected<int64_t> estart = ::tendisplus::stoll(args[2]);
+        Expected<int64_t> eend = ::tendisplus::stoll(args[3]);
+        if (!estart.ok() || !eend.ok()) {
+          s = estart.ok() ? eend.status() : estart.status();
+          return {0, 0};
+        }
+        start = estart.value();
+        end = eend.value();
+        if (start < 0 && end < 0 && start > end) {
+          return {0, 0};
+        }
+        if (start < 0) {
+          start = len + start;
+        }
+        if (end < 0) {
+          end = len + end;
+        }
+        if (start < 0) {
+          start = 0;
+        }
+        if (end < 0) {
+          end = 0;
+        }
+        if (end >= len) {
+          end = len - 1;
+        }
+      } else if (args.size() == 2) {
+        // nothing
+      } else {
+        s = Status(ErrorCodes::ERR_PARSEOPT, "syntax error");
+        return {0, 0};
       }
-      if (end >= len) {
-        end = len - 1;
+      if (start > end) {
+        return {0, 0};
       }
-    } else if (sess->getArgs().size() == 2) {
-      // nothing
-    } else {
-      return {ErrorCodes::ERR_PARSEOPT, "syntax error"};
-    }
-    if (start > end) {
+      return {start, end - start + 1};
+    };
+    auto target = getStringRangeGeneric(sess, key, rangeOf);
+    if (target.status().code() == ErrorCodes::ERR_EXPIRED) {
       return Command::fmtZero();
+    } else if (target.status().code() == ErrorCodes::ERR_NOTFOUND) {
+      return Command::fmtZero();
+    } else if (!target.ok()) {
+      return target.status();
+    }
+    if (!s.ok()) {
+      return s;
     }
     return Command::fmtLongLong(
-      redis_port::popCount(target.c_str() + start, end - start + 1));
+      redis_port::popCount(target.value().c_str(), target.value().size()));
   }
 } bitcntCmd;
 
@@ -875,33 +945,37 @@ class GetRangeGenericCommand : public GetGenericCmd {
     }
     int64_t end = eend.value();
 
-    auto v = GetGenericCmd::run(sess);
+    // only [start, end] of the string is read
+    auto rangeOf = [&](uint64_t size) -> std::pair<uint64_t, uint64_t> {
+      ssize_t len = size;
+      if (start < 0) {
+        start = len + start;
+      }
+      if (end < 0) {
+        end = len + end;
+      }
+      if (start < 0) {
+        start = 0;
+      }
+      if (end < 0) {
+        end = 0;
+      }
+      if (end >= len) {
+        end = len - 1;
+      }
+      if (start > end || len == 0) {
+        return {0, 0};
+      }
+      return {start, end - start + 1};
+    };
+    auto v = getStringRangeGeneric(sess, sess->getArgs()[1], rangeOf);
     if (v.status().code() == ErrorCodes::ERR_EXPIRED ||
         v.status().code() == ErrorCodes::ERR_NOTFOUND) {
       return Command::fmtBulk("");
     } else if (!v.ok()) {
       return v.status();
     }
-    std::string s = std::move(v.value());
-    if (start < 0) {
-      start = s.size() + start;
-    }
-    if (end < 0) {
-      end = s.size() + end;
-    }
-    if (start < 0) {
-      start = 0;
-    }
-    if (end < 0) {
-      end = 0;
-    }
-    if (end >= static_cast<ssize_t>(s.size())) {
-      end = s.size() - 1;
-    }
-    if (start > end || s.size() == 0) {
-      return Command::fmtBulk("");
-    }
-    return Command::fmtBulk(s.substr(start, end - start + 1));
+    return Command::fmtBulk(v.value());
   }
 };
 
@@ -1062,9 +1136,108 @@ class CasCommand : public GetSetGeneral {
   }
 } casCommand;
 
-class AppendCommand : public GetSetGeneral {
+// APPEND/SETRANGE/SETBIT overwrite a range of the string, only the range
+// is read and written if the string is chunked.
+class SetRangeGeneral : public Command {
+ public:
+  explicit SetRangeGeneral(const std::string& name, const char* sflags)
+    : Command(name, sflags) {}
+
+  // the range to overwrite as (offset, len), size is the length of the
+  // string. return ERR_NOTFOUND if nothing to do for a key not exists.
+  virtual Expected<std::pair<uint64_t, uint64_t>> rangeOf(
+    Session* sess, bool exists, uint64_t size) const = 0;
+
+  // the new content of the range, oldRange is padded with zero
+  virtual Expected<std::string> newRange(
+    Session* sess, const std::string& oldRange) const = 0;
+
+  // return the length of the new string and the old range
+  Expected<std::pair<uint64_t, std::string>> runGeneral(Session* sess) {
+    const std::string& key = sess->getArgs()[firstkey()];
+    SessionCtx* pCtx = sess->getCtx();
+    INVARIANT(pCtx != nullptr);
+
+    auto server = sess->getServerEntry();
+    INVARIANT(server != nullptr);
+    auto expdb = server->getSegmentMgr()->getDbWithKeyLock(
+      sess, key, mgl::LockMode::LOCK_X);
+    if (!expdb.ok()) {
+      return expdb.status();
+    }
+
+    PStore kvstore = expdb.value().store;
+    RecordKey rk(
+      expdb.value().chunkId, pCtx->getDbId(), RecordType::RT_KV, key, "");
+
+    for (int32_t i = 0; i < RETRY_CNT; ++i) {
+      // expire if possible, the value is read again on retry since the
+      // pieces and the size of the string may be changed
+      Expected<RecordValue> rv =
+        Command::expireKeyIfNeeded(sess, key, RecordType::RT_KV, true, false);
+      if (rv.status().code() != ErrorCodes::ERR_OK &&
+          rv.status().code() != ErrorCodes::ERR_EXPIRED &&
+          rv.status().code() != ErrorCodes::ERR_NOTFOUND) {
+        return rv.status();
+      }
+
+      uint64_t size = rv.ok() ? Command::getStringSize(rv.value()) : 0;
+      auto range = rangeOf(sess, rv.ok(), size);
+      if (range.status().code() == ErrorCodes::ERR_NOTFOUND) {
+        return std::make_pair(size, std::string());
+      }
+      if (!range.ok()) {
+        return range.status();
+      }
+      uint64_t offset = range.value().first;
+      uint64_t len = range.value().second;
+
+      auto ptxn = kvstore->createTransaction(sess);
+      if (!ptxn.ok()) {
+        return ptxn.status();
+      }
+      std::unique_ptr<Transaction> txn = std::move(ptxn.value());
+      std::string oldRange;
+      if (rv.ok()) {
+        auto eRange = Command::getStringRange(
+          kvstore, txn.get(), rk, rv.value(), offset, len);
+        if (!eRange.ok()) {
+          return eRange.status();
+        }
+        oldRange = std::move(eRange.value());
+      }
+      oldRange.resize(len, 0);
+      auto val = newRange(sess, oldRange);
+      if (!val.ok()) {
+        return val.status();
+      }
+      auto newSize = Command::setStringRange(
+        sess, kvstore, txn.get(), rk, rv, offset, val.value());
+      if (!newSize.ok()) {
+        return newSize.status();
+      }
+      auto eCmt = txn->commit();
+      if (eCmt.ok()) {
+        return std::make_pair(newSize.value(), std::move(oldRange));
+      }
+      if (eCmt.status().code() != ErrorCodes::ERR_COMMIT_RETRY) {
+        return eCmt.status();
+      }
+      if (i == RETRY_CNT - 1) {
+        return eCmt.status();
+      } else {
+        continue;
+      }
+    }
+
+    INVARIANT_D(0);
+    return {ErrorCodes::ERR_INTERNAL, "not reachable"};
+  }
+};
+
+class AppendCommand : public SetRangeGeneral {
  public:
-  AppendCommand() : GetSetGeneral("append", "wm") {}
+  AppendCommand() : SetRangeGeneral("append", "wm") {}
 
   ssize_t arity() const {
     return 3;
@@ -1082,39 +1255,29 @@ class AppendCommand : public GetSetGeneral {
     return 1;
   }
 
-  Expected<RecordValue> newValueFromOld(
-    Session* sess, const Expected<RecordValue>& oldValue) const {
-    const std::string& val = sess->getArgs()[2];
-    std::string cat;
-    if (!oldValue.ok()) {
-      cat = val;
-    } else {
-      cat = oldValue.value().getValue();
-      cat.insert(cat.end(), val.begin(), val.end());
-    }
+  Expected<std::pair<uint64_t, uint64_t>> rangeOf(Session* sess,
+                                                  bool exists,
+                                                  uint64_t size) const {
+    return std::make_pair(size, uint64_t(sess->getArgs()[2].size()));
+  }
 
-    uint64_t ttl = 0;
-    RecordType type = RecordType::RT_KV;
-    if (oldValue.ok()) {
-      ttl = oldValue.value().getTtl();
-      type = oldValue.value().getRecordType();
-    }
-    return std::move(RecordValue(
-      std::move(cat), type, sess->getCtx()->getVersionEP(), ttl, oldValue));
+  Expected<std::string> newRange(Session* sess,
+                                 const std::string& oldRange) const {
+    return sess->getArgs()[2];
   }
 
   Expected<std::string> run(Session* sess) final {
-    const Expected<RecordValue>& rv = runGeneral(sess);
-    if (!rv.ok()) {
-      return rv.status();
+    auto ret = runGeneral(sess);
+    if (!ret.ok()) {
+      return ret.status();
     }
-    return Command::fmtLongLong(rv.value().getValue().size());
+    return Command::fmtLongLong(ret.value().first);
   }
 } appendCmd;
 
-class SetRangeCommand : public GetSetGeneral {
+class SetRangeCommand : public SetRangeGeneral {
  public:
-  SetRangeCommand() : GetSetGeneral("setrange", "wm") {}
+  SetRangeCommand() : SetRangeGeneral("setrange", "wm") {}
 
   ssize_t arity() const {
     return 4;
@@ -1132,14 +1295,12 @@ class SetRangeCommand : public GetSetGeneral {
     return 1;
   }
 
-  Expected<RecordValue> newValueFromOld(
-    Session* sess, const Expected<RecordValue>& oldValue) const {
+  Expected<std::pair<uint64_t, uint64_t>> rangeOf(Session* sess,
+                                                  bool exists,
+                                                  uint64_t size) const {
     const std::string& val = sess->getArgs()[3];
-    if (oldValue.status().code() == ErrorCodes::ERR_NOTFOUND ||
-        oldValue.status().code() == ErrorCodes::ERR_EXPIRED) {
-      if (val.size() == 0) {
-        return {ErrorCodes::ERR_NOTFOUND, ""};
-      }
+    if (!exists && val.size() == 0) {
+      return {ErrorCodes::ERR_NOTFOUND, ""};
     }
     Expected<int64_t> eoffset = ::tendisplus::stoll(sess->getArgs()[2]);
     if (!eoffset.ok()) {
@@ -1148,47 +1309,31 @@ class SetRangeCommand : public GetSetGeneral {
     if (eoffset.value() < 0) {
       return {ErrorCodes::ERR_PARSEOPT, "offset is out of range"};
     }
-    uint32_t offset = eoffset.value();
+    uint64_t offset = eoffset.value();
     if (offset + val.size() > 512 * 1024 * 1024) {
       return {ErrorCodes::ERR_PARSEOPT,
               "string exceeds maximum allowed size (512MB)"};
     }
-    std::string cat;
-    if (oldValue.ok()) {
-      cat = oldValue.value().getValue();
-    }
-    if (offset + val.size() > cat.size()) {
-      cat.resize(offset + val.size(), 0);
-    }
-    for (size_t i = offset; i < offset + val.size(); ++i) {
-      cat[i] = val[i - offset];
-    }
-    uint64_t ttl = 0;
-    RecordType type = RecordType::RT_KV;
-    if (oldValue.ok()) {
-      ttl = oldValue.value().getTtl();
-      type = oldValue.value().getRecordType();
-    }
-    return RecordValue(
-      std::move(cat), type, sess->getCtx()->getVersionEP(), ttl, oldValue);
+    return std::make_pair(offset, uint64_t(val.size()));
+  }
+
+  Expected<std::string> newRange(Session* sess,
+                                 const std::string& oldRange) const {
+    return sess->getArgs()[3];
   }
 
   Expected<std::string> run(Session* sess) final {
-    const Expected<RecordValue>& rv = runGeneral(sess);
-    if (!rv.ok()) {
-      return rv.status();
+    auto ret = runGeneral(sess);
+    if (!ret.ok()) {
+      return ret.status();
     }
-    return Command::fmtLongLong(rv.value().getValue().size());
+    return Command::fmtLongLong(ret.value().first);
   }
 } setrangeCmd;
 
-class SetBitCommand : public GetSetGeneral {
+class SetBitCommand : public SetRangeGeneral {
  public:
-  SetBitCommand() : GetSetGeneral("setbit", "wm") {}
-
-  bool replyNewValue() const final {
-    return false;
-  }
+  SetBitCommand() : SetRangeGeneral("setbit", "wm") {}
 
   ssize_t arity() const {
     return 4;
@@ -1206,18 +1351,14 @@ class SetBitCommand : public GetSetGeneral {
     return 1;
   }
 
-  Expected<RecordValue> newValueFromOld(
-    Session* sess, const Expected<RecordValue>& oldValue) const {
+  Expected<std::pair<uint64_t, uint64_t>> rangeOf(Session* sess,
+                                                  bool exists,
+                                                  uint64_t size) const {
     Expected<uint64_t> epos = ::tendisplus::stoul(sess->getArgs()[2]);
     if (!epos.ok()) {
       return epos.status();
     }
     uint64_t pos = epos.value();
-    int on = 0;
-    std::string tomodify;
-    if (oldValue.ok()) {
-      tomodify = oldValue.value().getValue();
-    }
     if ((pos >> 3) >= (512 * 1024 * 1024)) {
       return {ErrorCodes::ERR_PARSEOPT,
               "bit offset is not an integer or out of range"};
@@ -1225,40 +1366,36 @@ class SetBitCommand : public GetSetGeneral {
     if ((pos >> 3) > 4 * 1024 * 1024) {
       LOG(WARNING) << "meet large bitpos:" << pos;
     }
-    if (sess->getArgs()[3] == "1") {
-      on = 1;
-    } else if (sess->getArgs()[3] == "0") {
-      on = 0;
-    } else {
+    if (sess->getArgs()[3] != "1" && sess->getArgs()[3] != "0") {
       return {ErrorCodes::ERR_PARSEOPT,
               "bit is not an integer or out of range"};
     }
+    // only the byte of the bit
+    return std::make_pair(pos >> 3, uint64_t(1));
+  }
 
-    uint64_t byte = (pos >> 3);
-    if (tomodify.size() < byte + 1) {
-      tomodify.resize(byte + 1, 0);
+  Expected<std::string> newRange(Session* sess,
+                                 const std::string& oldRange) const {
+    Expected<uint64_t> epos = ::tendisplus::stoul(sess->getArgs()[2]);
+    if (!epos.ok()) {
+      return epos.status();
     }
-    uint8_t byteval = static_cast<uint8_t>(tomodify[byte]);
+    uint64_t pos = epos.value();
+    int on = sess->getArgs()[3] == "1" ? 1 : 0;
+
+    std::string tomodify = oldRange;
+    uint8_t byteval = static_cast<uint8_t>(tomodify[0]);
     uint8_t bit = 7 - (pos & 0x7);
     byteval &= ~(1 << bit);
     byteval |= ((on & 0x1) << bit);
-    tomodify[byte] = byteval;
-
-    // incrby wont clear ttl
-    uint64_t ttl = 0;
-    RecordType type = RecordType::RT_KV;
-    if (oldValue.ok()) {
-      ttl = oldValue.value().getTtl();
-      type = oldValue.value().getRecordType();
-    }
-    return RecordValue(
-      std::move(tomodify), type, sess->getCtx()->getVersionEP(), ttl, oldValue);
+    tomodify[0] = byteval;
+    return tomodify;
   }
 
   Expected<std::string> run(Session* sess) final {
-    const Expected<RecordValue>& rv = runGeneral(sess);
-    if (!rv.ok()) {
-      return rv.status();
+    auto ret = runGeneral(sess);
+    if (!ret.ok()) {
+      return ret.status();
     }
 
     Expected<uint64_t> epos = ::tendisplus::stoul(sess->getArgs()[2]);
@@ -1266,13 +1403,8 @@ class SetBitCommand : public GetSetGeneral {
       return epos.status();
     }
     uint64_t pos = epos.value();
-    std::string toreturn = rv.value().getValue();
-
-    uint64_t byte = (pos >> 3);
-    if (toreturn.size() < byte + 1) {
-      toreturn.resize(byte + 1, 0);
-    }
-    uint8_t byteval = static_cast<uint8_t>(toreturn[byte]);
+    const std::string& oldRange = ret.value().second;
+    uint8_t byteval = static_cast<uint8_t>(oldRange[0]);
     uint8_t bit = 7 - (pos & 0x7);
     uint8_t bitval = byteval & (1 << bit);
     return bitval ? Command::fmtOne() : Command::fmtZero();
@@ -1673,6 +1805,10 @@ class MGetCommand : public Command {
  public:
   MGetCommand() : Command("mget", "rF") {}
 
+  Expected<std::string> run(Session* sess) final {
+    return runReplyToString(sess);
+  }
+
   ssize_t arity() const {
     return -2;
   }
@@ -1689,7 +1825,7 @@ class MGetCommand : public Command {
     return 1;
   }
 
-  Expected<std::string> run(Session* sess) final {
+  Status runReply(Session* sess, ReplyBuffer* reply) final {
     SessionCtx* pCtx = sess->getCtx();
     INVARIANT(pCtx != nullptr);
     auto server = sess->getServerEntry();
@@ -1703,23 +1839,21 @@ class MGetCommand : public Command {
       return locklist.status();
     }
 
-    std::stringstream ss;
-    Command::fmtMultiBulkLen(ss, sess->getArgs().size() - 1);
-    for (size_t i = 1; i < sess->getArgs().size(); ++i) {
-      const std::string& key = sess->getArgs()[i];
-      Expected<RecordValue> rv =
-        Command::expireKeyIfNeeded(sess, key, RecordType::RT_KV);
+    auto values =
+      Command::expireKeysIfNeeded(sess, args, index, RecordType::RT_KV);
+    Command::fmtMultiBulkLen(*reply, values.size());
+    for (auto& rv : values) {
       if (rv.status().code() == ErrorCodes::ERR_EXPIRED ||
           rv.status().code() == ErrorCodes::ERR_NOTFOUND ||
           rv.status().code() == ErrorCodes::ERR_WRONG_TYPE) {
-        Command::fmtNull(ss);
+        Command::fmtNull(*reply);
         continue;
       } else if (!rv.status().ok()) {
         return rv.status();
       }
-      Command::fmtBulk(ss, rv.value().getValue());
+      Command::fmtBulk(*reply, rv.value().getValue());
     }
-    return ss.str();
+    return {ErrorCodes::ERR_OK, ""};
   }
 } mgetCmd;
 
@@ -1976,7 +2110,7 @@ class MSetGenericCommand : public Command {
     if (!failed) {
       auto s = pCtx->commitAll("mset(nx)");
       if (!s.ok()) {
-        failed = true;
+        return s;
       }
     } else {
       pCtx->rollbackAll();
@@ -2138,8 +2272,25 @@ class RenameGenericCommand : public Command {
       return dptxn.status();
     }
 
-    // set new meta k/v
-    s = dststore->setKV(dstRk, rv.value(), dptxn.value());
+    // set new meta k/v, the subkeys of dst get a new version, so that
+    // the stale subkeys of an old dst deleted lazily are not visible.
+    RecordValue dstRv = rv.value();
+    if (rcd_util::isVersionedType(dstRv.getRecordType())) {
+      dstRv.setVersion(rcd_util::genSubKeyVersion());
+    }
+    if (dstRv.isChunked()) {
+      // the pieces of src are dropped with its meta, dst is saved as a
+      // new chunked string
+      s = Command::loadChunkedString(srcstore, sptxn.value(), rk, &dstRv);
+      if (!s.ok()) {
+        return s;
+      }
+    }
+    if (dstRv.getRecordType() == RecordType::RT_KV) {
+      s = Command::setStringKV(sess, dststore, dptxn.value(), dstRk, dstRv);
+    } else {
+      s = dststore->setKV(dstRk, dstRv, dptxn.value());
+    }
     if (!s.ok()) {
       return s;
     }
@@ -2161,8 +2312,11 @@ class RenameGenericCommand : public Command {
     }
 
     if (rv.value().getRecordType() == RecordType::RT_KV) {
-      pCtx->commitAll("rename");
       rollback = false;
+      auto s = pCtx->commitAll("rename");
+      if (!s.ok()) {
+        return s;
+      }
       return _flagnx ? Command::fmtOne() : Command::fmtOK();
     }
 
@@ -2172,7 +2326,7 @@ class RenameGenericCommand : public Command {
     }
 
     std::vector<std::string> prefixes =
-      getEleType(rk, rv.value().getRecordType());
+      getEleType(rk, rv.value().getRecordType(), rv.value().getVersion());
     std::vector<Record> pending;
     pending.reserve(cnt.value());
     for (const auto& prefix : prefixes) {
@@ -2202,7 +2356,8 @@ class RenameGenericCommand : public Command {
                    dstRk.getDbId(),
                    srcRk.getRecordType(),
                    dst,
-                   srcRk.getSecondaryKey());
+                   srcRk.getSecondaryKey(),
+                   dstRv.getVersion());
       const RecordValue& rv = ele.getRecordValue();
       Status s = dststore->setKV(rk, rv, dptxn.value());
       if (!s.ok()) {
@@ -2218,8 +2373,11 @@ class RenameGenericCommand : public Command {
       }
     }
 
-    pCtx->commitAll("rename");
     rollback = false;
+    auto cs = pCtx->commitAll("rename");
+    if (!cs.ok()) {
+      return cs;
+    }
 
     return _flagnx ? Command::fmtOne() : Command::fmtOK();
   }
@@ -2227,14 +2385,16 @@ class RenameGenericCommand : public Command {
  private:
   bool _flagnx;
   std::vector<std::string> getEleType(const RecordKey& rk,
-                                      const RecordType& type) {
+                                      const RecordType& type,
+                                      uint64_t version) {
     std::vector<std::string> ret;
     if (type == RecordType::RT_HASH_META) {
       RecordKey fakeRk(rk.getChunkId(),
                        rk.getDbId(),
                        RecordType::RT_HASH_ELE,
                        rk.getPrimaryKey(),
-                       "");
+                       "",
+                       version);
       ret.push_back(fakeRk.prefixPk());
     } else if (type == RecordType::RT_LIST_META) {
       RecordKey fakeRk(rk.getChunkId(),
@@ -2248,20 +2408,23 @@ class RenameGenericCommand : public Command {
                        rk.getDbId(),
                        RecordType::RT_SET_ELE,
                        rk.getPrimaryKey(),
-                       "");
+                       "",
+                       version);
       ret.push_back(fakeRk.prefixPk());
     } else if (type == RecordType::RT_ZSET_META) {
       RecordKey fakeRk(rk.getChunkId(),
                        rk.getDbId(),
                        RecordType::RT_ZSET_S_ELE,
                        rk.getPrimaryKey(),
-                       "");
+                       "",
+                       version);
       ret.push_back(fakeRk.prefixPk());
       RecordKey fakeRk2(rk.getChunkId(),
                         rk.getDbId(),
                         RecordType::RT_ZSET_H_ELE,
                         rk.getPrimaryKey(),
-                        "");
+                        "",
+                        version);
       ret.push_back(fakeRk2.prefixPk());
     }
     return ret;
@@ -2308,7 +2471,13 @@ class GetBitCommand : public GetGenericCmd {
       return {ErrorCodes::ERR_PARSEOPT,
               "bit offset is not an integer or out of range"};
     }
-    auto v = GetGenericCmd::run(sess);
+    uint64_t byte = pos >> 3;
+    size_t bit = 7 - (pos & 0x7);
+    // only the byte is read
+    auto rangeOf = [byte](uint64_t) -> std::pair<uint64_t, uint64_t> {
+      return {byte, 1};
+    };
+    auto v = getStringRangeGeneric(sess, sess->getArgs()[1], rangeOf);
     if (v.status().code() == ErrorCodes::ERR_EXPIRED ||
         v.status().code() == ErrorCodes::ERR_NOTFOUND) {
       return Command::fmtZero();
@@ -2317,16 +2486,11 @@ class GetBitCommand : public GetGenericCmd {
       return v.status();
     }
 
-    std::string bitValue = v.value();
-    size_t byte, bit;
-    uint8_t bitval = 0;
-
-    byte = pos >> 3;
-    bit = 7 - (pos & 0x7);
-    if (byte > bitValue.size()) {
+    const std::string& bitValue = v.value();
+    if (bitValue.empty()) {
       return Command::fmtZero();
     }
-    bitval = static_cast<uint8_t>(bitValue[byte]) & (1 << bit);
+    uint8_t bitval = static_cast<uint8_t>(bitValue[0]) & (1 << bit);
     return bitval ? Command::fmtOne() : Command::fmtZero();
   }
 } getbitCommand;
@@ -2508,6 +2672,9 @@ class BitFieldCommand : public Command {
 
     bool readonly(1);
     size_t highestOffset(0);
+    // the bits touched by all the ops
+    size_t lowestAnyOffset(std::numeric_limits<size_t>::max());
+    size_t highestAnyOffset(0);
     BFOverFlowType owtype(BFOverFlowType::BFOVERFLOW_WRAP);
     for (size_t i = 2; i < args.size(); i++) {
       int remaining = args.size() - i - 1;
@@ -2573,6 +2740,10 @@ class BitFieldCommand : public Command {
                 "bit offset is not an integer or out of range"};
       }
 
+      lowestAnyOffset = std::min(lowestAnyOffset, static_cast<size_t>(offset));
+      highestAnyOffset =
+        std::max(highestAnyOffset, static_cast<size_t>(offset) + bits - 1);
+
       ++i;
       if (opcode != FieldOpType::BITFIELDOP_GET) {
         readonly = 0;
@@ -2589,30 +2760,51 @@ class BitFieldCommand : public Command {
         static_cast<size_t>(offset), i64, opcode, owtype, bits, sign});
     }
 
-    std::string value;
-    RecordValue rv(RecordType::RT_KV);
     const std::string& key = args[1];
     auto server = sess->getServerEntry();
     auto pCtx = sess->getCtx();
     auto expdb = server->getSegmentMgr()->getDbWithKeyLock(
       sess, key, mgl::LockMode::LOCK_X);
+    if (!expdb.ok()) {
+      return expdb.status();
+    }
     Expected<RecordValue> eRv =
-      Command::expireKeyIfNeeded(sess, key, RecordType::RT_KV);
+      Command::expireKeyIfNeeded(sess, key, RecordType::RT_KV, true, false);
     if (eRv.status().code() == ErrorCodes::ERR_EXPIRED ||
         eRv.status().code() == ErrorCodes::ERR_NOTFOUND) {
       if (readonly)
         return Command::fmtZero();
     } else if (!eRv.ok()) {
       return eRv.status();
-    } else {
-      rv = std::move(eRv.value());
-      value = rv.getValue();
+    }
+
+    PStore kvstore = expdb.value().store;
+    auto ptxn = kvstore->createTransaction(sess);
+    if (!ptxn.ok()) {
+      return ptxn.status();
+    }
+    std::unique_ptr<Transaction> txn = std::move(ptxn.value());
+    RecordKey rk(
+      expdb.value().chunkId, pCtx->getDbId(), RecordType::RT_KV, key, "");
+
+    // NOTE: value holds only the bytes touched by the ops, from the byte
+    // winStart, so that the other pieces of a chunked string are not read.
+    uint64_t winStart = ops.empty() ? 0 : lowestAnyOffset >> 3;
+    std::string value;
+    if (eRv.ok() && !ops.empty()) {
+      uint64_t winLen = (highestAnyOffset >> 3) + 1 - winStart;
+      auto eValue = Command::getStringRange(
+        kvstore, txn.get(), rk, eRv.value(), winStart, winLen);
+      if (!eValue.ok()) {
+        return eValue.status();
+      }
+      value = std::move(eValue.value());
     }
 
     if (!readonly) {
       uint64_t maxbyte = highestOffset >> 3;
-      if (value.size() < maxbyte + 1)
-        value.resize(maxbyte + 1);
+      if (value.size() < maxbyte + 1 - winStart)
+        value.resize(maxbyte + 1 - winStart);
     }
     bool changes(false);
 
@@ -2622,6 +2814,7 @@ class BitFieldCommand : public Command {
     for (size_t i = 0; i < size; i++) {
       BitfieldOp op = ops.front();
       ops.pop();
+      op.offset -= winStart * 8;
       if (op.opcode == FieldOpType::BITFIELDOP_SET ||
           op.opcode == FieldOpType::BITFIELDOP_INCRBY) {
         if (op.sign) {
@@ -2701,19 +2894,10 @@ class BitFieldCommand : public Command {
       }
     }  // end of ops' loop
     if (changes) {
-      RecordKey rk(
-        expdb.value().chunkId, pCtx->getDbId(), RecordType::RT_KV, key, "");
-      RecordValue newrv(
-        value, RecordType::RT_KV, pCtx->getVersionEP(), rv.getTtl(), rv);
-      PStore kvstore = expdb.value().store;
-      auto ptxn = kvstore->createTransaction(sess);
-      if (!ptxn.ok()) {
-        return ptxn.status();
-      }
-      std::unique_ptr<Transaction> txn = std::move(ptxn.value());
-      Status s = kvstore->setKV(rk, newrv, txn.get());
+      auto s = Command::setStringRange(
+        sess, kvstore, txn.get(), rk, eRv, winStart, value);
       if (!s.ok()) {
-        return s;
+        return s.status();
       }
       auto eCmt = txn->commit();
       if (!eCmt.ok()) {
@@ -14,6 +14,7 @@
 #include "tendisplus/utils/string.h"
 #include "tendisplus/utils/invariant.h"
 #include "tendisplus/utils/scopeguard.h"
+#include "tendisplus/utils/time.h"
 #include "tendisplus/commands/command.h"
 
 namespace tendisplus {
@@ -153,6 +154,65 @@ Expected<std::string> genericPush(Session* sess,
   return Command::fmtLongLong(lm.getTail() - lm.getHead());
 }
 
+// pop an element of the key with the key locked,
+// return ERR_NOTFOUND if the list is empty
+Expected<std::string> lockAndPop(Session* sess,
+                                 const std::string& key,
+                                 ListPos pos) {
+  SessionCtx* pCtx = sess->getCtx();
+  INVARIANT(pCtx != nullptr);
+
+  auto server = sess->getServerEntry();
+  auto expdb = server->getSegmentMgr()->getDbWithKeyLock(
+    sess, key, mgl::LockMode::LOCK_X);
+  if (!expdb.ok()) {
+    return expdb.status();
+  }
+  Expected<RecordValue> rv =
+    Command::expireKeyIfNeeded(sess, key, RecordType::RT_LIST_META);
+  if (rv.status().code() == ErrorCodes::ERR_EXPIRED ||
+      rv.status().code() == ErrorCodes::ERR_NOTFOUND) {
+    return {ErrorCodes::ERR_NOTFOUND, ""};
+  } else if (!rv.ok()) {
+    return rv.status();
+  }
+
+  // record exists
+  RecordKey metaRk(expdb.value().chunkId,
+                   pCtx->getDbId(),
+                   RecordType::RT_LIST_META,
+                   key,
+                   "");
+  PStore kvstore = expdb.value().store;
+
+  for (uint32_t i = 0; i < Command::RETRY_CNT; ++i) {
+    auto ptxn = kvstore->createTransaction(sess);
+    if (!ptxn.ok()) {
+      return ptxn.status();
+    }
+    std::unique_ptr<Transaction> txn = std::move(ptxn.value());
+    Expected<std::string> s1 =
+      genericPop(sess, kvstore, txn.get(), metaRk, rv, pos);
+    if (!s1.ok()) {
+      return s1.status();
+    }
+    auto s = txn->commit();
+    if (s.ok()) {
+      return s1.value();
+    } else if (s.status().code() != ErrorCodes::ERR_COMMIT_RETRY) {
+      return s.status();
+    }
+    if (i == Command::RETRY_CNT - 1) {
+      return s.status();
+    } else {
+      continue;
+    }
+  }
+
+  INVARIANT_D(0);
+  return {ErrorCodes::ERR_INTERNAL, "not reachable"};
+}
+
 class LLenCommand : public Command {
  public:
   LLenCommand() : Command("llen", "rF") {}
@@ -226,60 +286,13 @@ class ListPopWrapper : public Command {
     const std::vector<std::string>& args = sess->getArgs();
     const std::string& key = args[1];
 
-    SessionCtx* pCtx = sess->getCtx();
-    INVARIANT(pCtx != nullptr);
-
-    auto server = sess->getServerEntry();
-    auto expdb = server->getSegmentMgr()->getDbWithKeyLock(
-      sess, key, mgl::LockMode::LOCK_X);
-    if (!expdb.ok()) {
-      return expdb.status();
-    }
-    Expected<RecordValue> rv =
-      Command::expireKeyIfNeeded(sess, key, RecordType::RT_LIST_META);
-    if (rv.status().code() == ErrorCodes::ERR_EXPIRED ||
-        rv.status().code() == ErrorCodes::ERR_NOTFOUND) {
+    auto v = lockAndPop(sess, key, _pos);
+    if (v.status().code() == ErrorCodes::ERR_NOTFOUND) {
       return Command::fmtNull();
-    } else if (!rv.ok()) {
-      return rv.status();
-    }
-
-    // record exists
-    RecordKey metaRk(expdb.value().chunkId,
-                     pCtx->getDbId(),
-                     RecordType::RT_LIST_META,
-                     key,
-                     "");
-    PStore kvstore = expdb.value().store;
-
-    for (uint32_t i = 0; i < RETRY_CNT; ++i) {
-      auto ptxn = kvstore->createTransaction(sess);
-      if (!ptxn.ok()) {
-        return ptxn.status();
-      }
-      std::unique_ptr<Transaction> txn = std::move(ptxn.value());
-      Expected<std::string> s1 =
-        genericPop(sess, kvstore, txn.get(), metaRk, rv, _pos);
-      if (s1.status().code() == ErrorCodes::ERR_NOTFOUND) {
-        return Command::fmtNull();
-      } else if (!s1.ok()) {
-        return s1.status();
-      }
-      auto s = txn->commit();
-      if (s.ok()) {
-        return Command::fmtBulk(s1.value());
-      } else if (s.status().code() != ErrorCodes::ERR_COMMIT_RETRY) {
-        return s.status();
-      }
-      if (i == RETRY_CNT - 1) {
-        return s.status();
-      } else {
-        continue;
-      }
+    } else if (!v.ok()) {
+      return v.status();
     }
-
-    INVARIANT_D(0);
-    return {ErrorCodes::ERR_INTERNAL, "not reachable"};
+    return Command::fmtBulk(v.value());
   }
 
  private:
@@ -370,6 +383,7 @@ class ListPushWrapper : public Command {
       }
       auto s = txn->commit();
       if (s.ok()) {
+        server->getBlockingMgr()->signalKey(pCtx->getDbId(), key);
         return s1.value();
       } else if (s.status().code() != ErrorCodes::ERR_COMMIT_RETRY) {
         return s.status();
@@ -411,6 +425,170 @@ class RPushXCommand : public ListPushWrapper {
 } rpushxCommand;
 
 // NOTE(deyukong): atomic is not guaranteed
+// pop an element from args[1] and push it to args[2], with the keys of
+// index locked, return ERR_NOTFOUND if args[1] is empty
+Expected<std::string> rpopLPush(Session* sess, const std::vector<int>& index) {
+  const std::vector<std::string>& args = sess->getArgs();
+  const std::string& key1 = args[1];
+  const std::string& key2 = args[2];
+
+  SessionCtx* pCtx = sess->getCtx();
+  auto server = sess->getServerEntry();
+  INVARIANT(pCtx != nullptr);
+
+  auto locklist = server->getSegmentMgr()->getAllKeysLocked(
+    sess, args, index, mgl::LockMode::LOCK_X);
+  if (!locklist.ok()) {
+    return locklist.status();
+  }
+
+  Expected<RecordValue> rv =
+    Command::expireKeyIfNeeded(sess, key1, RecordType::RT_LIST_META);
+  if (rv.status().code() == ErrorCodes::ERR_EXPIRED ||
+      rv.status().code() == ErrorCodes::ERR_NOTFOUND) {
+    return {ErrorCodes::ERR_NOTFOUND, ""};
+  } else if (!rv.ok()) {
+    return rv.status();
+  }
+
+  auto expdb1 = server->getSegmentMgr()->getDbHasLocked(sess, key1);
+  if (!expdb1.ok()) {
+    return expdb1.status();
+  }
+  RecordKey metaRk1(expdb1.value().chunkId,
+                    pCtx->getDbId(),
+                    RecordType::RT_LIST_META,
+                    key1,
+                    "");
+  PStore kvstore1 = expdb1.value().store;
+  auto etxn = pCtx->createTransaction(kvstore1);
+  if (!etxn.ok()) {
+    return etxn.status();
+  }
+  bool rollback = true;
+  const auto guard = MakeGuard([&rollback, &pCtx] {
+    if (rollback) {
+      pCtx->rollbackAll();
+    }
+  });
+
+  std::string val = "";
+  for (uint32_t i = 0; i < Command::RETRY_CNT; ++i) {
+    Expected<std::string> s =
+      genericPop(sess, kvstore1, etxn.value(), metaRk1, rv, ListPos::LP_TAIL);
+    if (s.ok()) {
+      val = std::move(s.value());
+      break;
+    }
+    if (s.status().code() == ErrorCodes::ERR_NOTFOUND) {
+      return {ErrorCodes::ERR_NOTFOUND, ""};
+    }
+
+    if (s.status().code() != ErrorCodes::ERR_COMMIT_RETRY) {
+      return s.status();
+    }
+    if (i == Command::RETRY_CNT - 1) {
+      return s.status();
+    } else {
+      continue;
+    }
+  }
+
+  if (key1 == key2) {
+    // NOTE(vinchen): if key1 == key2, it should getkv of rv2 using
+    // etxn, because key1 has be pop() by etxn. Otherwise if rv2 =
+    // Command::expireKeyIfNeeded(), it would get the old value.
+    auto rv2 = kvstore1->getKV(metaRk1, etxn.value());
+    // Only means that former pop has removed this meta key.
+    // if (!rv2.ok()) {
+    // INVARIANT(0);
+    // return Command::fmtNull();
+    // }
+
+    for (uint32_t i = 0; i < Command::RETRY_CNT; ++i) {
+      auto s = genericPush(sess,
+                           kvstore1,
+                           etxn.value(),
+                           metaRk1,
+                           rv2,
+                           {val},
+                           ListPos::LP_HEAD,
+                           false /*need_exist*/);
+      if (s.ok()) {
+        rollback = false;
+        auto cs = pCtx->commitAll("rpoplpush");
+        if (!cs.ok()) {
+          return cs;
+        }
+        server->getBlockingMgr()->signalKey(pCtx->getDbId(), key2);
+        return val;
+      }
+      if (s.status().code() != ErrorCodes::ERR_COMMIT_RETRY) {
+        return s.status();
+      }
+      if (i == Command::RETRY_CNT - 1) {
+        return s.status();
+      } else {
+        continue;
+      }
+    }
+  } else {
+    auto expdb2 = server->getSegmentMgr()->getDbHasLocked(sess, key2);
+    if (!expdb2.ok()) {
+      return expdb2.status();
+    }
+    RecordKey metaRk2(expdb2.value().chunkId,
+                      pCtx->getDbId(),
+                      RecordType::RT_LIST_META,
+                      key2,
+                      "");
+    PStore kvstore2 = expdb2.value().store;
+
+    auto etxn2 = pCtx->createTransaction(kvstore2);
+    if (!etxn2.ok()) {
+      return etxn2.status();
+    }
+
+    Expected<RecordValue> rv2 =
+      Command::expireKeyIfNeeded(sess, key2, RecordType::RT_LIST_META);
+    if (rv2.status().code() != ErrorCodes::ERR_OK &&
+        rv2.status().code() != ErrorCodes::ERR_EXPIRED &&
+        rv2.status().code() != ErrorCodes::ERR_NOTFOUND) {
+      return rv2.status();
+    }
+
+    for (uint32_t i = 0; i < Command::RETRY_CNT; ++i) {
+      auto s = genericPush(sess,
+                           kvstore2,
+                           etxn2.value(),
+                           metaRk2,
+                           rv2,
+                           {val},
+                           ListPos::LP_HEAD,
+                           false /*need_exist*/);
+      if (s.ok()) {
+        rollback = false;
+        auto cs = pCtx->commitAll("rpoplpush");
+        if (!cs.ok()) {
+          return cs;
+        }
+        server->getBlockingMgr()->signalKey(pCtx->getDbId(), key2);
+        return val;
+      }
+      if (s.status().code() != ErrorCodes::ERR_COMMIT_RETRY) {
+        return s.status();
+      }
+      if (i == Command::RETRY_CNT - 1) {
+        return s.status();
+      } else {
+        continue;
+      }
+    }
+  }
+  INVARIANT_D(0);
+  return {ErrorCodes::ERR_INTERNAL, "not reachable"};
+}
+
 class RPopLPushCommand : public Command {
  public:
   RPopLPushCommand() : Command("rpoplpush", "wm") {}
@@ -432,160 +610,199 @@ class RPopLPushCommand : public Command {
   }
 
   Expected<std::string> run(Session* sess) final {
-    const std::vector<std::string>& args = sess->getArgs();
-    const std::string& key1 = args[1];
-    const std::string& key2 = args[2];
+    auto v = rpopLPush(sess, getKeysFromCommand(sess->getArgs()));
+    if (v.status().code() == ErrorCodes::ERR_NOTFOUND) {
+      return Command::fmtNull();
+    } else if (!v.ok()) {
+      return v.status();
+    }
+    return Command::fmtBulk(v.value());
+  }
+} rpoplpushCmd;
 
+// BLPOP/BRPOP/BRPOPLPUSH. If all the lists are empty, the session is
+// blocked instead of replying, see BlockingManager. It's resumed by a push
+// to one of the keys or the timeout, and runs the command again from the
+// start, so the keys are locked and checked as usual(e.g. MOVED).
+class ListBlockingWrapper : public Command {
+ public:
+  ListBlockingWrapper(const std::string& name, const char* sflags)
+    : Command(name, sflags) {}
+
+  Expected<std::string> run(Session* sess) final {
+    const std::vector<std::string>& args = sess->getArgs();
     SessionCtx* pCtx = sess->getCtx();
-    auto server = sess->getServerEntry();
     INVARIANT(pCtx != nullptr);
+    auto blockingMgr = sess->getServerEntry()->getBlockingMgr();
+
+    // only a normal client can be blocked, the others(or in MULTI)
+    // reply at once as if it's timed out.
+    bool canBlock =
+      sess->getType() == Session::Type::NET && !pCtx->isInMulti();
+    bool blocked = false;
+    const auto guard = MakeGuard([&] {
+      if (!blocked) {
+        pCtx->setBlockDeadline(0);
+        if (canBlock) {
+          blockingMgr->removeWaiter(sess->id());
+        }
+      }
+    });
 
-    auto index = getKeysFromCommand(args);
-    auto locklist = server->getSegmentMgr()->getAllKeysLocked(
-      sess, args, index, mgl::LockMode::LOCK_X);
-    if (!locklist.ok()) {
-      return locklist.status();
+    auto deadline = getDeadline(sess, args.back());
+    if (!deadline.ok()) {
+      return deadline.status();
+    }
+    if (canBlock) {
+      // add the waiter before reading the keys, so that a push committed
+      // after the reads can not be missed.
+      blockingMgr->addWaiter(
+        sess->id(), pCtx->getDbId(), blockingKeys(args), deadline.value());
     }
 
-    Expected<RecordValue> rv =
-      Command::expireKeyIfNeeded(sess, key1, RecordType::RT_LIST_META);
-    if (rv.status().code() == ErrorCodes::ERR_EXPIRED ||
-        rv.status().code() == ErrorCodes::ERR_NOTFOUND) {
-      return Command::fmtNull();
-    } else if (!rv.ok()) {
-      return rv.status();
+    auto v = tryPop(sess);
+    if (v.ok()) {
+      return v.value();
+    } else if (v.status().code() != ErrorCodes::ERR_NOTFOUND) {
+      return v.status();
     }
+    if (!canBlock || msSinceEpoch() >= deadline.value()) {
+      return Command::fmtNullArray();
+    }
+    blocked = true;
+    pCtx->setBlocked(true);
+    return std::string();
+  }
+
+ protected:
+  // the keys waited for
+  virtual std::vector<std::string> blockingKeys(
+    const std::vector<std::string>& args) = 0;
+  // return the reply, or ERR_NOTFOUND if all the lists are empty
+  virtual Expected<std::string> tryPop(Session* sess) = 0;
 
-    auto expdb1 = server->getSegmentMgr()->getDbHasLocked(sess, key1);
-    if (!expdb1.ok()) {
-      return expdb1.status();
+ private:
+  // the deadline(ms) is computed at the first run, and kept in SessionCtx
+  // until the command replies.
+  Expected<uint64_t> getDeadline(Session* sess, const std::string& timeout) {
+    SessionCtx* pCtx = sess->getCtx();
+    if (pCtx->getBlockDeadline() != 0) {
+      return pCtx->getBlockDeadline();
     }
-    RecordKey metaRk1(expdb1.value().chunkId,
-                      pCtx->getDbId(),
-                      RecordType::RT_LIST_META,
-                      key1,
-                      "");
-    PStore kvstore1 = expdb1.value().store;
-    auto etxn = pCtx->createTransaction(kvstore1);
-    if (!etxn.ok()) {
-      return etxn.status();
-    }
-    bool rollback = true;
-    const auto guard = MakeGuard([&rollback, &pCtx] {
-      if (rollback) {
-        pCtx->rollbackAll();
-      }
-    });
+    auto et = ::tendisplus::stoll(timeout);
+    if (!et.ok()) {
+      return {ErrorCodes::ERR_PARSEPKT,
+              "timeout is not an integer or out of range"};
+    }
+    if (et.value() < 0) {
+      return {ErrorCodes::ERR_PARSEPKT, "timeout is negative"};
+    }
+    uint64_t deadline = BlockingManager::NO_DEADLINE;
+    if (et.value() > 0) {
+      deadline = msSinceEpoch() + et.value() * 1000;
+    }
+    pCtx->setBlockDeadline(deadline);
+    return deadline;
+  }
+};
 
-    std::string val = "";
-    for (uint32_t i = 0; i < RETRY_CNT; ++i) {
-      Expected<std::string> s =
-        genericPop(sess, kvstore1, etxn.value(), metaRk1, rv, ListPos::LP_TAIL);
-      if (s.ok()) {
-        val = std::move(s.value());
-        break;
-      }
-      if (s.status().code() == ErrorCodes::ERR_NOTFOUND) {
-        return Command::fmtNull();
-      }
+class BListPopWrapper : public ListBlockingWrapper {
+ public:
+  explicit BListPopWrapper(ListPos pos, const char* sflags)
+    : ListBlockingWrapper(pos == ListPos::LP_HEAD ? "blpop" : "brpop",
+                          sflags),
+      _pos(pos) {}
 
-      if (s.status().code() != ErrorCodes::ERR_COMMIT_RETRY) {
-        return s.status();
-      }
-      if (i == RETRY_CNT - 1) {
-        return s.status();
-      } else {
+  ssize_t arity() const {
+    return -3;
+  }
+
+  int32_t firstkey() const {
+    return 1;
+  }
+
+  int32_t lastkey() const {
+    return -2;
+  }
+
+  int32_t keystep() const {
+    return 1;
+  }
+
+ protected:
+  std::vector<std::string> blockingKeys(
+    const std::vector<std::string>& args) final {
+    return std::vector<std::string>(args.begin() + 1, args.end() - 1);
+  }
+
+  // the keys are popped one by one in order, only one key is locked
+  // at a time.
+  Expected<std::string> tryPop(Session* sess) final {
+    const std::vector<std::string>& args = sess->getArgs();
+    for (size_t i = 1; i < args.size() - 1; ++i) {
+      auto v = lockAndPop(sess, args[i], _pos);
+      if (v.status().code() == ErrorCodes::ERR_NOTFOUND) {
         continue;
+      } else if (!v.ok()) {
+        return v.status();
       }
+      std::stringstream ss;
+      Command::fmtMultiBulkLen(ss, 2);
+      Command::fmtBulk(ss, args[i]);
+      Command::fmtBulk(ss, v.value());
+      return ss.str();
     }
+    return {ErrorCodes::ERR_NOTFOUND, ""};
+  }
 
-    if (key1 == key2) {
-      // NOTE(vinchen): if key1 == key2, it should getkv of rv2 using
-      // etxn, because key1 has be pop() by etxn. Otherwise if rv2 =
-      // Command::expireKeyIfNeeded(), it would get the old value.
-      auto rv2 = kvstore1->getKV(metaRk1, etxn.value());
-      // Only means that former pop has removed this meta key.
-      // if (!rv2.ok()) {
-      // INVARIANT(0);
-      // return Command::fmtNull();
-      // }
-
-      for (uint32_t i = 0; i < RETRY_CNT; ++i) {
-        auto s = genericPush(sess,
-                             kvstore1,
-                             etxn.value(),
-                             metaRk1,
-                             rv2,
-                             {val},
-                             ListPos::LP_HEAD,
-                             false /*need_exist*/);
-        if (s.ok()) {
-          pCtx->commitAll("rpoplpush");
-          rollback = false;
-          return Command::fmtBulk(val);
-        }
-        if (s.status().code() != ErrorCodes::ERR_COMMIT_RETRY) {
-          return s.status();
-        }
-        if (i == RETRY_CNT - 1) {
-          return s.status();
-        } else {
-          continue;
-        }
-      }
-    } else {
-      auto expdb2 = server->getSegmentMgr()->getDbHasLocked(sess, key2);
-      if (!expdb2.ok()) {
-        return expdb2.status();
-      }
-      RecordKey metaRk2(expdb2.value().chunkId,
-                        pCtx->getDbId(),
-                        RecordType::RT_LIST_META,
-                        key2,
-                        "");
-      PStore kvstore2 = expdb2.value().store;
-
-      auto etxn2 = pCtx->createTransaction(kvstore2);
-      if (!etxn2.ok()) {
-        return etxn2.status();
-      }
+ private:
+  ListPos _pos;
+};
 
-      Expected<RecordValue> rv2 =
-        Command::expireKeyIfNeeded(sess, key2, RecordType::RT_LIST_META);
-      if (rv2.status().code() != ErrorCodes::ERR_OK &&
-          rv2.status().code() != ErrorCodes::ERR_EXPIRED &&
-          rv2.status().code() != ErrorCodes::ERR_NOTFOUND) {
-        return rv2.status();
-      }
+class BLPopCommand : public BListPopWrapper {
+ public:
+  BLPopCommand() : BListPopWrapper(ListPos::LP_HEAD, "ws") {}
+} blpopCommand;
 
-      for (uint32_t i = 0; i < RETRY_CNT; ++i) {
-        auto s = genericPush(sess,
-                             kvstore2,
-                             etxn2.value(),
-                             metaRk2,
-                             rv2,
-                             {val},
-                             ListPos::LP_HEAD,
-                             false /*need_exist*/);
-        if (s.ok()) {
-          pCtx->commitAll("rpoplpush");
-          rollback = false;
-          return Command::fmtBulk(val);
-        }
-        if (s.status().code() != ErrorCodes::ERR_COMMIT_RETRY) {
-          return s.status();
-        }
-        if (i == RETRY_CNT - 1) {
-          return s.status();
-        } else {
-          continue;
-        }
-      }
+class BRPopCommand : public BListPopWrapper {
+ public:
+  BRPopCommand() : BListPopWrapper(ListPos::LP_TAIL, "ws") {}
+} brpopCommand;
+
+class BRPopLPushCommand : public ListBlockingWrapper {
+ public:
+  BRPopLPushCommand() : ListBlockingWrapper("brpoplpush", "wms") {}
+
+  ssize_t arity() const {
+    return 4;
+  }
+
+  int32_t firstkey() const {
+    return 1;
+  }
+
+  int32_t lastkey() const {
+    return 2;
+  }
+
+  int32_t keystep() const {
+    return 1;
+  }
+
+ protected:
+  std::vector<std::string> blockingKeys(
+    const std::vector<std::string>& args) final {
+    return {args[1]};
+  }
+
+  Expected<std::string> tryPop(Session* sess) final {
+    auto v = rpopLPush(sess, getKeysFromCommand(sess->getArgs()));
+    if (!v.ok()) {
+      return v.status();
     }
-    INVARIANT_D(0);
-    return {ErrorCodes::ERR_INTERNAL, "not reachable"};
+    return Command::fmtBulk(v.value());
   }
-} rpoplpushCmd;
+} brpoplpushCmd;
 
 class LtrimCommand : public Command {
  public:
@@ -778,6 +995,10 @@ class LRangeCommand : public Command {
   }
 
   Expected<std::string> run(Session* sess) final {
+    return runReplyToString(sess);
+  }
+
+  Status runReply(Session* sess, ReplyBuffer* reply) final {
     const std::vector<std::string>& args = sess->getArgs();
     const std::string& key = args[1];
     Expected<int64_t> estart = ::tendisplus::stoll(args[2]);
@@ -799,9 +1020,11 @@ class LRangeCommand : public Command {
     Expected<RecordValue> rv =
       Command::expireKeyIfNeeded(sess, key, RecordType::RT_LIST_META);
     if (rv.status().code() == ErrorCodes::ERR_EXPIRED) {
-      return fmtZeroBulkLen();
+      reply->append(fmtZeroBulkLen());
+      return {ErrorCodes::ERR_OK, ""};
     } else if (rv.status().code() == ErrorCodes::ERR_NOTFOUND) {
-      return fmtZeroBulkLen();
+      reply->append(fmtZeroBulkLen());
+      return {ErrorCodes::ERR_OK, ""};
     } else if (!rv.ok()) {
       return rv.status();
     }
@@ -843,15 +1066,15 @@ class LRangeCommand : public Command {
       start = 0;
     }
     if (start > end || start >= len) {
-      return Command::fmtZeroBulkLen();
+      reply->append(Command::fmtZeroBulkLen());
+      return {ErrorCodes::ERR_OK, ""};
     }
     if (end >= len) {
       end = len - 1;
     }
     int64_t rangelen = (end - start) + 1;
     start += head;
-    std::stringstream ss;
-    Command::fmtMultiBulkLen(ss, rangelen);
+    Command::fmtMultiBulkLen(*reply, rangelen);
     while (rangelen--) {
       RecordKey subRk(expdb.value().chunkId,
                       pCtx->getDbId(),
@@ -860,13 +1083,13 @@ class LRangeCommand : public Command {
                       std::to_string(start));
       Expected<RecordValue> eSubVal = kvstore->getKV(subRk, txn.get());
       if (eSubVal.ok()) {
-        Command::fmtBulk(ss, eSubVal.value().getValue());
+        Command::fmtBulk(*reply, eSubVal.value().getValue());
       } else {
         return eSubVal.status();
       }
       start++;
     }
-    return ss.str();
+    return {ErrorCodes::ERR_OK, ""};
   }
 } lrangeCmd;
 
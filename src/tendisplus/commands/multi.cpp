@@ -0,0 +1,322 @@
+// Copyright (C) 2020 THL A29 Limited, a Tencent company.  All rights reserved.
+// Please refer to the license text that comes with this tendis open source
+// project for additional information.
+
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tendisplus/commands/command.h"
+#include "tendisplus/network/network.h"
+#include "tendisplus/server/watch_manager.h"
+#include "tendisplus/utils/scopeguard.h"
+#include "tendisplus/utils/string.h"
+
+namespace tendisplus {
+
+namespace {
+// the stamp of the key's meta, empty if the key doesn't exist.
+// The version of a meta changes when the key is recreated.
+Expected<std::string> watchStamp(Session* sess, const std::string& key) {
+  auto rv = Command::expireKeyIfNeeded(
+    sess, key, RecordType::RT_DATA_META, true, false);
+  if (rv.status().code() == ErrorCodes::ERR_EXPIRED ||
+      rv.status().code() == ErrorCodes::ERR_NOTFOUND) {
+    return std::string();
+  } else if (!rv.ok()) {
+    return rv.status();
+  }
+  std::stringstream ss;
+  ss << rt2Char(rv.value().getRecordType()) << ":"
+     << rv.value().getVersion() << ":" << rv.value().getTtl();
+  return ss.str();
+}
+}  // namespace
+
+class MultiCommand : public Command {
+ public:
+  MultiCommand() : Command("multi", "sF") {}
+
+  ssize_t arity() const {
+    return 1;
+  }
+
+  int32_t firstkey() const {
+    return 0;
+  }
+
+  int32_t lastkey() const {
+    return 0;
+  }
+
+  int32_t keystep() const {
+    return 0;
+  }
+
+  Expected<std::string> run(Session* sess) final {
+    auto pCtx = sess->getCtx();
+    if (pCtx->isInMulti()) {
+      return {ErrorCodes::ERR_PARSEPKT, "MULTI calls can not be nested"};
+    }
+    pCtx->setMulti();
+    // NOTE: with the extended protocol, the commands between MULTI and
+    // EXEC are executed immediately, EXEC only checks the version.
+    if (!pCtx->isEp()) {
+      pCtx->setFlags(CLIENT_MULTI_QUEUED);
+    }
+    return Command::fmtOK();
+  }
+} multiCmd;
+
+// EXEC locks the keys of all the queued commands and the watched keys, then
+// runs the commands with one transaction per kvstore, which are committed
+// together at last. So the commands write one binlog per kvstore, and
+// sync the WAL once. The writes of a failed command are rolled back to the
+// savepoint set before it.
+class ExecCommand : public Command {
+ public:
+  ExecCommand() : Command("exec", "sM") {}
+
+  Expected<std::string> run(Session* sess) final {
+    return runReplyToString(sess);
+  }
+
+  ssize_t arity() const {
+    return 1;
+  }
+
+  int32_t firstkey() const {
+    return 0;
+  }
+
+  int32_t lastkey() const {
+    return 0;
+  }
+
+  int32_t keystep() const {
+    return 0;
+  }
+
+  Status runReply(Session* sess, ReplyBuffer* reply) final {
+    auto pCtx = sess->getCtx();
+    if (!pCtx->isInMulti()) {
+      return {ErrorCodes::ERR_PARSEPKT, "EXEC without MULTI"};
+    }
+    if (!(pCtx->getFlags() & CLIENT_MULTI_QUEUED)) {
+      // check version ?
+      if (!pCtx->verifyVersion(pCtx->getVersionEP())) {
+        return {ErrorCodes::ERR_WRONG_VERSION_EP, ""};
+      }
+      pCtx->resetMulti();
+      reply->append(Command::fmtOK());
+      return {ErrorCodes::ERR_OK, ""};
+    }
+
+    auto server = sess->getServerEntry();
+    auto watchMgr = server->getWatchMgr();
+    bool dirty = pCtx->getFlags() & CLIENT_DIRTY_EXEC;
+    auto cmds = pCtx->takeMultiCmds();
+    const auto guard = MakeGuard([sess, pCtx, watchMgr] {
+      pCtx->resetMulti();
+      watchMgr->unwatch(sess->id());
+    });
+    if (dirty) {
+      return {ErrorCodes::ERR_PARSEOPT,
+              "-EXECABORT Transaction discarded because of previous "
+              "errors.\r\n"};
+    }
+    auto ns = dynamic_cast<NetSession*>(sess);
+    if (ns == nullptr) {
+      return {ErrorCodes::ERR_INTERNAL, "EXEC is only for network clients"};
+    }
+
+    std::vector<std::string> keys;
+    std::vector<std::string> writeKeys;
+    for (const auto& args : cmds) {
+      auto it = commandMap().find(toLower(args[0]));
+      INVARIANT(it != commandMap().end());
+      for (auto i : it->second->getKeysFromCommand(args)) {
+        keys.push_back(args[i]);
+        if (it->second->isWriteable()) {
+          writeKeys.push_back(args[i]);
+        }
+      }
+    }
+    auto watched = watchMgr->getWatchedKeys(sess->id());
+    for (const auto& wk : watched) {
+      keys.push_back(wk.key);
+    }
+    std::vector<int> index;
+    for (size_t i = 0; i < keys.size(); ++i) {
+      index.push_back(i);
+    }
+    auto locklist = server->getSegmentMgr()->getAllKeysLocked(
+      sess, keys, index, mgl::LockMode::LOCK_X);
+    if (!locklist.ok()) {
+      return locklist.status();
+    }
+
+    if (watchMgr->isDirty(sess->id())) {
+      reply->append(Command::fmtNullArray());
+      return {ErrorCodes::ERR_OK, ""};
+    }
+    auto dbId = pCtx->getDbId();
+    for (const auto& wk : watched) {
+      pCtx->setDbId(wk.dbId);
+      auto stamp = watchStamp(sess, wk.key);
+      pCtx->setDbId(dbId);
+      if (!stamp.ok()) {
+        return stamp.status();
+      }
+      if (stamp.value() != wk.stamp) {
+        reply->append(Command::fmtNullArray());
+        return {ErrorCodes::ERR_OK, ""};
+      }
+    }
+    // the keys are locked by EXEC, the commands won't touch them again
+    for (const auto& key : writeKeys) {
+      watchMgr->touchKey(key, sess->id());
+    }
+
+    auto execArgs = sess->getArgs();
+    pCtx->setInExec(true);
+    const auto execGuard = MakeGuard([ns, pCtx, &execArgs] {
+      ns->setArgs(execArgs);
+      pCtx->setInExec(false);
+      pCtx->rollbackExec();
+    });
+    ReplyBuffer replies;
+    Command::fmtMultiBulkLen(replies, cmds.size());
+    for (auto& args : cmds) {
+      ns->setArgs(args);
+      pCtx->setExecSavePoint();
+      ReplyBuffer r;
+      auto s = Command::runSessionCmd(sess, &r);
+      if (s.ok()) {
+        replies.append(std::move(r));
+        continue;
+      }
+      // discard the partial writes of the failed command
+      auto rs = pCtx->rollbackExecToSavePoint();
+      if (!rs.ok()) {
+        return rs;
+      }
+      replies.append(Command::fmtErr(s.toString()));
+    }
+    // the binlogs are written as EXEC
+    ns->setArgs(execArgs);
+    pCtx->setInExec(false);
+    auto s = pCtx->commitExec();
+    if (!s.ok()) {
+      return s;
+    }
+    reply->append(std::move(replies));
+    return {ErrorCodes::ERR_OK, ""};
+  }
+} execCmd;
+
+class DiscardCommand : public Command {
+ public:
+  DiscardCommand() : Command("discard", "sF") {}
+
+  ssize_t arity() const {
+    return 1;
+  }
+
+  int32_t firstkey() const {
+    return 0;
+  }
+
+  int32_t lastkey() const {
+    return 0;
+  }
+
+  int32_t keystep() const {
+    return 0;
+  }
+
+  Expected<std::string> run(Session* sess) final {
+    auto pCtx = sess->getCtx();
+    if (!pCtx->isInMulti()) {
+      return {ErrorCodes::ERR_PARSEPKT, "DISCARD without MULTI"};
+    }
+    pCtx->resetMulti();
+    sess->getServerEntry()->getWatchMgr()->unwatch(sess->id());
+    return Command::fmtOK();
+  }
+} discardCmd;
+
+class WatchCommand : public Command {
+ public:
+  WatchCommand() : Command("watch", "sF") {}
+
+  ssize_t arity() const {
+    return -2;
+  }
+
+  int32_t firstkey() const {
+    return 1;
+  }
+
+  int32_t lastkey() const {
+    return -1;
+  }
+
+  int32_t keystep() const {
+    return 1;
+  }
+
+  Expected<std::string> run(Session* sess) final {
+    auto pCtx = sess->getCtx();
+    if (pCtx->isInMulti()) {
+      return {ErrorCodes::ERR_PARSEPKT, "WATCH inside MULTI is not allowed"};
+    }
+    auto server = sess->getServerEntry();
+    const auto& args = sess->getArgs();
+    for (size_t i = 1; i < args.size(); ++i) {
+      // the key is watched with its lock held, so that no write could
+      // come between reading its stamp and watching it.
+      auto expdb = server->getSegmentMgr()->getDbWithKeyLock(
+        sess, args[i], Command::RdLock());
+      if (!expdb.ok()) {
+        return expdb.status();
+      }
+      auto stamp = watchStamp(sess, args[i]);
+      if (!stamp.ok()) {
+        return stamp.status();
+      }
+      server->getWatchMgr()->watch(
+        sess->id(), {pCtx->getDbId(), args[i], stamp.value()});
+    }
+    return Command::fmtOK();
+  }
+} watchCmd;
+
+class UnwatchCommand : public Command {
+ public:
+  UnwatchCommand() : Command("unwatch", "sF") {}
+
+  ssize_t arity() const {
+    return 1;
+  }
+
+  int32_t firstkey() const {
+    return 0;
+  }
+
+  int32_t lastkey() const {
+    return 0;
+  }
+
+  int32_t keystep() const {
+    return 0;
+  }
+
+  Expected<std::string> run(Session* sess) final {
+    sess->getServerEntry()->getWatchMgr()->unwatch(sess->id());
+    return Command::fmtOK();
+  }
+} unwatchCmd;
+
+}  // namespace tendisplus
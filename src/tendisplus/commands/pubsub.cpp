@@ -0,0 +1,239 @@
+// Copyright (C) 2020 THL A29 Limited, a Tencent company.  All rights reserved.
+// Please refer to the license text that comes with this tendis open source
+// project for additional information.
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tendisplus/commands/command.h"
+#include "tendisplus/server/pubsub_manager.h"
+#include "tendisplus/server/server_entry.h"
+#include "tendisplus/utils/string.h"
+
+namespace tendisplus {
+
+namespace {
+void fmtSubReply(std::stringstream& ss,
+                 const std::string& kind,
+                 const std::string& name,
+                 size_t count) {
+  Command::fmtMultiBulkLen(ss, 3);
+  Command::fmtBulk(ss, kind);
+  Command::fmtBulk(ss, name);
+  Command::fmtLongLong(ss, count);
+}
+
+void updatePubSubFlag(Session* sess, size_t count) {
+  if (count) {
+    sess->getCtx()->setFlags(CLIENT_PUBSUB);
+  } else {
+    sess->getCtx()->resetFlags(CLIENT_PUBSUB);
+  }
+}
+}  // namespace
+
+class SubscribeWrapper : public Command {
+ public:
+  SubscribeWrapper(const std::string& name, bool pattern)
+    : Command(name, "pslt"), _pattern(pattern) {}
+
+  ssize_t arity() const {
+    return -2;
+  }
+
+  int32_t firstkey() const {
+    return 0;
+  }
+
+  int32_t lastkey() const {
+    return 0;
+  }
+
+  int32_t keystep() const {
+    return 0;
+  }
+
+  Expected<std::string> run(Session* sess) final {
+    // the session is kept by weak_ptr, publish writes to its socket directly
+    auto self = sess->weak_from_this().lock();
+    if (sess->getType() != Session::Type::NET || !self) {
+      return {ErrorCodes::ERR_INTERNAL, "only network clients can subscribe"};
+    }
+    auto mgr = sess->getServerEntry()->getPubSubMgr();
+    const auto& args = sess->getArgs();
+    std::stringstream ss;
+    size_t count = 0;
+    for (size_t i = 1; i < args.size(); ++i) {
+      count = _pattern ? mgr->psubscribe(self, args[i])
+                       : mgr->subscribe(self, args[i]);
+      fmtSubReply(ss, _pattern ? "psubscribe" : "subscribe", args[i], count);
+    }
+    updatePubSubFlag(sess, count);
+    return ss.str();
+  }
+
+ private:
+  bool _pattern;
+};
+
+class SubscribeCommand : public SubscribeWrapper {
+ public:
+  SubscribeCommand() : SubscribeWrapper("subscribe", false) {}
+} subscribeCmd;
+
+class PSubscribeCommand : public SubscribeWrapper {
+ public:
+  PSubscribeCommand() : SubscribeWrapper("psubscribe", true) {}
+} psubscribeCmd;
+
+class UnsubscribeWrapper : public Command {
+ public:
+  UnsubscribeWrapper(const std::string& name, bool pattern)
+    : Command(name, "pslt"), _pattern(pattern) {}
+
+  ssize_t arity() const {
+    return -1;
+  }
+
+  int32_t firstkey() const {
+    return 0;
+  }
+
+  int32_t lastkey() const {
+    return 0;
+  }
+
+  int32_t keystep() const {
+    return 0;
+  }
+
+  Expected<std::string> run(Session* sess) final {
+    auto mgr = sess->getServerEntry()->getPubSubMgr();
+    const auto& args = sess->getArgs();
+    std::vector<std::string> names(args.begin() + 1, args.end());
+    // without arguments, unsubscribe from all
+    if (names.empty()) {
+      names = _pattern ? mgr->getPatterns(sess->id())
+                       : mgr->getChannels(sess->id());
+    }
+    std::string kind = _pattern ? "punsubscribe" : "unsubscribe";
+    std::stringstream ss;
+    if (names.empty()) {
+      Command::fmtMultiBulkLen(ss, 3);
+      Command::fmtBulk(ss, kind);
+      Command::fmtNull(ss);
+      Command::fmtLongLong(ss, countOf(sess));
+      return ss.str();
+    }
+    size_t count = 0;
+    for (const auto& name : names) {
+      count = _pattern ? mgr->punsubscribe(sess->id(), name)
+                       : mgr->unsubscribe(sess->id(), name);
+      fmtSubReply(ss, kind, name, count);
+    }
+    updatePubSubFlag(sess, count);
+    return ss.str();
+  }
+
+ private:
+  size_t countOf(Session* sess) const {
+    auto mgr = sess->getServerEntry()->getPubSubMgr();
+    return mgr->getChannels(sess->id()).size() +
+      mgr->getPatterns(sess->id()).size();
+  }
+
+  bool _pattern;
+};
+
+class UnsubscribeCommand : public UnsubscribeWrapper {
+ public:
+  UnsubscribeCommand() : UnsubscribeWrapper("unsubscribe", false) {}
+} unsubscribeCmd;
+
+class PUnsubscribeCommand : public UnsubscribeWrapper {
+ public:
+  PUnsubscribeCommand() : UnsubscribeWrapper("punsubscribe", true) {}
+} punsubscribeCmd;
+
+class PublishCommand : public Command {
+ public:
+  PublishCommand() : Command("publish", "pltF") {}
+
+  ssize_t arity() const {
+    return 3;
+  }
+
+  int32_t firstkey() const {
+    return 0;
+  }
+
+  int32_t lastkey() const {
+    return 0;
+  }
+
+  int32_t keystep() const {
+    return 0;
+  }
+
+  Expected<std::string> run(Session* sess) final {
+    // NOTE: the message is delivered to the subscribers of this node only,
+    // it is not propagated through the cluster bus.
+    auto svr = sess->getServerEntry();
+    const auto& args = sess->getArgs();
+    size_t receivers = svr->getPubSubMgr()->publish(
+      args[1], args[2], svr->getParams()->pubsubOutputLimit);
+    return Command::fmtLongLong(receivers);
+  }
+} publishCmd;
+
+class PubSubCommand : public Command {
+ public:
+  PubSubCommand() : Command("pubsub", "pltR") {}
+
+  ssize_t arity() const {
+    return -2;
+  }
+
+  int32_t firstkey() const {
+    return 0;
+  }
+
+  int32_t lastkey() const {
+    return 0;
+  }
+
+  int32_t keystep() const {
+    return 0;
+  }
+
+  Expected<std::string> run(Session* sess) final {
+    auto mgr = sess->getServerEntry()->getPubSubMgr();
+    const auto& args = sess->getArgs();
+    auto subCmd = toLower(args[1]);
+    std::stringstream ss;
+    if (subCmd == "channels" && args.size() <= 3) {
+      auto channels =
+        mgr->getActiveChannels(args.size() == 3 ? args[2] : "");
+      Command::fmtMultiBulkLen(ss, channels.size());
+      for (const auto& channel : channels) {
+        Command::fmtBulk(ss, channel);
+      }
+      return ss.str();
+    } else if (subCmd == "numsub") {
+      Command::fmtMultiBulkLen(ss, (args.size() - 2) * 2);
+      for (size_t i = 2; i < args.size(); ++i) {
+        Command::fmtBulk(ss, args[i]);
+        Command::fmtLongLong(ss, mgr->getSubscriberCount(args[i]));
+      }
+      return ss.str();
+    } else if (subCmd == "numpat" && args.size() == 2) {
+      return Command::fmtLongLong(mgr->getPatternCount());
+    }
+    return {ErrorCodes::ERR_PARSEOPT,
+            "Unknown PUBSUB subcommand or wrong number of arguments for '" +
+              args[1] + "'"};
+  }
+} pubsubCmd;
+
+}  // namespace tendisplus
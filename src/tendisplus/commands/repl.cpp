@@ -307,13 +307,16 @@ class RestoreBackupCommand : public Command {
   }
 } restoreBackupCommand;
 
-// fullSync storeId dstStoreId ip port
+// fullSync storeId ip port [streams [resumePos]]
+// fullSync storeId ip port attach clientId
+// with streams, the files are streamed over the connection and the ones
+// attached with clientId later.
 class FullSyncCommand : public Command {
  public:
   FullSyncCommand() : Command("fullsync", "a") {}
 
   ssize_t arity() const {
-    return 4;
+    return -4;
   }
 
   int32_t firstkey() const {
@@ -463,6 +466,9 @@ class ApplyBinlogsGeneric : public Command {
     INVARIANT(replMgr != nullptr);
 
     size_t cnt = 0;
+    // the binlogs from master are applied as a batch, see
+    // ReplManager::applyRepllogsV2()
+    std::vector<ReplLogRawV2> logs;
     BinlogReader reader(binlogs);
     while (true) {
       auto eLog = reader.next();
@@ -474,10 +480,7 @@ class ApplyBinlogsGeneric : public Command {
       }
       Status s;
       if (mode == BinlogApplyMode::KEEP_BINLOG_ID) {
-        s = replMgr->applyRepllogV2(sess,
-                                    storeId,
-                                    eLog.value().getReplLogKey(),
-                                    eLog.value().getReplLogValue());
+        logs.emplace_back(std::move(eLog.value()));
       } else {
         if (!svr->isClusterEnabled()) {
           LOG(ERROR) << "not ClusterEnabled.";
@@ -502,6 +505,15 @@ class ApplyBinlogsGeneric : public Command {
       return {ErrorCodes::ERR_PARSEOPT, "invalid binlog size of binlog count"};
     }
 
+    if (!logs.empty()) {
+      auto s = replMgr->applyRepllogsV2(sess, storeId, logs);
+      if (!s.ok()) {
+        LOG(ERROR) << "applyRepllogsV2 failed, storeId:" << storeId
+                   << " err:" << s.toString();
+        return s;
+      }
+    }
+
     return {ErrorCodes::ERR_OK, ""};
   }
 
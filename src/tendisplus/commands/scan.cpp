@@ -6,9 +6,12 @@
 #include <utility>
 #include <memory>
 #include <algorithm>
+#include <bitset>
 #include <cctype>
 #include <clocale>
 #include <vector>
+#include <map>
+#include <list>
 #include "glog/logging.h"
 #include "tendisplus/utils/sync_point.h"
 #include "tendisplus/utils/string.h"
@@ -17,6 +20,7 @@
 #include "tendisplus/commands/command.h"
 #include "tendisplus/storage/varint.h"
 #include "tendisplus/storage/skiplist.h"
+#include "tendisplus/cluster/cluster_manager.h"
 
 namespace tendisplus {
 class ScanGenericCommand : public Command {
@@ -28,7 +32,8 @@ class ScanGenericCommand : public Command {
 
   virtual RecordKey genFakeRcd(uint32_t chunkId,
                                uint32_t dbId,
-                               const std::string& key) const = 0;
+                               const std::string& key,
+                               uint64_t version) const = 0;
 
   virtual Expected<std::string> genResult(const std::string& cursor,
                                           const std::list<Record>& rcds) = 0;
@@ -111,17 +116,17 @@ class ScanGenericCommand : public Command {
 
     std::string name = getName();
     if (name == "zscanbyscore") {
-      auto eMetaContent = ZSlMetaValue::decode(rv.value().getValue());
-      if (!eMetaContent.ok()) {
-        return eMetaContent.status();
+      auto esl = openZSet(
+        expdb.value().chunkId, pCtx->getDbId(), key, rv.value(), kvstore);
+      if (!esl.ok()) {
+        return esl.status();
       }
-      ZSlMetaValue meta = eMetaContent.value();
-      SkipList sl(expdb.value().chunkId, pCtx->getDbId(), key, meta, kvstore);
+      PZSetEngine& sl = esl.value();
       Zrangespec range;
       if (zslParseRange(cursor.c_str(), maxscore.c_str(), &range) != 0) {
         return {ErrorCodes::ERR_ZSLPARSERANGE, ""};
       }
-      auto arr = sl.scanByScore(range, 0, count + 1, false, txn.get());
+      auto arr = sl->scanByScore(range, 0, count + 1, false, txn.get());
       if (!arr.ok()) {
         return arr.status();
       }
@@ -141,9 +146,19 @@ class ScanGenericCommand : public Command {
       return ss.str();
     }
 
-    RecordKey fake = genFakeRcd(expdb.value().chunkId, pCtx->getDbId(), key);
+    RecordKey fake = genFakeRcd(
+      expdb.value().chunkId, pCtx->getDbId(), key, rv.value().getVersion());
 
-    auto batch = Command::scan(fake.prefixPk(), cursor, count, txn.get());
+    // an inline hash/set/zset is returned in one batch, ignoring the count
+    auto inlineEles = rcd_util::getInlineEles(metaRk, rv.value());
+    if (!inlineEles.ok() &&
+        inlineEles.status().code() != ErrorCodes::ERR_NOTFOUND) {
+      return inlineEles.status();
+    }
+    Expected<std::pair<std::string, std::list<Record>>> batch =
+      inlineEles.ok()
+      ? std::make_pair(std::string("0"), std::move(inlineEles.value()))
+      : Command::scan(fake.prefixPk(), cursor, count, txn.get());
     if (!batch.ok()) {
       return batch.status();
     }
@@ -179,8 +194,9 @@ class ZScanCommand : public ScanGenericCommand {
 
   RecordKey genFakeRcd(uint32_t chunkId,
                        uint32_t dbId,
-                       const std::string& key) const final {
-    return {chunkId, dbId, RecordType::RT_ZSET_H_ELE, key, ""};
+                       const std::string& key,
+                       uint64_t version) const final {
+    return {chunkId, dbId, RecordType::RT_ZSET_H_ELE, key, "", version};
   }
 
   Expected<std::string> genResult(const std::string& cursor,
@@ -212,12 +228,14 @@ class ZScanbyscoreCommand : public ScanGenericCommand {
 
   RecordKey genFakeRcd(uint32_t chunkId,
                        uint32_t dbId,
-                       const std::string& key) const final {
+                       const std::string& key,
+                       uint64_t version) const final {
     return {chunkId,
             dbId,
             RecordType::RT_ZSET_S_ELE,
             key,
-            std::to_string(ZSlMetaValue::HEAD_ID)};
+            std::to_string(ZSlMetaValue::HEAD_ID),
+            version};
   }
 
   Expected<std::string> genResult(const std::string& cursor,
@@ -265,8 +283,9 @@ class SScanCommand : public ScanGenericCommand {
 
   RecordKey genFakeRcd(uint32_t chunkId,
                        uint32_t dbId,
-                       const std::string& key) const final {
-    return {chunkId, dbId, RecordType::RT_SET_ELE, key, ""};
+                       const std::string& key,
+                       uint64_t version) const final {
+    return {chunkId, dbId, RecordType::RT_SET_ELE, key, "", version};
   }
 
   Expected<std::string> genResult(const std::string& cursor,
@@ -292,8 +311,9 @@ class HScanCommand : public ScanGenericCommand {
 
   RecordKey genFakeRcd(uint32_t chunkId,
                        uint32_t dbId,
-                       const std::string& key) const final {
-    return {chunkId, dbId, RecordType::RT_HASH_ELE, key, ""};
+                       const std::string& key,
+                       uint64_t version) const final {
+    return {chunkId, dbId, RecordType::RT_HASH_ELE, key, "", version};
   }
 
   Expected<std::string> genResult(const std::string& cursor,
@@ -334,9 +354,192 @@ class ScanCommand : public Command {
     return false;
   }
 
-  // NOTE(deyukong): tendis did not impl this api
+  // cursor: hex of storeId(4B, big-endian) + the key to seek next time.
+  // "0" means to begin (or the end of) the iteration.
   Expected<std::string> run(Session* sess) final {
-    return Command::fmtZeroBulkLen();
+    const std::vector<std::string>& args = sess->getArgs();
+    auto server = sess->getServerEntry();
+    uint64_t count = 10;
+    std::string pat;
+    bool usePattern = false;
+    RecordType type = RecordType::RT_INVALID;
+    for (size_t i = 2; i < args.size(); i += 2) {
+      if (i + 1 >= args.size()) {
+        return {ErrorCodes::ERR_PARSEOPT, "syntax error"};
+      }
+      auto opt = toLower(args[i]);
+      if (opt == "count") {
+        Expected<uint64_t> ecnt = ::tendisplus::stoul(args[i + 1]);
+        if (!ecnt.ok()) {
+          return ecnt.status();
+        }
+        if (ecnt.value() < 1) {
+          return {ErrorCodes::ERR_PARSEOPT, "syntax error"};
+        }
+        count = ecnt.value();
+      } else if (opt == "match") {
+        pat = args[i + 1];
+        usePattern = !(pat.size() == 1 && pat[0] == '*');
+      } else if (opt == "type") {
+        const std::map<std::string, RecordType> lookup = {
+          {"string", RecordType::RT_KV},
+          {"list", RecordType::RT_LIST_META},
+          {"hash", RecordType::RT_HASH_META},
+          {"set", RecordType::RT_SET_META},
+          {"zset", RecordType::RT_ZSET_META},
+        };
+        auto it = lookup.find(toLower(args[i + 1]));
+        // unknown type matches nothing, the same as redis
+        type = it == lookup.end() ? RecordType::RT_META : it->second;
+      } else {
+        return {ErrorCodes::ERR_PARSEOPT, "syntax error"};
+      }
+    }
+
+    uint32_t storeId = 0;
+    std::string seekKey;
+    if (args[1] != "0") {
+      auto unhex = unhexlify(args[1]);
+      if (!unhex.ok() || unhex.value().size() < sizeof(storeId)) {
+        return {ErrorCodes::ERR_PARSEOPT, "invalid cursor"};
+      }
+      storeId = int32Decode(unhex.value().c_str());
+      seekKey = unhex.value().substr(sizeof(storeId));
+    }
+
+    // in cluster mode, only scan the slots served by this node. They are
+    // taken once per call, rather than looked up with the cluster lock
+    // for every record.
+    bool clusterEnabled = server->isClusterEnabled();
+    std::bitset<CLUSTER_SLOTS> mySlots;
+    if (clusterEnabled) {
+      auto clusterState = server->getClusterMgr()->getClusterState();
+      auto myself = clusterState->getMyselfNode();
+      auto owner = myself->nodeIsSlave() ? myself->getMaster() : myself;
+      if (!owner) {
+        return {ErrorCodes::ERR_CLUSTER, "no master for this node"};
+      }
+      mySlots = owner->getSlots();
+    }
+
+    const uint32_t dbId = sess->getCtx()->getDbId();
+    const size_t chunkSize = server->getSegmentMgr()->getChunkSize();
+    auto ts = msSinceEpoch();
+    std::list<std::string> result;
+    // both seeks and examined records are counted, so one call costs
+    // O(count) even if most of the chunks are empty.
+    uint64_t work = 0;
+    for (; storeId < server->getKVStoreCount(); ++storeId, seekKey.clear()) {
+      if (work >= count) {
+        break;
+      }
+      auto expdb =
+        server->getSegmentMgr()->getDb(sess, storeId, mgl::LockMode::LOCK_IS);
+      if (!expdb.ok()) {
+        if (expdb.status().code() == ErrorCodes::ERR_STORE_NOT_OPEN) {
+          continue;
+        }
+        return expdb.status();
+      }
+      auto ptxn = expdb.value().store->createTransaction(sess);
+      if (!ptxn.ok()) {
+        return ptxn.status();
+      }
+      std::unique_ptr<Transaction> txn = std::move(ptxn.value());
+      auto cursor = txn->createDataCursor();
+
+      // NOTE: within a chunk, the RT_DATA_META records sort before all
+      // the *_ELE records (see rt2Char), so when we meet a record which
+      // is not the meta of this db, jump to the metas of the next chunk
+      // with one seek instead of walking through the elements.
+      bool needSeek = true;
+      bool storeDone = false;
+      while (work < count) {
+        if (needSeek) {
+          cursor->seek(seekKey);
+          needSeek = false;
+          work++;
+        }
+        Expected<Record> exptRcd = cursor->next();
+        if (exptRcd.status().code() == ErrorCodes::ERR_EXHAUST) {
+          storeDone = true;
+          break;
+        }
+        if (!exptRcd.ok()) {
+          return exptRcd.status();
+        }
+        const RecordKey& rk = exptRcd.value().getRecordKey();
+        uint32_t chunkId = rk.getChunkId();
+        // NOTE(vinchen):
+        // RecordType::RT_TTL_INDEX and RecordType::BINLOG
+        // is always at the last of rocksdb, and the chunkid is very big
+        if (chunkId >= chunkSize) {
+          storeDone = true;
+          break;
+        }
+        bool mine = !clusterEnabled || mySlots.test(chunkId);
+        if (mine && rk.getRecordType() == RecordType::RT_DATA_META &&
+            rk.getDbId() < dbId) {
+          seekKey =
+            RecordKey(chunkId, dbId, RecordType::RT_DATA_META, "", "")
+              .prefixPk();
+          needSeek = true;
+          continue;
+        }
+        if (!mine || rk.getRecordType() != RecordType::RT_DATA_META ||
+            rk.getDbId() != dbId) {
+          if (chunkId + 1 >= chunkSize) {
+            storeDone = true;
+            break;
+          }
+          seekKey =
+            RecordKey(chunkId + 1, dbId, RecordType::RT_DATA_META, "", "")
+              .prefixPk();
+          needSeek = true;
+          continue;
+        }
+
+        work++;
+        // the smallest key after this one
+        seekKey = rk.encode();
+        seekKey.push_back('\0');
+
+        const RecordValue& rv = exptRcd.value().getRecordValue();
+        auto ttl = rv.getTtl();
+        if (!Command::noExpire() && ttl != 0 && ttl < ts) {
+          continue;
+        }
+        if (type != RecordType::RT_INVALID && rv.getRecordType() != type) {
+          continue;
+        }
+        const std::string& key = rk.getPrimaryKey();
+        if (usePattern &&
+            !redis_port::stringmatchlen(
+              pat.c_str(), pat.size(), key.c_str(), key.size(), 0)) {
+          continue;
+        }
+        result.emplace_back(key);
+      }
+      if (!storeDone) {
+        break;
+      }
+    }
+
+    std::string nextCursor = "0";
+    if (storeId < server->getKVStoreCount()) {
+      std::string raw(sizeof(storeId), '\0');
+      int32Encode(&raw[0], storeId);
+      nextCursor = hexlify(raw + seekKey);
+    }
+
+    std::stringstream ss;
+    Command::fmtMultiBulkLen(ss, 2);
+    Command::fmtBulk(ss, nextCursor);
+    Command::fmtMultiBulkLen(ss, result.size());
+    for (const auto& v : result) {
+      Command::fmtBulk(ss, v);
+    }
+    return ss.str();
   }
 } scanCmd;
 
@@ -8,6 +8,8 @@
 #include <algorithm>
 #include <cctype>
 #include <clocale>
+#include <list>
+#include <map>
 #include <vector>
 #include "tendisplus/utils/sync_point.h"
 #include "tendisplus/utils/string.h"
@@ -20,6 +22,44 @@ namespace tendisplus {
 
 Expected<bool> delGeneric(Session* sess, const std::string& key);
 
+// the members of an inline set are kept in its meta instead of the
+// RT_SET_ELE records, see SetMetaValue
+Expected<RecordValue> getSetMember(PStore kvstore,
+                                   Transaction* txn,
+                                   const SetMetaValue& meta,
+                                   const RecordKey& subRk) {
+  if (!meta.isInline()) {
+    return kvstore->getKV(subRk, txn);
+  }
+  if (!meta.hasMember(subRk.getSecondaryKey())) {
+    return {ErrorCodes::ERR_NOTFOUND, ""};
+  }
+  return RecordValue("", RecordType::RT_SET_ELE, -1);
+}
+
+Status addSetMember(PStore kvstore,
+                    Transaction* txn,
+                    SetMetaValue* meta,
+                    const RecordKey& subRk) {
+  if (!meta->isInline()) {
+    RecordValue subRv("", RecordType::RT_SET_ELE, -1);
+    return kvstore->setKV(subRk, subRv, txn);
+  }
+  meta->addMember(subRk.getSecondaryKey());
+  return {ErrorCodes::ERR_OK, ""};
+}
+
+Status delSetMember(PStore kvstore,
+                    Transaction* txn,
+                    SetMetaValue* meta,
+                    const RecordKey& subRk) {
+  if (!meta->isInline()) {
+    return kvstore->delKV(subRk, txn);
+  }
+  meta->delMember(subRk.getSecondaryKey());
+  return {ErrorCodes::ERR_OK, ""};
+}
+
 Expected<std::string> genericSRem(Session* sess,
                                   PStore kvstore,
                                   Transaction* txn,
@@ -50,8 +90,9 @@ Expected<std::string> genericSRem(Session* sess,
                     metaRk.getDbId(),
                     RecordType::RT_SET_ELE,
                     metaRk.getPrimaryKey(),
-                    args[i]);
-    Expected<RecordValue> rv = kvstore->getKV(subRk, txn);
+                    args[i],
+                    rv.value().getVersion());
+    Expected<RecordValue> rv = getSetMember(kvstore, txn, sm, subRk);
     if (rv.ok()) {
       cnt += 1;
     } else if (rv.status().code() == ErrorCodes::ERR_NOTFOUND) {
@@ -59,7 +100,7 @@ Expected<std::string> genericSRem(Session* sess,
     } else {
       return rv.status();
     }
-    Status s = kvstore->delKV(subRk, txn);
+    Status s = delSetMember(kvstore, txn, &sm, subRk);
     if (!s.ok()) {
       return s;
     }
@@ -115,17 +156,21 @@ Expected<std::string> genericSAdd(Session* sess,
   } else if (rv.status().code() != ErrorCodes::ERR_NOTFOUND &&
              rv.status().code() != ErrorCodes::ERR_EXPIRED) {
     return rv.status();
+  } else {
+    sm.setInline(Command::isInlineEnabled(sess, RecordType::RT_SET_META));
   }
 
+  uint64_t version = rcd_util::getSubKeyVersion(rv);
   uint64_t cnt = 0;
   for (size_t i = 2; i < args.size(); ++i) {
     RecordKey subRk(metaRk.getChunkId(),
                     metaRk.getDbId(),
                     RecordType::RT_SET_ELE,
                     metaRk.getPrimaryKey(),
-                    args[i]);
+                    args[i],
+                    version);
 
-      Expected<RecordValue> subrv = kvstore->getKV(subRk, txn);
+      Expected<RecordValue> subrv = getSetMember(kvstore, txn, sm, subRk);
       if (subrv.ok()) {
         continue;
       } else if (subrv.status().code() == ErrorCodes::ERR_NOTFOUND) {
@@ -134,20 +179,24 @@ Expected<std::string> genericSAdd(Session* sess,
         return subrv.status();
       }
 
-    RecordValue subRv("", RecordType::RT_SET_ELE, -1);
-    Status s = kvstore->setKV(subRk, subRv, txn);
+    Status s = addSetMember(kvstore, txn, &sm, subRk);
     if (!s.ok()) {
       return s;
     }
   }
   sm.setCount(sm.getCount() + cnt);
-  Status s = kvstore->setKV(metaRk,
-                            RecordValue(sm.encode(),
-                                        RecordType::RT_SET_META,
-                                        sess->getCtx()->getVersionEP(),
-                                        ttl,
-                                        rv),
-                            txn);
+  Status s =
+    Command::spillInlineSet(sess, kvstore, txn, metaRk, version, &sm);
+  if (!s.ok()) {
+    return s;
+  }
+  RecordValue metaValue(sm.encode(),
+                        RecordType::RT_SET_META,
+                        sess->getCtx()->getVersionEP(),
+                        ttl,
+                        rv);
+  metaValue.setVersion(version);
+  s = kvstore->setKV(metaRk, metaValue, txn);
   if (!s.ok()) {
     return s;
   }
@@ -218,9 +267,19 @@ class SMembersCommand : public Command {
 
     std::stringstream ss;
     Command::fmtMultiBulkLen(ss, ssize);
+    if (exptSm.value().isInline()) {
+      for (const auto& member : exptSm.value().getMembers()) {
+        Command::fmtBulk(ss, member);
+      }
+      return ss.str();
+    }
     auto cursor = txn->createDataCursor();
-    RecordKey fake = {
-      expdb.value().chunkId, pCtx->getDbId(), RecordType::RT_SET_ELE, key, ""};
+    RecordKey fake = {expdb.value().chunkId,
+                      pCtx->getDbId(),
+                      RecordType::RT_SET_ELE,
+                      key,
+                      "",
+                      rv.value().getVersion()};
     cursor->seek(fake.prefixPk());
     while (true) {
       Expected<Record> exptRcd = cursor->next();
@@ -307,8 +366,14 @@ class SIsMemberCommand : public Command {
                     pCtx->getDbId(),
                     RecordType::RT_SET_ELE,
                     key,
-                    subkey);
-    Expected<RecordValue> eSubVal = kvstore->getKV(subRk, txn.get());
+                    subkey,
+                    rv.value().getVersion());
+    Expected<SetMetaValue> exptSm = SetMetaValue::decode(rv.value().getValue());
+    if (!exptSm.ok()) {
+      return exptSm.status();
+    }
+    Expected<RecordValue> eSubVal =
+      getSetMember(kvstore, txn.get(), exptSm.value(), subRk);
     if (eSubVal.ok()) {
       return Command::fmtOne();
     } else if (eSubVal.status().code() == ErrorCodes::ERR_NOTFOUND) {
@@ -434,28 +499,45 @@ class SrandMemberCommand : public Command {
       // TODO(vinchen):  should be configable
       return {ErrorCodes::ERR_INTERNAL, "bulk too big"};
     }
-    RecordKey fake = {
-      expdb.value().chunkId, pCtx->getDbId(), RecordType::RT_SET_ELE, key, ""};
-    cursor->seek(fake.prefixPk());
-    while (true) {
-      Expected<Record> exptRcd = cursor->next();
-      if (exptRcd.status().code() == ErrorCodes::ERR_EXHAUST) {
-        break;
-      }
-      if (!exptRcd.ok()) {
-        return exptRcd.status();
-      }
-      if (cnt++ < beginIdx) {
-        continue;
-      }
-      if (cnt > ssize) {
-        break;
-      }
-      if (peek < remain) {
-        vals.emplace_back(exptRcd.value().getRecordKey().getSecondaryKey());
+    RecordKey fake = {expdb.value().chunkId,
+                      pCtx->getDbId(),
+                      RecordType::RT_SET_ELE,
+                      key,
+                      "",
+                      rv.value().getVersion()};
+    if (exptSm.value().isInline()) {
+      for (const auto& member : exptSm.value().getMembers()) {
+        if (cnt++ < beginIdx) {
+          continue;
+        }
+        if (peek >= remain) {
+          break;
+        }
+        vals.emplace_back(member);
         peek++;
-      } else {
-        break;
+      }
+    } else {
+      cursor->seek(fake.prefixPk());
+      while (true) {
+        Expected<Record> exptRcd = cursor->next();
+        if (exptRcd.status().code() == ErrorCodes::ERR_EXHAUST) {
+          break;
+        }
+        if (!exptRcd.ok()) {
+          return exptRcd.status();
+        }
+        if (cnt++ < beginIdx) {
+          continue;
+        }
+        if (cnt > ssize) {
+          break;
+        }
+        if (peek < remain) {
+          vals.emplace_back(exptRcd.value().getRecordKey().getSecondaryKey());
+          peek++;
+        } else {
+          break;
+        }
       }
     }
     // TODO(vinchen): vals should be shuffle here
@@ -551,13 +633,31 @@ class SpopCommand : public Command {
       return ptxn.status();
     }
     std::unique_ptr<Transaction> txn = std::move(ptxn.value());
-    RecordKey fake = {
-      expdb.value().chunkId, pCtx->getDbId(), RecordType::RT_SET_ELE, key, ""};
-    auto batch = Command::scan(fake.prefixPk(), "0", count, txn.get());
-    if (!batch.ok()) {
-      return batch.status();
+    RecordKey fake = {expdb.value().chunkId,
+                      pCtx->getDbId(),
+                      RecordType::RT_SET_ELE,
+                      key,
+                      "",
+                      rv.value().getVersion()};
+    std::list<Record> rcds;
+    if (sm.isInline()) {
+      auto eles = rcd_util::getInlineEles(metaRk, rv.value());
+      if (!eles.ok()) {
+        return eles.status();
+      }
+      for (auto& ele : eles.value()) {
+        if (rcds.size() >= count) {
+          break;
+        }
+        rcds.emplace_back(std::move(ele));
+      }
+    } else {
+      auto batch = Command::scan(fake.prefixPk(), "0", count, txn.get());
+      if (!batch.ok()) {
+        return batch.status();
+      }
+      rcds = std::move(batch.value().second);
     }
-    const auto& rcds = batch.value().second;
     if (rcds.size() == 0) {
       return Command::fmtNull();
     }
@@ -580,11 +680,13 @@ class SpopCommand : public Command {
       }
       std::unique_ptr<Transaction> txn = std::move(ptxn.value());
 
+      // NOTE: keep sm unchanged, this txn may be retried
+      SetMetaValue newSm = sm;
       // avoid string copy, directly delete elements according to rcds.
       Status s;
       for (auto iter = rcds.begin(); iter != rcds.end(); iter++) {
         const RecordKey& subRk = iter->getRecordKey();
-        s = kvstore->delKV(subRk, txn.get());
+        s = delSetMember(kvstore, txn.get(), &newSm, subRk);
         if (!s.ok()) {
           return s;
         }
@@ -597,9 +699,9 @@ class SpopCommand : public Command {
           return s;
         }
       } else {
-        sm.setCount(sm.getCount() - rcds.size());
+        newSm.setCount(newSm.getCount() - rcds.size());
         s = kvstore->setKV(metaRk,
-                           RecordValue(sm.encode(),
+                           RecordValue(newSm.encode(),
                                        RecordType::RT_SET_META,
                                        pCtx->getVersionEP(),
                                        rv.value().getTtl(),
@@ -864,6 +966,22 @@ class SdiffgenericCommand : public Command {
         return rv.status();
       }
 
+      Expected<SetMetaValue> exptSm =
+        SetMetaValue::decode(rv.value().getValue());
+      if (!exptSm.ok()) {
+        return exptSm.status();
+      }
+      if (exptSm.value().isInline()) {
+        for (const auto& member : exptSm.value().getMembers()) {
+          if (i == startkey) {
+            result.insert(member);
+          } else {
+            result.erase(member);
+          }
+        }
+        continue;
+      }
+
       auto expdb = server->getSegmentMgr()->getDbHasLocked(sess, args[i]);
       if (!expdb.ok()) {
         return expdb.status();
@@ -880,7 +998,8 @@ class SdiffgenericCommand : public Command {
                         pCtx->getDbId(),
                         RecordType::RT_SET_ELE,
                         args[i],
-                        ""};
+                        "",
+                        rv.value().getVersion()};
       cursor->seek(fake.prefixPk());
       while (true) {
         Expected<Record> exptRcd = cursor->next();
@@ -1038,6 +1157,9 @@ class SintergenericCommand : public Command {
 
     // stored all sets sorted by their length
     std::vector<std::pair<size_t, uint64_t>> setList;
+    // the subkey version of each set
+    std::map<size_t, uint64_t> versions;
+    std::map<size_t, SetMetaValue> metas;
     for (size_t i = startkey; i < args.size(); i++) {
       Expected<RecordValue> rv =
         Command::expireKeyIfNeeded(sess, args[i], RecordType::RT_SET_META);
@@ -1056,6 +1178,9 @@ class SintergenericCommand : public Command {
 
       Expected<SetMetaValue> expSetMeta =
         SetMetaValue::decode(rv.value().getValue());
+      if (!expSetMeta.ok()) {
+        return expSetMeta.status();
+      }
 
       uint64_t setLength = expSetMeta.value().getCount();
       if (setLength == 0) {
@@ -1065,6 +1190,8 @@ class SintergenericCommand : public Command {
         return Command::fmtNull();
       }
       setList.push_back(std::make_pair(i, setLength));
+      versions[i] = rv.value().getVersion();
+      metas[i] = std::move(expSetMeta.value());
     }
     std::sort(setList.begin(), setList.end(), [](auto& left, auto& right) {
       return left.second < right.second;
@@ -1072,6 +1199,13 @@ class SintergenericCommand : public Command {
 
     for (size_t i = 0; i < setList.size(); i++) {
       const std::string& key = args[setList[i].first];
+      uint64_t version = versions[setList[i].first];
+      const SetMetaValue& meta = metas[setList[i].first];
+      if (i == 0 && meta.isInline()) {
+        const auto& members = meta.getMembers();
+        result.insert(members.begin(), members.end());
+        continue;
+      }
       auto expdb = server->getSegmentMgr()->getDbHasLocked(sess, key);
       if (!expdb.ok()) {
         return expdb.status();
@@ -1088,7 +1222,8 @@ class SintergenericCommand : public Command {
                          pCtx->getDbId(),
                          RecordType::RT_SET_ELE,
                          key,
-                         "");
+                         "",
+                         version);
         cursor->seek(fakeRk.prefixPk());
         while (true) {
           Expected<Record> expRcd = cursor->next();
@@ -1123,8 +1258,10 @@ class SintergenericCommand : public Command {
                         pCtx->getDbId(),
                         RecordType::RT_SET_ELE,
                         key,
-                        *iter);
-        Expected<RecordValue> subValue = kvstore->getKV(subRk, txn.get());
+                        *iter,
+                        version);
+        Expected<RecordValue> subValue =
+          getSetMember(kvstore, txn.get(), meta, subRk);
         // if key not found, erase it
         if (!subValue.ok() ||
             subValue.status().code() == ErrorCodes::ERR_NOTFOUND) {
@@ -1369,8 +1506,11 @@ class SmoveCommand : public Command {
         Expected<std::string> addRet = genericSAdd(
           sess, destStore, etxn2.value(), addRk, destRv, {"", "", member});
         if (addRet.ok()) {
-          pCtx->commitAll("smove");
           rollback = false;
+          auto s = pCtx->commitAll("smove");
+          if (!s.ok()) {
+            return s;
+          }
           return addRet.value();
         }
         if (addRet.status().code() != ErrorCodes::ERR_COMMIT_RETRY) {
@@ -1417,6 +1557,17 @@ class SuniongenericCommand : public Command {
         return rv.status();
       }
 
+      Expected<SetMetaValue> exptSm =
+        SetMetaValue::decode(rv.value().getValue());
+      if (!exptSm.ok()) {
+        return exptSm.status();
+      }
+      if (exptSm.value().isInline()) {
+        const auto& members = exptSm.value().getMembers();
+        result.insert(members.begin(), members.end());
+        continue;
+      }
+
       auto expdb = server->getSegmentMgr()->getDbHasLocked(sess, args[i]);
       if (!expdb.ok()) {
         return expdb.status();
@@ -1432,7 +1583,8 @@ class SuniongenericCommand : public Command {
                        pCtx->getDbId(),
                        RecordType::RT_SET_ELE,
                        args[i],
-                       "");
+                       "",
+                       rv.value().getVersion());
       cursor->seek(fakeRk.prefixPk());
       while (true) {
         Expected<Record> exptRcd = cursor->next();
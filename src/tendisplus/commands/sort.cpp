@@ -94,11 +94,25 @@ class SortCommand : public Command {
     std::unique_ptr<Transaction> ROTxn = std::move(byExptxn.value());
 
     if (fieldKey.size() != 0) {
+      if (byRv.value().getRecordType() == RecordType::RT_HASH_META) {
+        auto hashMeta = HashMetaValue::decode(byRv.value().getValue());
+        if (!hashMeta.ok()) {
+          return hashMeta.status();
+        }
+        if (hashMeta.value().isInline()) {
+          const std::string* v = hashMeta.value().getField(fieldKey);
+          if (v == nullptr) {
+            return {ErrorCodes::ERR_NOTFOUND, ""};
+          }
+          return *v;
+        }
+      }
       RecordKey hashRk(expdb.value().chunkId,
                        pCtx->getDbId(),
                        RecordType::RT_HASH_ELE,
                        metaKey,
-                       fieldKey);
+                       fieldKey,
+                       byRv.value().getVersion());
       auto hashVal = byStore->getKV(hashRk, ROTxn.get());
       if (!hashVal.ok()) {
         return hashVal.status();
@@ -111,6 +125,13 @@ class SortCommand : public Command {
       if (!kvVal.ok()) {
         return kvVal.status();
       }
+      if (kvVal.value().isChunked()) {
+        auto s = Command::loadChunkedString(
+          byStore, ROTxn.get(), kvRk, &kvVal.value());
+        if (!s.ok()) {
+          return s;
+        }
+      }
       return std::move(kvVal.value().getValue());
     }
   }
@@ -264,7 +285,7 @@ class SortCommand : public Command {
     // get the length of the object
     ssize_t veclen(0);
     uint64_t lHead(0), lTail(0);
-    std::unique_ptr<SkipList> sl(nullptr);
+    PZSetEngine sl(nullptr);
     switch (keyType) {
       case RecordType::RT_LIST_META: {
         auto lm = ListMetaValue::decode(rv->getValue());
@@ -285,17 +306,16 @@ class SortCommand : public Command {
         break;
       }
       case RecordType::RT_ZSET_META: {
-        auto zm = ZSlMetaValue::decode(rv->getValue());
-        if (!zm.ok()) {
-          return zm.status();
+        auto ezsl = openZSet(metaRk.getChunkId(),
+                             metaRk.getDbId(),
+                             metaRk.getPrimaryKey(),
+                             *rv,
+                             kvstore);
+        if (!ezsl.ok()) {
+          return ezsl.status();
         }
-        ZSlMetaValue meta = zm.value();
-        veclen = meta.getCount() - 1;
-        sl = std::make_unique<SkipList>(metaRk.getChunkId(),
-                                        metaRk.getDbId(),
-                                        metaRk.getPrimaryKey(),
-                                        meta,
-                                        kvstore);
+        sl = std::move(ezsl.value());
+        veclen = sl->getCount() - 1;
         break;
       }
       default:
@@ -368,12 +388,22 @@ class SortCommand : public Command {
         pos += sign;
       }
     } else if (keyType == RecordType::RT_SET_META) {
+      auto setMeta = SetMetaValue::decode(rv->getValue());
+      if (!setMeta.ok()) {
+        return setMeta.status();
+      }
+      // NOTE: only an inline set has members in its meta, and then the
+      // prefix scan below finds nothing
+      for (const auto& member : setMeta.value().getMembers()) {
+        records.emplace_back(Element{member, 0});
+      }
       auto cursor = txn->createDataCursor();
       RecordKey fakeRk = {expdb.value().chunkId,
                           pCtx->getDbId(),
                           RecordType::RT_SET_ELE,
                           key,
-                          ""};
+                          "",
+                          rv->getVersion()};
       cursor->seek(fakeRk.prefixPk());
       while (true) {
         Expected<Record> expRcd = cursor->next();
@@ -42,58 +42,47 @@ Expected<std::string> genericZrem(Session* sess,
       return eMeta.status();
     }
   }
-  auto eMetaContent = ZSlMetaValue::decode(eMeta.value().getValue());
-  if (!eMetaContent.ok()) {
-    return eMetaContent.status();
+  auto esl = openZSet(mk.getChunkId(),
+                      mk.getDbId(),
+                      mk.getPrimaryKey(),
+                      eMeta.value(),
+                      kvstore);
+  if (!esl.ok()) {
+    return esl.status();
   }
-  ZSlMetaValue meta = eMetaContent.value();
-  SkipList sl(mk.getChunkId(), mk.getDbId(), mk.getPrimaryKey(), meta, kvstore);
+  PZSetEngine& sl = esl.value();
 
   uint32_t cnt = 0;
   for (const auto& subkey : subkeys) {
-    RecordKey hk(mk.getChunkId(),
-                 pCtx->getDbId(),
-                 RecordType::RT_ZSET_H_ELE,
-                 mk.getPrimaryKey(),
-                 subkey);
-    Expected<RecordValue> eValue = kvstore->getKV(hk, txn.get());
-    if (!eValue.ok() && eValue.status().code() != ErrorCodes::ERR_NOTFOUND) {
-      return eValue.status();
-    }
-    if (eValue.status().code() == ErrorCodes::ERR_NOTFOUND) {
+    Expected<double> oldScore = sl->getScore(subkey, txn.get());
+    if (!oldScore.ok() &&
+        oldScore.status().code() != ErrorCodes::ERR_NOTFOUND) {
+      return oldScore.status();
+    }
+    if (oldScore.status().code() == ErrorCodes::ERR_NOTFOUND) {
       continue;
     } else {
       cnt += 1;
-      Expected<double> oldScore =
-        ::tendisplus::doubleDecode(eValue.value().getValue());
-      if (!oldScore.ok()) {
-        return oldScore.status();
-      }
-      Status s = sl.remove(oldScore.value(), subkey, txn.get());
+      Status s = sl->remove(oldScore.value(), subkey, txn.get());
       if (!s.ok()) {
         return s;
       }
-      s = kvstore->delKV(hk, txn.get());
+      s = sl->delScore(subkey, txn.get());
       if (!s.ok()) {
         return s;
       }
     }
   }
   Status s;
-  if (sl.getCount() > 1) {
-    s = sl.save(txn.get(), eMeta, pCtx->getVersionEP());
+  if (sl->getCount() > 1) {
+    s = sl->save(txn.get(), eMeta, pCtx->getVersionEP());
   } else {
-    INVARIANT(sl.getCount() == 1);
+    INVARIANT(sl->getCount() == 1);
     s = Command::delKeyAndTTL(sess, mk, eMeta.value(), txn.get());
     if (!s.ok()) {
       return s;
     }
-    RecordKey head(mk.getChunkId(),
-                   pCtx->getDbId(),
-                   RecordType::RT_ZSET_S_ELE,
-                   mk.getPrimaryKey(),
-                   std::to_string(ZSlMetaValue::HEAD_ID));
-    s = kvstore->delKV(head, txn.get());
+    s = sl->drop(txn.get());
   }
   if (!s.ok()) {
     return s;
@@ -143,77 +132,71 @@ Expected<std::string> genericZadd(Session* sess,
   }
 
   std::unique_ptr<Transaction> txn = std::move(ptxn.value());
-  ZSlMetaValue meta;
-
-  if (eMeta.ok()) {
-    auto eMetaContent = ZSlMetaValue::decode(eMeta.value().getValue());
-    if (!eMetaContent.ok()) {
-      return eMetaContent.status();
-    }
-    meta = eMetaContent.value();
-  } else {
-    INVARIANT_D(eMeta.status().code() == ErrorCodes::ERR_NOTFOUND ||
-                eMeta.status().code() == ErrorCodes::ERR_EXPIRED);
-    // head node also included into the count
-    ZSlMetaValue tmp(1 /*lvl*/, 1 /*count*/, 0 /*tail*/);
-    RecordValue rv(
-      tmp.encode(), RecordType::RT_ZSET_META, pCtx->getVersionEP());
-    Status s = kvstore->setKV(mk, rv, txn.get());
-    if (!s.ok()) {
-      return s;
-    }
-    RecordKey head(mk.getChunkId(),
-                   pCtx->getDbId(),
-                   RecordType::RT_ZSET_S_ELE,
-                   mk.getPrimaryKey(),
-                   std::to_string(ZSlMetaValue::HEAD_ID));
-    ZSlEleValue headVal;
-    RecordValue subRv(headVal.encode(), RecordType::RT_ZSET_S_ELE, -1);
-    s = kvstore->setKV(head, subRv, txn.get());
-    if (!s.ok()) {
-      return s;
-    }
-    Expected<RecordValue> eMeta = kvstore->getKV(mk, txn.get());
-    if (!eMeta.ok()) {
-      return eMeta.status();
-    }
-    auto eMetaContent = ZSlMetaValue::decode(eMeta.value().getValue());
-    if (!eMetaContent.ok()) {
-      return eMetaContent.status();
-    }
-    meta = eMetaContent.value();
-  }
-
-  SkipList sl(mk.getChunkId(), mk.getDbId(), mk.getPrimaryKey(), meta, kvstore);
+  uint64_t version = rcd_util::getSubKeyVersion(eMeta);
+  uint8_t engine = Command::getZSetEngine(sess);
+
+  INVARIANT_D(eMeta.ok() ||
+              eMeta.status().code() == ErrorCodes::ERR_NOTFOUND ||
+              eMeta.status().code() == ErrorCodes::ERR_EXPIRED);
+  // NOTE: a new zset starts inline if enabled, it's spilled below once
+  // it's too large
+  auto esl = eMeta.ok() ? openZSet(mk.getChunkId(),
+                                   mk.getDbId(),
+                                   mk.getPrimaryKey(),
+                                   eMeta.value(),
+                                   kvstore)
+                        : createZSet(mk.getChunkId(),
+                                     mk.getDbId(),
+                                     mk.getPrimaryKey(),
+                                     Command::isInlineEnabled(
+                                       sess, RecordType::RT_ZSET_META)
+                                       ? ZSlMetaValue::ENGINE_INLINE
+                                       : engine,
+                                     version,
+                                     kvstore,
+                                     txn.get());
+  if (!esl.ok()) {
+    return esl.status();
+  }
+  // NOTE: a zset of the other engine is converted when it's written
+  if (esl.value()->getEngine() != ZSlMetaValue::ENGINE_INLINE) {
+    esl = convertZSet(mk.getChunkId(),
+                      mk.getDbId(),
+                      mk.getPrimaryKey(),
+                      std::move(esl.value()),
+                      engine,
+                      version,
+                      kvstore,
+                      txn.get());
+    if (!esl.ok()) {
+      return esl.status();
+    }
+  }
+  PZSetEngine& sl = esl.value();
   std::stringstream ss;
   double newScore = 0;
   // sl.traverse(ss, txn.get());
   for (const auto& entry : subKeys) {
-    RecordKey hk(mk.getChunkId(),
-                 pCtx->getDbId(),
-                 RecordType::RT_ZSET_H_ELE,
-                 mk.getPrimaryKey(),
-                 entry.first);
     newScore = entry.second;
     if (std::isnan(newScore)) {
       return {ErrorCodes::ERR_NAN, ""};
     }
-    Expected<RecordValue> eValue = kvstore->getKV(hk, txn.get());
-    if (!eValue.ok() && eValue.status().code() != ErrorCodes::ERR_NOTFOUND) {
-      return eValue.status();
+    Expected<double> oldScore = sl->getScore(entry.first, txn.get());
+    if (!oldScore.ok() &&
+        oldScore.status().code() != ErrorCodes::ERR_NOTFOUND) {
+      return oldScore.status();
     }
-    if (eValue.status().code() == ErrorCodes::ERR_NOTFOUND) {
+    if (oldScore.status().code() == ErrorCodes::ERR_NOTFOUND) {
       if (xx) {
         continue;
       }
       added++;
       processed++;
-      Status s = sl.insert(entry.second, entry.first, txn.get());
+      Status s = sl->insert(entry.second, entry.first, txn.get());
       if (!s.ok()) {
         return s;
       }
-      RecordValue hv(newScore, RecordType::RT_ZSET_H_ELE);
-      s = kvstore->setKV(hk, hv, txn.get());
+      s = sl->setScore(entry.first, newScore, txn.get());
       if (!s.ok()) {
         return s;
       }
@@ -221,11 +204,6 @@ Expected<std::string> genericZadd(Session* sess,
       if (nx) {
         continue;
       }
-      Expected<double> oldScore =
-        ::tendisplus::doubleDecode(eValue.value().getValue());
-      if (!oldScore.ok()) {
-        return oldScore.status();
-      }
       if (incr) {
         newScore += oldScore.value();
         if (std::isnan(newScore)) {
@@ -239,23 +217,27 @@ Expected<std::string> genericZadd(Session* sess,
       updated++;
       processed++;
       // change score
-      Status s = sl.remove(oldScore.value(), entry.first, txn.get());
+      Status s = sl->remove(oldScore.value(), entry.first, txn.get());
       if (!s.ok()) {
         return s;
       }
-      s = sl.insert(newScore, entry.first, txn.get());
+      s = sl->insert(newScore, entry.first, txn.get());
       if (!s.ok()) {
         return s;
       }
-      RecordValue hv(newScore, RecordType::RT_ZSET_H_ELE);
-      s = kvstore->setKV(hk, hv, txn.get());
+      s = sl->setScore(entry.first, newScore, txn.get());
       if (!s.ok()) {
         return s;
       }
     }
   }
+  Status s =
+    Command::spillInlineZSet(sess, kvstore, txn.get(), mk, version, &sl);
+  if (!s.ok()) {
+    return s;
+  }
   // NOTE(vinchen): skiplist save one time
-  Status s = sl.save(txn.get(), eMeta, sess->getCtx()->getVersionEP());
+  s = sl->save(txn.get(), eMeta, sess->getCtx()->getVersionEP());
   if (!s.ok()) {
     return s;
   }
@@ -285,38 +267,26 @@ Expected<std::string> genericZRank(Session* sess,
   }
   std::unique_ptr<Transaction> txn = std::move(ptxn.value());
 
-  RecordKey hk(mk.getChunkId(),
-               mk.getDbId(),
-               RecordType::RT_ZSET_H_ELE,
-               mk.getPrimaryKey(),
-               subkey);
-  Expected<RecordValue> eValue =
-    kvstore->getKV(hk, txn.get(), RecordType::RT_ZSET_H_ELE);
-  if (!eValue.ok()) {
-    if (eValue.status().code() == ErrorCodes::ERR_NOTFOUND) {
-      return Command::fmtNull();
-    }
-    return eValue.status();
+  auto esl = openZSet(
+    mk.getChunkId(), mk.getDbId(), mk.getPrimaryKey(), mv, kvstore);
+  if (!esl.ok()) {
+    return esl.status();
   }
-  Expected<double> score =
-    ::tendisplus::doubleDecode(eValue.value().getValue());
+  PZSetEngine& sl = esl.value();
+  Expected<double> score = sl->getScore(subkey, txn.get());
   if (!score.ok()) {
+    if (score.status().code() == ErrorCodes::ERR_NOTFOUND) {
+      return Command::fmtNull();
+    }
     return score.status();
   }
-
-  auto eMetaContent = ZSlMetaValue::decode(mv.getValue());
-  if (!eMetaContent.ok()) {
-    return eMetaContent.status();
-  }
-  const ZSlMetaValue& meta = eMetaContent.value();
-  SkipList sl(mk.getChunkId(), mk.getDbId(), mk.getPrimaryKey(), meta, kvstore);
-  Expected<uint32_t> rank = sl.rank(score.value(), subkey, txn.get());
+  Expected<uint32_t> rank = sl->rank(score.value(), subkey, txn.get());
   if (!rank.ok()) {
     return rank.status();
   }
   int64_t r = rank.value() - 1;
   if (reverse) {
-    r = meta.getCount() - 2 - r;
+    r = sl->getCount() - 2 - r;
   }
   INVARIANT_D(r >= 0);
   return Command::fmtLongLong(r);
@@ -382,16 +352,18 @@ class ZRemByRangeGenericCommand : public Command {
         return eMeta.status();
       }
     }
-    auto eMetaContent = ZSlMetaValue::decode(eMeta.value().getValue());
-    if (!eMetaContent.ok()) {
-      return eMetaContent.status();
+    auto esl = openZSet(mk.getChunkId(),
+                        mk.getDbId(),
+                        mk.getPrimaryKey(),
+                        eMeta.value(),
+                        kvstore);
+    if (!esl.ok()) {
+      return esl.status();
     }
-    ZSlMetaValue meta = eMetaContent.value();
-    SkipList sl(
-      mk.getChunkId(), mk.getDbId(), mk.getPrimaryKey(), meta, kvstore);
+    PZSetEngine& sl = esl.value();
 
     if (_type == Type::RANK) {
-      int64_t llen = sl.getCount() - 1;
+      int64_t llen = sl->getCount() - 1;
       if (start < 0) {
         start = llen + start;
       }
@@ -411,51 +383,41 @@ class ZRemByRangeGenericCommand : public Command {
 
     std::list<std::pair<double, std::string>> result;
     if (_type == Type::RANK) {
-      auto tmp = sl.removeRangeByRank(start + 1, end + 1, txn.get());
+      auto tmp = sl->removeRangeByRank(start + 1, end + 1, txn.get());
       if (!tmp.ok()) {
         return tmp.status();
       }
       result = std::move(tmp.value());
     } else if (_type == Type::SCORE) {
-      auto tmp = sl.removeRangeByScore(range, txn.get());
+      auto tmp = sl->removeRangeByScore(range, txn.get());
       if (!tmp.ok()) {
         return tmp.status();
       }
       result = std::move(tmp.value());
     } else if (_type == Type::LEX) {
-      auto tmp = sl.removeRangeByLex(lexrange, txn.get());
+      auto tmp = sl->removeRangeByLex(lexrange, txn.get());
       if (!tmp.ok()) {
         return tmp.status();
       }
       result = std::move(tmp.value());
     }
     for (const auto& v : result) {
-      RecordKey hk(mk.getChunkId(),
-                   pCtx->getDbId(),
-                   RecordType::RT_ZSET_H_ELE,
-                   mk.getPrimaryKey(),
-                   v.second);
-      auto s = kvstore->delKV(hk, txn.get());
+      auto s = sl->delScore(v.second, txn.get());
       if (!s.ok()) {
         return s;
       }
     }
 
     Status s;
-    if (sl.getCount() > 1) {
-      s = sl.save(txn.get(), eMeta, pCtx->getVersionEP());
+    if (sl->getCount() > 1) {
+      s = sl->save(txn.get(), eMeta, pCtx->getVersionEP());
     } else {
-      INVARIANT(sl.getCount() == 1);
+      INVARIANT(sl->getCount() == 1);
       s = Command::delKeyAndTTL(sess, mk, eMeta.value(), txn.get());
       if (!s.ok()) {
         return s;
       }
-      RecordKey head(mk.getChunkId(),
-                     pCtx->getDbId(),
-                     RecordType::RT_ZSET_S_ELE,
-                     mk.getPrimaryKey(),
-                     std::to_string(ZSlMetaValue::HEAD_ID));
-      s = kvstore->delKV(head, txn.get());
+      s = sl->drop(txn.get());
     }
     if (!s.ok()) {
       return s;
@@ -911,40 +873,17 @@ class ZCountCommand : public Command {
       return ptxn.status();
     }
     std::unique_ptr<Transaction> txn = std::move(ptxn.value());
-    auto eMetaContent = ZSlMetaValue::decode(rv.value().getValue());
-    if (!eMetaContent.ok()) {
-      return eMetaContent.status();
-    }
-    ZSlMetaValue meta = eMetaContent.value();
-    SkipList sl(expdb.value().chunkId, pCtx->getDbId(), key, meta, kvstore);
-    auto f = sl.firstInRange(range, txn.get());
-    if (!f.ok()) {
-      return f.status();
-    }
-    if (f.value() == SKIPLIST_INVALID_POS) {
-      return Command::fmtZero();
-    }
-    auto first = sl.getCacheNode(f.value());
-    Expected<uint32_t> rank =
-      sl.rank(first->getScore(), first->getSubKey(), txn.get());
-    if (!rank.ok()) {
-      return rank.status();
+    auto esl = openZSet(
+      expdb.value().chunkId, pCtx->getDbId(), key, rv.value(), kvstore);
+    if (!esl.ok()) {
+      return esl.status();
     }
-    // sl.getCount()-1 : total skiplist nodes exclude head
-    uint32_t count = (sl.getCount() - 1 - (rank.value() - 1));
-    auto l = sl.lastInRange(range, txn.get());
-    if (!l.ok()) {
-      return l.status();
+    PZSetEngine& sl = esl.value();
+    auto count = sl->countInRange(range, txn.get());
+    if (!count.ok()) {
+      return count.status();
     }
-    if (l.value() == SKIPLIST_INVALID_POS) {
-      return Command::fmtLongLong(count);
-    }
-    auto last = sl.getCacheNode(l.value());
-    rank = sl.rank(last->getScore(), last->getSubKey(), txn.get());
-    if (!rank.ok()) {
-      return rank.status();
-    }
-    return Command::fmtLongLong(count - (sl.getCount() - 1 - rank.value()));
+    return Command::fmtLongLong(count.value());
   }
 } zcountCommand;
 
@@ -1001,41 +940,17 @@ class ZlexCountCommand : public Command {
       return ptxn.status();
     }
     std::unique_ptr<Transaction> txn = std::move(ptxn.value());
-    auto eMetaContent = ZSlMetaValue::decode(rv.value().getValue());
-    if (!eMetaContent.ok()) {
-      return eMetaContent.status();
+    auto esl = openZSet(
+      expdb.value().chunkId, pCtx->getDbId(), key, rv.value(), kvstore);
+    if (!esl.ok()) {
+      return esl.status();
     }
-    ZSlMetaValue meta = eMetaContent.value();
-    SkipList sl(expdb.value().chunkId, pCtx->getDbId(), key, meta, kvstore);
-
-    auto f = sl.firstInLexRange(range, txn.get());
-    if (!f.ok()) {
-      return f.status();
-    }
-    if (f.value() == SKIPLIST_INVALID_POS) {
-      return Command::fmtZero();
-    }
-    auto first = sl.getCacheNode(f.value());
-    Expected<uint32_t> rank =
-      sl.rank(first->getScore(), first->getSubKey(), txn.get());
-    if (!rank.ok()) {
-      return rank.status();
-    }
-    // sl.getCount()-1 : total skiplist nodes exclude head
-    uint32_t count = (sl.getCount() - 1 - (rank.value() - 1));
-    auto l = sl.lastInLexRange(range, txn.get());
-    if (!l.ok()) {
-      return l.status();
-    }
-    if (l.value() == SKIPLIST_INVALID_POS) {
-      return Command::fmtLongLong(count);
-    }
-    auto last = sl.getCacheNode(l.value());
-    rank = sl.rank(last->getScore(), last->getSubKey(), txn.get());
-    if (!rank.ok()) {
-      return rank.status();
+    PZSetEngine& sl = esl.value();
+    auto count = sl->countInLexRange(range, txn.get());
+    if (!count.ok()) {
+      return count.status();
     }
-    return Command::fmtLongLong(count - (sl.getCount() - 1 - rank.value()));
+    return Command::fmtLongLong(count.value());
   }
 } zlexCntCmd;
 
@@ -1137,13 +1052,13 @@ class ZRangeByScoreGenericCommand : public Command {
       return ptxn.status();
     }
     std::unique_ptr<Transaction> txn = std::move(ptxn.value());
-    auto eMetaContent = ZSlMetaValue::decode(rv.value().getValue());
-    if (!eMetaContent.ok()) {
-      return eMetaContent.status();
+    auto esl = openZSet(
+      expdb.value().chunkId, pCtx->getDbId(), key, rv.value(), kvstore);
+    if (!esl.ok()) {
+      return esl.status();
     }
-    ZSlMetaValue meta = eMetaContent.value();
-    SkipList sl(expdb.value().chunkId, pCtx->getDbId(), key, meta, kvstore);
-    auto arr = sl.scanByScore(range, offset, limit, _rev, txn.get());
+    PZSetEngine& sl = esl.value();
+    auto arr = sl->scanByScore(range, offset, limit, _rev, txn.get());
     if (!arr.ok()) {
       return arr.status();
     }
@@ -1272,13 +1187,13 @@ class ZRangeByLexGenericCommand : public Command {
       return ptxn.status();
     }
     std::unique_ptr<Transaction> txn = std::move(ptxn.value());
-    auto eMetaContent = ZSlMetaValue::decode(rv.value().getValue());
-    if (!eMetaContent.ok()) {
-      return eMetaContent.status();
+    auto esl = openZSet(
+      expdb.value().chunkId, pCtx->getDbId(), key, rv.value(), kvstore);
+    if (!esl.ok()) {
+      return esl.status();
     }
-    ZSlMetaValue meta = eMetaContent.value();
-    SkipList sl(expdb.value().chunkId, pCtx->getDbId(), key, meta, kvstore);
-    auto arr = sl.scanByLex(range, offset, limit, _rev, txn.get());
+    PZSetEngine& sl = esl.value();
+    auto arr = sl->scanByLex(range, offset, limit, _rev, txn.get());
     if (!arr.ok()) {
       return arr.status();
     }
@@ -1373,13 +1288,13 @@ class ZRangeGenericCommand : public Command {
       return ptxn.status();
     }
     std::unique_ptr<Transaction> txn = std::move(ptxn.value());
-    auto eMetaContent = ZSlMetaValue::decode(rv.value().getValue());
-    if (!eMetaContent.ok()) {
-      return eMetaContent.status();
+    auto esl = openZSet(
+      expdb.value().chunkId, pCtx->getDbId(), key, rv.value(), kvstore);
+    if (!esl.ok()) {
+      return esl.status();
     }
-    ZSlMetaValue meta = eMetaContent.value();
-    SkipList sl(expdb.value().chunkId, pCtx->getDbId(), key, meta, kvstore);
-    int64_t len = sl.getCount() - 1;
+    PZSetEngine& sl = esl.value();
+    int64_t len = sl->getCount() - 1;
     if (start < 0) {
       start = len + start;
     }
@@ -1396,7 +1311,7 @@ class ZRangeGenericCommand : public Command {
       end = len - 1;
     }
     int64_t rangeLen = end - start + 1;
-    auto arr = sl.scanByRank(start, rangeLen, _rev, txn.get());
+    auto arr = sl->scanByRank(start, rangeLen, _rev, txn.get());
     if (!arr.ok()) {
       return arr.status();
     }
@@ -1485,23 +1400,19 @@ class ZScoreCommand : public Command {
       return ptxn.status();
     }
     std::unique_ptr<Transaction> txn = std::move(ptxn.value());
-    RecordKey hk(expdb.value().chunkId,
-                 pCtx->getDbId(),
-                 RecordType::RT_ZSET_H_ELE,
-                 key,
-                 subkey);
-    Expected<RecordValue> eValue = kvstore->getKV(hk, txn.get());
-    if (!eValue.ok() && eValue.status().code() != ErrorCodes::ERR_NOTFOUND) {
-      return eValue.status();
-    }
-    if (eValue.status().code() == ErrorCodes::ERR_NOTFOUND) {
-      return Command::fmtNull();
-    }
-    Expected<double> oldScore =
-      ::tendisplus::doubleDecode(eValue.value().getValue());
-    if (!oldScore.ok()) {
+    auto esl = openZSet(
+      expdb.value().chunkId, pCtx->getDbId(), key, rv.value(), kvstore);
+    if (!esl.ok()) {
+      return esl.status();
+    }
+    Expected<double> oldScore = esl.value()->getScore(subkey, txn.get());
+    if (!oldScore.ok() &&
+        oldScore.status().code() != ErrorCodes::ERR_NOTFOUND) {
       return oldScore.status();
     }
+    if (oldScore.status().code() == ErrorCodes::ERR_NOTFOUND) {
+      return Command::fmtNull();
+    }
     return Command::fmtBulk(::tendisplus::dtos(oldScore.value()));
   }
 } zscoreCmd;
@@ -1859,16 +1770,19 @@ class ZUnionInterGenericCommand : public Command {
       }
       std::unique_ptr<Transaction> txn = std::move(ptxn.value());
       RecordType keyType = zsetList[i].second.getRecordType();
+      uint64_t version = zsetList[i].second.getVersion();
       if (fakei == 0 || _op == ZsetOp::SET_OP_UNION) {
         if (keyType == RecordType::RT_ZSET_META) {
-          Expected<ZSlMetaValue> zslMeta =
-            ZSlMetaValue::decode(zsetList[i].second.getValue());
-          SkipList sl(expdb.value().chunkId,
-                      pCtx->getDbId(),
-                      key,
-                      zslMeta.value(),
-                      kvstore);
-          auto arr = sl.scanByRank(0, sl.getCount() - 1, false, txn.get());
+          auto esl = openZSet(expdb.value().chunkId,
+                              pCtx->getDbId(),
+                              key,
+                              zsetList[i].second,
+                              kvstore);
+          if (!esl.ok()) {
+            return esl.status();
+          }
+          PZSetEngine& sl = esl.value();
+          auto arr = sl->scanByRank(0, sl->getCount() - 1, false, txn.get());
           if (!arr.ok()) {
             return arr.status();
           }
@@ -1883,12 +1797,28 @@ class ZUnionInterGenericCommand : public Command {
             zunionInterAggregate(&scoreMap[v.second], value, aggr);
           }
         } else if (keyType == RecordType::RT_SET_META) {
+          Expected<SetMetaValue> setMeta =
+            SetMetaValue::decode(zsetList[i].second.getValue());
+          if (!setMeta.ok()) {
+            return setMeta.status();
+          }
+          if (setMeta.value().isInline()) {
+            for (const auto& subkey : setMeta.value().getMembers()) {
+              if (!scoreMap.count(subkey)) {
+                scoreMap[subkey] = 1 * w;
+                continue;
+              }
+              zunionInterAggregate(&scoreMap[subkey], 1 * w, aggr);
+            }
+            continue;
+          }
           auto cursor = txn->createDataCursor();
           RecordKey rk(expdb.value().chunkId,
                        pCtx->getDbId(),
                        RecordType::RT_SET_ELE,
                        key,
-                       "");
+                       "",
+                       version);
           cursor->seek(rk.prefixPk());
           while (true) {
             Expected<Record> expRcd = cursor->next();
@@ -1913,29 +1843,64 @@ class ZUnionInterGenericCommand : public Command {
         }
         continue;
       } else if (_op == ZsetOp::SET_OP_INTER) {
-        RecordType eleType = keyType == RecordType::RT_ZSET_META
-          ? RecordType::RT_ZSET_H_ELE
-          : RecordType::RT_SET_ELE;
+        if (keyType == RecordType::RT_ZSET_META) {
+          auto esl = openZSet(expdb.value().chunkId,
+                              pCtx->getDbId(),
+                              key,
+                              zsetList[i].second,
+                              kvstore);
+          if (!esl.ok()) {
+            return esl.status();
+          }
+          PZSetEngine& sl = esl.value();
+          for (auto iter = scoreMap.begin(); iter != scoreMap.end();) {
+            Expected<double> eScore = sl->getScore(iter->first, txn.get());
+            if (!eScore.ok()) {
+              iter = scoreMap.erase(iter);
+              continue;
+            }
+            double value = eScore.value() * w;
+            if (std::isnan(value))
+              value = 0;
+            zunionInterAggregate(&iter->second, value, aggr);
+            ++iter;
+          }
+          continue;
+        }
+        Expected<SetMetaValue> setMeta =
+          SetMetaValue::decode(zsetList[i].second.getValue());
+        if (!setMeta.ok()) {
+          return setMeta.status();
+        }
+        if (setMeta.value().isInline()) {
+          for (auto iter = scoreMap.begin(); iter != scoreMap.end();) {
+            if (!setMeta.value().hasMember(iter->first)) {
+              iter = scoreMap.erase(iter);
+              continue;
+            }
+            double value = 1 * w;
+            if (std::isnan(value))
+              value = 0;
+            zunionInterAggregate(&iter->second, value, aggr);
+            ++iter;
+          }
+          continue;
+        }
         for (auto iter = scoreMap.begin(); iter != scoreMap.end();) {
           const std::string& subkey = iter->first;
-          RecordKey rk(
-            expdb.value().chunkId, pCtx->getDbId(), eleType, key, subkey);
+          RecordKey rk(expdb.value().chunkId,
+                       pCtx->getDbId(),
+                       RecordType::RT_SET_ELE,
+                       key,
+                       subkey,
+                       version);
           auto eVal = kvstore->getKV(rk, txn.get());
 
           if (!eVal.ok() || eVal.status().code() == ErrorCodes::ERR_NOTFOUND) {
             iter = scoreMap.erase(iter);
             continue;
           }
-          double value = 1;
-          if (keyType == RecordType::RT_ZSET_META) {
-            Expected<double> eScore =
-              tendisplus::doubleDecode(eVal.value().getValue());
-            if (!eScore.ok()) {
-              return eScore.status();
-            }
-            value = eScore.value();
-          }
-          value = value * w;
+          double value = 1 * w;
           if (std::isnan(value))
             value = 0;
           zunionInterAggregate(&(iter->second), value, aggr);
@@ -7,6 +7,7 @@
 #include "tendisplus/lock/lock.h"
 #include "tendisplus/utils/invariant.h"
 #include "tendisplus/server/server_entry.h"
+#include "tendisplus/utils/time.h"
 
 namespace tendisplus {
 
@@ -194,29 +195,71 @@ Expected<std::unique_ptr<KeyLock>> KeyLock::AquireKeyLock(
   Session* sess,
   mgl::MGLockMgr* mgr,
   uint64_t lockTimeoutMs) {
-  if (sess->getCtx()->isLockedByMe(key, mode)) {
+  auto pCtx = sess->getCtx();
+  if (pCtx->isLockedByMe(key, mode)) {
     return std::unique_ptr<KeyLock>(nullptr);
-  } else {
-    auto lock = std::make_unique<KeyLock>(
-      storeId, chunkId, key, mode, sess, mgr, lockTimeoutMs);
-    if (lock->getLockResult() == mgl::LockRes::LOCKRES_OK) {
-      return lock;
-    } else if (lock->getLockResult() == mgl::LockRes::LOCKRES_TIMEOUT) {
+  }
+
+  // the command runs again after its key lock was waited
+  auto pending = pCtx->takePendingLock();
+  if (pending) {
+    if (pending->getKey() == key && pending->getMode() == mode &&
+        pending->getChunkId() == chunkId) {
+      if (pending->isGranted()) {
+        pending->setGranted();
+        return std::move(pending);
+      }
+      auto deadline = pCtx->getLockDeadline();
+      if (msSinceEpoch() < deadline) {
+        pCtx->setPendingLock(std::move(pending), deadline);
+        return {ErrorCodes::ERR_LOCK_WAIT, ""};
+      }
+      pCtx->setWaitLock(0, 0, "", mgl::LockMode::LOCK_NONE);
       return {ErrorCodes::ERR_LOCK_TIMEOUT, "Lock wait timeout"};
-    } else {
-      INVARIANT_D(0);
-      return {ErrorCodes::ERR_UNKNOWN, "unknown error"};
     }
+    // not the lock waited, it's dequeued
+    pending.reset();
+  }
+
+  std::function<void()> granted = nullptr;
+  if (canWaitAsync(sess)) {
+    auto blockingMgr = sess->getServerEntry()->getBlockingMgr();
+    auto sessId = sess->id();
+    granted = [blockingMgr, sessId]() { blockingMgr->signalSession(sessId); };
+  }
+  auto lock = std::make_unique<KeyLock>(
+    storeId, chunkId, key, mode, sess, mgr, lockTimeoutMs, std::move(granted));
+  if (lock->getLockResult() == mgl::LockRes::LOCKRES_OK) {
+    return lock;
+  } else if (lock->getLockResult() == mgl::LockRes::LOCKRES_TIMEOUT) {
+    return {ErrorCodes::ERR_LOCK_TIMEOUT, "Lock wait timeout"};
+  } else if (lock->getLockResult() == mgl::LockRes::LOCKRES_WAIT) {
+    pCtx->setPendingLock(std::move(lock), msSinceEpoch() + lockTimeoutMs);
+    return {ErrorCodes::ERR_LOCK_WAIT, ""};
+  } else {
+    INVARIANT_D(0);
+    return {ErrorCodes::ERR_UNKNOWN, "unknown error"};
   }
 }
 
+// only a normal client can wait asynchronously. A session holding other
+// locks may have done some writes, so it can't run the command again.
+bool KeyLock::canWaitAsync(Session* sess) {
+  auto svr = sess->getServerEntry();
+  auto pCtx = sess->getCtx();
+  return svr && svr->getParams()->lockWaitAsync &&
+    sess->getType() == Session::Type::NET && !pCtx->isInMulti() &&
+    !pCtx->isReplOnly() && !pCtx->hasLocks();
+}
+
 KeyLock::KeyLock(uint32_t storeId,
                  uint32_t chunkId,
                  const std::string& key,
                  mgl::LockMode mode,
                  Session* sess,
                  mgl::MGLockMgr* mgr,
-                 uint64_t lockTimeoutMs)
+                 uint64_t lockTimeoutMs,
+                 std::function<void()> granted)
   // :ILock(new StoreLock(storeId, getParentMode(mode), nullptr, mgr,
   // lockTimeoutMs),
   : ILock(new ChunkLock(
@@ -231,7 +274,17 @@ KeyLock::KeyLock(uint32_t storeId,
     if (_sess) {
       _sess->getCtx()->setWaitLock(storeId, chunkId, key, mode);
     }
-    _lockResult = _mgl->lock(target, mode, lockTimeoutMs);
+    if (granted) {
+      // the intent locks of the parents are rarely waited, only the key
+      // lock is waited asynchronously
+      _lockResult = _mgl->lockAsync(target, mode, std::move(granted));
+      if (_lockResult == mgl::LockRes::LOCKRES_WAIT) {
+        // the wait lock is kept in SessionCtx until setGranted()
+        return;
+      }
+    } else {
+      _lockResult = _mgl->lock(target, mode, lockTimeoutMs);
+    }
     if (_sess) {
       _sess->getCtx()->setWaitLock(0, 0, "", mgl::LockMode::LOCK_NONE);
       if (_lockResult == mgl::LockRes::LOCKRES_OK) {
@@ -242,6 +295,20 @@ KeyLock::KeyLock(uint32_t storeId,
   }
 }
 
+bool KeyLock::isGranted() const {
+  return _mgl->getStatus() == mgl::LockRes::LOCKRES_OK;
+}
+
+void KeyLock::setGranted() {
+  INVARIANT_D(_lockResult == mgl::LockRes::LOCKRES_WAIT && isGranted());
+  _lockResult = mgl::LockRes::LOCKRES_OK;
+  if (_sess) {
+    _sess->getCtx()->setWaitLock(0, 0, "", mgl::LockMode::LOCK_NONE);
+    _sess->getCtx()->addLock(this);
+    _sess->getCtx()->setKeylock(_key, getMode());
+  }
+}
+
 KeyLock::~KeyLock() {
   if (_sess && _lockResult == mgl::LockRes::LOCKRES_OK) {
     _sess->getCtx()->unsetKeylock(_key);
@@ -8,6 +8,7 @@
 #include <string>
 #include <utility>
 #include <memory>
+#include <functional>
 
 #include "tendisplus/lock/mgl/mgl.h"
 #include "tendisplus/server/session.h"
@@ -93,6 +94,11 @@ class ChunkLock : public ILock {
   uint32_t _chunkId;
 };
 
+// For a normal client, if the key lock can't be granted at once and the
+// session holds no other lock, AquireKeyLock() returns ERR_LOCK_WAIT
+// instead of waiting. The lock is kept queued in SessionCtx and the
+// session is parked, the next run of the command takes it back once
+// it's granted or timed out.
 class KeyLock : public ILock {
  public:
   static Expected<std::unique_ptr<KeyLock>> AquireKeyLock(
@@ -103,21 +109,26 @@ class KeyLock : public ILock {
     Session* sess,
     mgl::MGLockMgr* mgr,
     uint64_t lockTimeoutMs = 3600000);
+  // if granted is set, the key lock doesn't wait, see lockAsync()
   KeyLock(uint32_t storeId,
           uint32_t chunkId,
           const std::string& key,
           mgl::LockMode mode,
           Session* sess,
           mgl::MGLockMgr* mgr,
-          uint64_t lockTimeoutMs = 3600000);
+          uint64_t lockTimeoutMs = 3600000,
+          std::function<void()> granted = nullptr);
   uint32_t getStoreId() const final;
   uint32_t getChunkId() const final;
   std::string getKey() const final;
+  bool isGranted() const;
   // remove lock from session before that lock has really been unlocked in its
   // parent's destructor.
   virtual ~KeyLock();
 
  private:
+  static bool canWaitAsync(Session* sess);
+  void setGranted();
   const std::string _key;
 };
 
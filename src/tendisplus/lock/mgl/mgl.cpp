@@ -7,7 +7,6 @@ namespace tendisplus {
 namespace mgl {
 
 std::atomic<uint64_t> MGLock::_idGen(0);
-std::list<MGLock*> MGLock::_dummyList{};
 
 MGLock::MGLock(MGLockMgr* mgr)
   : _id(_idGen.fetch_add(1, std::memory_order_relaxed)),
@@ -15,9 +14,13 @@ MGLock::MGLock(MGLockMgr* mgr)
     _targetHash(0),
     _mode(LockMode::LOCK_NONE),
     _res(LockRes::LOCKRES_UNINITED),
-    _resIter(_dummyList.end()),
     _lockMgr(mgr),
-    _threadId(getCurThreadId()) {}
+    _threadId(getCurThreadId()),
+    _prev(nullptr),
+    _next(nullptr),
+    _node(nullptr),
+    _fast(false),
+    _granted(nullptr) {}
 
 MGLock::~MGLock() {
   INVARIANT_D(_res == LockRes::LOCKRES_UNINITED);
@@ -26,13 +29,20 @@ MGLock::~MGLock() {
 void MGLock::releaseLockResult() {
   std::lock_guard<std::mutex> lk(_mutex);
   _res = LockRes::LOCKRES_UNINITED;
-  _resIter = _dummyList.end();
+  _node = nullptr;
+  _fast = false;
 }
 
-void MGLock::setLockResult(LockRes res, std::list<MGLock*>::iterator iter) {
+void MGLock::setLockResult(LockRes res) {
   std::lock_guard<std::mutex> lk(_mutex);
   _res = res;
-  _resIter = iter;
+}
+
+void MGLock::setFastLockResult(LockNode* node) {
+  std::lock_guard<std::mutex> lk(_mutex);
+  _res = LockRes::LOCKRES_OK;
+  _node = node;
+  _fast = true;
 }
 
 void MGLock::unlock() {
@@ -50,13 +60,10 @@ void MGLock::unlock() {
   }
 }
 
-LockRes MGLock::lock(const std::string& target,
-                     LockMode mode,
-                     uint64_t timeoutMs) {
+void MGLock::enqueue(const std::string& target, LockMode mode) {
   _target = target;
   _mode = mode;
   INVARIANT_D(getStatus() == LockRes::LOCKRES_UNINITED);
-  _resIter = _dummyList.end();
   if (_target != "") {
     _targetHash = static_cast<uint64_t>(std::hash<std::string>{}(_target));
   } else {
@@ -67,6 +74,21 @@ LockRes MGLock::lock(const std::string& target,
   } else {
     _lockMgr->lock(this);
   }
+}
+
+LockRes MGLock::lockAsync(const std::string& target,
+                          LockMode mode,
+                          std::function<void()> granted) {
+  _granted = std::move(granted);
+  enqueue(target, mode);
+  return getStatus();
+}
+
+LockRes MGLock::lock(const std::string& target,
+                     LockMode mode,
+                     uint64_t timeoutMs) {
+  _granted = nullptr;
+  enqueue(target, mode);
   if (getStatus() == LockRes::LOCKRES_OK) {
     return LockRes::LOCKRES_OK;
   }
@@ -77,12 +99,11 @@ LockRes MGLock::lock(const std::string& target,
   }
 }
 
-std::list<MGLock*>::iterator MGLock::getLockIter() const {
-  return _resIter;
-}
-
 void MGLock::notify() {
   _cv.notify_one();
+  if (_granted) {
+    _granted();
+  }
 }
 
 bool MGLock::waitLock(uint64_t timeoutMs) {
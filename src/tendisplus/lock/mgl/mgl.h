@@ -3,9 +3,9 @@
 
 #include <atomic>
 #include <string>
-#include <list>
 #include <mutex>  // NOLINT
 #include <condition_variable>  // NOLINT
+#include <functional>
 
 #include "tendisplus/lock/mgl/lock_defines.h"
 #include "tendisplus/lock/mgl/mgl_mgr.h"
@@ -15,6 +15,7 @@ namespace tendisplus {
 namespace mgl {
 
 class LockSchedCtx;
+struct LockNode;
 
 // multi granularity lock
 // each lock can lock only one target, use multiple MGLocks
@@ -27,6 +28,10 @@ class MGLock {
     ~MGLock();
     LockRes lock(const std::string& target, LockMode mode,
                  uint64_t timeoutMs);
+    // don't wait, return LOCKRES_OK or LOCKRES_WAIT. If it waits, granted
+    // is called when the lock is granted, with the shard's mutex held.
+    LockRes lockAsync(const std::string& target, LockMode mode,
+                      std::function<void()> granted);
     void unlock();
     uint64_t getHash() const { return _targetHash; }
     LockMode getMode() const { return _mode; }
@@ -37,9 +42,13 @@ class MGLock {
 
  private:
     friend class LockSchedCtx;
-    void setLockResult(LockRes res, std::list<MGLock*>::iterator iter);
+    friend class MGLockMgr;
+    friend class MGLockList;
+    void setLockResult(LockRes res);
+    // granted by the fast path of MGLockMgr
+    void setFastLockResult(LockNode* node);
     void releaseLockResult();
-    std::list<MGLock*>::iterator getLockIter() const;
+    void enqueue(const std::string& target, LockMode mode);
     void notify();
     bool waitLock(uint64_t timeoutMs);
 
@@ -52,12 +61,19 @@ class MGLock {
     mutable std::mutex _mutex;
     std::condition_variable _cv;
     LockRes _res;
-    std::list<MGLock*>::iterator _resIter;
     MGLockMgr* _lockMgr;
     uint64_t _threadId;
 
+    // wrote by MGLockMgr under the shard's mutex
+    MGLock* _prev;
+    MGLock* _next;
+    LockNode* _node;
+    // counted in _node's word instead of queued in its ctx
+    bool _fast;
+    // set by lockAsync()
+    std::function<void()> _granted;
+
     static std::atomic<uint64_t> _idGen;
-    static std::list<MGLock*> _dummyList;
 };
 
 }  // namespace mgl
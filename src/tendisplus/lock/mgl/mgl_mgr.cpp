@@ -3,6 +3,9 @@
 // project for additional information.
 
 #include <utility>
+#include <sstream>
+#include <thread>  // NOLINT
+#include <vector>
 #include "tendisplus/utils/invariant.h"
 #include "tendisplus/lock/mgl/mgl_mgr.h"
 #include "tendisplus/lock/mgl/mgl.h"
@@ -12,6 +15,102 @@
 namespace tendisplus {
 namespace mgl {
 
+namespace {
+// LockNode::word: | SLOW | DEAD | 2 bits | S:20 | IX:20 | IS:20 |
+constexpr uint64_t FAST_BITS = 20;
+constexpr uint64_t FAST_MASK = (1ULL << FAST_BITS) - 1;
+// the locks of the node are queued in its ctx
+constexpr uint64_t NODE_SLOW = 1ULL << 63;
+// the node is unlinked from its shard
+constexpr uint64_t NODE_DEAD = 1ULL << 62;
+// the retired nodes of a shard are kept until no reader, but at most
+constexpr size_t MAX_RETIRED = 1024;
+// the cached free nodes of a thread
+constexpr size_t MAX_POOLED = 4096;
+
+// the shift of the mode's counter in LockNode::word, -1 if it can't be
+// counted
+int fastShift(LockMode mode) {
+  switch (mode) {
+    case LockMode::LOCK_IS:
+      return 0;
+    case LockMode::LOCK_IX:
+      return FAST_BITS;
+    case LockMode::LOCK_S:
+      return 2 * FAST_BITS;
+    default:
+      return -1;
+  }
+}
+
+uint16_t fastModes(uint64_t word) {
+  uint16_t modes = 0;
+  if (word & FAST_MASK) {
+    modes |= 1 << enum2Int(LockMode::LOCK_IS);
+  }
+  if ((word >> FAST_BITS) & FAST_MASK) {
+    modes |= 1 << enum2Int(LockMode::LOCK_IX);
+  }
+  if ((word >> (2 * FAST_BITS)) & FAST_MASK) {
+    modes |= 1 << enum2Int(LockMode::LOCK_S);
+  }
+  return modes;
+}
+
+// count the lock in the node's word, it fails if the node is slow or dead,
+// or the lock conflicts with the counted ones.
+bool casFastLock(LockNode* node, LockMode mode) {
+  int shift = fastShift(mode);
+  if (shift < 0) {
+    return false;
+  }
+  uint64_t w = node->word.load();
+  while (true) {
+    if ((w & (NODE_SLOW | NODE_DEAD)) || isConflict(fastModes(w), mode) ||
+        ((w >> shift) & FAST_MASK) == FAST_MASK) {
+      return false;
+    }
+    if (node->word.compare_exchange_weak(w, w + (1ULL << shift))) {
+      return true;
+    }
+  }
+}
+
+// the free nodes of the current thread, so that locking allocates nothing
+// in the steady state.
+class LockNodePool {
+ public:
+  ~LockNodePool() {
+    for (auto node : _nodes) {
+      delete node;
+    }
+  }
+
+  LockNode* get() {
+    if (_nodes.empty()) {
+      return new LockNode();
+    }
+    auto node = _nodes.back();
+    _nodes.pop_back();
+    return node;
+  }
+
+  void put(LockNode* node) {
+    INVARIANT_D(node->ctx.empty());
+    if (_nodes.size() >= MAX_POOLED) {
+      delete node;
+      return;
+    }
+    _nodes.push_back(node);
+  }
+
+ private:
+  std::vector<LockNode*> _nodes;
+};
+
+thread_local LockNodePool nodePool;
+}  // namespace
+
 const char* lockModeRepr(LockMode mode) {
   switch (mode) {
     case LockMode::LOCK_X:
@@ -43,34 +142,61 @@ bool isConflict(uint16_t modes, LockMode mode) {
   return (conflictTable[modeInt] & modes) != 0;
 }
 
+void MGLockList::pushBack(MGLock* core) {
+  core->_prev = _tail;
+  core->_next = nullptr;
+  if (_tail) {
+    _tail->_next = core;
+  } else {
+    _head = core;
+  }
+  _tail = core;
+  _size++;
+}
+
+void MGLockList::erase(MGLock* core) {
+  if (core->_prev) {
+    core->_prev->_next = core->_next;
+  } else {
+    _head = core->_next;
+  }
+  if (core->_next) {
+    core->_next->_prev = core->_prev;
+  } else {
+    _tail = core->_prev;
+  }
+  core->_prev = nullptr;
+  core->_next = nullptr;
+  _size--;
+}
+
 LockSchedCtx::LockSchedCtx()
   : _runningModes(0),
     _pendingModes(0),
-    _runningRefCnt(enum2Int(LockMode::LOCK_MODE_NUM), 0),
-    _pendingRefCnt(enum2Int(LockMode::LOCK_MODE_NUM), 0) {}
+    _runningRefCnt{0},
+    _pendingRefCnt{0} {}
 
 // NOTE(deyukong): if compitable locks come endlessly,
 // and we always schedule compitable locks first.
 // Then the _pendingList will have no chance to schedule.
-void LockSchedCtx::lock(MGLock* core) {
+void LockSchedCtx::lock(MGLock* core, uint16_t fastModes) {
   auto mode = core->getMode();
-  if (isConflict(_runningModes, mode) || _pendingList.size() >= 1) {
-    auto it = _pendingList.insert(_pendingList.end(), core);
+  if (isConflict(_runningModes | fastModes, mode) ||
+      _pendingList.size() >= 1) {
+    _pendingList.pushBack(core);
     incrPendingRef(mode);
-    core->setLockResult(LockRes::LOCKRES_WAIT, it);
+    core->setLockResult(LockRes::LOCKRES_WAIT);
   } else {
-    auto it = _runningList.insert(_runningList.end(), core);
+    _runningList.pushBack(core);
     incrRunningRef(mode);
-    core->setLockResult(LockRes::LOCKRES_OK, it);
+    core->setLockResult(LockRes::LOCKRES_OK);
   }
 }
 
-void LockSchedCtx::schedPendingLocks() {
-  std::list<MGLock*>::iterator it = _pendingList.begin();
-  while (it != _pendingList.end()) {
-    MGLock* tmpLock = *it;
-    if (isConflict(_runningModes, tmpLock->getMode())) {
-      it++;
+void LockSchedCtx::schedPendingLocks(uint16_t fastModes) {
+  while (!_pendingList.empty()) {
+    MGLock* tmpLock = _pendingList.front();
+    if (isConflict(_runningModes | fastModes, tmpLock->getMode())) {
       // NOTE(vinchen): Here, it should be break instead of continue.
       // Because of first come first lock/unlock, it can't release the
       // lock after the conflict pending lock. Otherwise, it would lead
@@ -79,35 +205,35 @@ void LockSchedCtx::schedPendingLocks() {
     }
     incrRunningRef(tmpLock->getMode());
     decPendingRef(tmpLock->getMode());
-    auto runningIt = _runningList.insert(_runningList.end(), tmpLock);
-    it = _pendingList.erase(it);
-    tmpLock->setLockResult(LockRes::LOCKRES_OK, runningIt);
+    _pendingList.erase(tmpLock);
+    _runningList.pushBack(tmpLock);
+    tmpLock->setLockResult(LockRes::LOCKRES_OK);
     tmpLock->notify();
   }
 }
 
-bool LockSchedCtx::unlock(MGLock* core) {
+bool LockSchedCtx::unlock(MGLock* core, uint16_t fastModes) {
   auto mode = core->getMode();
   if (core->getStatus() == LockRes::LOCKRES_OK) {
-    _runningList.erase(core->getLockIter());
+    _runningList.erase(core);
     decRunningRef(mode);
     core->releaseLockResult();
     if (_runningModes != 0) {
       return false;
     }
     INVARIANT_D(_runningList.size() == 0);
-    schedPendingLocks();
+    schedPendingLocks(fastModes);
   } else if (core->getStatus() == LockRes::LOCKRES_WAIT) {
-    _pendingList.erase(core->getLockIter());
+    _pendingList.erase(core);
     decPendingRef(mode);
     core->releaseLockResult();
     INVARIANT_D((_pendingModes == 0 && _pendingList.size() == 0) ||
                 (_pendingModes != 0 && _pendingList.size() != 0));
-    schedPendingLocks();
+    schedPendingLocks(fastModes);
   } else {
     INVARIANT_D(0);
   }
-  return _pendingList.empty() && _runningList.empty();
+  return empty();
 }
 
 void LockSchedCtx::incrPendingRef(LockMode mode) {
@@ -151,11 +277,11 @@ void LockSchedCtx::decRunningRef(LockMode mode) {
 std::string LockSchedCtx::toString() {
   std::stringstream ss;
 
-  for (auto i : _runningList) {
+  for (auto i = _runningList.front(); i; i = i->_next) {
     ss << "running: {" << i->toString() << "}\r\n";
   }
 
-  for (auto i : _pendingList) {
+  for (auto i = _pendingList.front(); i; i = i->_next) {
     ss << "pending: {" << i->toString() << "}\r\n";
   }
 
@@ -164,49 +290,158 @@ std::string LockSchedCtx::toString() {
 
 std::vector<std::string> LockSchedCtx::getShardLocks() {
   std::vector<std::string> tempLocks;
-  for (auto i : _runningList) {
+  for (auto i = _runningList.front(); i; i = i->_next) {
     tempLocks.push_back("running: {" + i->toString() + "}");
   }
 
-  for (auto i : _pendingList) {
+  for (auto i = _pendingList.front(); i; i = i->_next) {
     tempLocks.push_back("pending: {" + i->toString() + "}");
   }
   return tempLocks;
 }
 
+MGLockMgr::MGLockMgr(size_t shardNum)
+  : _shardNum(shardNum ? shardNum : DEFAULT_SHARD_NUM),
+    _shards(new LockShard[_shardNum]) {}
+
+MGLockMgr::~MGLockMgr() {
+  for (size_t i = 0; i < _shardNum; i++) {
+    LockShard& shard = _shards[i];
+    auto node = shard.head.load();
+    while (node) {
+      auto next = node->next.load();
+      delete node;
+      node = next;
+    }
+    for (auto n : shard.retired) {
+      delete n;
+    }
+  }
+}
+
 MGLockMgr& MGLockMgr::getInstance() {
   static MGLockMgr mgr;
   return mgr;
 }
 
+LockNode* MGLockMgr::findNode(const LockShard& shard,
+                              const MGLock* core) const {
+  auto node = shard.head.load();
+  while (node) {
+    if (node->hash == core->getHash() && node->target == core->getTarget()) {
+      return node;
+    }
+    node = node->next.load();
+  }
+  return nullptr;
+}
+
+// unlink the idle nodes of the shard, they are reused after no fast path
+// reads them.
+void MGLockMgr::sweepInLock(LockShard* shard) {
+  LockNode* prev = nullptr;
+  auto node = shard->head.load();
+  while (node) {
+    auto next = node->next.load();
+    uint64_t idle = 0;
+    if (node->ctx.empty() &&
+        node->word.compare_exchange_strong(idle, NODE_DEAD)) {
+      if (prev) {
+        prev->next.store(next);
+      } else {
+        shard->head.store(next);
+      }
+      shard->retired.push_back(node);
+    } else {
+      prev = node;
+    }
+    node = next;
+  }
+  if (shard->retired.empty()) {
+    return;
+  }
+  if (shard->retired.size() < MAX_RETIRED && shard->readers.load() != 0) {
+    return;
+  }
+  // the readers are on the fast path, they never wait for the mutex
+  while (shard->readers.load() != 0) {
+    std::this_thread::yield();
+  }
+  for (auto n : shard->retired) {
+    nodePool.put(n);
+  }
+  shard->retired.clear();
+}
+
+void MGLockMgr::clearSlowInLock(LockNode* node) {
+  if (node->ctx.empty()) {
+    node->word.fetch_and(~NODE_SLOW);
+  }
+}
+
 void MGLockMgr::lock(MGLock* core) {
-  uint64_t hash = core->getHash();
-  LockShard& shard = _shards[hash % SHARD_NUM];
+  LockShard& shard = getShard(core->getHash());
+  // fast path, the node can't be reused during shard.readers > 0
+  shard.readers++;
+  auto node = findNode(shard, core);
+  bool fast = node && casFastLock(node, core->getMode());
+  shard.readers--;
+  if (fast) {
+    core->setFastLockResult(node);
+    return;
+  }
+
   std::lock_guard<std::mutex> lk(shard.mutex);
-  auto iter = shard.map.find(core->getTarget());
-  if (iter == shard.map.end()) {
-    LockSchedCtx tmp;
-    auto insertResult = shard.map.emplace(core->getTarget(), std::move(tmp));
-    iter = insertResult.first;
+  node = findNode(shard, core);
+  if (node == nullptr) {
+    sweepInLock(&shard);
+    node = nodePool.get();
+    node->word.store(0);
+    node->hash = core->getHash();
+    node->target = core->getTarget();
+    node->next.store(shard.head.load());
+    shard.head.store(node);
+  }
+  if (casFastLock(node, core->getMode())) {
+    core->setFastLockResult(node);
+    return;
   }
-  iter->second.lock(core);
+  // the node is slow from now on, the fast locks counted in word still
+  // block the conflicting locks in ctx.
+  uint64_t w = node->word.fetch_or(NODE_SLOW);
+  core->_node = node;
+  node->ctx.lock(core, fastModes(w));
   return;
 }
 
 void MGLockMgr::unlock(MGLock* core) {
-  uint64_t hash = core->getHash();
-  LockShard& shard = _shards[hash % SHARD_NUM];
-  std::lock_guard<std::mutex> lk(shard.mutex);
+  LockShard& shard = getShard(core->getHash());
+  LockNode* node = core->_node;
+  INVARIANT_D(node != nullptr);
 
+  if (core->_fast) {
+    uint64_t inc = 1ULL << fastShift(core->getMode());
+    uint64_t w = node->word.load();
+    while (!(w & NODE_SLOW)) {
+      if (node->word.compare_exchange_weak(w, w - inc)) {
+        core->releaseLockResult();
+        return;
+      }
+    }
+    // the pending locks in ctx may be waiting for this one
+    std::lock_guard<std::mutex> lk(shard.mutex);
+    w = node->word.fetch_sub(inc) - inc;
+    core->releaseLockResult();
+    node->ctx.schedPendingLocks(fastModes(w));
+    clearSlowInLock(node);
+    return;
+  }
+
+  std::lock_guard<std::mutex> lk(shard.mutex);
   INVARIANT_D(core->getStatus() == LockRes::LOCKRES_WAIT ||
               core->getStatus() == LockRes::LOCKRES_OK);
-
-  auto iter = shard.map.find(core->getTarget());
-  INVARIANT(iter != shard.map.end());
-  bool empty = iter->second.unlock(core);
-  if (empty) {
-    shard.map.erase(iter);
-  }
+  node->ctx.unlock(core, fastModes(node->word.load()));
+  clearSlowInLock(node);
   return;
 }
 
@@ -221,11 +456,21 @@ std::string MGLockMgr::toString() {
 
 std::vector<std::string> MGLockMgr::getLockList() {
   std::vector<std::string> list;
-  for (uint32_t i = 0; i < SHARD_NUM; i++) {
+  for (uint32_t i = 0; i < _shardNum; i++) {
     LockShard& shard = _shards[i];
     std::lock_guard<std::mutex> lk(shard.mutex);
-    for (auto& iter : shard.map) {
-      auto locklist = iter.second.getShardLocks();
+    for (auto node = shard.head.load(); node; node = node->next.load()) {
+      uint64_t w = node->word.load();
+      if (w & (FAST_MASK | FAST_MASK << FAST_BITS |
+               FAST_MASK << (2 * FAST_BITS))) {
+        std::stringstream ss;
+        ss << "fast: {target:" << node->target
+           << " IS:" << (w & FAST_MASK)
+           << " IX:" << ((w >> FAST_BITS) & FAST_MASK)
+           << " S:" << ((w >> (2 * FAST_BITS)) & FAST_MASK) << "}";
+        list.push_back(ss.str());
+      }
+      auto locklist = node->ctx.getShardLocks();
       for (auto& v : locklist) {
         list.push_back(v);
       }
@@ -5,12 +5,11 @@
 #ifndef SRC_TENDISPLUS_LOCK_MGL_MGL_MGR_H__
 #define SRC_TENDISPLUS_LOCK_MGL_MGL_MGR_H__
 
+#include <atomic>
+#include <memory>
 #include <vector>
-#include <list>
-#include <unordered_map>
 #include <mutex>  // NOLINT
 #include <string>
-#include <set>
 
 #include "tendisplus/lock/mgl/lock_defines.h"
 
@@ -19,28 +18,54 @@ namespace mgl {
 
 class MGLock;
 
+// an intrusive list of MGLocks, linked by MGLock::_prev/_next.
+// not thread safe, protected by LockShard's mutex
+class MGLockList {
+ public:
+  MGLockList() : _head(nullptr), _tail(nullptr), _size(0) {}
+  void pushBack(MGLock* core);
+  void erase(MGLock* core);
+  MGLock* front() const {
+    return _head;
+  }
+  bool empty() const {
+    return _size == 0;
+  }
+  size_t size() const {
+    return _size;
+  }
+
+ private:
+  MGLock* _head;
+  MGLock* _tail;
+  size_t _size;
+};
+
 // TODO(deyukong): this class should only be in mgl_mgr.cpp
 // not thread safe, protected by LockShard's mutex
+// fastModes are the modes held by the fast path, see LockNode
 class LockSchedCtx {
  public:
   LockSchedCtx();
-  LockSchedCtx(LockSchedCtx&&) = default;
-  void lock(MGLock* core);
-  bool unlock(MGLock* core);
+  void lock(MGLock* core, uint16_t fastModes);
+  bool unlock(MGLock* core, uint16_t fastModes);
+  void schedPendingLocks(uint16_t fastModes);
+  bool empty() const {
+    return _runningList.empty() && _pendingList.empty();
+  }
   std::string toString();
   std::vector<std::string> getShardLocks();
  private:
-  void schedPendingLocks();
   void incrPendingRef(LockMode mode);
   void incrRunningRef(LockMode mode);
   void decPendingRef(LockMode mode);
   void decRunningRef(LockMode mode);
   uint16_t _runningModes;
   uint16_t _pendingModes;
-  std::vector<uint16_t> _runningRefCnt;
-  std::vector<uint16_t> _pendingRefCnt;
-  std::list<MGLock*> _runningList;
-  std::list<MGLock*> _pendingList;
+  uint16_t _runningRefCnt[enum2Int(LockMode::LOCK_MODE_NUM)];
+  uint16_t _pendingRefCnt[enum2Int(LockMode::LOCK_MODE_NUM)];
+  MGLockList _runningList;
+  MGLockList _pendingList;
 };
 
 /* First come first lock
@@ -55,12 +80,35 @@ class LockSchedCtx {
 
   For same session: LOCK(IX), LOCK(X), it would lead to deadlock
 */
+
+// The lock of one target.
+// The IS/IX/S locks are counted in word by CAS without any mutex, as long
+// as they don't conflict with each other. Once a lock conflicts or is X,
+// the node turns slow, all the locks of the target are queued in ctx under
+// the shard's mutex, until ctx is empty again.
+struct LockNode {
+  LockNode() : word(0), next(nullptr), hash(0) {}
+  // IS/IX/S counters of the fast path, and the SLOW/DEAD flags
+  std::atomic<uint64_t> word;
+  std::atomic<LockNode*> next;
+  uint64_t hash;
+  std::string target;
+  LockSchedCtx ctx;
+};
+
 // class alignas(std::hardware_destructive_interference_size) LockShard {
 // hardware_destructive_interference_size requires quite high version
 // gcc. 128 should work for most cases
 struct alignas(128) LockShard {
+  LockShard() : head(nullptr), readers(0) {}
+  // guards the node linking/unlinking and the ctx of the nodes
   std::mutex mutex;
-  std::unordered_map<std::string, LockSchedCtx> map;
+  // the nodes of the shard, the fast path reads them without mutex
+  std::atomic<LockNode*> head;
+  // number of the fast path reading the nodes
+  std::atomic<uint32_t> readers;
+  // the unlinked nodes, they're reused after no reader
+  std::vector<LockNode*> retired;
 };
 
 // TODO(vinchen): now there is a warning here, because the MGLockMgr change from
@@ -68,7 +116,10 @@ struct alignas(128) LockShard {
 // warning C4316: tendisplus::mgl::MGLockMgr
 class MGLockMgr {
  public:
-  MGLockMgr() = default;
+  static constexpr size_t DEFAULT_SHARD_NUM = 1024;
+
+  explicit MGLockMgr(size_t shardNum = DEFAULT_SHARD_NUM);
+  ~MGLockMgr();
   void lock(MGLock* core);
   void unlock(MGLock* core);
   static MGLockMgr& getInstance();
@@ -76,8 +127,15 @@ class MGLockMgr {
   std::vector<std::string> getLockList();
 
  private:
-  static constexpr size_t SHARD_NUM = 32;
-  LockShard _shards[SHARD_NUM];
+  LockShard& getShard(uint64_t hash) {
+    return _shards[hash % _shardNum];
+  }
+  LockNode* findNode(const LockShard& shard, const MGLock* core) const;
+  void sweepInLock(LockShard* shard);
+  void clearSlowInLock(LockNode* node);
+
+  const size_t _shardNum;
+  std::unique_ptr<LockShard[]> _shards;
 };
 
 }  // namespace mgl
@@ -2,6 +2,9 @@
 #include <string>
 #include <algorithm>
 #include <thread>  // NOLINT
+#include <vector>
+#include <atomic>
+#include <chrono>  // NOLINT
 
 #include "gtest/gtest.h"
 
@@ -106,5 +109,110 @@ TEST(MGL, Starvation) {
     l3.unlock();
 }
 
+TEST(MGL, FastPath) {
+    MGLockMgr mgr(16);
+    MGLock l1(&mgr), l2(&mgr), l3(&mgr), l4(&mgr);
+    EXPECT_EQ(l1.lock("something", LockMode::LOCK_IS, 1000),
+                      LockRes::LOCKRES_OK);
+    EXPECT_EQ(l2.lock("something", LockMode::LOCK_IX, 1000),
+                      LockRes::LOCKRES_OK);
+    auto list = mgr.getLockList();
+    EXPECT_EQ(list.size(), 1U);
+    EXPECT_NE(list[0].find("IS:1 IX:1 S:0"), std::string::npos);
+
+    // X waits for the fast holders, and the later locks queue behind it
+    std::thread tmp([&l3]() {
+        EXPECT_EQ(l3.lock("something", LockMode::LOCK_X, 10000),
+                          LockRes::LOCKRES_OK);
+    });
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    EXPECT_EQ(l4.lock("something", LockMode::LOCK_IS, 100),
+                      LockRes::LOCKRES_TIMEOUT);
+    l1.unlock();
+    l2.unlock();
+    tmp.join();
+    l3.unlock();
+    EXPECT_EQ(l4.getStatus(), LockRes::LOCKRES_OK);
+    l4.unlock();
+
+    // the node turns fast again once it's drained
+    EXPECT_EQ(l1.lock("something", LockMode::LOCK_S, 1000),
+                      LockRes::LOCKRES_OK);
+    list = mgr.getLockList();
+    EXPECT_EQ(list.size(), 1U);
+    EXPECT_NE(list[0].find("S:1"), std::string::npos);
+    l1.unlock();
+    EXPECT_EQ(mgr.getLockList().size(), 0U);
+}
+
+TEST(MGL, LockAsync) {
+    MGLockMgr mgr;
+    MGLock l1(&mgr), l2(&mgr), l3(&mgr);
+    std::atomic<int> granted(0);
+    EXPECT_EQ(l1.lockAsync("something", LockMode::LOCK_X,
+                           [&granted]() { granted++; }),
+              LockRes::LOCKRES_OK);
+    EXPECT_EQ(l2.lockAsync("something", LockMode::LOCK_S,
+                           [&granted]() { granted++; }),
+              LockRes::LOCKRES_WAIT);
+    EXPECT_EQ(l3.lockAsync("something", LockMode::LOCK_S,
+                           [&granted]() { granted++; }),
+              LockRes::LOCKRES_WAIT);
+    EXPECT_EQ(granted.load(), 0);
+
+    // a waiting lock could be given up
+    l3.unlock();
+    l1.unlock();
+    EXPECT_EQ(granted.load(), 1);
+    EXPECT_EQ(l2.getStatus(), LockRes::LOCKRES_OK);
+    l2.unlock();
+    EXPECT_EQ(mgr.getLockList().size(), 0U);
+}
+
+TEST(MGL, ContentionBench) {
+    // the intent locks on the shared targets are what every command takes,
+    // and the key locks rarely conflict.
+    MGLockMgr mgr;
+    const uint32_t threadNum = 16;
+    const uint32_t opNum = 100000;
+    std::atomic<uint64_t> timeouts(0);
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < threadNum; i++) {
+        threads.emplace_back([&mgr, &timeouts, i, opNum]() {
+            for (uint32_t j = 0; j < opNum; j++) {
+                bool write = j % 4 == 0;
+                MGLock stores(&mgr), store(&mgr), chunk(&mgr), key(&mgr);
+                stores.lock("stores", LockMode::LOCK_IS, 10000);
+                store.lock("store_" + std::to_string(j % 10),
+                    write ? LockMode::LOCK_IX : LockMode::LOCK_IS, 10000);
+                chunk.lock("chunk_" + std::to_string(j % 100),
+                    write ? LockMode::LOCK_IX : LockMode::LOCK_IS, 10000);
+                auto res = key.lock(
+                    "key_" + std::to_string((i * opNum + j) % 1000),
+                    write ? LockMode::LOCK_X : LockMode::LOCK_S, 10000);
+                if (res != LockRes::LOCKRES_OK) {
+                    timeouts++;
+                }
+                key.unlock();
+                chunk.unlock();
+                store.unlock();
+                stores.unlock();
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    EXPECT_EQ(timeouts.load(), 0U);
+    EXPECT_EQ(mgr.getLockList().size(), 0U);
+    std::cout << "threads:" << threadNum << " ops:" << threadNum * opNum
+              << " cost:" << us << "us ops/s:"
+              << threadNum * opNum * 1000000ULL / (us ? us : 1)
+              << std::endl;
+}
+
 }  // namespace mgl
 }  // namespace tendisplus
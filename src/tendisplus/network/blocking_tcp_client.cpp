@@ -4,6 +4,17 @@
 
 #include "tendisplus/network/blocking_tcp_client.h"
 
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+#ifndef _WIN32
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
+#include <errno.h>
+#include <string.h>
+
 #include <sstream>
 #include <iostream>
 #include <utility>
@@ -293,6 +304,76 @@ Status BlockingTcpClient::writeOneBatch(const char* data,
   }
 }
 
+Status BlockingTcpClient::waitWritable(std::chrono::seconds timeout) {
+  _notified = false;
+  auto self(shared_from_this());
+  _socket.async_wait(asio::ip::tcp::socket::wait_write,
+                     [this, self](const asio::error_code& oec) {
+                       std::unique_lock<std::mutex> lk(_mutex);
+                       _ec = oec;
+                       _notified = true;
+                       _cv.notify_one();
+                     });
+
+  std::unique_lock<std::mutex> lk(_mutex);
+  if (_cv.wait_for(lk, timeout, [this] { return _notified; })) {
+    if (_ec) {
+      closeSocket();
+      return {ErrorCodes::ERR_NETWORK, _ec.message()};
+    }
+    return {ErrorCodes::ERR_OK, ""};
+  } else {
+    closeSocket();
+    return {ErrorCodes::ERR_TIMEOUT, "writeFile timeout"};
+  }
+}
+
+Status BlockingTcpClient::writeFile(int fd,
+                                    uint64_t offset,
+                                    uint64_t size,
+                                    std::chrono::seconds timeout) {
+  while (size > 0) {
+    uint32_t sendSize = std::min<uint64_t>(size, _netBatchSize);
+#ifdef __linux__
+    off_t off = offset;
+    ssize_t n = ::sendfile(_socket.native_handle(), fd, &off, sendSize);
+    if (n < 0 && errno == EAGAIN) {
+      auto s = waitWritable(timeout);
+      if (!s.ok()) {
+        return s;
+      }
+      continue;
+    } else if (n < 0 && errno == EINTR) {
+      continue;
+    } else if (n <= 0) {
+      std::string err = n < 0 ? strerror(errno) : "unexpected end of file";
+      closeSocket();
+      return {ErrorCodes::ERR_NETWORK, "sendfile failed:" + err};
+    }
+#else
+    std::string buf(sendSize, '\0');
+    if (::lseek(fd, offset, SEEK_SET) < 0) {
+      return {ErrorCodes::ERR_INTERNAL, strerror(errno)};
+    }
+    auto n = ::read(fd, &buf[0], sendSize);
+    if (n <= 0) {
+      return {ErrorCodes::ERR_INTERNAL,
+              n < 0 ? strerror(errno) : "unexpected end of file"};
+    }
+    auto s = writeOneBatch(buf.c_str(), n, timeout);
+    if (!s.ok()) {
+      return s;
+    }
+#endif
+    offset += n;
+    size -= n;
+    if (_rateLimiter) {
+      _rateLimiter->Request(n);
+    }
+  }
+  return {ErrorCodes::ERR_OK, ""};
+}
+
 Status BlockingTcpClient::writeLine(const std::string& line) {
   std::string line1 = line;
   line1.append("\r\n");
@@ -42,6 +42,12 @@ class BlockingTcpClient
                        uint32_t size,
                        std::chrono::seconds timeout);
   Status writeData(const std::string& data);
+  // send [offset, offset + size) of the file fd, by sendfile() if possible,
+  // the data is not copied through the user space.
+  Status writeFile(int fd,
+                   uint64_t offset,
+                   uint64_t size,
+                   std::chrono::seconds timeout);
 
   std::string getRemoteRepr() const {
     try {
@@ -89,6 +95,7 @@ class BlockingTcpClient
 
  private:
   void closeSocket();
+  Status waitWritable(std::chrono::seconds timeout);
   std::mutex _mutex;
   std::condition_variable _cv;
   bool _inited;
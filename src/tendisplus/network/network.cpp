@@ -14,6 +14,7 @@
 #include "tendisplus/utils/test_util.h"
 #include "tendisplus/storage/varint.h"
 #include "tendisplus/server/server_entry.h"
+#include "tendisplus/commands/command.h"
 
 namespace tendisplus {
 
@@ -76,7 +77,9 @@ std::string NetworkMatrix::toString() const {
   std::stringstream ss;
   ss << "\nstickyPackets\t" << stickyPackets << "\nconnCreated\t" << connCreated
      << "\nconnReleased\t" << connReleased << "\ninvalidPackets\t"
-     << invalidPackets;
+     << invalidPackets << "\npipelineBatches\t" << pipelineBatches
+     << "\npipelineBatchedCmds\t" << pipelineBatchedCmds << "\nwritesSaved\t"
+     << writesSaved;
   return ss.str();
 }
 
@@ -85,6 +88,9 @@ void NetworkMatrix::reset() {
   connCreated = 0;
   connReleased = 0;
   invalidPackets = 0;
+  pipelineBatches = 0;
+  pipelineBatchedCmds = 0;
+  writesSaved = 0;
 }
 
 NetworkMatrix NetworkMatrix::operator-(const NetworkMatrix& right) {
@@ -93,6 +99,9 @@ NetworkMatrix NetworkMatrix::operator-(const NetworkMatrix& right) {
   result.connCreated = connCreated - right.connCreated;
   result.connReleased = connReleased - right.connReleased;
   result.invalidPackets = invalidPackets - right.invalidPackets;
+  result.pipelineBatches = pipelineBatches - right.pipelineBatches;
+  result.pipelineBatchedCmds = pipelineBatchedCmds - right.pipelineBatchedCmds;
+  result.writesSaved = writesSaved - right.writesSaved;
   return result;
 }
 
@@ -358,13 +367,17 @@ NetSession::NetSession(std::shared_ptr<ServerEntry> server,
     _closeAfterRsp(false),
     _state(State::Created),
     _sock(std::move(sock)),
-    _queryBuf(std::vector<char>()),
+    _queryBuf(),
     _queryBufPos(0),
     _reqType(RedisReqMode::REDIS_REQ_UNKNOWN),
     _multibulklen(0),
     _bulkLen(-1),
     _isSendRunning(false),
     _isEnded(false),
+    _coalesceRsp(false),
+    _parked(false),
+    _waitingClose(false),
+    _pendingRspBytes(0),
     _netMatrix(netMatrix),
     _reqMatrix(reqMatrix) {
   if (initSock) {
@@ -481,25 +494,54 @@ asio::ip::tcp::socket NetSession::borrowConn() {
 }
 
 Status NetSession::setResponse(const std::string& s) {
+  ReplyBuffer reply;
+  reply.append(s);
+  return setResponse(std::move(reply));
+}
+
+Status NetSession::setResponse(ReplyBuffer&& reply) {
   std::lock_guard<std::mutex> lk(_mutex);
   if (_isEnded) {
     _closeAfterRsp = true;
     return {ErrorCodes::ERR_NETWORK, "connection is ended"};
   }
 
+  _pendingRspBytes += reply.size();
+  // a reply waiting to be sent is merged into the last waiting one, so
+  // the small replies of a pipeline share their chunks
+  std::shared_ptr<SendBuffer> last;
+  if (_coalesceRsp && !_coalescedRsp.empty()) {
+    last = _coalescedRsp.back();
+  } else if (!_coalesceRsp && _isSendRunning && !_sendBuffer.empty()) {
+    last = _sendBuffer.back();
+  }
+  if (last && !last->closeAfterThis) {
+    last->buffer.append(std::move(reply));
+    last->closeAfterThis = _closeAfterRsp;
+    last->replies++;
+    return {ErrorCodes::ERR_OK, ""};
+  }
+
   auto v = std::make_shared<SendBuffer>();
-  std::copy(s.begin(), s.end(), std::back_inserter(v->buffer));
+  v->buffer = std::move(reply);
   v->closeAfterThis = _closeAfterRsp;
-  if (_isSendRunning) {
+  if (_coalesceRsp) {
+    _coalescedRsp.emplace_back(std::move(v));
+  } else if (_isSendRunning) {
     _sendBuffer.push_back(v);
   } else {
     _isSendRunning = true;
-    drainRsp(v);
+    drainRsp({v});
   }
 
   return {ErrorCodes::ERR_OK, ""};
 }
 
+uint64_t NetSession::getPendingRspBytes() const {
+  std::lock_guard<std::mutex> lk(_mutex);
+  return _pendingRspBytes;
+}
+
 void NetSession::start() {
   stepState();
 }
@@ -552,7 +594,6 @@ void NetSession::processInlineBuffer() {
       return;
     }
     setState(State::DrainReqNet);
-    schedule();
     return;
   }
 
@@ -585,7 +626,6 @@ void NetSession::processInlineBuffer() {
   }
 
   setState(State::Process);
-  schedule();
 }
 
 // NOTE(deyukong): mainly port from redis::networking.c,
@@ -607,14 +647,12 @@ void NetSession::processMultibulkBuffer() {
       }
       // not complete line
       setState(State::DrainReqNet);
-      schedule();
       return;
     }
     /* Buffer should also contain \n */
     if (newLine - _queryBuf.data() > _queryBufPos - 2) {
       // not complete line
       setState(State::DrainReqNet);
-      schedule();
       return;
     }
 
@@ -639,7 +677,6 @@ void NetSession::processMultibulkBuffer() {
 
       INVARIANT(_args.size() == 0);
       setState(State::Process);
-      schedule();
       return;
     }
     _multibulklen = ll;
@@ -691,8 +728,6 @@ void NetSession::processMultibulkBuffer() {
         return;
       }
       pos += newLine - (_queryBuf.data() + pos) + 2;
-      // the optimization of ll >= REDIS_MBULK_BIG_ARG
-      // is not ported from redis
       if (ll >= REDIS_MBULK_BIG_ARG) {
         /* If we are going to read a large object from network
          * try to make it likely that it will start at c->querybuf
@@ -700,15 +735,31 @@ void NetSession::processMultibulkBuffer() {
          * avoiding a large copy of data. */
         shiftQueryBuf(pos, -1);
         pos = 0;
+        /* Hint the buffer to be exactly as large as the bulk (plus the
+         * trailing \r\n and the terminating 0), drainReqNet() never
+         * reads beyond it. */
+        if (static_cast<int64_t>(_queryBuf.size()) < ll + 3) {
+          _queryBuf.resize(ll + 3, 0);
+        }
       }
       _bulkLen = ll;
     }
     if (_queryBufPos - pos < _bulkLen + 2) {
       // not complete
       break;
+    } else if (pos == 0 && _bulkLen >= REDIS_MBULK_BIG_ARG &&
+               _queryBufPos == _bulkLen + 2) {
+      /* Optimization: if the buffer contains JUST our bulk element
+       * instead of creating a new object by *copying* the buffer we
+       * hand off the buffer itself as the argument. */
+      _queryBuf.resize(_bulkLen);
+      _args.emplace_back(std::move(_queryBuf));
+      _queryBuf = std::string();
+      _queryBufPos = 0;
+      _bulkLen = -1;
+      _multibulklen -= 1;
     } else {
-      // TODO(vinchen): There is a optimization is not ported from redis
-      _args.push_back(std::string(_queryBuf.data() + pos, _bulkLen));
+      _args.emplace_back(_queryBuf.data() + pos, _bulkLen);
       pos += _bulkLen + 2;
       _bulkLen = -1;
       _multibulklen -= 1;
@@ -722,7 +773,23 @@ void NetSession::processMultibulkBuffer() {
   } else {
     setState(State::DrainReqNet);
   }
-  schedule();
+}
+
+void NetSession::processQueryBuf() {
+  if (_reqType == RedisReqMode::REDIS_REQ_UNKNOWN) {
+    if (_queryBuf[0] == '*') {
+      _reqType = RedisReqMode::REDIS_REQ_MULTIBULK;
+    } else {
+      _reqType = RedisReqMode::REDIS_REQ_INLINE;
+    }
+  }
+  if (_reqType == RedisReqMode::REDIS_REQ_MULTIBULK) {
+    processMultibulkBuffer();
+  } else if (_reqType == RedisReqMode::REDIS_REQ_INLINE) {
+    processInlineBuffer();
+  } else {
+    LOG(FATAL) << "unknown request type";
+  }
 }
 
 void NetSession::drainReqCallback(const std::error_code& ec, size_t actualLen) {
@@ -761,19 +828,11 @@ void NetSession::drainReqCallback(const std::error_code& ec, size_t actualLen) {
     setRspAndClose("Closing client that reached max query buffer length");
     return;
   }
-  if (_reqType == RedisReqMode::REDIS_REQ_UNKNOWN) {
-    if (_queryBuf[0] == '*') {
-      _reqType = RedisReqMode::REDIS_REQ_MULTIBULK;
-    } else {
-      _reqType = RedisReqMode::REDIS_REQ_INLINE;
-    }
-  }
-  if (_reqType == RedisReqMode::REDIS_REQ_MULTIBULK) {
-    processMultibulkBuffer();
-  } else if (_reqType == RedisReqMode::REDIS_REQ_INLINE) {
-    processInlineBuffer();
-  } else {
-    LOG(FATAL) << "unknown request type";
+  processQueryBuf();
+  // on protocol error, the error reply is sent and the session is closed
+  // by drainRspCallback, no need to schedule anymore.
+  if (!_closeAfterRsp) {
+    schedule();
   }
 }
 
@@ -829,6 +888,15 @@ void NetSession::drainReqBuf() {
 void NetSession::drainReqNet() {
   // we may do a sync-read to reduce async-callbacks
   size_t wantLen = REDIS_IOBUF_LEN;
+  // a big bulk has its room reserved in processMultibulkBuffer(), read
+  // exactly the rest of it so the buffer can be handed off to _args.
+  if (_reqType == RedisReqMode::REDIS_REQ_MULTIBULK && _multibulklen &&
+      _bulkLen >= REDIS_MBULK_BIG_ARG) {
+    ssize_t remaining = _bulkLen + 2 - _queryBufPos;
+    if (remaining > 0) {
+      wantLen = remaining;
+    }
+  }
   // here we use >= than >, so the last element will always be 0,
   // it's convinent for c-style string search
   if (wantLen + _queryBufPos >= _queryBuf.size()) {
@@ -850,25 +918,75 @@ void NetSession::drainReqNet() {
     });
 }
 
+// NOTE: pipelined requests already in _queryBuf are executed back-to-back
+// in the same schedule round, at most netPipelineBatchMax of them, so a
+// long pipeline can not starve other sessions. Their replies are coalesced
+// and written out by one gather write.
 void NetSession::processReq() {
-  bool continueSched = true;
-  if (_args.size()) {
-    _ctx->setProcessPacketStart(nsSinceEpoch());
-    continueSched = _server->processRequest(reinterpret_cast<Session*>(this));
-    _reqMatrix->processed += 1;
-    _reqMatrix->processCost += nsSinceEpoch() - _ctx->getProcessPacketStart();
-    _ctx->setProcessPacketStart(0);
+  uint32_t batchMax = 1;
+  if (getServerEntry()) {
+    batchMax = std::max(getServerEntry()->getParams()->netPipelineBatchMax, 1U);
   }
-  if (!continueSched) {
-    endSession();
-  } else if (!_closeAfterRsp) {
+  if (batchMax > 1) {
+    beginCoalesceRsp();
+  }
+
+  bool continueSched = true;
+  bool blocked = false;
+  uint32_t batched = 0;
+  while (true) {
+    if (_args.size()) {
+      // the commands borrowing the socket must be the first one in a
+      // batch, or the coalesced replies would be written after them.
+      if (batched > 0 && Command::getCommand(this) &&
+          Command::getCommand(this)->isBgCmd()) {
+        break;
+      }
+      _ctx->setProcessPacketStart(nsSinceEpoch());
+      continueSched = _server->processRequest(reinterpret_cast<Session*>(this));
+      _reqMatrix->processed += 1;
+      _reqMatrix->processCost += nsSinceEpoch() - _ctx->getProcessPacketStart();
+      _ctx->setProcessPacketStart(0);
+      ++batched;
+      // _args and the Process state are kept for running it again
+      if (_ctx->isBlocked()) {
+        blocked = true;
+        break;
+      }
+    }
+    if (!continueSched || _closeAfterRsp) {
+      break;
+    }
     resetMultiBulkCtx();
     if (_queryBufPos == 0) {
       setState(State::DrainReqNet);
-    } else {
+      break;
+    }
+    ++_netMatrix->stickyPackets;
+    if (batched >= batchMax) {
       setState(State::DrainReqBuf);
-      ++_netMatrix->stickyPackets;
+      break;
+    }
+    processQueryBuf();
+    if (_closeAfterRsp ||
+        _state.load(std::memory_order_relaxed) != State::Process) {
+      break;
     }
+  }
+
+  if (batched > 1) {
+    ++_netMatrix->pipelineBatches;
+    _netMatrix->pipelineBatchedCmds += batched;
+  }
+  if (batchMax > 1) {
+    endCoalesceRsp();
+  }
+
+  if (!continueSched) {
+    endSession();
+  } else if (blocked) {
+    park();
+  } else if (!_closeAfterRsp) {
     schedule();
   } else {
     // closeAfterRsp, donot process more requests
@@ -876,30 +994,157 @@ void NetSession::processReq() {
   }
 }
 
-void NetSession::drainRsp(std::shared_ptr<SendBuffer> buf) {
+// NOTE: a parked session holds no executor thread, and no read is
+// pending. A session parked by a blocking command holds no lock either.
+// One waiting for a key lock keeps the pending KeyLock in its SessionCtx,
+// which holds the intent lock of the chunk and is queued for the key,
+// see ServerEntry::processRequest(). The socket is only watched for the
+// client closing. The requests pipelined after the blocking one are read into
+// the query buffer meanwhile, so that a close after them is still seen.
+// They are run after it's resumed.
+void NetSession::park() {
+  _ctx->setBlocked(false);
+  auto self(shared_from_this());
+  auto blockingMgr = _server->getBlockingMgr();
+  {
+    std::lock_guard<std::mutex> lk(_mutex);
+    _parked = true;
+  }
+  bool parked = blockingMgr->park(id(), [this, self]() {
+    {
+      std::lock_guard<std::mutex> lk(_mutex);
+      _parked = false;
+    }
+    schedule();
+  });
+  if (!parked) {
+    // signaled before being parked
+    {
+      std::lock_guard<std::mutex> lk(_mutex);
+      _parked = false;
+    }
+    schedule();
+    return;
+  }
+  waitClose();
+}
+
+void NetSession::waitClose() {
+  if (_waitingClose.exchange(true)) {
+    return;
+  }
+  auto self(shared_from_this());
+  _sock.async_wait(
+    tcp::socket::wait_read, [this, self](const std::error_code& ec) {
+      _waitingClose = false;
+      if (!ec) {
+        std::unique_lock<std::mutex> lk(_mutex);
+        if (!_parked) {
+          // resumed, the pending read would see the close
+          return;
+        }
+        std::error_code ec2;
+        size_t avail = _sock.available(ec2);
+        size_t n = 0;
+        bool rearm = false;
+        if (!ec2 && avail > 0) {
+          if (static_cast<size_t>(_queryBufPos) + avail >= _queryBuf.size()) {
+            _queryBuf.resize((_queryBufPos + avail) * 2, 0);
+          }
+          n = _sock.read_some(
+            asio::buffer(&_queryBuf[_queryBufPos], avail), ec2);
+        }
+        if (!ec2 && n > 0) {
+          _queryBufPos += n;
+          _queryBuf[_queryBufPos] = 0;
+          if (_server) {
+            _server->getServerStat().netInputBytes += n;
+          }
+          rearm = _queryBufPos <= REDIS_MAX_QUERYBUF_LEN;
+        }
+        lk.unlock();
+        if (rearm) {
+          // wait again for the requests after, or the close
+          waitClose();
+          return;
+        }
+      }
+      // closed, canceled or too many requests pipelined, it's ended here
+      // only if still parked, or the pending read would see it after
+      // resumed.
+      if (_server->getBlockingMgr()->removeWaiter(id())) {
+        endSession();
+      }
+    });
+}
+
+void NetSession::beginCoalesceRsp() {
+  std::lock_guard<std::mutex> lk(_mutex);
+  INVARIANT_D(_coalescedRsp.empty());
+  _coalesceRsp = true;
+}
+
+void NetSession::endCoalesceRsp() {
+  std::lock_guard<std::mutex> lk(_mutex);
+  _coalesceRsp = false;
+  if (_coalescedRsp.empty()) {
+    return;
+  }
+  std::vector<std::shared_ptr<SendBuffer>> bufs;
+  bufs.swap(_coalescedRsp);
+  if (_isEnded) {
+    return;
+  }
+  if (_isSendRunning) {
+    for (auto& v : bufs) {
+      _sendBuffer.push_back(v);
+    }
+  } else {
+    _isSendRunning = true;
+    drainRsp(std::move(bufs));
+  }
+}
+
+void NetSession::drainRsp(std::vector<std::shared_ptr<SendBuffer>> bufs) {
+  INVARIANT_D(!bufs.empty());
   auto self(shared_from_this());
   uint64_t now = nsSinceEpoch();
+  std::vector<asio::const_buffer> iov;
+  size_t replies = 0;
+  for (const auto& buf : bufs) {
+    buf->buffer.appendIoVec(&iov);
+    replies += buf->replies;
+  }
+  _netMatrix->writesSaved += replies - 1;
   asio::async_write(
     _sock,
-    asio::buffer(buf->buffer.data(), buf->buffer.size()),  // NOLINT
-    [this, self, buf, now](const std::error_code& ec, size_t actualLen) {
+    iov,
+    [this, self, bufs = std::move(bufs), now](const std::error_code& ec,
+                                              size_t actualLen) {
       _reqMatrix->sendPacketCost += nsSinceEpoch() - now;
-      drainRspCallback(ec, actualLen, buf);
+      drainRspCallback(ec, actualLen, bufs);
     });
 }
 
-void NetSession::drainRspCallback(const std::error_code& ec,
-                                  size_t actualLen,
-                                  std::shared_ptr<SendBuffer> buf) {
+void NetSession::drainRspCallback(
+  const std::error_code& ec,
+  size_t actualLen,
+  std::vector<std::shared_ptr<SendBuffer>> bufs) {
   if (ec) {
     LOG(WARNING) << "drainRspCallback:" << ec.message();
     endSession();
     return;
   }
-  if (actualLen != buf->buffer.size()) {
-    LOG(FATAL) << "conn:" << _connId << ",data:" << buf->buffer.data()
-               << ",actualLen:" << actualLen
-               << ",bufsize:" << buf->buffer.size() << ",invalid drainRsp len";
+  size_t expectLen = 0;
+  bool closeAfterThis = false;
+  for (const auto& buf : bufs) {
+    expectLen += buf->buffer.size();
+    closeAfterThis |= buf->closeAfterThis;
+  }
+  if (actualLen != expectLen) {
+    LOG(FATAL) << "conn:" << _connId << ",bufcnt:" << bufs.size()
+               << ",actualLen:" << actualLen << ",bufsize:" << expectLen
+               << ",invalid drainRsp len";
   }
 
   if (_server) {
@@ -907,17 +1152,26 @@ void NetSession::drainRspCallback(const std::error_code& ec,
     _server->getServerStat().netOutputBytes += actualLen;
   }
 
-  if (buf->closeAfterThis) {
+  if (closeAfterThis) {
     endSession();
     return;
   }
 
   std::lock_guard<std::mutex> lk(_mutex);
   INVARIANT(_isSendRunning);
+  _pendingRspBytes -= actualLen;
   if (_sendBuffer.size() > 0) {
-    auto it = _sendBuffer.front();
-    _sendBuffer.pop_front();
-    drainRsp(it);
+    // send all the pending replies together, stop at the one which
+    // closes the connection.
+    std::vector<std::shared_ptr<SendBuffer>> next;
+    while (_sendBuffer.size() > 0) {
+      next.emplace_back(_sendBuffer.front());
+      _sendBuffer.pop_front();
+      if (next.back()->closeAfterThis) {
+        break;
+      }
+    }
+    drainRsp(std::move(next));
   } else {
     _isSendRunning = false;
   }
@@ -19,6 +19,7 @@
 
 #include "tendisplus/network/session_ctx.h"
 #include "tendisplus/network/blocking_tcp_client.h"
+#include "tendisplus/network/reply_buffer.h"
 #include "tendisplus/server/session.h"
 #include "tendisplus/server/server_params.h"
 #include "tendisplus/utils/status.h"
@@ -43,6 +44,11 @@ class NetworkMatrix {
   Atom<uint64_t> connCreated{0};
   Atom<uint64_t> connReleased{0};
   Atom<uint64_t> invalidPackets{0};
+  // pipelined requests executed in one schedule round, see processReq()
+  Atom<uint64_t> pipelineBatches{0};
+  Atom<uint64_t> pipelineBatchedCmds{0};
+  // replies merged into another reply's write instead of their own
+  Atom<uint64_t> writesSaved{0};
   NetworkMatrix operator-(const NetworkMatrix& right);
   std::string toString() const;
   void reset();
@@ -122,8 +128,10 @@ class NetworkAsio {
 };
 
 struct SendBuffer {
-  std::vector<char> buffer;
+  ReplyBuffer buffer;
   bool closeAfterThis;
+  // the replies merged into the buffer
+  size_t replies = 1;
 };
 
 // represent a ingress tcp-connection
@@ -143,6 +151,8 @@ class NetSession : public Session {
   virtual std::string getLocalRepr() const;
   asio::ip::tcp::socket borrowConn();
   virtual Status setResponse(const std::string& s);
+  virtual Status setResponse(ReplyBuffer&& reply);
+  virtual uint64_t getPendingRspBytes() const;
   void setCloseAfterRsp();
   virtual void start();
   virtual Status cancel();
@@ -181,25 +191,39 @@ class NetSession : public Session {
   virtual void drainReqBuf();
   virtual void drainReqCallback(const std::error_code& ec, size_t actualLen);
 
-  // send data to tcpbuff
-  virtual void drainRsp(std::shared_ptr<SendBuffer>);
-  virtual void drainRspCallback(const std::error_code& ec,
-                                size_t actualLen,
-                                std::shared_ptr<SendBuffer> buf);
+  // send data to tcpbuff, all buffers are sent with one gather write
+  virtual void drainRsp(std::vector<std::shared_ptr<SendBuffer>> bufs);
+  virtual void drainRspCallback(
+    const std::error_code& ec,
+    size_t actualLen,
+    std::vector<std::shared_ptr<SendBuffer>> bufs);
 
   // handle msg parsed from drainReqCallback
   virtual void processReq();
+  // park the session blocked by the current command, it's resumed by
+  // BlockingManager and runs the command again.
+  virtual void park();
+  // watch the socket of the parked session for the client closing
+  void waitClose();
   // cleanup state for next request
   virtual void resetMultiBulkCtx();
 
  private:
   FRIEND_TEST(NetSession, drainReqInvalid);
   FRIEND_TEST(NetSession, Completed);
+  FRIEND_TEST(NetSession, Pipeline);
+  FRIEND_TEST(NetSession, BigArg);
   FRIEND_TEST(Command, common);
 
+  // parse _queryBuf and set the next state, never schedule
+  void processQueryBuf();
   void processMultibulkBuffer();
   void processInlineBuffer();
 
+  // replies set between begin/end are held and written out together
+  void beginCoalesceRsp();
+  void endCoalesceRsp();
+
   // network is ok, but client's msg is not ok, reply and close
   void setRspAndClose(const std::string&);
 
@@ -211,7 +235,9 @@ class NetSession : public Session {
   bool _closeAfterRsp;
   std::atomic<State> _state;
   asio::ip::tcp::socket _sock;
-  std::vector<char> _queryBuf;
+  // NOTE: std::string rather than std::vector<char>, so that the buffer
+  // holding a big bulk can be moved into _args, see processMultibulkBuffer()
+  std::string _queryBuf;
   ssize_t _queryBufPos;
 
   // contexts for RedisReqMode::REDIS_REQ_MULTIBULK
@@ -219,13 +245,21 @@ class NetSession : public Session {
   int64_t _multibulklen;
   int64_t _bulkLen;
 
-  // _mutex protects _isSendRunning, _isEnded, _sendBuffer
+  // _mutex protects _isSendRunning, _isEnded, _sendBuffer,
+  // _coalesceRsp, _coalescedRsp, _pendingRspBytes, _parked, and the
+  // query buffer while parked.
   // other variables will never be visited in send-threads.
-  std::mutex _mutex;
+  mutable std::mutex _mutex;
   bool _isSendRunning;
   bool _isEnded;
   bool _first;
+  bool _coalesceRsp;
+  bool _parked;
+  // whether a wait for the client closing is pending, see park()
+  std::atomic<bool> _waitingClose;
   std::list<std::shared_ptr<SendBuffer>> _sendBuffer;
+  std::vector<std::shared_ptr<SendBuffer>> _coalescedRsp;
+  uint64_t _pendingRspBytes;
 
   std::shared_ptr<NetworkMatrix> _netMatrix;
   std::shared_ptr<RequestMatrix> _reqMatrix;
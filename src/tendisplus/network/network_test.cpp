@@ -138,6 +138,94 @@ TEST(NetSession, Completed) {
   EXPECT_EQ(sess->_args[1], "1");
 }
 
+TEST(NetSession, Pipeline) {
+  std::string s =
+    "*2\r\n$3\r\nget\r\n$1\r\na\r\nping\r\n"
+    "*3\r\n$3\r\nset\r\n$1\r\nb\r\n$1\r";
+  asio::io_context ioContext;
+  asio::ip::tcp::socket socket(ioContext);
+  auto sess =
+    std::make_shared<NoSchedNetSession>(nullptr,
+                                        std::move(socket),
+                                        1,
+                                        false,
+                                        std::make_shared<NetworkMatrix>(),
+                                        std::make_shared<RequestMatrix>());
+
+  sess->setState(NetSession::State::DrainReqNet);
+  sess->_queryBuf.resize(128, 0);
+  std::copy(s.begin(), s.end(), sess->_queryBuf.begin());
+  sess->drainReqCallback(std::error_code(), s.size());
+  EXPECT_EQ(sess->_state.load(), NetSession::State::Process);
+  EXPECT_EQ(sess->_args.size(), size_t(2));
+  EXPECT_EQ(sess->_args[1], "a");
+
+  // the following requests are parsed in place, without rescheduling
+  sess->resetMultiBulkCtx();
+  sess->processQueryBuf();
+  EXPECT_EQ(sess->_state.load(), NetSession::State::Process);
+  EXPECT_EQ(sess->_args.size(), size_t(1));
+  EXPECT_EQ(sess->_args[0], "ping");
+
+  sess->resetMultiBulkCtx();
+  sess->processQueryBuf();
+  EXPECT_EQ(sess->_state.load(), NetSession::State::DrainReqNet);
+  EXPECT_EQ(sess->_closeAfterRsp, false);
+
+  std::string left = "\n1\r\n";
+  std::copy(
+    left.begin(), left.end(), sess->_queryBuf.begin() + sess->_queryBufPos);
+  sess->drainReqCallback(std::error_code(), left.size());
+  EXPECT_EQ(sess->_state.load(), NetSession::State::Process);
+  EXPECT_EQ(sess->_args.size(), size_t(3));
+  EXPECT_EQ(sess->_args[2], "1");
+  EXPECT_EQ(sess->_queryBufPos, 0);
+}
+
+TEST(NetSession, BigArg) {
+  std::string s = "*3\r\n$3\r\nset\r\n$1\r\na\r\n$40000\r\n";
+  std::string val(40000, 'v');
+  val.append("\r\n");
+  asio::io_context ioContext;
+  asio::ip::tcp::socket socket(ioContext);
+  auto sess =
+    std::make_shared<NoSchedNetSession>(nullptr,
+                                        std::move(socket),
+                                        1,
+                                        false,
+                                        std::make_shared<NetworkMatrix>(),
+                                        std::make_shared<RequestMatrix>());
+
+  sess->setState(NetSession::State::DrainReqNet);
+  sess->_queryBuf.resize(128, 0);
+  std::copy(s.begin(), s.end(), sess->_queryBuf.begin());
+  sess->drainReqCallback(std::error_code(), s.size());
+  EXPECT_EQ(sess->_state.load(), NetSession::State::DrainReqNet);
+  EXPECT_EQ(sess->_queryBufPos, 0);
+  // room for the whole bulk is reserved
+  EXPECT_GE(sess->_queryBuf.size(), val.size());
+
+  // the bulk arrives in two reads
+  std::copy(val.begin(), val.begin() + 1000, sess->_queryBuf.begin());
+  sess->drainReqCallback(std::error_code(), 1000);
+  EXPECT_EQ(sess->_state.load(), NetSession::State::DrainReqNet);
+  std::copy(val.begin() + 1000, val.end(), sess->_queryBuf.begin() + 1000);
+  sess->drainReqCallback(std::error_code(), val.size() - 1000);
+  EXPECT_EQ(sess->_state.load(), NetSession::State::Process);
+  EXPECT_EQ(sess->_args.size(), size_t(3));
+  EXPECT_EQ(sess->_args[2], std::string(40000, 'v'));
+  // the buffer itself is handed off as the argument
+  EXPECT_EQ(sess->_queryBufPos, 0);
+  EXPECT_EQ(sess->_queryBuf.size(), size_t(0));
+
+  // only the head of a big arg is kept for introspection
+  sess->setArgs({"set", std::string(1000, 'k'), std::string(100000, 'v')});
+  auto brief = sess->getCtx()->getArgsBrief();
+  EXPECT_EQ(brief.size(), size_t(3));
+  EXPECT_EQ(brief[1], std::string(1000, 'k'));
+  EXPECT_EQ(brief[2], std::string(SessionCtx::ARGS_BRIEF_MAX_LEN, 'v'));
+}
+
 
 class session : public std::enable_shared_from_this<session> {
  public:
@@ -0,0 +1,208 @@
+// Copyright (C) 2020 THL A29 Limited, a Tencent company.  All rights reserved.
+// Please refer to the license text that comes with this tendis open source
+// project for additional information.
+
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tendisplus/network/reply_buffer.h"
+#include "tendisplus/utils/invariant.h"
+
+namespace tendisplus {
+
+Atom<uint64_t> ReplyChunkPool::chunkAllocated{0};
+Atom<uint64_t> ReplyChunkPool::chunkReused{0};
+
+size_t ReplyChunk::append(const char* data, size_t len) {
+  size_t n = std::min(len, avail());
+  memcpy(_data + _size, data, n);
+  _size += n;
+  return n;
+}
+
+void ReplyChunkDeleter::operator()(ReplyChunk* chunk) const {
+  auto owner = std::move(chunk->_owner);
+  INVARIANT_D(owner != nullptr);
+  owner->put(chunk);
+}
+
+ReplyChunkPool::~ReplyChunkPool() {
+  for (auto chunk : _free) {
+    delete chunk;
+  }
+}
+
+ReplyChunkPool* ReplyChunkPool::local() {
+  // NOTE: the chunks hold a reference of their pool, so the pool
+  // outlives its thread if some chunks are still being sent.
+  static thread_local std::shared_ptr<ReplyChunkPool> pool =
+    std::make_shared<ReplyChunkPool>();
+  return pool.get();
+}
+
+ReplyChunkPtr ReplyChunkPool::get() {
+  ReplyChunk* chunk = nullptr;
+  {
+    std::lock_guard<std::mutex> lk(_mutex);
+    if (!_free.empty()) {
+      chunk = _free.back();
+      _free.pop_back();
+    }
+  }
+  if (chunk) {
+    ++chunkReused;
+  } else {
+    chunk = new ReplyChunk();
+    ++chunkAllocated;
+  }
+  chunk->_size = 0;
+  chunk->_owner = shared_from_this();
+  return ReplyChunkPtr(chunk);
+}
+
+void ReplyChunkPool::put(ReplyChunk* chunk) {
+  {
+    std::lock_guard<std::mutex> lk(_mutex);
+    if (_free.size() < MAX_FREE_CHUNKS) {
+      _free.push_back(chunk);
+      return;
+    }
+  }
+  delete chunk;
+}
+
+size_t ReplyChunkPool::freeCount() const {
+  std::lock_guard<std::mutex> lk(_mutex);
+  return _free.size();
+}
+
+ReplyBuffer::ReplyBuffer(std::string&& s) : _size(0) {
+  append(std::move(s));
+}
+
+size_t ReplyBuffer::appendToTail(const char* data, size_t len) {
+  if (_segs.empty()) {
+    return 0;
+  }
+  auto& tail = _segs.back();
+  if (tail.chunk) {
+    return tail.chunk->append(data, len);
+  }
+  if (tail.isInline()) {
+    size_t n = std::min(len, MIN_CHAINED_SIZE - tail.str.size());
+    tail.str.append(data, n);
+    return n;
+  }
+  return 0;
+}
+
+void ReplyBuffer::append(const char* data, size_t len) {
+  _size += len;
+  while (len > 0) {
+    size_t n = appendToTail(data, len);
+    if (n == 0) {
+      Segment seg;
+      if (_size > MIN_CHAINED_SIZE) {
+        seg.chunk = ReplyChunkPool::local()->get();
+      }
+      _segs.emplace_back(std::move(seg));
+      continue;
+    }
+    data += n;
+    len -= n;
+  }
+}
+
+void ReplyBuffer::append(std::string&& s) {
+  if (s.size() < MIN_CHAINED_SIZE) {
+    append(s.data(), s.size());
+    return;
+  }
+  _size += s.size();
+  Segment seg;
+  seg.str = std::move(s);
+  _segs.emplace_back(std::move(seg));
+}
+
+void ReplyBuffer::append(std::shared_ptr<const std::string> s) {
+  _size += s->size();
+  Segment seg;
+  seg.shared = std::move(s);
+  _segs.emplace_back(std::move(seg));
+}
+
+void ReplyBuffer::append(ReplyBuffer&& other) {
+  for (auto& seg : other._segs) {
+    if ((seg.chunk || seg.isInline()) && seg.size() < MIN_CHAINED_SIZE) {
+      append(seg.data(), seg.size());
+      continue;
+    }
+    _size += seg.size();
+    _segs.emplace_back(std::move(seg));
+  }
+  other.clear();
+}
+
+void ReplyBuffer::appendMultiBulkLen(uint64_t len) {
+  std::string s("*");
+  s.append(std::to_string(len)).append("\r\n");
+  append(s);
+}
+
+void ReplyBuffer::appendBulk(const std::string& s) {
+  std::string head("$");
+  head.append(std::to_string(s.size())).append("\r\n");
+  append(head);
+  append(s);
+  append("\r\n", 2);
+}
+
+void ReplyBuffer::appendBulk(std::string&& s) {
+  std::string head("$");
+  head.append(std::to_string(s.size())).append("\r\n");
+  append(head);
+  append(std::move(s));
+  append("\r\n", 2);
+}
+
+void ReplyBuffer::appendNull() {
+  append("$-1\r\n", 5);
+}
+
+void ReplyBuffer::appendLongLong(int64_t v) {
+  std::string s(":");
+  s.append(std::to_string(v)).append("\r\n");
+  append(s);
+}
+
+void ReplyBuffer::appendStatus(const std::string& s) {
+  append("+", 1);
+  append(s);
+  append("\r\n", 2);
+}
+
+void ReplyBuffer::clear() {
+  _segs.clear();
+  _size = 0;
+}
+
+std::string ReplyBuffer::toString() const {
+  std::string result;
+  result.reserve(_size);
+  for (const auto& seg : _segs) {
+    result.append(seg.data(), seg.size());
+  }
+  return result;
+}
+
+void ReplyBuffer::appendIoVec(std::vector<asio::const_buffer>* iov) const {
+  for (const auto& seg : _segs) {
+    iov->emplace_back(asio::buffer(seg.data(), seg.size()));
+  }
+}
+
+}  // namespace tendisplus
@@ -0,0 +1,152 @@
+// Copyright (C) 2020 THL A29 Limited, a Tencent company.  All rights reserved.
+// Please refer to the license text that comes with this tendis open source
+// project for additional information.
+
+#ifndef SRC_TENDISPLUS_NETWORK_REPLY_BUFFER_H_
+#define SRC_TENDISPLUS_NETWORK_REPLY_BUFFER_H_
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "asio.hpp"
+#include "tendisplus/utils/atomic_utility.h"
+
+namespace tendisplus {
+
+class ReplyChunkPool;
+
+// a fixed size memory chunk holding (part of) the replies. Chunks are
+// handed out by the ReplyChunkPool of the thread building the reply, and
+// return to that pool when released, no matter which thread releases it.
+class ReplyChunk {
+ public:
+  static constexpr size_t CAPACITY = 16 * 1024;
+  ReplyChunk() : _owner(nullptr), _size(0) {}
+  ReplyChunk(const ReplyChunk&) = delete;
+  ReplyChunk(ReplyChunk&&) = delete;
+  const char* data() const {
+    return _data;
+  }
+  size_t size() const {
+    return _size;
+  }
+  size_t avail() const {
+    return CAPACITY - _size;
+  }
+  // copy at most avail() bytes, return the bytes copied
+  size_t append(const char* data, size_t len);
+
+ private:
+  friend class ReplyChunkPool;
+  friend struct ReplyChunkDeleter;
+  std::shared_ptr<ReplyChunkPool> _owner;
+  size_t _size;
+  char _data[CAPACITY];
+};
+
+struct ReplyChunkDeleter {
+  void operator()(ReplyChunk* chunk) const;
+};
+
+using ReplyChunkPtr = std::unique_ptr<ReplyChunk, ReplyChunkDeleter>;
+
+class ReplyChunkPool : public std::enable_shared_from_this<ReplyChunkPool> {
+ public:
+  // 4MB cached at most for each thread
+  static constexpr size_t MAX_FREE_CHUNKS = 256;
+  ReplyChunkPool() = default;
+  ReplyChunkPool(const ReplyChunkPool&) = delete;
+  ReplyChunkPool(ReplyChunkPool&&) = delete;
+  ~ReplyChunkPool();
+
+  // the pool of current thread
+  static ReplyChunkPool* local();
+  ReplyChunkPtr get();
+  size_t freeCount() const;
+
+  static Atom<uint64_t> chunkAllocated;
+  static Atom<uint64_t> chunkReused;
+
+ private:
+  friend struct ReplyChunkDeleter;
+  void put(ReplyChunk* chunk);
+
+  mutable std::mutex _mutex;
+  std::vector<ReplyChunk*> _free;
+};
+
+// ReplyBuffer builds a reply as a chain of pooled chunks. Big strings
+// passed by rvalue are chained as they are, without copy. A reply no
+// bigger than MIN_CHAINED_SIZE is kept in a small inline string instead,
+// so it doesn't pin a whole chunk. The chain is sent with one gather
+// write, see NetSession::drainRsp().
+class ReplyBuffer {
+ public:
+  // strings at least this size are chained instead of copied
+  static constexpr size_t MIN_CHAINED_SIZE = 4 * 1024;
+
+  ReplyBuffer() : _size(0) {}
+  explicit ReplyBuffer(std::string&& s);
+  ReplyBuffer(const ReplyBuffer&) = delete;
+  ReplyBuffer(ReplyBuffer&&) = default;
+  ReplyBuffer& operator=(ReplyBuffer&&) = default;
+
+  void append(const char* data, size_t len);
+  void append(const std::string& s) {
+    append(s.data(), s.size());
+  }
+  void append(std::string&& s);
+  // the small segments of other are copied into the tail, the others
+  // are chained
+  void append(ReplyBuffer&& other);
+  // a string shared by many replies(e.g. a published message) is always
+  // chained, it's released after the last reply is sent.
+  void append(std::shared_ptr<const std::string> s);
+
+  // redis protocol
+  void appendMultiBulkLen(uint64_t len);
+  void appendBulk(const std::string& s);
+  void appendBulk(std::string&& s);
+  void appendNull();
+  void appendLongLong(int64_t v);
+  void appendStatus(const std::string& s);
+
+  size_t size() const {
+    return _size;
+  }
+  bool empty() const {
+    return _size == 0;
+  }
+  void clear();
+  std::string toString() const;
+  // the buffers are valid until this ReplyBuffer is changed
+  void appendIoVec(std::vector<asio::const_buffer>* iov) const;
+
+ private:
+  // either a pooled chunk, a chained string or a shared one. A string
+  // shorter than MIN_CHAINED_SIZE is an inline one, which is appended to.
+  struct Segment {
+    ReplyChunkPtr chunk;
+    std::string str;
+    std::shared_ptr<const std::string> shared;
+    const char* data() const {
+      return chunk ? chunk->data() : (shared ? shared->data() : str.data());
+    }
+    size_t size() const {
+      return chunk ? chunk->size() : (shared ? shared->size() : str.size());
+    }
+    bool isInline() const {
+      return !chunk && !shared && str.size() < MIN_CHAINED_SIZE;
+    }
+  };
+  // copy as much as the tail segment can hold, return the bytes copied
+  size_t appendToTail(const char* data, size_t len);
+  std::vector<Segment> _segs;
+  size_t _size;
+};
+
+}  // namespace tendisplus
+
+#endif  // SRC_TENDISPLUS_NETWORK_REPLY_BUFFER_H_
@@ -0,0 +1,142 @@
+// Copyright (C) 2020 THL A29 Limited, a Tencent company.  All rights reserved.
+// Please refer to the license text that comes with this tendis open source
+// project for additional information.
+
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "tendisplus/network/reply_buffer.h"
+
+namespace tendisplus {
+
+TEST(ReplyBuffer, Common) {
+  ReplyBuffer rb;
+  EXPECT_TRUE(rb.empty());
+  rb.appendMultiBulkLen(3);
+  rb.appendBulk("foo");
+  rb.appendNull();
+  rb.appendLongLong(-10);
+  rb.appendStatus("OK");
+  std::string expect = "*3\r\n$3\r\nfoo\r\n$-1\r\n:-10\r\n+OK\r\n";
+  EXPECT_EQ(rb.size(), expect.size());
+  EXPECT_EQ(rb.toString(), expect);
+
+  std::vector<asio::const_buffer> iov;
+  rb.appendIoVec(&iov);
+  EXPECT_EQ(iov.size(), size_t(1));
+
+  rb.clear();
+  EXPECT_TRUE(rb.empty());
+  EXPECT_EQ(rb.toString(), "");
+}
+
+TEST(ReplyBuffer, Chain) {
+  ReplyBuffer rb;
+  // spans several chunks
+  std::string small(ReplyChunk::CAPACITY + 100, 'a');
+  rb.append(small);
+  // chained without copy
+  std::string big(ReplyBuffer::MIN_CHAINED_SIZE * 2, 'b');
+  const char* bigData = big.data();
+  rb.appendBulk(std::move(big));
+  rb.append("c", 1);
+
+  std::vector<asio::const_buffer> iov;
+  rb.appendIoVec(&iov);
+  // 2 chunks for small and the bulk header, the big string, 1 chunk
+  // for the tail
+  ASSERT_EQ(iov.size(), size_t(4));
+  EXPECT_EQ(iov[2].data(), bigData);
+
+  std::string expect = small + "$" +
+    std::to_string(ReplyBuffer::MIN_CHAINED_SIZE * 2) + "\r\n" +
+    std::string(ReplyBuffer::MIN_CHAINED_SIZE * 2, 'b') + "\r\nc";
+  EXPECT_EQ(rb.size(), expect.size());
+  EXPECT_EQ(rb.toString(), expect);
+
+  ReplyBuffer other(std::string("d"));
+  rb.append(std::move(other));
+  EXPECT_TRUE(other.empty());
+  EXPECT_EQ(rb.toString(), expect + "d");
+}
+
+TEST(ReplyBuffer, Small) {
+  auto chunks = [] {
+    return ReplyChunkPool::chunkAllocated.get() +
+      ReplyChunkPool::chunkReused.get();
+  };
+  uint64_t before = chunks();
+  // small replies don't take chunks
+  ReplyBuffer rb;
+  std::string expect;
+  for (int i = 0; i < 64; ++i) {
+    ReplyBuffer r;
+    r.appendBulk("value" + std::to_string(i));
+    expect += r.toString();
+    rb.append(std::move(r));
+  }
+  EXPECT_EQ(chunks(), before);
+  EXPECT_EQ(rb.toString(), expect);
+  std::vector<asio::const_buffer> iov;
+  rb.appendIoVec(&iov);
+  EXPECT_EQ(iov.size(), size_t(1));
+
+  // once it's bigger than MIN_CHAINED_SIZE, the rest goes to chunks
+  std::string s(ReplyBuffer::MIN_CHAINED_SIZE, 'a');
+  rb.append(s);
+  EXPECT_EQ(chunks(), before + 1);
+  expect += s;
+  EXPECT_EQ(rb.size(), expect.size());
+  EXPECT_EQ(rb.toString(), expect);
+  iov.clear();
+  rb.appendIoVec(&iov);
+  EXPECT_EQ(iov.size(), size_t(2));
+}
+
+TEST(ReplyBuffer, Shared) {
+  auto msg = std::make_shared<const std::string>("message");
+  {
+    ReplyBuffer rb1;
+    ReplyBuffer rb2;
+    rb1.append(msg);
+    rb2.append("a", 1);
+    rb2.append(msg);
+    EXPECT_EQ(msg.use_count(), 3);
+
+    std::vector<asio::const_buffer> iov;
+    rb1.appendIoVec(&iov);
+    rb2.appendIoVec(&iov);
+    ASSERT_EQ(iov.size(), size_t(3));
+    EXPECT_EQ(iov[0].data(), msg->data());
+    EXPECT_EQ(iov[2].data(), msg->data());
+    EXPECT_EQ(rb2.size(), msg->size() + 1);
+    EXPECT_EQ(rb2.toString(), "a" + *msg);
+  }
+  EXPECT_EQ(msg.use_count(), 1);
+}
+
+TEST(ReplyChunkPool, Reuse) {
+  auto pool = ReplyChunkPool::local();
+  const std::string s(ReplyChunk::CAPACITY * 2, 'a');
+  {
+    ReplyBuffer rb;
+    rb.append(s);
+    rb.append(s);
+  }
+  size_t freeCnt = pool->freeCount();
+  EXPECT_GE(freeCnt, size_t(4));
+
+  ReplyBuffer rb;
+  rb.append(s);
+  EXPECT_EQ(pool->freeCount(), freeCnt - 2);
+
+  // chunks released by another thread return to their owner pool
+  std::thread thd([&rb]() { rb.clear(); });
+  thd.join();
+  EXPECT_EQ(pool->freeCount(), freeCnt);
+}
+
+}  // namespace tendisplus
@@ -14,6 +14,39 @@
 
 namespace tendisplus {
 
+namespace {
+// commit the transactions one by one, the rest are rolled back once one
+// fails. There is no way to undo the ones committed before, so the
+// partial success is reported to the client.
+Status commitTxns(
+  const std::string& cmd,
+  std::unordered_map<std::string, std::unique_ptr<Transaction>>* txns) {
+  Status s = {ErrorCodes::ERR_OK, ""};
+  std::string committed;
+  for (auto& txn : *txns) {
+    if (!s.ok()) {
+      txn.second->rollback();
+      continue;
+    }
+    auto exptCommit = txn.second->commit();
+    if (exptCommit.ok()) {
+      committed += committed.empty() ? txn.first : "," + txn.first;
+      continue;
+    }
+    s = exptCommit.status();
+    if (!committed.empty()) {
+      LOG(ERROR) << cmd << " commit error at kvstore " << txn.first
+                 << ". It lead to partial success.";
+      s = {ErrorCodes::ERR_INTERNAL,
+           cmd + " partially committed, kvstore " + txn.first +
+             " failed: " + s.toString() + ", committed kvstores: " +
+             committed};
+    }
+  }
+  return s;
+}
+}  // namespace
+
 SessionCtx::SessionCtx(Session* sess)
   : _authed(false),
     _dbId(0),
@@ -31,11 +64,20 @@ SessionCtx::SessionCtx(Session* sess)
     _replOnly(false),
     _session(sess),
     _isMonitor(false),
-    _flags(0) {
+    _flags(0),
+    _blocked(false),
+    _blockDeadline(0),
+    _inExec(false),
+    _lockDeadline(0) {
   _perfContext.Reset();
   _ioContext.Reset();
 }
 
+SessionCtx::~SessionCtx() {
+  // the pending lock is dequeued here if the session is closed when parked
+  _pendingLock.reset();
+}
+
 void SessionCtx::setProcessPacketStart(uint64_t start) {
   _processPacketStart = start;
 }
@@ -76,6 +118,27 @@ void SessionCtx::removeLock(ILock* lock) {
   INVARIANT_D(0);
 }
 
+bool SessionCtx::hasLocks() const {
+  std::lock_guard<std::mutex> lk(_mutex);
+  return !_locks.empty();
+}
+
+void SessionCtx::setPendingLock(std::unique_ptr<KeyLock> lock,
+                                uint64_t deadlineMs) {
+  INVARIANT_D(_pendingLock == nullptr);
+  _pendingLock = std::move(lock);
+  _lockDeadline = deadlineMs;
+}
+
+std::unique_ptr<KeyLock> SessionCtx::takePendingLock() {
+  _lockDeadline = 0;
+  return std::move(_pendingLock);
+}
+
+bool SessionCtx::isPendingLockGranted() const {
+  return _pendingLock && _pendingLock->isGranted();
+}
+
 std::vector<std::string> SessionCtx::getArgsBrief() const {
   std::lock_guard<std::mutex> lk(_mutex);
   return _argsBrief;
@@ -85,8 +148,10 @@ void SessionCtx::setArgsBrief(const std::vector<std::string>& v) {
   std::lock_guard<std::mutex> lk(_mutex);
   _argsBrief.clear();
   constexpr size_t MAX_SIZE = 8;
+  // NOTE: only the head of a big arg is kept, which shows in
+  // "show processlist", the others are kept whole
   for (size_t i = 0; i < std::min(v.size(), MAX_SIZE); ++i) {
-    _argsBrief.push_back(v[i]);
+    _argsBrief.emplace_back(v[i], 0, ARGS_BRIEF_MAX_LEN);
   }
 }
 
@@ -124,15 +189,7 @@ Expected<Transaction*> SessionCtx::createTransaction(const PStore& kvstore) {
 
 Status SessionCtx::commitAll(const std::string& cmd) {
   std::lock_guard<std::mutex> lk(_mutex);
-  Status s;
-  for (auto& txn : _txnMap) {
-    Expected<uint64_t> exptCommit = txn.second->commit();
-    if (!exptCommit.ok()) {
-      LOG(ERROR) << cmd << " commit error at kvstore " << txn.first
-                 << ". It lead to partial success.";
-      s = exptCommit.status();
-    }
-  }
+  auto s = commitTxns(cmd, &_txnMap);
   _txnMap.clear();
   return s;
 }
@@ -151,6 +208,63 @@ Status SessionCtx::rollbackAll() {
   return s;
 }
 
+Transaction* SessionCtx::getExecTxn(const std::string& dbId) {
+  std::lock_guard<std::mutex> lk(_mutex);
+  auto it = _execTxnMap.find(dbId);
+  return it == _execTxnMap.end() ? nullptr : it->second.get();
+}
+
+Transaction* SessionCtx::addExecTxn(const std::string& dbId,
+                                    std::unique_ptr<Transaction> txn) {
+  std::lock_guard<std::mutex> lk(_mutex);
+  INVARIANT_D(_execTxnMap.count(dbId) == 0);
+  auto ptr = txn.get();
+  // it's created by the running command, which may be rolled back
+  ptr->setSavePoint();
+  _execTxnMap[dbId] = std::move(txn);
+  return ptr;
+}
+
+void SessionCtx::setExecSavePoint() {
+  std::lock_guard<std::mutex> lk(_mutex);
+  for (auto& txn : _execTxnMap) {
+    txn.second->setSavePoint();
+  }
+}
+
+Status SessionCtx::rollbackExecToSavePoint() {
+  std::lock_guard<std::mutex> lk(_mutex);
+  for (auto& txn : _execTxnMap) {
+    auto s = txn.second->rollbackToSavePoint();
+    if (!s.ok()) {
+      LOG(ERROR) << "exec rollback to savepoint error at kvstore "
+                 << txn.first << ":" << s.toString();
+      return s;
+    }
+  }
+  return {ErrorCodes::ERR_OK, ""};
+}
+
+Status SessionCtx::commitExec() {
+  std::lock_guard<std::mutex> lk(_mutex);
+  auto s = commitTxns("exec", &_execTxnMap);
+  _execTxnMap.clear();
+  return s;
+}
+
+Status SessionCtx::rollbackExec() {
+  std::lock_guard<std::mutex> lk(_mutex);
+  Status s = {ErrorCodes::ERR_OK, ""};
+  for (auto& txn : _execTxnMap) {
+    s = txn.second->rollback();
+    if (!s.ok()) {
+      LOG(ERROR) << "exec rollback error at kvstore " << txn.first;
+    }
+  }
+  _execTxnMap.clear();
+  return s;
+}
+
 void SessionCtx::setWaitLock(uint32_t storeId,
                              uint32_t chunkId,
                              const std::string& key,
@@ -28,11 +28,17 @@ namespace tendisplus {
 
 #define InMulti (1 << 0)
 #define CLIENT_READONLY (1 << 1)
+#define CLIENT_PUBSUB (1 << 2)
+// commands after MULTI are queued until EXEC
+#define CLIENT_MULTI_QUEUED (1 << 3)
+// a queued command failed, EXEC is aborted
+#define CLIENT_DIRTY_EXEC (1 << 4)
 
 // storeLock state pair
 using SLSP = std::tuple<uint32_t, uint32_t, std::string, mgl::LockMode>;
 
 class ILock;
+class KeyLock;
 class SessionCtx {
   enum class PerfLevel : unsigned char {
     kUninitialized = 0,             // unknown setting
@@ -49,6 +55,7 @@ class SessionCtx {
 
  public:
   explicit SessionCtx(Session* sess);
+  ~SessionCtx();
   SessionCtx(const SessionCtx&) = delete;
   SessionCtx(SessionCtx&&) = delete;
   bool authed() const;
@@ -68,6 +75,7 @@ class SessionCtx {
 
   void addLock(ILock* lock);
   void removeLock(ILock* lock);
+  bool hasLocks() const;
 
   // return by value, only for stats
   std::vector<std::string> getArgsBrief() const;
@@ -117,9 +125,34 @@ class SessionCtx {
     _txnVersion = _version;
   }
   inline void resetMulti() {
-    _flags &= ~InMulti;
+    _flags &= ~(InMulti | CLIENT_MULTI_QUEUED | CLIENT_DIRTY_EXEC);
     _txnVersion = -1;
+    _multiCmds.clear();
   }
+  void queueMultiCmd(const std::vector<std::string>& args) {
+    _multiCmds.push_back(args);
+  }
+  std::vector<std::vector<std::string>> takeMultiCmds() {
+    return std::move(_multiCmds);
+  }
+  // When in exec, RocksKVStore::createTransaction() returns a SharedTxn of
+  // the session's transaction of the kvstore, see execCommand.
+  bool isInExec() const {
+    return _inExec;
+  }
+  void setInExec(bool v) {
+    _inExec = v;
+  }
+  Transaction* getExecTxn(const std::string& dbId);
+  Transaction* addExecTxn(const std::string& dbId,
+                          std::unique_ptr<Transaction> txn);
+  // set a savepoint before each command run by exec, and roll back to it
+  // if the command fails, so that its partial writes are not committed
+  void setExecSavePoint();
+  Status rollbackExecToSavePoint();
+  // commit or rollback the transactions of exec
+  Status commitExec();
+  Status rollbackExec();
   uint32_t getFlags() {
     return _flags;
   }
@@ -131,8 +164,40 @@ class SessionCtx {
   }
   bool verifyVersion(uint64_t keyVersion);
 
+  // A blocking command sets blocked instead of replying, the session is
+  // parked then, see BlockingManager. The deadline(ms) is kept across the
+  // runs of the same command, 0 means it's not computed yet.
+  bool isBlocked() const {
+    return _blocked;
+  }
+  void setBlocked(bool v) {
+    _blocked = v;
+  }
+  uint64_t getBlockDeadline() const {
+    return _blockDeadline;
+  }
+  void setBlockDeadline(uint64_t v) {
+    _blockDeadline = v;
+  }
+
+  // A key lock waited without holding the executor thread, it's kept
+  // queued in MGLockMgr while the session is parked, and taken back by
+  // the next run of the same command, see KeyLock::AquireKeyLock().
+  void setPendingLock(std::unique_ptr<KeyLock> lock, uint64_t deadlineMs);
+  std::unique_ptr<KeyLock> takePendingLock();
+  bool hasPendingLock() const {
+    return _pendingLock != nullptr;
+  }
+  bool isPendingLockGranted() const;
+  uint64_t getLockDeadline() const {
+    return _lockDeadline;
+  }
+
   static constexpr uint64_t VERSIONEP_UNINITED = -1;
   static constexpr uint64_t TSEP_UNINITED = -1;
+  // the args in getArgsBrief() are cut to this length, the same as the
+  // big arg of the protocol, so only the big values are not copied whole
+  static constexpr size_t ARGS_BRIEF_MAX_LEN = 32 * 1024;
 
  private:
   // not protected by mutex
@@ -154,6 +219,12 @@ class SessionCtx {
   std::unordered_map<std::string, mgl::LockMode> _keylockmap;
   bool _isMonitor;
   uint32_t _flags;
+  bool _blocked;
+  uint64_t _blockDeadline;
+  bool _inExec;
+  std::vector<std::vector<std::string>> _multiCmds;
+  std::unique_ptr<KeyLock> _pendingLock;
+  uint64_t _lockDeadline;
 
   mutable std::mutex _mutex;
 
@@ -161,6 +232,7 @@ class SessionCtx {
   std::vector<ILock*> _locks;
   // multi key
   std::unordered_map<std::string, std::unique_ptr<Transaction>> _txnMap;
+  std::unordered_map<std::string, std::unique_ptr<Transaction>> _execTxnMap;
   std::vector<std::string> _argsBrief;
   rocksdb::PerfContext _perfContext;
   rocksdb::IOStatsContext _ioContext;
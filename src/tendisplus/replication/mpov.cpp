@@ -2,11 +2,17 @@
 // Please refer to the license text that comes with this tendis open source
 // project for additional information.
 
+#include <algorithm>
+#include <atomic>
 #include <list>
 #include <chrono>  // NOLINT
 #include <fstream>
 #include <string>
 #include <memory>
+#include <set>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
 
 #include "glog/logging.h"
 #include "rapidjson/document.h"
@@ -20,7 +26,9 @@ namespace tendisplus {
 bool ReplManager::supplyFullSync(asio::ip::tcp::socket sock,
                                  const std::string& storeIdArg,
                                  const std::string& slaveIpArg,
-                                 const std::string& slavePortArg) {
+                                 const std::string& slavePortArg,
+                                 const std::string& streamsArg,
+                                 const std::string& resumePosArg) {
   std::shared_ptr<BlockingTcpClient> client =
     std::move(_svr->getNetwork()->createBlockingClient(std::move(sock),
                                                        64 * 1024 * 1024));
@@ -49,19 +57,74 @@ bool ReplManager::supplyFullSync(asio::ip::tcp::socket sock,
     return false;
   }
   LOG(INFO) << "ReplManager::supplyFullSync storeId:" << storeIdArg << " "
-            << slaveIpArg << ":" << slavePortArg;
+            << slaveIpArg << ":" << slavePortArg << " streams:" << streamsArg;
   uint16_t slavePort = static_cast<uint16_t>(expSlavePort.value());
+  bool streaming = !streamsArg.empty();
+  uint64_t resumePos = 0;
+  if (!resumePosArg.empty()) {
+    auto expPos = tendisplus::stoul(resumePosArg);
+    if (!expPos.ok()) {
+      client->writeLine("-ERR invalid resumePos");
+      return false;
+    }
+    resumePos = expPos.value();
+  }
   _fullPusher->schedule([this,
                          storeId,
                          client(std::move(client)),
                          slaveIpArg,
-                         slavePort]() mutable {
-    supplyFullSyncRoutine(std::move(client), storeId, slaveIpArg, slavePort);
+                         slavePort,
+                         streaming,
+                         resumePos]() mutable {
+    supplyFullSyncRoutine(
+      std::move(client), storeId, slaveIpArg, slavePort, streaming, resumePos);
   });
 
   return true;
 }
 
+bool ReplManager::attachFullSync(asio::ip::tcp::socket sock,
+                                 const std::string& storeIdArg,
+                                 const std::string& slaveIpArg,
+                                 const std::string& slavePortArg,
+                                 const std::string& clientIdArg) {
+  std::shared_ptr<BlockingTcpClient> client =
+    std::move(_svr->getNetwork()->createBlockingClient(std::move(sock),
+                                                       64 * 1024 * 1024));
+
+  auto expStoreId = tendisplus::stoul(storeIdArg);
+  auto expSlavePort = tendisplus::stoul(slavePortArg);
+  auto expClientId = tendisplus::stoul(clientIdArg);
+  if (!expStoreId.ok() || !expSlavePort.ok() || !expClientId.ok() ||
+      expStoreId.value() >= _svr->getKVStoreCount()) {
+    LOG(ERROR) << "ReplManager::attachFullSync invalid args, storeId:"
+               << storeIdArg << " slavePort:" << slavePortArg
+               << " clientId:" << clientIdArg;
+    client->writeLine("-ERR invalid args");
+    return false;
+  }
+  uint32_t storeId = static_cast<uint32_t>(expStoreId.value());
+  string slaveNode = slaveIpArg + ":" + to_string(expSlavePort.value());
+  {
+    std::lock_guard<std::mutex> lk(_mutex);
+    auto iter = _fullPushStatus[storeId].find(slaveNode);
+    if (iter == _fullPushStatus[storeId].end() ||
+        iter->second->clientId != expClientId.value() ||
+        iter->second->state != FullPushState::PUSHING) {
+      LOG(ERROR) << "ReplManager::attachFullSync no fullsync of storeId:"
+                 << storeId << " slave node:" << slaveNode
+                 << " clientId:" << clientIdArg;
+      client->writeLine("-ERR no such fullsync");
+      return false;
+    }
+    iter->second->streams.push_back(client);
+  }
+  LOG(INFO) << "ReplManager::attachFullSync storeId:" << storeId
+            << " slave node:" << slaveNode << " clientId:" << clientIdArg;
+  client->writeLine("+OK");
+  return true;
+}
+
 bool ReplManager::isFullSupplierFull() const {
   return _fullPusher->isFull();
 }
@@ -307,11 +370,15 @@ bool ReplManager::registerIncrSync(asio::ip::tcp::socket sock,
 //     send content
 //     read +OK
 // read +OK
+// if streaming, the files are sent by supplyFileStreams() instead, and the
+// checkpoint is kept after failure for the slave to resume from.
 void ReplManager::supplyFullSyncRoutine(
   std::shared_ptr<BlockingTcpClient> client,
   uint32_t storeId,
   const string& slave_listen_ip,
-  uint16_t slave_listen_port) {
+  uint16_t slave_listen_port,
+  bool streaming,
+  uint64_t resumePos) {
   LocalSessionGuard sg(_svr.get());
   sg.getSession()->setArgs(
     {"masterfullsync", client->getRemoteRepr(), std::to_string(storeId)});
@@ -335,24 +402,47 @@ void ReplManager::supplyFullSyncRoutine(
     return;
   }
 
+  string slaveNode = slave_listen_ip + ":" + to_string(slave_listen_port);
+  uint64_t clientId = 0;
+  std::unique_ptr<BackupInfo> resumed;
+  bool releaseCkpt = false;
   {
     std::lock_guard<std::mutex> lk(_mutex);
     uint64_t highestBinlogid = store->getHighestBinlogId();
-    string slaveNode = slave_listen_ip + ":" + to_string(slave_listen_port);
     auto iter = _fullPushStatus[storeId].find(slaveNode);
     if (iter != _fullPushStatus[storeId].end()) {
       LOG(INFO) << "supplyFullSyncRoutine already have _fullPushStatus, "
                 << iter->second->toString();
-      if (iter->second->state == FullPushState::ERR) {
-        _fullPushStatus[storeId].erase(iter);
-      } else {
+      if (iter->second->state != FullPushState::ERR) {
         client->writeLine("-ERR already have _fullPushStatus, " +
                           iter->second->toString());
         return;
       }
     }
+    // there is one checkpoint of a store at most, the one kept for
+    // resuming is reused by the same slave, or released for a new one.
+    auto& pushStatus = _fullPushStatus[storeId];
+    for (auto it = pushStatus.begin(); it != pushStatus.end();) {
+      if (it->second->state != FullPushState::ERR) {
+        ++it;
+        continue;
+      }
+      auto& ckpt = it->second->ckpt;
+      if (ckpt) {
+        if (it->first == slaveNode && resumePos != 0 &&
+            ckpt->getBinlogPos() == resumePos) {
+          resumed = std::move(ckpt);
+        } else {
+          releaseCkpt = true;
+        }
+      }
+      it = pushStatus.erase(it);
+    }
+    if (resumed) {
+      highestBinlogid = resumed->getBinlogPos();
+    }
 
-    uint64_t clientId = _clientIdGen.fetch_add(1);
+    clientId = _clientIdGen.fetch_add(1);
 #if defined(_WIN32) && _MSC_VER > 1900
     _fullPushStatus[storeId][slaveNode] =
       new MPovFullPushStatus{storeId,
@@ -378,33 +468,54 @@ void ReplManager::supplyFullSyncRoutine(
                                slave_listen_port}));
 #endif
   }
+  if (releaseCkpt) {
+    LOG(INFO) << "supplyFullSyncRoutine release the checkpoint kept of store:"
+              << storeId;
+    store->releaseBackup();
+  }
   bool hasError = true;
-  auto guard_0 = MakeGuard(
-    [this, store, storeId, &hasError, slave_listen_ip, slave_listen_port]() {
-      std::lock_guard<std::mutex> lk(_mutex);
-      string slaveNode = slave_listen_ip + ":" + to_string(slave_listen_port);
-      auto iter = _fullPushStatus[storeId].find(slaveNode);
-      if (iter != _fullPushStatus[storeId].end()) {
-        if (hasError) {
-          LOG(INFO) << "supplyFullSyncRoutine hasError, _fullPushStatus erase, "
-                    << iter->second->toString();
-          _fullPushStatus[storeId].erase(iter);
-        } else {
-          iter->second->endTime = SCLOCK::now();
-          iter->second->state = FullPushState::SUCESS;
-        }
+  std::unique_ptr<BackupInfo> retained;
+  auto guard_0 = MakeGuard([this,
+                            store,
+                            storeId,
+                            &hasError,
+                            &retained,
+                            slave_listen_ip,
+                            slave_listen_port]() {
+    std::lock_guard<std::mutex> lk(_mutex);
+    string slaveNode = slave_listen_ip + ":" + to_string(slave_listen_port);
+    auto iter = _fullPushStatus[storeId].find(slaveNode);
+    if (iter != _fullPushStatus[storeId].end()) {
+      if (hasError && retained) {
+        iter->second->endTime = SCLOCK::now();
+        iter->second->state = FullPushState::ERR;
+        iter->second->ckpt = std::move(retained);
+        LOG(INFO) << "supplyFullSyncRoutine hasError, keep the checkpoint, "
+                  << iter->second->toString();
+      } else if (hasError) {
+        LOG(INFO) << "supplyFullSyncRoutine hasError, _fullPushStatus erase, "
+                  << iter->second->toString();
+        _fullPushStatus[storeId].erase(iter);
       } else {
-        LOG(ERROR) << "supplyFullSyncRoutine, _fullPushStatus find node "
-                      "failed, storeid:"
-                   << storeId << " slave node:" << slaveNode;
+        iter->second->endTime = SCLOCK::now();
+        iter->second->state = FullPushState::SUCESS;
+      }
+    } else {
+      LOG(ERROR) << "supplyFullSyncRoutine, _fullPushStatus find node "
+                    "failed, storeid:"
+                 << storeId << " slave node:" << slaveNode;
+      if (retained) {
+        store->releaseBackup();
       }
-    });
+    }
+  });
 
   uint64_t currTime = nsSinceEpoch();
-  Expected<BackupInfo> bkInfo =
-    store->backup(store->dftBackupDir(),
-                  KVStore::BackupMode::BACKUP_CKPT_INTER,
-                  _svr->getCatalog()->getBinlogVersion());
+  Expected<BackupInfo> bkInfo = resumed
+    ? Expected<BackupInfo>(*resumed)
+    : store->backup(store->dftBackupDir(),
+                    KVStore::BackupMode::BACKUP_CKPT_INTER,
+                    _svr->getCatalog()->getBinlogVersion());
   if (!bkInfo.ok()) {
     std::stringstream ss;
     ss << "-ERR backup failed:" << bkInfo.status().toString();
@@ -414,10 +525,17 @@ void ReplManager::supplyFullSyncRoutine(
   } else {
     LOG(INFO) << "storeId:" << storeId
               << ",backup cost:" << (nsSinceEpoch() - currTime) << "ns"
-              << ",pos:" << bkInfo.value().getBinlogPos();
+              << ",pos:" << bkInfo.value().getBinlogPos()
+              << ",resumed:" << (resumed != nullptr);
   }
 
-  auto guard = MakeGuard([this, store, storeId]() {
+  auto guard = MakeGuard([this, store, storeId, streaming, &hasError, &bkInfo,
+                          &retained]() {
+    if (hasError && streaming && _cfg->fullSyncResumeSecs > 0) {
+      // see recycleFullPushStatus()
+      retained = std::make_unique<BackupInfo>(bkInfo.value());
+      return;
+    }
     Status s = store->releaseBackup();
     if (!s.ok()) {
       LOG(ERROR) << "supplyFullSync end clean store:" << storeId
@@ -454,52 +572,63 @@ void ReplManager::supplyFullSyncRoutine(
   LOG(INFO) << "fullsync " << storeId
             << " send fileList success:" << sb.GetString();
 
-  std::string readBuf;
-  size_t fileBatch = (_cfg->binlogRateLimitMB * 1024 * 1024) / 10;
-  readBuf.reserve(fileBatch);
-  for (auto& fileInfo : bkInfo.value().getFileList()) {
-    s = client->writeLine(fileInfo.first);
-    if (!s.ok()) {
-      LOG(ERROR) << "write fname:" << fileInfo.first
-                 << " to client failed:" << s.toString();
+  if (streaming) {
+    if (!supplyFileStreams(client,
+                           storeId,
+                           slaveNode,
+                           clientId,
+                           store->dftBackupDir(),
+                           bkInfo.value().getFileList())) {
       return;
     }
-    LOG(INFO) << "fulsync send filename success:" << fileInfo.first;
-    std::string fname = store->dftBackupDir() + "/" + fileInfo.first;
-    auto myfile = std::ifstream(fname, std::ios::binary);
-    if (!myfile.is_open()) {
-      LOG(ERROR) << "open file:" << fname << " for read failed";
-      return;
-    }
-    size_t remain = fileInfo.second;
-    while (remain) {
-      size_t batchSize = std::min(remain, fileBatch);
-      _rateLimiter->Request(batchSize);
-      readBuf.resize(batchSize);
-      remain -= batchSize;
-      myfile.read(&readBuf[0], batchSize);
-      if (!myfile) {
-        LOG(ERROR) << "read file:" << fname
-                   << " failed with err:" << strerror(errno);
-        return;
-      }
-      s = client->writeData(readBuf);
+  } else {
+    std::string readBuf;
+    size_t fileBatch = (_cfg->binlogRateLimitMB * 1024 * 1024) / 10;
+    readBuf.reserve(fileBatch);
+    for (auto& fileInfo : bkInfo.value().getFileList()) {
+      s = client->writeLine(fileInfo.first);
       if (!s.ok()) {
-        LOG(ERROR) << "write bulk to client failed:" << s.toString();
+        LOG(ERROR) << "write fname:" << fileInfo.first
+                   << " to client failed:" << s.toString();
         return;
       }
-      secs = _cfg->timeoutSecBinlogWaitRsp;  // 10
-      auto rpl = client->readLine(std::chrono::seconds(secs));
-      if (!rpl.ok() || rpl.value() != "+OK") {
-        LOG(ERROR) << "send client:" << client->getRemoteRepr()
-                   << "file:" << fileInfo.first << ",size:" << fileInfo.second
-                   << " failed:"
-                   << (rpl.ok() ? rpl.value()
-                                : rpl.status().toString());  // NOLINT
+      LOG(INFO) << "fulsync send filename success:" << fileInfo.first;
+      std::string fname = store->dftBackupDir() + "/" + fileInfo.first;
+      auto myfile = std::ifstream(fname, std::ios::binary);
+      if (!myfile.is_open()) {
+        LOG(ERROR) << "open file:" << fname << " for read failed";
         return;
       }
+      size_t remain = fileInfo.second;
+      while (remain) {
+        size_t batchSize = std::min(remain, fileBatch);
+        _rateLimiter->Request(batchSize);
+        readBuf.resize(batchSize);
+        remain -= batchSize;
+        myfile.read(&readBuf[0], batchSize);
+        if (!myfile) {
+          LOG(ERROR) << "read file:" << fname
+                     << " failed with err:" << strerror(errno);
+          return;
+        }
+        s = client->writeData(readBuf);
+        if (!s.ok()) {
+          LOG(ERROR) << "write bulk to client failed:" << s.toString();
+          return;
+        }
+        secs = _cfg->timeoutSecBinlogWaitRsp;  // 10
+        auto rpl = client->readLine(std::chrono::seconds(secs));
+        if (!rpl.ok() || rpl.value() != "+OK") {
+          LOG(ERROR) << "send client:" << client->getRemoteRepr()
+                     << "file:" << fileInfo.first << ",size:" << fileInfo.second
+                     << " failed:"
+                     << (rpl.ok() ? rpl.value()
+                                  : rpl.status().toString());  // NOLINT
+          return;
+        }
+      }
+      LOG(INFO) << "fulsync send file success:" << fname;
     }
-    LOG(INFO) << "fulsync send file success:" << fname;
   }
   secs = _cfg->timeoutSecBinlogWaitRsp;  // 10
   Expected<std::string> reply = client->readLine(std::chrono::seconds(secs));
@@ -514,4 +643,130 @@ void ReplManager::supplyFullSyncRoutine(
   }
 }
 
+// the streaming protocol of fullsync:
+// send clientId, the slave attaches its other connections with it
+// read "+STREAMS n", n is the number of connections in total
+// read [filename, ...], the files the slave has already got
+// the other files are sent over the n connections in parallel, by
+// sendFileStream(), without waiting for replies
+// send "+END" over each connection
+bool ReplManager::supplyFileStreams(
+  const std::shared_ptr<BlockingTcpClient>& client,
+  uint32_t storeId,
+  const string& slaveNode,
+  uint64_t clientId,
+  const std::string& dir,
+  const std::map<std::string, uint64_t>& flist) {
+  auto secs = std::chrono::seconds(_cfg->timeoutSecBinlogWaitRsp);
+  Status s = client->writeLine(std::to_string(clientId));
+  if (!s.ok()) {
+    LOG(ERROR) << "store:" << storeId
+               << " fullsync send clientId failed:" << s.toString();
+    return false;
+  }
+  auto expStreams = client->readLine(secs);
+  if (!expStreams.ok()) {
+    LOG(ERROR) << "store:" << storeId << " fullsync read streams failed:"
+               << expStreams.status().toString();
+    return false;
+  }
+  auto args = stringSplit(expStreams.value(), " ");
+  Expected<uint64_t> streamNum = {ErrorCodes::ERR_PARSEPKT, ""};
+  if (args.size() == 2 && args[0] == "+STREAMS") {
+    streamNum = tendisplus::stoul(args[1]);
+  }
+  if (!streamNum.ok()) {
+    LOG(ERROR) << "store:" << storeId
+               << " fullsync invalid streams:" << expStreams.value();
+    return false;
+  }
+
+  auto expSkip = client->readLine(secs);
+  if (!expSkip.ok()) {
+    LOG(ERROR) << "store:" << storeId << " fullsync read files got failed:"
+               << expSkip.status().toString();
+    return false;
+  }
+  rapidjson::Document doc;
+  doc.Parse(expSkip.value());
+  if (doc.HasParseError() || !doc.IsArray()) {
+    LOG(ERROR) << "store:" << storeId
+               << " fullsync invalid files got:" << expSkip.value();
+    return false;
+  }
+  std::set<std::string> skip;
+  for (const auto& v : doc.GetArray()) {
+    if (v.IsString()) {
+      skip.insert(v.GetString());
+    }
+  }
+
+  std::vector<std::shared_ptr<BlockingTcpClient>> streams{client};
+  {
+    std::lock_guard<std::mutex> lk(_mutex);
+    auto iter = _fullPushStatus[storeId].find(slaveNode);
+    if (iter != _fullPushStatus[storeId].end()) {
+      for (auto& c : iter->second->streams) {
+        streams.emplace_back(std::move(c));
+      }
+      iter->second->streams.clear();
+    }
+  }
+  if (streams.size() != streamNum.value()) {
+    LOG(ERROR) << "store:" << storeId << " fullsync streams:" << streams.size()
+               << " not match the slave's:" << streamNum.value();
+    return false;
+  }
+
+  // the big files first, so that the streams end at about the same time
+  std::vector<std::pair<std::string, uint64_t>> files;
+  for (const auto& kv : flist) {
+    if (!skip.count(kv.first)) {
+      files.emplace_back(kv);
+    }
+  }
+  std::sort(files.begin(), files.end(), [](const auto& a, const auto& b) {
+    return a.second > b.second;
+  });
+  size_t fileBatch = (_cfg->binlogRateLimitMB * 1024 * 1024) / 10;
+  std::atomic<size_t> next(0);
+  std::atomic<bool> failed(false);
+  auto sendFiles = [this, &dir, &files, &next, &failed, fileBatch, secs](
+                     BlockingTcpClient* c) {
+    for (size_t i = next++; i < files.size() && !failed; i = next++) {
+      auto s = sendFileStream(c,
+                              [this](uint64_t n) { _rateLimiter->Request(n); },
+                              dir,
+                              files[i].first,
+                              files[i].second,
+                              fileBatch,
+                              secs);
+      if (!s.ok()) {
+        LOG(ERROR) << "send file:" << files[i].first << " to "
+                   << c->getRemoteRepr() << " failed:" << s.toString();
+        failed = true;
+        return;
+      }
+    }
+    if (!failed && !c->writeLine("+END").ok()) {
+      failed = true;
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < streams.size(); i++) {
+    threads.emplace_back(sendFiles, streams[i].get());
+  }
+  sendFiles(client.get());
+  for (auto& t : threads) {
+    t.join();
+  }
+  if (failed) {
+    return false;
+  }
+  LOG(INFO) << "fullsync " << storeId << " send files success over "
+            << streams.size() << " streams, skipped:" << skip.size();
+  return true;
+}
+
 }  // namespace tendisplus
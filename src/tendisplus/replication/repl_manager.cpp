@@ -88,6 +88,7 @@ ReplManager::ReplManager(std::shared_ptr<ServerEntry> svr,
     _fullReceiveMatrix(std::make_shared<PoolMatrix>()),
     _incrCheckMatrix(std::make_shared<PoolMatrix>()),
     _logRecycleMatrix(std::make_shared<PoolMatrix>()),
+    _incrApplyMatrix(std::make_shared<PoolMatrix>()),
     _connectMasterTimeoutMs(1000) {
   _cfg->serverParamsVar("incrPushThreadnum")->setUpdate([this]() {
     incrPusherResize(_cfg->incrPushThreadnum);
@@ -101,6 +102,9 @@ ReplManager::ReplManager(std::shared_ptr<ServerEntry> svr,
   _cfg->serverParamsVar("logRecycleThreadnum")->setUpdate([this]() {
     logRecyclerResize(_cfg->logRecycleThreadnum);
   });
+  _cfg->serverParamsVar("incrApplyThreadnum")->setUpdate([this]() {
+    incrApplierResize(_cfg->incrApplyThreadnum);
+  });
 }
 
 Status ReplManager::stopStore(uint32_t storeId) {
@@ -115,6 +119,11 @@ Status ReplManager::stopStore(uint32_t storeId) {
   for (auto& mpov : _pushStatus[storeId]) {
     mpov.second->nextSchedTime = SCLOCK::time_point::max();
   }
+  for (auto& mpov : _fullPushStatus[storeId]) {
+    if (mpov.second->ckpt) {
+      releaseFullSyncCkpt(storeId);
+    }
+  }
   _fullPushStatus[storeId].clear();
 
   return {ErrorCodes::ERR_OK, ""};
@@ -183,6 +192,13 @@ Status ReplManager::startup() {
     return s;
   }
 
+  _incrApplier =
+    std::make_unique<WorkerPool>("tx-repl-sinc", _incrApplyMatrix);
+  s = _incrApplier->startup(_cfg->incrApplyThreadnum);
+  if (!s.ok()) {
+    return s;
+  }
+
   for (uint32_t i = 0; i < _svr->getKVStoreCount(); i++) {
     // here we are starting up, dont acquire a storelock.
     auto expdb =
@@ -581,17 +597,45 @@ void ReplManager::controlRoutine() {
 void ReplManager::recycleFullPushStatus() {
   auto now = SCLOCK::now();
   for (size_t i = 0; i < _fullPushStatus.size(); i++) {
-    for (auto& mpov : _fullPushStatus[i]) {
+    for (auto it = _fullPushStatus[i].begin();
+         it != _fullPushStatus[i].end();) {
+      auto& mpov = it->second;
+      bool timeout = false;
       // if timeout, delte it.
-      if (mpov.second->state == FullPushState::SUCESS &&
-          now > mpov.second->endTime + std::chrono::seconds(600)) {
-        LOG(ERROR) << "timeout, _fullPushStatus erase,"
-                   << mpov.second->toString();
-        _fullPushStatus[i].erase(mpov.first);
+      if (mpov->state == FullPushState::SUCESS &&
+          now > mpov->endTime + std::chrono::seconds(600)) {
+        timeout = true;
+      } else if (mpov->state == FullPushState::ERR && mpov->ckpt &&
+                 now > mpov->endTime +
+                     std::chrono::seconds(_cfg->fullSyncResumeSecs)) {
+        // the checkpoint kept for resuming, see supplyFullSyncRoutine()
+        releaseFullSyncCkpt(i);
+        timeout = true;
+      }
+      if (timeout) {
+        LOG(ERROR) << "timeout, _fullPushStatus erase," << mpov->toString();
+        it = _fullPushStatus[i].erase(it);
+      } else {
+        ++it;
       }
     }
   }
 }
+
+void ReplManager::releaseFullSyncCkpt(uint32_t storeId) {
+  auto expdb =
+    _svr->getSegmentMgr()->getDb(nullptr, storeId, mgl::LockMode::LOCK_NONE);
+  if (!expdb.ok()) {
+    LOG(ERROR) << "releaseFullSyncCkpt getDb failed, storeId:" << storeId
+               << " err:" << expdb.status().toString();
+    return;
+  }
+  auto s = expdb.value().store->releaseBackup();
+  if (!s.ok()) {
+    LOG(ERROR) << "releaseFullSyncCkpt failed, storeId:" << storeId
+               << " err:" << s.toString();
+  }
+}
 void ReplManager::onFlush(uint32_t storeId, uint64_t binlogid) {
   std::lock_guard<std::mutex> lk(_mutex);
   auto& v = _logRecycStatus[storeId];
@@ -1533,6 +1577,7 @@ void ReplManager::stop() {
   _fullReceiver->stop();
   _incrChecker->stop();
   _logRecycler->stop();
+  _incrApplier->stop();
 
 #if defined(_WIN32) && _MSC_VER > 1900
   for (size_t i = 0; i < _pushStatus.size(); i++) {
@@ -1577,6 +1622,10 @@ void ReplManager::logRecyclerResize(size_t size) {
   _logRecycler->resize(size);
 }
 
+void ReplManager::incrApplierResize(size_t size) {
+  _incrApplier->resize(size);
+}
+
 size_t ReplManager::fullPusherSize() {
   return _fullPusher->size();
 }
@@ -1593,4 +1642,8 @@ size_t ReplManager::logRecycleSize() {
   return _logRecycler->size();
 }
 
+size_t ReplManager::incrApplierSize() {
+  return _incrApplier->size();
+}
+
 }  // namespace tendisplus
@@ -75,6 +75,10 @@ struct MPovFullPushStatus {
   uint64_t clientId;
   string slave_listen_ip;
   uint16_t slave_listen_port;
+  // the other connections attached by the slave, see attachFullSync()
+  std::vector<std::shared_ptr<BlockingTcpClient>> streams;
+  // the checkpoint kept for the slave to resume after ERR
+  std::unique_ptr<BackupInfo> ckpt;
 };
 
 struct RecycleBinlogStatus {
@@ -150,10 +154,20 @@ class ReplManager {
                                 uint32_t port,
                                 uint32_t sourceStoreId,
                                 bool checkEmpty = true);
+  // if streamsArg is not empty, the files are sent by the streaming
+  // protocol, see supplyFileStreams(). The checkpoint of resumePosArg is
+  // reused if it's kept.
   bool supplyFullSync(asio::ip::tcp::socket sock,
                       const std::string& storeIdArg,
                       const std::string& slaveIpArg,
-                      const std::string& slavePortArg);
+                      const std::string& slavePortArg,
+                      const std::string& streamsArg = "",
+                      const std::string& resumePosArg = "");
+  bool attachFullSync(asio::ip::tcp::socket sock,
+                      const std::string& storeIdArg,
+                      const std::string& slaveIpArg,
+                      const std::string& slavePortArg,
+                      const std::string& clientIdArg);
   bool registerIncrSync(asio::ip::tcp::socket sock,
                         const std::string& storeIdArg,
                         const std::string& dstStoreIdArg,
@@ -176,6 +190,11 @@ class ReplManager {
                         uint32_t storeId,
                         const std::string& logKey,
                         const std::string& logValue);
+  // apply a batch of binlogs from the master, in parallel if
+  // incrApplyThreadnum > 1
+  Status applyRepllogsV2(Session* sess,
+                         uint32_t storeId,
+                         const std::vector<ReplLogRawV2>& logs);
 #endif
   bool flushCurBinlogFs(uint32_t storeId);
   void appendJSONStat(rapidjson::PrettyWriter<rapidjson::StringBuffer>&) const;
@@ -192,11 +211,13 @@ class ReplManager {
   void fullReceiverResize(size_t size);
   void incrPusherResize(size_t size);
   void logRecyclerResize(size_t size);
+  void incrApplierResize(size_t size);
 
   size_t fullPusherSize();
   size_t fullReceiverSize();
   size_t incrPusherSize();
   size_t logRecycleSize();
+  size_t incrApplierSize();
 
   std::string getMasterHost() const;
   uint32_t getMasterPort() const;
@@ -213,12 +234,27 @@ class ReplManager {
   void supplyFullSyncRoutine(std::shared_ptr<BlockingTcpClient> client,
                              uint32_t storeId,
                              const string& slave_listen_ip,
-                             uint16_t slave_listen_port);
+                             uint16_t slave_listen_port,
+                             bool streaming,
+                             uint64_t resumePos);
+  bool supplyFileStreams(const std::shared_ptr<BlockingTcpClient>& client,
+                         uint32_t storeId,
+                         const string& slaveNode,
+                         uint64_t clientId,
+                         const std::string& dir,
+                         const std::map<std::string, uint64_t>& flist);
   bool isFullSupplierFull() const;
+  void releaseFullSyncCkpt(uint32_t storeId);
 
   std::shared_ptr<BlockingTcpClient> createClient(const StoreMeta&,
                                                   uint64_t timeoutMs = 1000);
   void slaveStartFullsync(const StoreMeta&);
+  Status slaveRecvFileStreams(const StoreMeta& metaSnapshot,
+                              std::shared_ptr<BlockingTcpClient> client,
+                              uint32_t streams,
+                              const std::string& dir,
+                              const std::map<std::string, uint64_t>& flist,
+                              std::map<std::string, uint64_t>* received);
   void slaveChkSyncStatus(const StoreMeta&);
   std::ofstream* getCurBinlogFs(uint32_t storeid);
 
@@ -305,6 +341,9 @@ class ReplManager {
   // master and slave's pov, log recycler
   std::unique_ptr<WorkerPool> _logRecycler;
 
+  // slave's pov, workerpool of applying binlogs in parallel
+  std::unique_ptr<WorkerPool> _incrApplier;
+
   std::atomic<uint64_t> _clientIdGen;
 
   const std::string _dumpPath;
@@ -316,6 +355,7 @@ class ReplManager {
   std::shared_ptr<PoolMatrix> _fullReceiveMatrix;
   std::shared_ptr<PoolMatrix> _incrCheckMatrix;
   std::shared_ptr<PoolMatrix> _logRecycleMatrix;
+  std::shared_ptr<PoolMatrix> _incrApplyMatrix;
   uint64_t _connectMasterTimeoutMs;
 };
 
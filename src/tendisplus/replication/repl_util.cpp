@@ -4,11 +4,23 @@
 
 #include "tendisplus/replication/repl_util.h"
 
+#include <fcntl.h>
+#ifndef _WIN32
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
+
+#include <algorithm>
+#include <fstream>
 #include <memory>
 #include <string>
 #include <utility>
 #include "glog/logging.h"
 #include "tendisplus/commands/command.h"
+#include "tendisplus/utils/portable.h"
+#include "tendisplus/utils/redis_port.h"
+#include "tendisplus/utils/scopeguard.h"
 
 namespace tendisplus {
 
@@ -493,4 +505,101 @@ Status SendSlotsBinlog(BlockingTcpClient* client,
   return {ErrorCodes::ERR_OK, ""};
 }
 
+Status sendFileStream(BlockingTcpClient* client,
+                      const std::function<void(uint64_t)>& rateLimit,
+                      const std::string& dir,
+                      const std::string& name,
+                      uint64_t size,
+                      size_t batch,
+                      std::chrono::seconds timeout) {
+  std::string fname = dir + "/" + name;
+  int flags = O_RDONLY;
+#ifdef O_BINARY
+  flags |= O_BINARY;
+#endif
+  int fd = ::open(fname.c_str(), flags);
+  if (fd < 0) {
+    return {ErrorCodes::ERR_INTERNAL,
+            "open file:" + fname + " failed:" + strerror(errno)};
+  }
+  const auto guard = MakeGuard([fd] { ::close(fd); });
+
+  auto s = client->writeLine(name + " " + std::to_string(size));
+  if (!s.ok()) {
+    return s;
+  }
+  for (uint64_t offset = 0; offset < size;) {
+    uint64_t n = std::min<uint64_t>(size - offset, batch);
+    rateLimit(n);
+    s = client->writeFile(fd, offset, n, timeout);
+    if (!s.ok()) {
+      return s;
+    }
+    offset += n;
+  }
+
+  // the file is still in the page cache
+  if (::lseek(fd, 0, SEEK_SET) < 0) {
+    return {ErrorCodes::ERR_INTERNAL, strerror(errno)};
+  }
+  uint64_t crc = 0;
+  std::string buf(1024 * 1024, '\0');
+  for (uint64_t remain = size; remain > 0;) {
+    auto n = ::read(fd, &buf[0], std::min<uint64_t>(remain, buf.size()));
+    if (n <= 0) {
+      return {ErrorCodes::ERR_INTERNAL,
+              "read file:" + fname + " failed:" +
+                (n < 0 ? strerror(errno) : "unexpected end of file")};
+    }
+    crc = redis_port::crc64(crc, reinterpret_cast<unsigned char*>(&buf[0]), n);
+    remain -= n;
+  }
+  return client->writeLine(std::to_string(crc));
+}
+
+Expected<uint64_t> recvFileStream(BlockingTcpClient* client,
+                                  const std::string& fullFileName,
+                                  uint64_t size,
+                                  size_t batch,
+                                  std::chrono::seconds timeout) {
+  std::error_code ec;
+  filesystem::path fileDir = filesystem::path(fullFileName).remove_filename();
+  filesystem::create_directories(fileDir, ec);
+  if (ec) {
+    return {ErrorCodes::ERR_INTERNAL,
+            "create dir:" + fileDir.string() + " failed:" + ec.message()};
+  }
+  auto myfile = std::fstream(fullFileName, std::ios::out | std::ios::binary);
+  if (!myfile.is_open()) {
+    return {ErrorCodes::ERR_INTERNAL,
+            "open file:" + fullFileName + " for write failed"};
+  }
+  uint64_t crc = 0;
+  for (uint64_t remain = size; remain > 0;) {
+    size_t batchSize = std::min<uint64_t>(remain, batch);
+    remain -= batchSize;
+    auto exptData = client->read(batchSize, timeout);
+    if (!exptData.ok()) {
+      return exptData.status();
+    }
+    const auto& data = exptData.value();
+    crc = redis_port::crc64(
+      crc, reinterpret_cast<const unsigned char*>(data.c_str()), data.size());
+    myfile.write(data.c_str(), data.size());
+    if (myfile.bad()) {
+      return {ErrorCodes::ERR_INTERNAL,
+              "write file:" + fullFileName + " failed:" + strerror(errno)};
+    }
+  }
+  myfile.close();
+  auto expCrc = client->readLine(timeout);
+  if (!expCrc.ok()) {
+    return expCrc.status();
+  }
+  if (expCrc.value() != std::to_string(crc)) {
+    return {ErrorCodes::ERR_INTERNAL, "crc64 mismatch of " + fullFileName};
+  }
+  return crc;
+}
+
 }  // namespace tendisplus
@@ -5,6 +5,8 @@
 #ifndef SRC_TENDISPLUS_REPLICATION_REPL_UTIL_H_
 #define SRC_TENDISPLUS_REPLICATION_REPL_UTIL_H_
 
+#include <chrono>  // NOLINT
+#include <functional>
 #include <memory>
 #include <string>
 #include "tendisplus/cluster/cluster_manager.h"
@@ -81,6 +83,27 @@ Status SendSlotsBinlog(BlockingTcpClient*,
                        bool* needRetry,
                        uint64_t* binlogTimeStamp);
 
+// send one file as a stream:
+// "filename filesize\r\n", the content, "crc64 of the content\r\n"
+// the content is sent by sendfile() and limited by rateLimit, the peer
+// doesn't reply for it.
+Status sendFileStream(BlockingTcpClient* client,
+                      const std::function<void(uint64_t)>& rateLimit,
+                      const std::string& dir,
+                      const std::string& name,
+                      uint64_t size,
+                      size_t batch,
+                      std::chrono::seconds timeout);
+
+// receive the content and the crc64 sent by sendFileStream() into
+// fullFileName, the header line has been read by the caller.
+// return the crc64 of the file
+Expected<uint64_t> recvFileStream(BlockingTcpClient* client,
+                                  const std::string& fullFileName,
+                                  uint64_t size,
+                                  size_t batch,
+                                  std::chrono::seconds timeout);
+
 }  // namespace tendisplus
 
 #endif  // SRC_TENDISPLUS_REPLICATION_REPL_UTIL_H_
@@ -3,7 +3,9 @@
 // project for additional information.
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>  // NOLINT
+#include <condition_variable>  // NOLINT
 #include <fstream>
 #include <limits>
 #include <list>
@@ -11,7 +13,10 @@
 #include <memory>
 #include <set>
 #include <string>
+#include <thread>  // NOLINT
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include "glog/logging.h"
 #include "rapidjson/document.h"
@@ -28,15 +33,102 @@
 #include "tendisplus/utils/redis_port.h"
 #include "tendisplus/utils/scopeguard.h"
 #include "tendisplus/utils/string.h"
+#include "tendisplus/utils/sync_point.h"
 
 namespace tendisplus {
 
+namespace {
+// the files got by a failed fullsync are kept in the resume dir, with a
+// manifest of {"master", "binlogPos", "files": {name: [size, crc64]}}
+const char FULLSYNC_MANIFEST[] = "fullsync_manifest";
+
+std::string syncSource(const StoreMeta& meta) {
+  return meta.syncFromHost + ":" + std::to_string(meta.syncFromPort) + ":" +
+    std::to_string(meta.syncFromId);
+}
+
+Status saveFullSyncManifest(const std::string& dir,
+                            const std::string& master,
+                            uint64_t binlogPos,
+                            const std::map<std::string, uint64_t>& received) {
+  rapidjson::StringBuffer sb;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(sb);
+  writer.StartObject();
+  writer.Key("master");
+  writer.String(master.c_str());
+  writer.Key("binlogPos");
+  writer.Uint64(binlogPos);
+  writer.Key("files");
+  writer.StartObject();
+  for (const auto& kv : received) {
+    std::error_code ec;
+    auto size = filesystem::file_size(dir + "/" + kv.first, ec);
+    if (ec) {
+      continue;
+    }
+    writer.Key(kv.first.c_str());
+    writer.StartArray();
+    writer.Uint64(size);
+    writer.Uint64(kv.second);
+    writer.EndArray();
+  }
+  writer.EndObject();
+  writer.EndObject();
+
+  std::ofstream file(dir + "/" + FULLSYNC_MANIFEST);
+  if (!file.is_open()) {
+    return {ErrorCodes::ERR_INTERNAL, "open fullsync manifest failed"};
+  }
+  file << sb.GetString();
+  file.close();
+  if (file.fail()) {
+    return {ErrorCodes::ERR_INTERNAL, "write fullsync manifest failed"};
+  }
+  return {ErrorCodes::ERR_OK, ""};
+}
+
+// returns the binlogPos of the files got, 0 if it's not resumable
+uint64_t loadFullSyncManifest(
+  const std::string& dir,
+  const std::string& master,
+  std::map<std::string, std::pair<uint64_t, uint64_t>>* files) {
+  std::ifstream file(dir + "/" + FULLSYNC_MANIFEST);
+  if (!file.is_open()) {
+    return 0;
+  }
+  std::stringstream ss;
+  ss << file.rdbuf();
+  rapidjson::Document doc;
+  doc.Parse(ss.str());
+  if (doc.HasParseError() || !doc.IsObject() || !doc.HasMember("master") ||
+      !doc["master"].IsString() || doc["master"].GetString() != master ||
+      !doc.HasMember("binlogPos") || !doc["binlogPos"].IsUint64() ||
+      !doc.HasMember("files") || !doc["files"].IsObject()) {
+    return 0;
+  }
+  for (const auto& o : doc["files"].GetObject()) {
+    if (!o.value.IsArray() || o.value.Size() != 2 ||
+        !o.value[0].IsUint64() || !o.value[1].IsUint64()) {
+      return 0;
+    }
+    (*files)[o.name.GetString()] = {o.value[0].GetUint64(),
+                                    o.value[1].GetUint64()};
+  }
+  return doc["binlogPos"].GetUint64();
+}
+}  // namespace
+
 Expected<BackupInfo> getBackupInfo(BlockingTcpClient* client,
                                    const StoreMeta& metaSnapshot,
                                    const string& ip,
-                                   uint16_t port) {
+                                   uint16_t port,
+                                   uint32_t streams,
+                                   uint64_t resumePos) {
   std::stringstream ss;
   ss << "FULLSYNC " << metaSnapshot.syncFromId << " " << ip << " " << port;
+  if (streams > 0) {
+    ss << " " << streams << " " << resumePos;
+  }
   Status s = client->writeLine(ss.str());
   if (!s.ok()) {
     LOG(WARNING) << "fullSync master failed:" << s.toString();
@@ -96,8 +188,10 @@ Expected<BackupInfo> getBackupInfo(BlockingTcpClient* client,
 //     read content
 //     send +OK
 // send +OK
+// if fullSyncStreams > 0, the files are read by slaveRecvFileStreams()
 void ReplManager::slaveStartFullsync(const StoreMeta& metaSnapshot) {
   LOG(INFO) << "store:" << metaSnapshot.id << " fullsync start";
+  uint32_t streams = _cfg->fullSyncStreams;
 
   LocalSessionGuard sg(_svr.get());
   // NOTE(deyukong): there is no need to setup a guard to clean the temp ctx
@@ -129,11 +223,30 @@ void ReplManager::slaveStartFullsync(const StoreMeta& metaSnapshot) {
                << " failed:" << clearStatus.toString();
   }
 
+  // the files got by the last failed fullsync
+  std::string resumeDir = store->dftBackupDir() + ".resume";
+  std::map<std::string, std::pair<uint64_t, uint64_t>> resumeFiles;
+  uint64_t resumePos = 0;
+  if (streams > 0) {
+    resumePos =
+      loadFullSyncManifest(resumeDir, syncSource(metaSnapshot), &resumeFiles);
+  }
+  // the files got by this fullsync, name -> crc64
+  std::map<std::string, uint64_t> received;
+  uint64_t receivedPos = 0;
+
   std::shared_ptr<BlockingTcpClient> client;
   // 2) necessary pre-conditions all ok, startup a guard to rollback
   // state if failed
   bool rollback = true;
-  auto guard = MakeGuard([this, &rollback, &metaSnapshot, &store, &client] {
+  auto guard = MakeGuard([this,
+                          &rollback,
+                          &metaSnapshot,
+                          &store,
+                          &client,
+                          &resumeDir,
+                          &received,
+                          &receivedPos] {
     std::lock_guard<std::mutex> lk(_mutex);
     if (rollback) {
       auto newMeta = metaSnapshot.copy();
@@ -141,9 +254,28 @@ void ReplManager::slaveStartFullsync(const StoreMeta& metaSnapshot) {
       newMeta->binlogId = Transaction::TXNID_UNINITED;
       changeReplStateInLock(*newMeta, false);
 
+      std::error_code ec;
+      if (!received.empty()) {
+        // keep the files got for the next fullsync to resume from
+        filesystem::remove_all(resumeDir, ec);
+        filesystem::rename(store->dftBackupDir(), resumeDir, ec);
+        auto s = ec ? Status(ErrorCodes::ERR_INTERNAL, ec.message())
+                    : saveFullSyncManifest(resumeDir,
+                                           syncSource(metaSnapshot),
+                                           receivedPos,
+                                           received);
+        if (!s.ok()) {
+          LOG(ERROR) << "slaveStartFullsync rollback, keep files failed:"
+                     << s.toString();
+          filesystem::remove_all(resumeDir, ec);
+        } else {
+          LOG(INFO) << "slaveStartFullsync rollback, keep " << received.size()
+                    << " files in:" << resumeDir;
+        }
+      }
+
       LOG(INFO) << "slaveStartFullsync rollback, rm dir:"
                 << store->dftBackupDir();
-      std::error_code ec;
       filesystem::remove_all(filesystem::path(store->dftBackupDir()), ec);
       if (ec) {
         LOG(ERROR) << "slaveStartFullsync rollback, rm dir:"
@@ -176,7 +308,9 @@ void ReplManager::slaveStartFullsync(const StoreMeta& metaSnapshot) {
   auto ebkInfo = getBackupInfo(client.get(),
                                metaSnapshot,
                                _svr->getParams()->bindIp,
-                               _svr->getParams()->port);
+                               _svr->getParams()->port,
+                               streams,
+                               resumePos);
   if (!ebkInfo.ok()) {
     LOG(WARNING) << "storeId:" << metaSnapshot.id
                  << ",syncMaster:" << metaSnapshot.syncFromHost << ":"
@@ -205,6 +339,49 @@ void ReplManager::slaveStartFullsync(const StoreMeta& metaSnapshot) {
   auto flist = ebkInfo.value().getFileList();
 
   std::set<std::string> finishedFiles;
+  if (streams > 0) {
+    // the master keeps the checkpoint of the last failed fullsync, the
+    // files got already are not sent again.
+    std::error_code ec;
+    if (resumePos != 0 && resumePos == ebkInfo.value().getBinlogPos()) {
+      filesystem::rename(resumeDir, store->dftBackupDir(), ec);
+      if (!ec) {
+        filesystem::remove(store->dftBackupDir() + "/" + FULLSYNC_MANIFEST, ec);
+        for (const auto& kv : resumeFiles) {
+          auto it = flist.find(kv.first);
+          auto size = filesystem::file_size(
+            store->dftBackupDir() + "/" + kv.first, ec);
+          if (!ec && it != flist.end() && it->second == kv.second.first &&
+              size == kv.second.first) {
+            received[kv.first] = kv.second.second;
+          }
+        }
+        LOG(INFO) << "storeId:" << metaSnapshot.id << " fullsync resumes with "
+                  << received.size() << " files of binlogPos:" << resumePos;
+        size_t resumed = received.size();
+        TEST_SYNC_POINT_CALLBACK("ReplManager::slaveStartFullsync::resumed",
+                                 &resumed);
+      }
+    }
+    filesystem::remove_all(resumeDir, ec);
+    receivedPos = ebkInfo.value().getBinlogPos();
+
+    auto s = slaveRecvFileStreams(metaSnapshot,
+                                  client,
+                                  streams,
+                                  store->dftBackupDir(),
+                                  flist,
+                                  &received);
+    if (!s.ok()) {
+      LOG(WARNING) << "storeId:" << metaSnapshot.id
+                   << " fullsync recv files failed:" << s.toString();
+      return;
+    }
+    // all done, skip the loop below
+    for (const auto& kv : flist) {
+      finishedFiles.insert(kv.first);
+    }
+  }
   while (true) {
     if (finishedFiles.size() == flist.size()) {
       break;
@@ -323,6 +500,141 @@ void ReplManager::slaveStartFullsync(const StoreMeta& metaSnapshot) {
             << ",restart binlogId:" << restartStatus.value();
 }
 
+// the streaming protocol of fullsync, see ReplManager::supplyFileStreams()
+// read clientId
+// attach the other streams-1 connections with clientId
+// send "+STREAMS n", n is the number of connections attached in total
+// send [filename, ...] of received, the files got already
+// foreach connection, in parallel
+//     read "filename filesize", content and crc64 until "+END"
+// the files got are added to received, even if it fails.
+Status ReplManager::slaveRecvFileStreams(
+  const StoreMeta& metaSnapshot,
+  std::shared_ptr<BlockingTcpClient> client,
+  uint32_t streams,
+  const std::string& dir,
+  const std::map<std::string, uint64_t>& flist,
+  std::map<std::string, uint64_t>* received) {
+  auto clientId = client->readLine(std::chrono::seconds(100));
+  if (!clientId.ok()) {
+    return clientId.status();
+  }
+  if (clientId.value().size() == 0 || clientId.value()[0] == '-') {
+    return {ErrorCodes::ERR_INTERNAL, "fullSync master not ok"};
+  }
+
+  std::vector<std::shared_ptr<BlockingTcpClient>> conns{client};
+  for (uint32_t i = 1; i < streams; i++) {
+    // go on with fewer connections if failed
+    auto c = createClient(metaSnapshot, _connectMasterTimeoutMs);
+    if (c == nullptr) {
+      break;
+    }
+    std::stringstream ss;
+    ss << "FULLSYNC " << metaSnapshot.syncFromId << " "
+       << _svr->getParams()->bindIp << " " << _svr->getParams()->port
+       << " attach " << clientId.value();
+    auto s = c->writeLine(ss.str());
+    if (!s.ok()) {
+      break;
+    }
+    auto rpl = c->readLine(std::chrono::seconds(10));
+    if (!rpl.ok() || rpl.value() != "+OK") {
+      LOG(WARNING) << "store:" << metaSnapshot.id << " fullsync attach failed:"
+                   << (rpl.ok() ? rpl.value() : rpl.status().toString());
+      break;
+    }
+    conns.emplace_back(std::move(c));
+  }
+  auto s = client->writeLine("+STREAMS " + std::to_string(conns.size()));
+  if (!s.ok()) {
+    return s;
+  }
+  rapidjson::StringBuffer sb;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(sb);
+  writer.StartArray();
+  for (const auto& kv : *received) {
+    writer.String(kv.first.c_str());
+  }
+  writer.EndArray();
+  s = client->writeLine(sb.GetString());
+  if (!s.ok()) {
+    return s;
+  }
+  LOG(INFO) << "store:" << metaSnapshot.id << " fullsync over "
+            << conns.size() << " streams";
+  size_t streamNum = conns.size();
+  TEST_SYNC_POINT_CALLBACK("ReplManager::slaveRecvFileStreams::streams",
+                           &streamNum);
+
+  size_t fileBatch = (_cfg->binlogRateLimitMB * 1024 * 1024) / 10;
+  std::mutex mutex;
+  Status result = {ErrorCodes::ERR_OK, ""};
+  auto recvFile = [&dir, &flist, &mutex, received, fileBatch](
+                    BlockingTcpClient* c, const std::string& header) -> Status {
+    auto args = stringSplit(header, " ");
+    if (args.size() != 2) {
+      return {ErrorCodes::ERR_PARSEPKT, "invalid file header:" + header};
+    }
+    const auto& name = args[0];
+    auto size = ::tendisplus::stoul(args[1]);
+    {
+      std::lock_guard<std::mutex> lk(mutex);
+      auto it = flist.find(name);
+      if (!size.ok() || it == flist.end() || it->second != size.value() ||
+          received->count(name)) {
+        return {ErrorCodes::ERR_PARSEPKT, "invalid file:" + header};
+      }
+    }
+
+    std::string fullFileName = dir + "/" + name;
+    auto crc = recvFileStream(
+      c, fullFileName, size.value(), fileBatch, std::chrono::seconds(100));
+    if (!crc.ok()) {
+      return crc.status();
+    }
+    LOG(INFO) << "fullsync file:" << fullFileName << " transfer done";
+    std::lock_guard<std::mutex> lk(mutex);
+    (*received)[name] = crc.value();
+    return {ErrorCodes::ERR_OK, ""};
+  };
+  auto recvFiles = [&recvFile, &mutex, &result](BlockingTcpClient* c) {
+    while (true) {
+      auto header = c->readLine(std::chrono::seconds(100));
+      Status s = header.status();
+      if (s.ok()) {
+        if (header.value() == "+END") {
+          return;
+        }
+        s = recvFile(c, header.value());
+        TEST_SYNC_POINT_CALLBACK("ReplManager::slaveRecvFileStreams::recvFile",
+                                 &s);
+      }
+      if (!s.ok()) {
+        std::lock_guard<std::mutex> lk(mutex);
+        result = s;
+        return;
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < conns.size(); i++) {
+    threads.emplace_back(recvFiles, conns[i].get());
+  }
+  recvFiles(client.get());
+  for (auto& t : threads) {
+    t.join();
+  }
+  if (!result.ok()) {
+    return result;
+  }
+  if (received->size() != flist.size()) {
+    return {ErrorCodes::ERR_INTERNAL, "fullsync files missing"};
+  }
+  return {ErrorCodes::ERR_OK, ""};
+}
+
 void ReplManager::slaveChkSyncStatus(const StoreMeta& metaSnapshot) {
   bool reconn = [this, &metaSnapshot] {
     std::lock_guard<std::mutex> lk(_mutex);
@@ -535,6 +847,277 @@ Status ReplManager::applyRepllogV2(Session* sess,
   return {ErrorCodes::ERR_OK, ""};
 }
 
+namespace {
+// a binlog applied by an applier lane, waiting to be committed
+struct LanedBinlog {
+  const ReplLogRawV2* log;
+  uint64_t binlogId;
+  uint64_t timestamp;
+  std::unique_ptr<Transaction> txn;
+  std::vector<ReplLogValueEntryV2> entries;
+  Status status;
+};
+
+// the binlogs are dispatched at most SEGMENT_SIZE a time, to bound the
+// memory of the uncommitted txns
+constexpr size_t SEGMENT_SIZE = 1024;
+
+// The lane of a binlog is decided by the chunk of its keys, the binlogs of
+// the same chunk are applied in order by the same lane, and the binlogs of
+// different chunks never touch the same key.
+// -1 means the binlog should be applied alone, after all the binlogs before
+// it, such as the binlogs crossing lanes or with special ops.
+int32_t binlogLane(const std::vector<ReplLogValueEntryV2>& entries,
+                   uint32_t laneNum) {
+  int32_t lane = -1;
+  for (const auto& entry : entries) {
+    if (entry.getOp() != ReplOp::REPL_OP_SET &&
+        entry.getOp() != ReplOp::REPL_OP_DEL) {
+      return -1;
+    }
+    const auto& key = entry.getOpKey();
+    if (key.size() <= RecordKey::getHdrSize()) {
+      return -1;
+    }
+    auto chunkId = RecordKey::decodeChunkId(key);
+    if (chunkId == TTLIndex::CHUNKID) {
+      // the ttl index goes with the key it belongs to
+      continue;
+    } else if (chunkId >= CLUSTER_SLOTS) {
+      return -1;
+    }
+    int32_t l = chunkId % laneNum;
+    if (lane != -1 && lane != l) {
+      return -1;
+    }
+    lane = l;
+  }
+  return lane;
+}
+}  // namespace
+
+Status ReplManager::applyRepllogsV2(Session* sess,
+                                    uint32_t storeId,
+                                    const std::vector<ReplLogRawV2>& logs) {
+  uint32_t laneNum = _cfg->incrApplyThreadnum;
+  if (laneNum <= 1 || logs.size() <= 1) {
+    for (const auto& log : logs) {
+      auto s = applyRepllogV2(
+        sess, storeId, log.getReplLogKey(), log.getReplLogValue());
+      if (!s.ok()) {
+        return s;
+      }
+    }
+    return {ErrorCodes::ERR_OK, ""};
+  }
+
+  [this, storeId]() {
+    std::unique_lock<std::mutex> lk(_mutex);
+    _cv.wait(lk, [this, storeId] { return !_syncStatus[storeId]->isRunning; });
+    _syncStatus[storeId]->isRunning = true;
+  }();
+
+  uint64_t sessionId = sess->id();
+  uint64_t binlogTs = 0;
+  bool idMatch = [this, storeId, sessionId]() {
+    std::unique_lock<std::mutex> lk(_mutex);
+    return (sessionId == _syncStatus[storeId]->sessionId);
+  }();
+  auto guard = MakeGuard([this, storeId, &binlogTs, &idMatch] {
+    std::unique_lock<std::mutex> lk(_mutex);
+    INVARIANT_D(_syncStatus[storeId]->isRunning);
+    _syncStatus[storeId]->isRunning = false;
+    if (idMatch) {
+      _syncStatus[storeId]->lastSyncTime = SCLOCK::now();
+      if (binlogTs > _syncStatus[storeId]->lastBinlogTs) {
+        _syncStatus[storeId]->lastBinlogTs = binlogTs;
+      }
+    }
+  });
+
+  if (!idMatch) {
+    return {ErrorCodes::ERR_NOTFOUND, "sessionId not match"};
+  }
+
+  auto expdb =
+    _svr->getSegmentMgr()->getDb(sess, storeId, mgl::LockMode::LOCK_IX);
+  if (!expdb.ok()) {
+    return expdb.status();
+  }
+  if (!sess->getCtx()->isReplOnly()) {
+    INVARIANT_D(0);
+    return {ErrorCodes::ERR_INTERNAL, "It is not a slave"};
+  }
+  auto store = expdb.value().store;
+
+  // record the binlogs applied, in order
+  auto applied = [this, storeId, &store, &binlogTs](uint64_t binlogId,
+                                                    uint64_t ts) {
+    std::lock_guard<std::mutex> lk(_mutex);
+    _syncMeta[storeId]->binlogId = binlogId;
+    if (ts > binlogTs) {
+      binlogTs = ts;
+      store->setBinlogTime(ts);
+    }
+  };
+
+  std::vector<LanedBinlog> segment;
+  std::vector<std::vector<size_t>> lanes(laneNum);
+  // the keys written by the uncommitted txns of the segment
+  std::unordered_set<std::string> segmentKeys;
+  // The lanes apply the binlogs of a segment to their txns in parallel,
+  // then the txns are committed one by one in binlog order, so the store
+  // never moves past a binlog failed, and the writes crossing chunks are
+  // seen in order. The binlogIds are reserved by setBinlogKV() just
+  // before commit.
+  auto runSegment =
+    [this, &segment, &lanes, &segmentKeys, &applied]() -> Status {
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t running = 0;
+    for (size_t i = 0; i < lanes.size(); i++) {
+      if (lanes[i].empty()) {
+        continue;
+      }
+      running++;
+      _incrApplier->schedule([&segment, &lanes, &mutex, &cv, &running, i]() {
+        for (auto idx : lanes[i]) {
+          auto& lb = segment[idx];
+          Status s = {ErrorCodes::ERR_OK, ""};
+          for (const auto& entry : lb.entries) {
+            s = lb.txn->applyBinlog(entry);
+            if (!s.ok()) {
+              break;
+            }
+          }
+          TEST_SYNC_POINT_CALLBACK("ReplManager::applyRepllogsV2::lane", &s);
+          lb.status = s;
+          // the later binlogs of the lane are not committed anyway
+          if (!s.ok()) {
+            break;
+          }
+        }
+        std::lock_guard<std::mutex> lk(mutex);
+        if (--running == 0) {
+          cv.notify_one();
+        }
+      });
+    }
+    {
+      std::unique_lock<std::mutex> lk(mutex);
+      cv.wait(lk, [&running] { return running == 0; });
+    }
+
+    Status s = {ErrorCodes::ERR_OK, ""};
+    for (auto& lb : segment) {
+      s = lb.status;
+      if (s.ok()) {
+        s = lb.txn->setBinlogKV(
+          lb.binlogId, lb.log->getReplLogKey(), lb.log->getReplLogValue());
+        TEST_SYNC_POINT_CALLBACK("ReplManager::applyRepllogsV2::commit", &s);
+      }
+      if (s.ok()) {
+        s = lb.txn->commit().status();
+      }
+      if (!s.ok()) {
+        LOG(ERROR) << "apply binlogId:" << lb.binlogId
+                   << " failed:" << s.toString();
+        break;
+      }
+      applied(lb.binlogId, lb.timestamp);
+    }
+    // the txns left are rolled back, and they have no binlogId yet
+    segment.clear();
+    segmentKeys.clear();
+    for (auto& lane : lanes) {
+      lane.clear();
+    }
+    return s;
+  };
+
+  for (const auto& log : logs) {
+    const auto& logKey = log.getReplLogKey();
+    const auto& logValue = log.getReplLogValue();
+    auto key = ReplLogKeyV2::decode(logKey);
+    if (!key.ok()) {
+      return key.status();
+    }
+    auto value = ReplLogValueV2::decode(logValue);
+    if (!value.ok()) {
+      return value.status();
+    }
+    auto entries = value.value().getLogList();
+    if (!entries.ok()) {
+      return entries.status();
+    }
+
+    auto lane = binlogLane(entries.value(), laneNum);
+    if (lane == -1) {
+      auto s = runSegment();
+      if (!s.ok()) {
+        return s;
+      }
+      auto binlog = applySingleTxnV2(
+        sess, storeId, logKey, logValue, BinlogApplyMode::KEEP_BINLOG_ID);
+      if (!binlog.ok()) {
+        return binlog.status();
+      }
+      applied(binlog.value().binlogId, binlog.value().binlogTs);
+      continue;
+    }
+
+    // same as applySingleTxnV2()
+    uint64_t binlogId = key.value().getBinlogId();
+    uint64_t lastId = segment.empty() ? store->getHighestBinlogId()
+                                      : segment.back().binlogId;
+    if (binlogId <= lastId) {
+      string err = "binlogId:" + to_string(binlogId) +
+        " can't be smaller than highestBinlogId:" + to_string(lastId);
+      LOG(ERROR) << err;
+      auto s = runSegment();
+      return s.ok() ? Status(ErrorCodes::ERR_MANUAL, err) : s;
+    }
+    // A pessimistic txn locks the keys it writes until it's committed,
+    // so a binlog writing a key of an uncommitted txn would wait for the
+    // lock forever in the same lane. Commit the segment before it.
+    bool conflict = false;
+    for (const auto& entry : entries.value()) {
+      conflict = conflict || segmentKeys.count(entry.getOpKey()) > 0;
+    }
+    if (conflict) {
+      TEST_SYNC_POINT("ReplManager::applyRepllogsV2::conflict");
+      auto s = runSegment();
+      if (!s.ok()) {
+        return s;
+      }
+    }
+    for (const auto& entry : entries.value()) {
+      segmentKeys.insert(entry.getOpKey());
+    }
+    auto ptxn = store->createTransaction(sess);
+    if (!ptxn.ok()) {
+      auto s = runSegment();
+      return s.ok() ? ptxn.status() : s;
+    }
+    uint64_t ts =
+      entries.value().empty() ? 0 : entries.value().back().getTimestamp();
+    lanes[lane].push_back(segment.size());
+    segment.push_back(LanedBinlog{&log,
+                                  binlogId,
+                                  ts,
+                                  std::move(ptxn.value()),
+                                  std::move(entries.value()),
+                                  {ErrorCodes::ERR_INTERNAL, "not applied"}});
+    if (segment.size() >= SEGMENT_SIZE) {
+      auto s = runSegment();
+      if (!s.ok()) {
+        return s;
+      }
+    }
+  }
+  return runSegment();
+}
+
 std::ofstream* ReplManager::getCurBinlogFs(uint32_t storeId) {
   std::ofstream* fs = nullptr;
   uint32_t currentId = 0;
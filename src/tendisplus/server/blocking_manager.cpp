@@ -0,0 +1,195 @@
+// Copyright (C) 2020 THL A29 Limited, a Tencent company.  All rights reserved.
+// Please refer to the license text that comes with this tendis open source
+// project for additional information.
+
+#include <algorithm>
+#include <utility>
+
+#include "tendisplus/server/blocking_manager.h"
+#include "tendisplus/utils/redis_port.h"
+
+namespace tendisplus {
+
+void BlockingManager::addWaiter(uint64_t sessId,
+                                uint32_t dbId,
+                                const std::vector<std::string>& keys,
+                                uint64_t deadlineMs) {
+  std::lock_guard<std::mutex> lk(_mutex);
+  eraseInLock(sessId);
+
+  Waiter w;
+  w.dbId = dbId;
+  w.keys = keys;
+  std::sort(w.keys.begin(), w.keys.end());
+  w.keys.erase(std::unique(w.keys.begin(), w.keys.end()), w.keys.end());
+  w.deadline = deadlineMs;
+  w.signaled = false;
+  for (const auto& key : w.keys) {
+    _keys[{dbId, key}].push_back(sessId);
+  }
+  if (deadlineMs != NO_DEADLINE) {
+    _deadlines.emplace(deadlineMs, sessId);
+  }
+  _waiters.emplace(sessId, std::move(w));
+  _waiterCnt.store(_waiters.size());
+}
+
+bool BlockingManager::removeWaiter(uint64_t sessId) {
+  std::lock_guard<std::mutex> lk(_mutex);
+  auto it = _waiters.find(sessId);
+  if (it == _waiters.end()) {
+    return false;
+  }
+  bool parked = static_cast<bool>(it->second.resume);
+  eraseInLock(sessId);
+  return parked;
+}
+
+bool BlockingManager::park(uint64_t sessId, std::function<void()> resume) {
+  std::lock_guard<std::mutex> lk(_mutex);
+  auto it = _waiters.find(sessId);
+  if (it == _waiters.end()) {
+    return false;
+  }
+  if (it->second.signaled) {
+    eraseInLock(sessId);
+    return false;
+  }
+  it->second.resume = std::move(resume);
+  return true;
+}
+
+void BlockingManager::signalKey(uint32_t dbId, const std::string& key) {
+  if (_waiterCnt.load() == 0) {
+    return;
+  }
+  std::list<std::function<void()>> resumes;
+  {
+    std::lock_guard<std::mutex> lk(_mutex);
+    auto it = _keys.find({dbId, key});
+    if (it == _keys.end()) {
+      return;
+    }
+    // NOTE: all the waiters are woken up, a waiter may pop another key of
+    // it, so waking up as many waiters as the elements pushed is not
+    // enough. The ones finding the list empty again would be parked again.
+    auto sessIds = it->second;
+    for (auto sessId : sessIds) {
+      signalInLock(sessId, &resumes);
+    }
+  }
+  for (auto& resume : resumes) {
+    resume();
+  }
+}
+
+void BlockingManager::signalSlots(const std::bitset<CLUSTER_SLOTS>& slots) {
+  std::list<std::function<void()>> resumes;
+  {
+    std::lock_guard<std::mutex> lk(_mutex);
+    std::vector<uint64_t> sessIds;
+    for (const auto& kv : _waiters) {
+      for (const auto& key : kv.second.keys) {
+        if (slots.test(redis_port::keyHashSlot(key.c_str(), key.size()))) {
+          sessIds.push_back(kv.first);
+          break;
+        }
+      }
+    }
+    for (auto sessId : sessIds) {
+      signalInLock(sessId, &resumes);
+    }
+  }
+  for (auto& resume : resumes) {
+    resume();
+  }
+}
+
+void BlockingManager::signalSession(uint64_t sessId) {
+  if (_waiterCnt.load() == 0) {
+    return;
+  }
+  std::list<std::function<void()>> resumes;
+  {
+    std::lock_guard<std::mutex> lk(_mutex);
+    signalInLock(sessId, &resumes);
+  }
+  for (auto& resume : resumes) {
+    resume();
+  }
+}
+
+void BlockingManager::expireWaiters(uint64_t nowMs) {
+  if (_waiterCnt.load() == 0) {
+    return;
+  }
+  std::list<std::function<void()>> resumes;
+  {
+    std::lock_guard<std::mutex> lk(_mutex);
+    std::vector<uint64_t> sessIds;
+    for (const auto& v : _deadlines) {
+      if (v.first > nowMs) {
+        break;
+      }
+      sessIds.push_back(v.second);
+    }
+    for (auto sessId : sessIds) {
+      signalInLock(sessId, &resumes);
+    }
+  }
+  for (auto& resume : resumes) {
+    resume();
+  }
+}
+
+void BlockingManager::clear() {
+  std::lock_guard<std::mutex> lk(_mutex);
+  _waiters.clear();
+  _waiterCnt.store(0);
+  _keys.clear();
+  _deadlines.clear();
+}
+
+size_t BlockingManager::getBlockedCount() const {
+  return _waiterCnt.load(std::memory_order_relaxed);
+}
+
+void BlockingManager::signalInLock(
+  uint64_t sessId, std::list<std::function<void()>>* resumes) {
+  auto it = _waiters.find(sessId);
+  if (it == _waiters.end()) {
+    return;
+  }
+  if (!it->second.resume) {
+    // not parked yet, see park()
+    it->second.signaled = true;
+    return;
+  }
+  resumes->emplace_back(std::move(it->second.resume));
+  eraseInLock(sessId);
+}
+
+void BlockingManager::eraseInLock(uint64_t sessId) {
+  auto it = _waiters.find(sessId);
+  if (it == _waiters.end()) {
+    return;
+  }
+  const auto& w = it->second;
+  for (const auto& key : w.keys) {
+    auto kit = _keys.find({w.dbId, key});
+    if (kit == _keys.end()) {
+      continue;
+    }
+    kit->second.remove(sessId);
+    if (kit->second.empty()) {
+      _keys.erase(kit);
+    }
+  }
+  if (w.deadline != NO_DEADLINE) {
+    _deadlines.erase({w.deadline, sessId});
+  }
+  _waiters.erase(it);
+  _waiterCnt.store(_waiters.size());
+}
+
+}  // namespace tendisplus
@@ -0,0 +1,99 @@
+// Copyright (C) 2020 THL A29 Limited, a Tencent company.  All rights reserved.
+// Please refer to the license text that comes with this tendis open source
+// project for additional information.
+
+#ifndef SRC_TENDISPLUS_SERVER_BLOCKING_MANAGER_H_
+#define SRC_TENDISPLUS_SERVER_BLOCKING_MANAGER_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <bitset>
+#include <functional>
+#include <list>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#define CLUSTER_SLOTS 16384
+
+namespace tendisplus {
+
+// BlockingManager keeps the sessions blocked by BLPOP/BRPOP/BRPOPLPUSH.
+// A blocked session is parked, it holds neither an executor thread nor a
+// key lock. When one of its keys is pushed or it times out, it is resumed
+// and runs its command again from the start.
+// The command adds its waiter before reading the keys, so a push committed
+// after the read always finds the waiter. If the push comes before the
+// session is parked, the waiter is marked as signaled, and park() tells
+// the session to run the command again at once.
+// A session waiting for a key lock is parked the same way, with a waiter
+// of no keys, see KeyLock::AquireKeyLock().
+class BlockingManager {
+ public:
+  static constexpr uint64_t NO_DEADLINE = UINT64_MAX;
+
+  BlockingManager() = default;
+  BlockingManager(const BlockingManager&) = delete;
+  BlockingManager(BlockingManager&&) = delete;
+
+  // a session has one waiter at most, the old one is replaced
+  void addWaiter(uint64_t sessId,
+                 uint32_t dbId,
+                 const std::vector<std::string>& keys,
+                 uint64_t deadlineMs);
+  // return true if the waiter was parked, its resume callback is dropped
+  // without being called.
+  bool removeWaiter(uint64_t sessId);
+  // park the session until its waiter is signaled or timed out, resume
+  // is called then, out of any lock. Return false if the waiter has been
+  // signaled or removed, the session should run its command again now.
+  bool park(uint64_t sessId, std::function<void()> resume);
+  // called after a push to the key is committed, with the key lock held,
+  // so that it can not miss a waiter added before the key is read.
+  void signalKey(uint32_t dbId, const std::string& key);
+  // called after the slots are migrated out, the waiters of them would
+  // get a MOVED reply when resumed.
+  void signalSlots(const std::bitset<CLUSTER_SLOTS>& slots);
+  // called when the key lock waited by the session is granted, see
+  // KeyLock::AquireKeyLock(). It's run with the MGL shard mutex held, so
+  // it only takes _mutex and schedules the session, see NetSession::park()
+  void signalSession(uint64_t sessId);
+  void expireWaiters(uint64_t nowMs);
+  // drop all the waiters without resuming them, when the server stops
+  void clear();
+  size_t getBlockedCount() const;
+
+ private:
+  using BlockKey = std::pair<uint32_t, std::string>;
+  struct Waiter {
+    uint32_t dbId;
+    std::vector<std::string> keys;
+    uint64_t deadline;
+    bool signaled;
+    // not empty when parked
+    std::function<void()> resume;
+  };
+  // the resume callback is returned if the waiter is parked, the caller
+  // should call it after releasing _mutex.
+  void signalInLock(uint64_t sessId,
+                    std::list<std::function<void()>>* resumes);
+  void eraseInLock(uint64_t sessId);
+
+  mutable std::mutex _mutex;
+  // the size of _waiters, pushes skip _mutex when nobody is blocked
+  std::atomic<size_t> _waiterCnt{0};
+  std::unordered_map<uint64_t, Waiter> _waiters;
+  // the waiters of each key, in the order of blocking
+  std::map<BlockKey, std::list<uint64_t>> _keys;
+  // (deadline, sessId)
+  std::set<std::pair<uint64_t, uint64_t>> _deadlines;
+};
+
+}  // namespace tendisplus
+
+#endif  // SRC_TENDISPLUS_SERVER_BLOCKING_MANAGER_H_
@@ -0,0 +1,140 @@
+// Copyright (C) 2020 THL A29 Limited, a Tencent company.  All rights reserved.
+// Please refer to the license text that comes with this tendis open source
+// project for additional information.
+
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "tendisplus/server/blocking_manager.h"
+#include "tendisplus/utils/redis_port.h"
+
+namespace tendisplus {
+
+TEST(BlockingManager, SignalKey) {
+  BlockingManager mgr;
+  int resumed1 = 0;
+  int resumed2 = 0;
+  mgr.addWaiter(1, 0, {"a", "b", "a"}, BlockingManager::NO_DEADLINE);
+  mgr.addWaiter(2, 0, {"b"}, BlockingManager::NO_DEADLINE);
+  EXPECT_EQ(mgr.getBlockedCount(), 2U);
+  EXPECT_TRUE(mgr.park(1, [&resumed1]() { ++resumed1; }));
+  EXPECT_TRUE(mgr.park(2, [&resumed2]() { ++resumed2; }));
+
+  // another db
+  mgr.signalKey(1, "a");
+  EXPECT_EQ(resumed1, 0);
+
+  mgr.signalKey(0, "a");
+  EXPECT_EQ(resumed1, 1);
+  EXPECT_EQ(resumed2, 0);
+  EXPECT_EQ(mgr.getBlockedCount(), 1U);
+
+  // waiter 1 is removed from "b" too
+  mgr.signalKey(0, "b");
+  EXPECT_EQ(resumed1, 1);
+  EXPECT_EQ(resumed2, 1);
+  EXPECT_EQ(mgr.getBlockedCount(), 0U);
+}
+
+TEST(BlockingManager, SignalBeforePark) {
+  BlockingManager mgr;
+  int resumed = 0;
+  mgr.addWaiter(1, 0, {"a"}, BlockingManager::NO_DEADLINE);
+  mgr.signalKey(0, "a");
+  // the push comes between reading the key and parking
+  EXPECT_FALSE(mgr.park(1, [&resumed]() { ++resumed; }));
+  EXPECT_EQ(resumed, 0);
+  EXPECT_EQ(mgr.getBlockedCount(), 0U);
+
+  EXPECT_FALSE(mgr.park(2, [&resumed]() { ++resumed; }));
+}
+
+TEST(BlockingManager, Remove) {
+  BlockingManager mgr;
+  int resumed = 0;
+  mgr.addWaiter(1, 0, {"a"}, BlockingManager::NO_DEADLINE);
+  EXPECT_FALSE(mgr.removeWaiter(1));
+
+  mgr.addWaiter(1, 0, {"a"}, 100);
+  EXPECT_TRUE(mgr.park(1, [&resumed]() { ++resumed; }));
+  EXPECT_TRUE(mgr.removeWaiter(1));
+  EXPECT_FALSE(mgr.removeWaiter(1));
+  mgr.signalKey(0, "a");
+  mgr.expireWaiters(200);
+  EXPECT_EQ(resumed, 0);
+
+  // a new waiter replaces the old one of the session
+  mgr.addWaiter(1, 0, {"a"}, BlockingManager::NO_DEADLINE);
+  mgr.addWaiter(1, 0, {"b"}, BlockingManager::NO_DEADLINE);
+  EXPECT_EQ(mgr.getBlockedCount(), 1U);
+  EXPECT_TRUE(mgr.park(1, [&resumed]() { ++resumed; }));
+  mgr.signalKey(0, "a");
+  EXPECT_EQ(resumed, 0);
+  mgr.signalKey(0, "b");
+  EXPECT_EQ(resumed, 1);
+}
+
+TEST(BlockingManager, SignalSession) {
+  BlockingManager mgr;
+  int resumed = 0;
+  mgr.signalSession(1);
+  mgr.addWaiter(1, 0, {}, 100);
+  mgr.signalSession(1);
+  // the lock is granted before parking
+  EXPECT_FALSE(mgr.park(1, [&resumed]() { ++resumed; }));
+
+  mgr.addWaiter(1, 0, {}, 100);
+  EXPECT_TRUE(mgr.park(1, [&resumed]() { ++resumed; }));
+  mgr.signalSession(2);
+  EXPECT_EQ(resumed, 0);
+  mgr.signalSession(1);
+  EXPECT_EQ(resumed, 1);
+  mgr.expireWaiters(200);
+  EXPECT_EQ(resumed, 1);
+  EXPECT_EQ(mgr.getBlockedCount(), 0U);
+}
+
+TEST(BlockingManager, Expire) {
+  BlockingManager mgr;
+  std::vector<uint64_t> resumed;
+  for (uint64_t i = 1; i <= 3; ++i) {
+    mgr.addWaiter(i, 0, {"a"}, i * 100);
+    EXPECT_TRUE(mgr.park(i, [&resumed, i]() { resumed.push_back(i); }));
+  }
+  mgr.addWaiter(4, 0, {"a"}, BlockingManager::NO_DEADLINE);
+  EXPECT_TRUE(mgr.park(4, [&resumed]() { resumed.push_back(4); }));
+
+  mgr.expireWaiters(50);
+  EXPECT_EQ(resumed.size(), 0U);
+  mgr.expireWaiters(200);
+  EXPECT_EQ(resumed, std::vector<uint64_t>({1, 2}));
+  mgr.expireWaiters(UINT64_MAX - 1);
+  EXPECT_EQ(resumed, std::vector<uint64_t>({1, 2, 3}));
+  EXPECT_EQ(mgr.getBlockedCount(), 1U);
+
+  mgr.clear();
+  EXPECT_EQ(mgr.getBlockedCount(), 0U);
+  mgr.signalKey(0, "a");
+  EXPECT_EQ(resumed.size(), 3U);
+}
+
+TEST(BlockingManager, SignalSlots) {
+  BlockingManager mgr;
+  int resumed1 = 0;
+  int resumed2 = 0;
+  std::string k1 = "{tag1}list";
+  std::string k2 = "{tag2}list";
+  mgr.addWaiter(1, 0, {k1}, BlockingManager::NO_DEADLINE);
+  mgr.addWaiter(2, 0, {k2}, BlockingManager::NO_DEADLINE);
+  EXPECT_TRUE(mgr.park(1, [&resumed1]() { ++resumed1; }));
+  EXPECT_TRUE(mgr.park(2, [&resumed2]() { ++resumed2; }));
+
+  std::bitset<CLUSTER_SLOTS> slots;
+  slots.set(redis_port::keyHashSlot(k1.c_str(), k1.size()));
+  mgr.signalSlots(slots);
+  EXPECT_EQ(resumed1, 1);
+  EXPECT_EQ(resumed2, 0);
+  EXPECT_EQ(mgr.getBlockedCount(), 1U);
+}
+
+}  // namespace tendisplus
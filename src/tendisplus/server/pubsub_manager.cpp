@@ -0,0 +1,285 @@
+// Copyright (C) 2020 THL A29 Limited, a Tencent company.  All rights reserved.
+// Please refer to the license text that comes with this tendis open source
+// project for additional information.
+
+#include <list>
+#include <utility>
+
+#include "glog/logging.h"
+#include "tendisplus/server/pubsub_manager.h"
+#include "tendisplus/network/reply_buffer.h"
+#include "tendisplus/utils/redis_port.h"
+
+namespace tendisplus {
+
+namespace {
+std::string encodeBulk(const std::string& s) {
+  std::string r("$");
+  r.append(std::to_string(s.size())).append("\r\n");
+  r.append(s).append("\r\n");
+  return r;
+}
+}  // namespace
+
+std::string PubSubManager::literalPrefix(const std::string& pattern) {
+  size_t i = 0;
+  for (; i < pattern.size(); ++i) {
+    char c = pattern[i];
+    if (c == '*' || c == '?' || c == '[' || c == '\\') {
+      break;
+    }
+  }
+  return pattern.substr(0, i);
+}
+
+size_t PubSubManager::subscribe(const std::shared_ptr<Session>& sess,
+                                const std::string& channel) {
+  std::lock_guard<std::mutex> lk(_mutex);
+  auto& state = _sessions[sess->id()];
+  if (state.channels.insert(channel).second) {
+    _channels[channel].emplace(sess->id(), sess);
+  }
+  return countInLock(sess->id());
+}
+
+size_t PubSubManager::unsubscribe(uint64_t sessId, const std::string& channel) {
+  std::lock_guard<std::mutex> lk(_mutex);
+  auto it = _sessions.find(sessId);
+  if (it == _sessions.end()) {
+    return 0;
+  }
+  if (it->second.channels.erase(channel)) {
+    auto cit = _channels.find(channel);
+    if (cit != _channels.end()) {
+      cit->second.erase(sessId);
+      if (cit->second.empty()) {
+        _channels.erase(cit);
+      }
+    }
+  }
+  size_t cnt = countInLock(sessId);
+  if (cnt == 0) {
+    _sessions.erase(it);
+  }
+  return cnt;
+}
+
+size_t PubSubManager::psubscribe(const std::shared_ptr<Session>& sess,
+                                 const std::string& pattern) {
+  std::lock_guard<std::mutex> lk(_mutex);
+  auto& state = _sessions[sess->id()];
+  if (state.patterns.insert(pattern).second) {
+    auto prefix = literalPrefix(pattern);
+    auto pit = _patterns.find(prefix);
+    if (pit == _patterns.end()) {
+      pit = _patterns.emplace(prefix, std::map<std::string, Subscribers>())
+              .first;
+      ++_prefixLens[prefix.size()];
+    }
+    pit->second[pattern].emplace(sess->id(), sess);
+    ++_patternCnt;
+  }
+  return countInLock(sess->id());
+}
+
+size_t PubSubManager::punsubscribe(uint64_t sessId,
+                                   const std::string& pattern) {
+  std::lock_guard<std::mutex> lk(_mutex);
+  auto it = _sessions.find(sessId);
+  if (it == _sessions.end()) {
+    return 0;
+  }
+  if (it->second.patterns.erase(pattern)) {
+    punsubscribeInLock(sessId, pattern);
+  }
+  size_t cnt = countInLock(sessId);
+  if (cnt == 0) {
+    _sessions.erase(it);
+  }
+  return cnt;
+}
+
+bool PubSubManager::punsubscribeInLock(uint64_t sessId,
+                                       const std::string& pattern) {
+  auto prefix = literalPrefix(pattern);
+  auto pit = _patterns.find(prefix);
+  if (pit == _patterns.end()) {
+    return false;
+  }
+  auto sit = pit->second.find(pattern);
+  if (sit == pit->second.end()) {
+    return false;
+  }
+  if (sit->second.erase(sessId)) {
+    --_patternCnt;
+  }
+  if (sit->second.empty()) {
+    pit->second.erase(sit);
+    if (pit->second.empty()) {
+      _patterns.erase(pit);
+      auto lit = _prefixLens.find(prefix.size());
+      if (--lit->second == 0) {
+        _prefixLens.erase(lit);
+      }
+    }
+  }
+  return true;
+}
+
+std::vector<std::string> PubSubManager::getChannels(uint64_t sessId) const {
+  std::lock_guard<std::mutex> lk(_mutex);
+  auto it = _sessions.find(sessId);
+  if (it == _sessions.end()) {
+    return {};
+  }
+  return {it->second.channels.begin(), it->second.channels.end()};
+}
+
+std::vector<std::string> PubSubManager::getPatterns(uint64_t sessId) const {
+  std::lock_guard<std::mutex> lk(_mutex);
+  auto it = _sessions.find(sessId);
+  if (it == _sessions.end()) {
+    return {};
+  }
+  return {it->second.patterns.begin(), it->second.patterns.end()};
+}
+
+void PubSubManager::removeSession(uint64_t sessId) {
+  std::lock_guard<std::mutex> lk(_mutex);
+  auto it = _sessions.find(sessId);
+  if (it == _sessions.end()) {
+    return;
+  }
+  for (const auto& channel : it->second.channels) {
+    auto cit = _channels.find(channel);
+    if (cit != _channels.end()) {
+      cit->second.erase(sessId);
+      if (cit->second.empty()) {
+        _channels.erase(cit);
+      }
+    }
+  }
+  for (const auto& pattern : it->second.patterns) {
+    punsubscribeInLock(sessId, pattern);
+  }
+  _sessions.erase(it);
+}
+
+size_t PubSubManager::publish(const std::string& channel,
+                              const std::string& message,
+                              uint64_t outputLimit) {
+  static const auto messageHead =
+    std::make_shared<const std::string>("*3\r\n$7\r\nmessage\r\n");
+  // the channel and the message, shared by all the subscribers
+  auto body =
+    std::make_shared<const std::string>(encodeBulk(channel) +
+                                        encodeBulk(message));
+
+  // (subscriber, head of the message)
+  std::list<std::pair<std::shared_ptr<Session>,
+                      std::shared_ptr<const std::string>>> targets;
+  {
+    std::lock_guard<std::mutex> lk(_mutex);
+    auto cit = _channels.find(channel);
+    if (cit != _channels.end()) {
+      for (const auto& kv : cit->second) {
+        auto sess = kv.second.lock();
+        if (sess) {
+          targets.emplace_back(std::move(sess), messageHead);
+        }
+      }
+    }
+    for (const auto& lv : _prefixLens) {
+      if (lv.first > channel.size()) {
+        break;
+      }
+      auto pit = _patterns.find(channel.substr(0, lv.first));
+      if (pit == _patterns.end()) {
+        continue;
+      }
+      for (const auto& sv : pit->second) {
+        const auto& pattern = sv.first;
+        if (!redis_port::stringmatchlen(pattern.c_str(),
+                                        pattern.size(),
+                                        channel.c_str(),
+                                        channel.size(),
+                                        0)) {
+          continue;
+        }
+        auto head = std::make_shared<const std::string>(
+          "*4\r\n$8\r\npmessage\r\n" + encodeBulk(pattern));
+        for (const auto& kv : sv.second) {
+          auto sess = kv.second.lock();
+          if (sess) {
+            targets.emplace_back(std::move(sess), head);
+          }
+        }
+      }
+    }
+  }
+
+  ++published;
+  size_t receivers = 0;
+  for (auto& target : targets) {
+    auto& sess = target.first;
+    uint64_t size = target.second->size() + body->size();
+    if (outputLimit && sess->getPendingRspBytes() + size > outputLimit) {
+      LOG(WARNING) << "pubsub client:" << sess->id() << " "
+                   << sess->getRemote() << " is closed for exceeding "
+                   << "the output limit:" << outputLimit;
+      ++outputLimitClosed;
+      sess->cancel();
+      continue;
+    }
+    ReplyBuffer reply;
+    reply.append(target.second);
+    reply.append(body);
+    if (sess->setResponse(std::move(reply)).ok()) {
+      ++receivers;
+    }
+  }
+  return receivers;
+}
+
+std::vector<std::string> PubSubManager::getActiveChannels(
+  const std::string& pattern) const {
+  std::lock_guard<std::mutex> lk(_mutex);
+  std::vector<std::string> result;
+  for (const auto& kv : _channels) {
+    if (pattern.empty() ||
+        redis_port::stringmatchlen(pattern.c_str(),
+                                   pattern.size(),
+                                   kv.first.c_str(),
+                                   kv.first.size(),
+                                   0)) {
+      result.push_back(kv.first);
+    }
+  }
+  return result;
+}
+
+size_t PubSubManager::getSubscriberCount(const std::string& channel) const {
+  std::lock_guard<std::mutex> lk(_mutex);
+  auto it = _channels.find(channel);
+  return it == _channels.end() ? 0 : it->second.size();
+}
+
+size_t PubSubManager::getPatternCount() const {
+  std::lock_guard<std::mutex> lk(_mutex);
+  return _patternCnt;
+}
+
+size_t PubSubManager::getChannelCount() const {
+  std::lock_guard<std::mutex> lk(_mutex);
+  return _channels.size();
+}
+
+size_t PubSubManager::countInLock(uint64_t sessId) const {
+  auto it = _sessions.find(sessId);
+  if (it == _sessions.end()) {
+    return 0;
+  }
+  return it->second.channels.size() + it->second.patterns.size();
+}
+
+}  // namespace tendisplus
@@ -0,0 +1,90 @@
+// Copyright (C) 2020 THL A29 Limited, a Tencent company.  All rights reserved.
+// Please refer to the license text that comes with this tendis open source
+// project for additional information.
+
+#ifndef SRC_TENDISPLUS_SERVER_PUBSUB_MANAGER_H_
+#define SRC_TENDISPLUS_SERVER_PUBSUB_MANAGER_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "tendisplus/server/session.h"
+#include "tendisplus/utils/atomic_utility.h"
+
+namespace tendisplus {
+
+// PubSubManager keeps the channel and pattern subscriptions of sessions.
+// A published message is encoded once into shared buffers, which are
+// chained into the reply of every subscriber without copy. A subscriber
+// whose unsent replies would exceed the output limit is closed instead.
+class PubSubManager {
+ public:
+  PubSubManager() = default;
+  PubSubManager(const PubSubManager&) = delete;
+  PubSubManager(PubSubManager&&) = delete;
+
+  // return the count of channels and patterns subscribed by the session
+  // after the change
+  size_t subscribe(const std::shared_ptr<Session>& sess,
+                   const std::string& channel);
+  size_t unsubscribe(uint64_t sessId, const std::string& channel);
+  size_t psubscribe(const std::shared_ptr<Session>& sess,
+                    const std::string& pattern);
+  size_t punsubscribe(uint64_t sessId, const std::string& pattern);
+  std::vector<std::string> getChannels(uint64_t sessId) const;
+  std::vector<std::string> getPatterns(uint64_t sessId) const;
+  // called when the session ends
+  void removeSession(uint64_t sessId);
+
+  // return the number of subscribers the message is sent to.
+  // outputLimit is in bytes, 0 means no limit.
+  size_t publish(const std::string& channel,
+                 const std::string& message,
+                 uint64_t outputLimit);
+
+  // for PUBSUB CHANNELS/NUMSUB/NUMPAT
+  std::vector<std::string> getActiveChannels(const std::string& pattern) const;
+  size_t getSubscriberCount(const std::string& channel) const;
+  size_t getPatternCount() const;
+  size_t getChannelCount() const;
+
+  // the part of the pattern before the first special char
+  static std::string literalPrefix(const std::string& pattern);
+
+  Atom<uint64_t> published{0};
+  // subscribers closed for exceeding the output limit
+  Atom<uint64_t> outputLimitClosed{0};
+
+ private:
+  using Subscribers = std::map<uint64_t, std::weak_ptr<Session>>;
+  struct SubState {
+    std::set<std::string> channels;
+    std::set<std::string> patterns;
+  };
+  size_t countInLock(uint64_t sessId) const;
+  bool punsubscribeInLock(uint64_t sessId, const std::string& pattern);
+
+  mutable std::mutex _mutex;
+  std::unordered_map<std::string, Subscribers> _channels;
+  // NOTE: the patterns are grouped by their literal prefix. A publish
+  // looks up each prefix of the channel whose length is in _prefixLens,
+  // and only globs the patterns of the groups found.
+  std::unordered_map<std::string, std::map<std::string, Subscribers>>
+    _patterns;
+  // prefix length -> count of the groups of that length
+  std::map<size_t, size_t> _prefixLens;
+  // count of the pattern subscriptions of all sessions
+  size_t _patternCnt = 0;
+  std::unordered_map<uint64_t, SubState> _sessions;
+};
+
+}  // namespace tendisplus
+
+#endif  // SRC_TENDISPLUS_SERVER_PUBSUB_MANAGER_H_
@@ -0,0 +1,112 @@
+// Copyright (C) 2020 THL A29 Limited, a Tencent company.  All rights reserved.
+// Please refer to the license text that comes with this tendis open source
+// project for additional information.
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "tendisplus/server/pubsub_manager.h"
+
+namespace tendisplus {
+
+class FakeSession : public Session {
+ public:
+  FakeSession() : Session(static_cast<ServerEntry*>(nullptr), Type::NET) {}
+  void start() final {}
+  Status cancel() final {
+    cancelled = true;
+    return {ErrorCodes::ERR_OK, ""};
+  }
+  int getFd() final {
+    return -1;
+  }
+  std::string getRemote() const final {
+    return "fake";
+  }
+  using Session::setResponse;
+  Status setResponse(const std::string& s) final {
+    output.append(s);
+    return {ErrorCodes::ERR_OK, ""};
+  }
+  uint64_t getPendingRspBytes() const final {
+    return pending;
+  }
+
+  std::string output;
+  uint64_t pending = 0;
+  bool cancelled = false;
+};
+
+TEST(PubSubManager, Channel) {
+  PubSubManager mgr;
+  auto s1 = std::make_shared<FakeSession>();
+  auto s2 = std::make_shared<FakeSession>();
+  EXPECT_EQ(mgr.subscribe(s1, "ch1"), 1U);
+  EXPECT_EQ(mgr.subscribe(s1, "ch1"), 1U);
+  EXPECT_EQ(mgr.subscribe(s1, "ch2"), 2U);
+  EXPECT_EQ(mgr.subscribe(s2, "ch1"), 1U);
+  EXPECT_EQ(mgr.getSubscriberCount("ch1"), 2U);
+  EXPECT_EQ(mgr.getChannelCount(), 2U);
+
+  EXPECT_EQ(mgr.publish("ch1", "hello", 0), 2U);
+  std::string msg = "*3\r\n$7\r\nmessage\r\n$3\r\nch1\r\n$5\r\nhello\r\n";
+  EXPECT_EQ(s1->output, msg);
+  EXPECT_EQ(s2->output, msg);
+  EXPECT_EQ(mgr.publish("ch3", "hello", 0), 0U);
+
+  EXPECT_EQ(mgr.unsubscribe(s1->id(), "ch1"), 1U);
+  EXPECT_EQ(mgr.unsubscribe(s1->id(), "ch1"), 1U);
+  mgr.removeSession(s2->id());
+  EXPECT_EQ(mgr.getSubscriberCount("ch1"), 0U);
+  EXPECT_EQ(mgr.getActiveChannels(""), std::vector<std::string>({"ch2"}));
+}
+
+TEST(PubSubManager, Pattern) {
+  PubSubManager mgr;
+  auto s1 = std::make_shared<FakeSession>();
+  auto s2 = std::make_shared<FakeSession>();
+  EXPECT_EQ(PubSubManager::literalPrefix("news.*"), "news.");
+  EXPECT_EQ(PubSubManager::literalPrefix("*"), "");
+  EXPECT_EQ(PubSubManager::literalPrefix("a?b"), "a");
+
+  EXPECT_EQ(mgr.psubscribe(s1, "news.*"), 1U);
+  EXPECT_EQ(mgr.psubscribe(s1, "*"), 2U);
+  EXPECT_EQ(mgr.psubscribe(s2, "news.*"), 1U);
+  EXPECT_EQ(mgr.psubscribe(s2, "sport.?"), 2U);
+  EXPECT_EQ(mgr.getPatternCount(), 4U);
+
+  EXPECT_EQ(mgr.publish("news.a", "x", 0), 3U);
+  EXPECT_EQ(s1->output,
+            "*4\r\n$8\r\npmessage\r\n$1\r\n*\r\n$6\r\nnews.a\r\n$1\r\nx\r\n"
+            "*4\r\n$8\r\npmessage\r\n$6\r\nnews.*\r\n$6\r\nnews.a\r\n"
+            "$1\r\nx\r\n");
+  EXPECT_EQ(mgr.publish("sport.ab", "x", 0), 1U);
+  EXPECT_EQ(mgr.publish("sport.a", "x", 0), 2U);
+
+  EXPECT_EQ(mgr.punsubscribe(s2->id(), "news.*"), 1U);
+  EXPECT_EQ(mgr.getPatternCount(), 3U);
+  mgr.removeSession(s1->id());
+  EXPECT_EQ(mgr.getPatternCount(), 1U);
+  EXPECT_EQ(mgr.publish("news.a", "x", 0), 0U);
+}
+
+TEST(PubSubManager, OutputLimit) {
+  PubSubManager mgr;
+  auto s1 = std::make_shared<FakeSession>();
+  auto s2 = std::make_shared<FakeSession>();
+  mgr.subscribe(s1, "ch");
+  mgr.subscribe(s2, "ch");
+  s2->pending = 1000;
+  EXPECT_EQ(mgr.publish("ch", "msg", 1000), 1U);
+  EXPECT_FALSE(s1->cancelled);
+  EXPECT_TRUE(s2->cancelled);
+  EXPECT_EQ(s2->output, "");
+  EXPECT_EQ(mgr.outputLimitClosed.get(), 1U);
+
+  // the expired subscriber is skipped
+  s1.reset();
+  EXPECT_EQ(mgr.publish("ch", "msg", 0), 1U);
+}
+
+}  // namespace tendisplus
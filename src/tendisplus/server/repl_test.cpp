@@ -2,9 +2,13 @@
 // Please refer to the license text that comes with this tendis open source
 // project for additional information.
 
+#include <atomic>
 #include <memory>
+#include <mutex>  // NOLINT
+#include <string>
 #include <utility>
 #include <thread>  // NOLINT
+#include <vector>
 
 #include "gtest/gtest.h"
 #include "glog/logging.h"
@@ -117,6 +121,32 @@ std::shared_ptr<ServerEntry> makeAnotherSlave(const std::string& name,
   return slave;
 }
 
+std::shared_ptr<ServerEntry> makeStreamingSlave(const std::string& name,
+                                                uint32_t storeCnt,
+                                                uint32_t port,
+                                                uint32_t mport,
+                                                uint32_t streams) {
+  EXPECT_TRUE(setupEnv(name));
+
+  auto cfg = makeServerParam(port, storeCnt, name, false);
+  cfg->fullSyncStreams = streams;
+
+  auto slave = std::make_shared<ServerEntry>(cfg);
+  auto s = slave->startup(cfg);
+  INVARIANT(s.ok());
+
+  {
+    auto ctx = std::make_shared<asio::io_context>();
+    auto session = makeSession(slave, ctx);
+
+    WorkLoad work(slave, session);
+    work.init();
+    work.slaveof("127.0.0.1", mport);
+  }
+
+  return slave;
+}
+
 #ifdef _WIN32
 size_t recordSize = 10;
 #else
@@ -328,6 +358,247 @@ TEST(Repl, SlaveOfNeedEmpty) {
   }
 }
 
+TEST(Repl, FullSyncStreams) {
+  const auto guard = MakeGuard([] {
+    SyncPoint::GetInstance()->DisableProcessing();
+    SyncPoint::GetInstance()->ClearAllCallBacks();
+    destroyEnv(master_dir);
+    destroyEnv(slave1_dir);
+    destroyEnv(slave2_dir);
+    std::this_thread::sleep_for(std::chrono::seconds(5));
+  });
+
+  // the number of connections of each fullsync
+  std::mutex mutex;
+  std::vector<size_t> streams;
+  SyncPoint::GetInstance()->SetCallBack(
+    "ReplManager::slaveRecvFileStreams::streams", [&](void* arg) {
+      std::lock_guard<std::mutex> lk(mutex);
+      streams.push_back(*reinterpret_cast<size_t*>(arg));
+    });
+  SyncPoint::GetInstance()->EnableProcessing();
+
+  uint32_t storeCnt = 2;
+  EXPECT_TRUE(setupEnv(master_dir));
+  auto cfg = makeServerParam(master_port, storeCnt, master_dir, false);
+  auto master = std::make_shared<ServerEntry>(cfg);
+  auto s = master->startup(cfg);
+  INVARIANT(s.ok());
+  initData(master, recordSize);
+
+  // the second fullsync of a store is given a clientId other than 0,
+  // the streams are still attached to it
+  for (const auto& slaveInfo : {std::make_pair(slave1_dir, slave1_port),
+                                std::make_pair(slave2_dir, slave2_port)}) {
+    auto slave = makeStreamingSlave(
+      slaveInfo.first, storeCnt, slaveInfo.second, master_port, 4);
+    waitSlaveCatchup(master, slave);
+    compareData(master, slave);
+    slave->stop();
+  }
+
+  SyncPoint::GetInstance()->DisableProcessing();
+  {
+    std::lock_guard<std::mutex> lk(mutex);
+    EXPECT_GE(streams.size(), 2 * storeCnt);
+    for (auto n : streams) {
+      EXPECT_EQ(n, 4U);
+    }
+  }
+  master->stop();
+}
+
+TEST(Repl, FullSyncResume) {
+  const auto guard = MakeGuard([] {
+    SyncPoint::GetInstance()->DisableProcessing();
+    SyncPoint::GetInstance()->ClearAllCallBacks();
+    destroyEnv(master_dir);
+    destroyEnv(slave1_dir);
+    std::this_thread::sleep_for(std::chrono::seconds(5));
+  });
+
+  // the first fullsync fails after a file is got, and the next one
+  // resumes from the files got with all the streams
+  std::atomic<bool> injected(false);
+  std::atomic<size_t> resumed(0);
+  std::mutex mutex;
+  std::vector<size_t> streams;
+  SyncPoint::GetInstance()->SetCallBack(
+    "ReplManager::slaveRecvFileStreams::recvFile", [&](void* arg) {
+      auto s = reinterpret_cast<Status*>(arg);
+      if (s->ok() && !injected.exchange(true)) {
+        *s = {ErrorCodes::ERR_NETWORK, "injected"};
+      }
+    });
+  SyncPoint::GetInstance()->SetCallBack(
+    "ReplManager::slaveStartFullsync::resumed", [&](void* arg) {
+      resumed = *reinterpret_cast<size_t*>(arg);
+    });
+  SyncPoint::GetInstance()->SetCallBack(
+    "ReplManager::slaveRecvFileStreams::streams", [&](void* arg) {
+      std::lock_guard<std::mutex> lk(mutex);
+      streams.push_back(*reinterpret_cast<size_t*>(arg));
+    });
+  SyncPoint::GetInstance()->EnableProcessing();
+
+  EXPECT_TRUE(setupEnv(master_dir));
+  auto cfg = makeServerParam(master_port, 1, master_dir, false);
+  auto master = std::make_shared<ServerEntry>(cfg);
+  auto s = master->startup(cfg);
+  INVARIANT(s.ok());
+  initData(master, recordSize);
+
+  auto slave = makeStreamingSlave(slave1_dir, 1, slave1_port, master_port, 4);
+  waitSlaveCatchup(master, slave);
+  compareData(master, slave);
+
+  SyncPoint::GetInstance()->DisableProcessing();
+  EXPECT_TRUE(injected.load());
+  EXPECT_GT(resumed.load(), 0U);
+  {
+    std::lock_guard<std::mutex> lk(mutex);
+    EXPECT_GE(streams.size(), 2U);
+    for (auto n : streams) {
+      EXPECT_EQ(n, 4U);
+    }
+  }
+  slave->stop();
+  master->stop();
+}
+
+TEST(Repl, ApplyLaneFailure) {
+  const auto guard = MakeGuard([] {
+    SyncPoint::GetInstance()->DisableProcessing();
+    SyncPoint::GetInstance()->ClearAllCallBacks();
+    destroyEnv(master_dir);
+    destroyEnv(slave_dir);
+    std::this_thread::sleep_for(std::chrono::seconds(5));
+  });
+
+  uint32_t storeCnt = 2;
+  EXPECT_TRUE(setupEnv(master_dir));
+  EXPECT_TRUE(setupEnv(slave_dir));
+  auto cfg1 = makeServerParam(master_port, storeCnt, master_dir, false);
+  auto cfg2 = makeServerParam(slave_port, storeCnt, slave_dir, false);
+  cfg2->incrApplyThreadnum = 4;
+
+  auto master = std::make_shared<ServerEntry>(cfg1);
+  auto s = master->startup(cfg1);
+  INVARIANT(s.ok());
+  auto slave = std::make_shared<ServerEntry>(cfg2);
+  s = slave->startup(cfg2);
+  INVARIANT(s.ok());
+  {
+    auto ctx = std::make_shared<asio::io_context>();
+    auto session = makeSession(slave, ctx);
+    WorkLoad work(slave, session);
+    work.init();
+    work.slaveof("127.0.0.1", master_port);
+  }
+  waitSlaveCatchup(master, slave);
+
+  // some binlogs fail in the lanes, and some fail after their binlogIds
+  // are reserved. The master resends them, and the slave goes on.
+  std::atomic<uint32_t> laneFailed(0);
+  std::atomic<uint32_t> commitFailed(0);
+  SyncPoint::GetInstance()->SetCallBack(
+    "ReplManager::applyRepllogsV2::lane", [&](void* arg) {
+      auto s = reinterpret_cast<Status*>(arg);
+      if (s->ok() && laneFailed.fetch_add(1) < 3) {
+        *s = {ErrorCodes::ERR_INTERNAL, "injected"};
+      }
+    });
+  SyncPoint::GetInstance()->SetCallBack(
+    "ReplManager::applyRepllogsV2::commit", [&](void* arg) {
+      auto s = reinterpret_cast<Status*>(arg);
+      if (s->ok() && commitFailed.fetch_add(1) < 3) {
+        *s = {ErrorCodes::ERR_INTERNAL, "injected"};
+      }
+    });
+  SyncPoint::GetInstance()->EnableProcessing();
+
+  initData(master, recordSize);
+  waitSlaveCatchup(master, slave);
+  compareData(master, slave);
+
+  SyncPoint::GetInstance()->DisableProcessing();
+  EXPECT_GT(laneFailed.load(), 3U);
+  EXPECT_GT(commitFailed.load(), 3U);
+  for (uint32_t i = 0; i < storeCnt; i++) {
+    EXPECT_EQ(master->getStores()[i]->getHighestBinlogId(),
+              slave->getStores()[i]->getHighestBinlogId());
+  }
+
+  master->stop();
+  slave->stop();
+}
+
+TEST(Repl, ApplyLaneSameKey) {
+  const auto guard = MakeGuard([] {
+    SyncPoint::GetInstance()->DisableProcessing();
+    SyncPoint::GetInstance()->ClearAllCallBacks();
+    destroyEnv(master_dir);
+    destroyEnv(slave_dir);
+    std::this_thread::sleep_for(std::chrono::seconds(5));
+  });
+
+  EXPECT_TRUE(setupEnv(master_dir));
+  EXPECT_TRUE(setupEnv(slave_dir));
+  auto cfg1 = makeServerParam(master_port, 1, master_dir, false);
+  auto cfg2 = makeServerParam(slave_port, 1, slave_dir, false);
+  cfg2->incrApplyThreadnum = 4;
+
+  auto master = std::make_shared<ServerEntry>(cfg1);
+  auto s = master->startup(cfg1);
+  INVARIANT(s.ok());
+  auto slave = std::make_shared<ServerEntry>(cfg2);
+  s = slave->startup(cfg2);
+  INVARIANT(s.ok());
+  {
+    auto ctx = std::make_shared<asio::io_context>();
+    auto session = makeSession(slave, ctx);
+    WorkLoad work(slave, session);
+    work.init();
+    work.slaveof("127.0.0.1", master_port);
+  }
+  waitSlaveCatchup(master, slave);
+
+  // the binlogs writing the same keys are not applied by uncommitted
+  // txns at the same time, no lane waits for a key lock
+  std::atomic<uint32_t> laneFailed(0);
+  std::atomic<uint32_t> conflicts(0);
+  SyncPoint::GetInstance()->SetCallBack(
+    "ReplManager::applyRepllogsV2::lane", [&](void* arg) {
+      if (!reinterpret_cast<Status*>(arg)->ok()) {
+        laneFailed++;
+      }
+    });
+  SyncPoint::GetInstance()->SetCallBack(
+    "ReplManager::applyRepllogsV2::conflict",
+    [&](void* arg) { conflicts++; });
+  SyncPoint::GetInstance()->EnableProcessing();
+
+  constexpr uint32_t CNT = 1000;
+  for (uint32_t i = 0; i < CNT; i++) {
+    runCmd(master, {"incr", "hot"});
+    runCmd(master, {"set", "k" + std::to_string(i % 10), std::to_string(i)});
+  }
+  auto start = msSinceEpoch();
+  waitSlaveCatchup(master, slave);
+  compareData(master, slave);
+
+  SyncPoint::GetInstance()->DisableProcessing();
+  EXPECT_EQ(laneFailed.load(), 0U);
+  EXPECT_GT(conflicts.load(), 0U);
+  // a lock wait times out in seconds
+  EXPECT_LT(msSinceEpoch() - start, 30 * 1000);
+  EXPECT_EQ(master->getStores()[0]->getHighestBinlogId(),
+            slave->getStores()[0]->getHighestBinlogId());
+
+  master->stop();
+  slave->stop();
+}
+
 void checkBinlogFile(string dir, bool hasBinlog, uint32_t storeCount) {
   for (uint32_t i = 0; i < storeCount; ++i) {
     std::string fullFileName = dir + "/dump/" + std::to_string(i) + "/";
@@ -12,10 +12,26 @@
 #include "tendisplus/utils/invariant.h"
 #include "tendisplus/utils/redis_port.h"
 #include "tendisplus/server/server_entry.h"
+#include "tendisplus/commands/command.h"
 
 
 namespace tendisplus {
 
+namespace {
+// a key locked by a write command touches its watchers, with the lock
+// held, see WatchManager
+void touchWatchedKey(Session* sess, const std::string& key) {
+  auto svr = sess ? sess->getServerEntry() : nullptr;
+  if (!svr || svr->getWatchMgr()->getWatchingCount() == 0) {
+    return;
+  }
+  auto cmd = Command::getCommand(sess);
+  if (cmd && cmd->isWriteable()) {
+    svr->getWatchMgr()->touchKey(key, sess->id());
+  }
+}
+}  // namespace
+
 SegmentMgr::SegmentMgr(const std::string& name) : _name(name) {}
 
 SegmentMgrFnvHash64::SegmentMgrFnvHash64(
@@ -82,6 +98,9 @@ Expected<DbWithLock> SegmentMgrFnvHash64::getDbWithKeyLock(
     if (!elk.ok()) {
       return elk.status();
     }
+    if (mode == mgl::LockMode::LOCK_X && elk.value()) {
+      touchWatchedKey(sess, key);
+    }
 
     if (cluster_enabled) {
       auto svr = sess->getServerEntry();
@@ -212,6 +231,9 @@ SegmentMgrFnvHash64::getAllKeysLocked(Session* sess,
       if (!elk.ok()) {
         return elk.status();
       }
+      if (mode == mgl::LockMode::LOCK_X && elk.value()) {
+        touchWatchedKey(sess, pair.second);
+      }
       locklist.emplace_back(std::move(elk.value()));
     }
   }
@@ -218,6 +218,9 @@ ServerEntry::ServerEntry()
     _mgLockMgr(nullptr),
     _clusterMgr(nullptr),
     _gcMgr(nullptr),
+    _blockingMgr(std::make_unique<BlockingManager>()),
+    _pubsubMgr(std::make_unique<PubSubManager>()),
+    _watchMgr(std::make_unique<WatchManager>()),
     _catalog(nullptr),
     _netMatrix(std::make_shared<NetworkMatrix>()),
     _poolMatrix(std::make_shared<PoolMatrix>()),
@@ -571,7 +574,7 @@ Status ServerEntry::startup(const std::shared_ptr<ServerParams>& cfg) {
   auto tmpPessimisticMgr = std::make_unique<PessimisticMgr>(kvStoreCount);
   installPessimisticMgrInLock(std::move(tmpPessimisticMgr));
 
-  auto tmpMGLockMgr = std::make_unique<mgl::MGLockMgr>();
+  auto tmpMGLockMgr = std::make_unique<mgl::MGLockMgr>(_cfg->lockShardNum);
   installMGLockMgrInLock(std::move(tmpMGLockMgr));
 
   for (uint32_t i = 0; i < _cfg->executorThreadNum;
@@ -726,6 +729,18 @@ GCManager* ServerEntry::getGcMgr() {
   return _gcMgr.get();
 }
 
+BlockingManager* ServerEntry::getBlockingMgr() {
+  return _blockingMgr.get();
+}
+
+PubSubManager* ServerEntry::getPubSubMgr() {
+  return _pubsubMgr.get();
+}
+
+WatchManager* ServerEntry::getWatchMgr() {
+  return _watchMgr.get();
+}
+
 std::string ServerEntry::requirepass() const {
   std::lock_guard<std::mutex> lk(_mutex);
   return _requirepass;
@@ -824,6 +839,9 @@ void ServerEntry::endSession(uint64_t connId) {
   if (pCtx->getIsMonitor()) {
     DelMonitorNoLock(connId);
   }
+  _blockingMgr->removeWaiter(connId);
+  _pubsubMgr->removeSession(connId);
+  _watchMgr->unwatch(connId);
 #ifdef TENDIS_DEBUG
   if (it->second->getType() != Session::Type::LOCAL) {
     DLOG(INFO) << "ServerEntry endSession id:" << connId
@@ -986,6 +1004,9 @@ bool ServerEntry::processRequest(Session* sess) {
 
   auto expCmd = Command::precheck(sess);
   if (!expCmd.ok()) {
+    if (sess->getCtx()->getFlags() & CLIENT_MULTI_QUEUED) {
+      sess->getCtx()->setFlags(CLIENT_DIRTY_EXEC);
+    }
     auto s =
       sess->setResponse(redis_port::errorReply(expCmd.status().toString()));
     if (!s.ok()) {
@@ -996,6 +1017,25 @@ bool ServerEntry::processRequest(Session* sess) {
 
   replyMonitors(sess);
 
+  if (sess->getCtx()->getFlags() & CLIENT_MULTI_QUEUED) {
+    static const std::set<std::string> notQueued = {
+      "multi", "exec", "discard", "watch", "unwatch", "quit"};
+    auto cmd = expCmd.value();
+    if (notQueued.count(cmd->getName()) == 0) {
+      std::string rsp = "+QUEUED\r\n";
+      // keyless writes such as FLUSHALL lock the whole kvstore, which
+      // would wait for the key locks held by EXEC.
+      if (cmd->isBgCmd() ||
+          ((cmd->getFlags() & CMD_WRITE) && cmd->firstkey() == 0)) {
+        sess->getCtx()->setFlags(CLIENT_DIRTY_EXEC);
+        rsp = Command::fmtErr("Command not allowed inside a transaction");
+      } else {
+        sess->getCtx()->queueMultiCmd(sess->getArgs());
+      }
+      return sess->setResponse(rsp).ok();
+    }
+  }
+
   if (expCmd.value()->isBgCmd()) {
     auto expCmdName = expCmd.value()->getName();
     if (expCmdName == "fullsync") {
@@ -1004,9 +1044,19 @@ bool ServerEntry::processRequest(Session* sess) {
       NetSession* ns = dynamic_cast<NetSession*>(sess);
       INVARIANT(ns != nullptr);
       std::vector<std::string> args = ns->getArgs();
-      // we have called precheck, it should have 4 args
-      INVARIANT(args.size() == 4);
-      _replMgr->supplyFullSync(ns->borrowConn(), args[1], args[2], args[3]);
+      // we have called precheck, it should have at least 4 args
+      INVARIANT(args.size() >= 4);
+      if (args.size() >= 6 && args[4] == "attach") {
+        _replMgr->attachFullSync(
+          ns->borrowConn(), args[1], args[2], args[3], args[5]);
+        return false;
+      }
+      _replMgr->supplyFullSync(ns->borrowConn(),
+                               args[1],
+                               args[2],
+                               args[3],
+                               args.size() > 4 ? args[4] : "",
+                               args.size() > 5 ? args[5] : "");
       ++_serverStat.syncFull;
       return false;
     } else if (expCmdName == "incrsync") {
@@ -1033,8 +1083,20 @@ bool ServerEntry::processRequest(Session* sess) {
       std::vector<std::string> args = ns->getArgs();
       // we have called precheck, it should have 2 args
       // INVARIANT(args.size() == 4);
-      _migrateMgr->dstReadyMigrate(
-        ns->borrowConn(), args[1], args[2], args[3], args[4]);
+      // the options asked by the receiver, the unknown ones are ignored
+      bool sstMode = false;
+      bool frameMode = false;
+      for (size_t i = 5; i < args.size(); i++) {
+        sstMode |= args[i] == "sst";
+        frameMode |= args[i] == "frame";
+      }
+      _migrateMgr->dstReadyMigrate(ns->borrowConn(),
+                                   args[1],
+                                   args[2],
+                                   args[3],
+                                   args[4],
+                                   sstMode,
+                                   frameMode);
       return false;
     } else if (expCmdName == "preparemigrate") {
       LOG(INFO) << "prepare migrate command";
@@ -1061,17 +1123,43 @@ bool ServerEntry::processRequest(Session* sess) {
     }
   }
 
-  auto expect = Command::runSessionCmd(sess);
+  ReplyBuffer reply;
+  auto expect = Command::runSessionCmd(sess, &reply);
+  if (expect.ok() && sess->getCtx()->isBlocked()) {
+    // no reply, the session would be parked, see NetSession::park()
+    return true;
+  }
+  auto pCtx = sess->getCtx();
+  if (pCtx->hasPendingLock()) {
+    if (expect.code() == ErrorCodes::ERR_LOCK_WAIT) {
+      // park until the key lock is granted or timed out, then run the
+      // command again, see KeyLock::AquireKeyLock()
+      // NOTE: the granted callback, BlockingManager::signalSession(), is
+      // run by the thread releasing the lock with the MGL shard mutex
+      // held, so it must not block or take a key lock.
+      _blockingMgr->addWaiter(sess->id(), pCtx->getDbId(), {},
+                              pCtx->getLockDeadline());
+      if (pCtx->isPendingLockGranted()) {
+        // granted before the waiter is added
+        _blockingMgr->signalSession(sess->id());
+      }
+      pCtx->setBlocked(true);
+      return true;
+    }
+    // the command goes on without the lock waited
+    pCtx->takePendingLock();
+    pCtx->setWaitLock(0, 0, "", mgl::LockMode::LOCK_NONE);
+  }
   if (!expect.ok()) {
-    auto s = sess->setResponse(Command::fmtErr(expect.status().toString()));
+    auto s = sess->setResponse(Command::fmtErr(expect.toString()));
     if (!s.ok()) {
       return false;
     }
     DLOG(ERROR) << "Command::runSessionCmd failed, cmd:" << sess->getCmdStr()
-                << " err:" << expect.status().toString();
+                << " err:" << expect.toString();
     return true;
   }
-  auto s = sess->setResponse(expect.value());
+  auto s = sess->setResponse(std::move(reply));
   if (!s.ok()) {
     return false;
   }
@@ -1118,6 +1206,11 @@ void ServerEntry::getStatInfo(std::stringstream& ss) const {
 
   ss << "total_stricky_packets:" << _netMatrix->stickyPackets.get() << "\r\n";
   ss << "total_invalid_packets:" << _netMatrix->invalidPackets.get() << "\r\n";
+  ss << "total_pipeline_batches:" << _netMatrix->pipelineBatches.get()
+     << "\r\n";
+  ss << "total_pipeline_batched_commands:"
+     << _netMatrix->pipelineBatchedCmds.get() << "\r\n";
+  ss << "total_net_writes_saved:" << _netMatrix->writesSaved.get() << "\r\n";
 
   ss << "total_net_input_bytes:" << _serverStat.netInputBytes.get() << "\r\n";
   ss << "total_net_output_bytes:" << _serverStat.netOutputBytes.get() << "\r\n";
@@ -1139,6 +1232,12 @@ void ServerEntry::getStatInfo(std::stringstream& ss) const {
   ss << "keyspace_misses:" << _serverStat.keyspaceMisses.get() << "\r\n";
   ss << "keyspace_wrong_versionep:" << _serverStat.keyspaceIncorrectEp.get()
      << "\r\n";
+  ss << "pubsub_channels:" << _pubsubMgr->getChannelCount()
+     << "\r\n";
+  ss << "pubsub_patterns:" << _pubsubMgr->getPatternCount() << "\r\n";
+  ss << "total_pubsub_published:" << _pubsubMgr->published.get() << "\r\n";
+  ss << "pubsub_output_limit_closed:" << _pubsubMgr->outputLimitClosed.get()
+     << "\r\n";
   ss << "scheduleNum:" << _scheduleNum << "\r\n";
 }
 
@@ -1156,6 +1255,12 @@ void ServerEntry::appendJSONStat(
     w.Uint64(_netMatrix->connReleased.get());
     w.Key("invalid_packets");
     w.Uint64(_netMatrix->invalidPackets.get());
+    w.Key("pipeline_batches");
+    w.Uint64(_netMatrix->pipelineBatches.get());
+    w.Key("pipeline_batched_cmds");
+    w.Uint64(_netMatrix->pipelineBatchedCmds.get());
+    w.Key("writes_saved");
+    w.Uint64(_netMatrix->writesSaved.get());
     w.EndObject();
   }
   if (sections.find("request") != sections.end()) {
@@ -1381,6 +1486,8 @@ void ServerEntry::serverCron() {
                                            _serverStat.netInputBytes.get());
       _serverStat.trackInstantaneousMetric(STATS_METRIC_NET_OUTPUT,
                                            _serverStat.netOutputBytes.get());
+      // resume the blocked sessions timed out
+      _blockingMgr->expireWaiters(msSinceEpoch());
     }
 
     run_with_period(1000) {
@@ -1467,6 +1574,8 @@ void ServerEntry::stop() {
     _migrateMgr->stop();
   if (_indexMgr)
     _indexMgr->stop();
+  // the parked sessions are referenced by their resume callbacks
+  _blockingMgr->clear();
   {
     std::lock_guard<std::mutex> lk(_mutex);
     _sessions.clear();
@@ -23,6 +23,9 @@
 #include "tendisplus/replication/repl_manager.h"
 #include "tendisplus/cluster/migrate_manager.h"
 #include "tendisplus/server/index_manager.h"
+#include "tendisplus/server/blocking_manager.h"
+#include "tendisplus/server/pubsub_manager.h"
+#include "tendisplus/server/watch_manager.h"
 #include "tendisplus/storage/kvstore.h"
 #include "tendisplus/storage/catalog.h"
 #include "tendisplus/lock/mgl/mgl_mgr.h"
@@ -44,6 +47,9 @@ class MigrateManager;
 class IndexManager;
 class ClusterManager;
 class GCManager;
+class BlockingManager;
+class PubSubManager;
+class WatchManager;
 
 /* Instantaneous metrics tracking. */
 #define STATS_METRIC_SAMPLES 16   /* Number of samples per metric. */
@@ -191,6 +197,9 @@ class ServerEntry : public std::enable_shared_from_this<ServerEntry> {
   IndexManager* getIndexMgr();
   ClusterManager* getClusterMgr();
   GCManager* getGcMgr();
+  BlockingManager* getBlockingMgr();
+  PubSubManager* getPubSubMgr();
+  WatchManager* getWatchMgr();
 
   // TODO(takenliu) : args exist at two places, has better way?
   std::string requirepass() const;
@@ -322,6 +331,9 @@ class ServerEntry : public std::enable_shared_from_this<ServerEntry> {
   std::unique_ptr<mgl::MGLockMgr> _mgLockMgr;
   std::unique_ptr<ClusterManager> _clusterMgr;
   std::unique_ptr<GCManager> _gcMgr;
+  std::unique_ptr<BlockingManager> _blockingMgr;
+  std::unique_ptr<PubSubManager> _pubsubMgr;
+  std::unique_ptr<WatchManager> _watchMgr;
 
   std::vector<PStore> _kvstores;
   std::unique_ptr<Catalog> _catalog;
@@ -107,6 +107,14 @@ bool compressTypeParamCheck(const string& val) {
   return false;
 }
 
+bool zsetEngineParamCheck(const string& val) {
+  auto v = toLower(val);
+  if (v == "skiplist" || v == "index") {
+    return true;
+  }
+  return false;
+}
+
 bool executorThreadNumCheck(const std::string& val) {
   auto num = std::strtoull(val.c_str(), nullptr, 10);
   if (!getGlobalServer()) {
@@ -303,6 +311,16 @@ ServerParams::ServerParams() {
   REGISTER_VARS(pauseTimeIndexMgr);
 
   REGISTER_VARS_DIFF_NAME("proto-max-bulk-len", protoMaxBulkLen);
+  REGISTER_VARS_ALLOW_DYNAMIC_SET(kvPieceThreshold);
+  REGISTER_VARS_SAME_NAME(kvPieceSize, nullptr, nullptr, 16, INT_MAX, true);
+  REGISTER_VARS_ALLOW_DYNAMIC_SET(hashMaxInlineEntries);
+  REGISTER_VARS_ALLOW_DYNAMIC_SET(hashMaxInlineValue);
+  REGISTER_VARS_ALLOW_DYNAMIC_SET(setMaxInlineEntries);
+  REGISTER_VARS_ALLOW_DYNAMIC_SET(setMaxInlineValue);
+  REGISTER_VARS_ALLOW_DYNAMIC_SET(zsetMaxInlineEntries);
+  REGISTER_VARS_ALLOW_DYNAMIC_SET(zsetMaxInlineValue);
+  REGISTER_VARS_SAME_NAME(
+    zsetEngine, zsetEngineParamCheck, removeQuotesAndToLower, -1, -1, false);
   REGISTER_VARS_DIFF_NAME("databases", dbNum);
 
   REGISTER_VARS(noexpire);
@@ -312,6 +330,7 @@ ServerParams::ServerParams() {
   REGISTER_VARS_ALLOW_DYNAMIC_SET(slaveBinlogKeepNum);
 
   REGISTER_VARS_ALLOW_DYNAMIC_SET(maxClients);
+  REGISTER_VARS_DIFF_NAME_DYNAMIC("pubsub-output-limit", pubsubOutputLimit);
   REGISTER_VARS_DIFF_NAME("slowlog", slowlogPath);
   REGISTER_VARS_DIFF_NAME_DYNAMIC("slowlog-log-slower-than",
                                   slowlogLogSlowerThan);
@@ -333,11 +352,17 @@ ServerParams::ServerParams() {
   REGISTER_VARS(binlogRateLimitMB);
   REGISTER_VARS(netBatchSize);
   REGISTER_VARS(netBatchTimeoutSec);
+  REGISTER_VARS_SAME_NAME(
+    netPipelineBatchMax, nullptr, nullptr, 1, 100000, true);
   REGISTER_VARS(timeoutSecBinlogWaitRsp);
   REGISTER_VARS_SAME_NAME(incrPushThreadnum, nullptr, nullptr, 1, 200, true);
   REGISTER_VARS_SAME_NAME(fullPushThreadnum, nullptr, nullptr, 1, 200, true);
+  REGISTER_VARS_SAME_NAME(fullSyncStreams, nullptr, nullptr, 0, 64, true);
+  REGISTER_VARS_SAME_NAME(
+    fullSyncResumeSecs, nullptr, nullptr, 0, 24 * 3600, true);
   REGISTER_VARS_SAME_NAME(fullReceiveThreadnum, nullptr, nullptr, 1, 200, true);
   REGISTER_VARS_SAME_NAME(logRecycleThreadnum, nullptr, nullptr, 1, 200, true);
+  REGISTER_VARS_SAME_NAME(incrApplyThreadnum, nullptr, nullptr, 1, 200, true);
   REGISTER_VARS_FULL("truncateBinlogIntervalMs", truncateBinlogIntervalMs,
     NULL, NULL, 10, 5000, true)
   REGISTER_VARS_ALLOW_DYNAMIC_SET(truncateBinlogNum);
@@ -347,6 +372,8 @@ ServerParams::ServerParams() {
 
   REGISTER_VARS_ALLOW_DYNAMIC_SET(keysDefaultLimit);
   REGISTER_VARS_ALLOW_DYNAMIC_SET(lockWaitTimeOut);
+  REGISTER_VARS_SAME_NAME(lockShardNum, nullptr, nullptr, 1, 1 << 20, false);
+  REGISTER_VARS_ALLOW_DYNAMIC_SET(lockWaitAsync);
 
   REGISTER_VARS_DIFF_NAME("rocks.blockcachemb", rocksBlockcacheMB);
   REGISTER_VARS_DIFF_NAME("rocks.blockcache_strict_capacity_limit",
@@ -354,6 +381,7 @@ ServerParams::ServerParams() {
   REGISTER_VARS_DIFF_NAME_DYNAMIC("rocks.disable_wal", rocksDisableWAL);
   REGISTER_VARS_DIFF_NAME_DYNAMIC("rocks.flush_log_at_trx_commit",
                                   rocksFlushLogAtTrxCommit);
+  REGISTER_VARS_DIFF_NAME_DYNAMIC("rocks.group_wal_sync", rocksGroupWALSync);
   REGISTER_VARS_DIFF_NAME("rocks.wal_dir", rocksWALDir);
 
   REGISTER_VARS_FULL("rocks.compress_type",
@@ -365,6 +393,7 @@ ServerParams::ServerParams() {
                      false);
   REGISTER_VARS_DIFF_NAME("rocks.level0_compress_enabled", level0Compress);
   REGISTER_VARS_DIFF_NAME("rocks.level1_compress_enabled", level1Compress);
+  REGISTER_VARS_DIFF_NAME("slot-stats-enabled", slotStatsEnabled);
 
   REGISTER_VARS_SAME_NAME(
     migrateSenderThreadnum, nullptr, nullptr, 1, 200, true);
@@ -388,12 +417,20 @@ ServerParams::ServerParams() {
   REGISTER_VARS_DIFF_NAME_DYNAMIC("cluster-migration-distance",
                                   migrateDistance);
   REGISTER_VARS_DIFF_NAME_DYNAMIC("garbage-delete-size", garbageDeleteSize);
+  REGISTER_VARS_DIFF_NAME_DYNAMIC("garbage-delete-by-compaction",
+                                  garbageDeleteByCompaction);
   REGISTER_VARS_DIFF_NAME_DYNAMIC("cluster-migration-binlog-iters",
                                   migrateBinlogIter);
   REGISTER_VARS_DIFF_NAME_DYNAMIC("cluster-migration-slots-num-per-task",
                                   migrateTaskSlotsLimit);
   REGISTER_VARS_DIFF_NAME_DYNAMIC("cluster-migration-rate-limit",
                                   migrateRateLimitMB);
+  REGISTER_VARS_DIFF_NAME_DYNAMIC("cluster-migration-sst-enabled",
+                                  migrateSstEnabled);
+  REGISTER_VARS_DIFF_NAME_DYNAMIC("cluster-migration-frame-enabled",
+                                  migrateFrameEnabled);
+  REGISTER_VARS_DIFF_NAME_DYNAMIC("cluster-migration-frame-compress",
+                                  migrateFrameCompress);
   REGISTER_VARS_DIFF_NAME_DYNAMIC("migrate-snapshot-retry-num",
                                   snapShotRetryCnt);
   REGISTER_VARS_DIFF_NAME_DYNAMIC("binlog-send-batch", bingLogSendBatch);
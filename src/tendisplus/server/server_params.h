@@ -376,6 +376,22 @@ class ServerParams {
   uint32_t pauseTimeIndexMgr = 10;
 
   uint32_t protoMaxBulkLen = CONFIG_DEFAULT_PROTO_MAX_BULK_LEN;
+  // a string longer than kvPieceThreshold is saved in pieces of
+  // kvPieceSize, 0 means never
+  uint32_t kvPieceThreshold = 1024 * 1024;
+  uint32_t kvPieceSize = 64 * 1024;
+  // a hash/set/zset with at most *MaxInlineEntries elements, none of
+  // them longer than *MaxInlineValue, is saved inline in its meta, 0 means
+  // never
+  uint32_t hashMaxInlineEntries = 32;
+  uint32_t hashMaxInlineValue = 64;
+  uint32_t setMaxInlineEntries = 32;
+  uint32_t setMaxInlineValue = 64;
+  uint32_t zsetMaxInlineEntries = 32;
+  uint32_t zsetMaxInlineValue = 64;
+  // the engine of new zsets, "skiplist" or "index". A zset of the other
+  // engine is converted when it's written by ZADD/ZINCRBY.
+  std::string zsetEngine = "skiplist";
   uint32_t dbNum = CONFIG_DEFAULT_DBNUM;
 
   bool noexpire = false;
@@ -384,6 +400,8 @@ class ServerParams {
   uint64_t slaveBinlogKeepNum = 1;
 
   uint32_t maxClients = CONFIG_DEFAULT_MAX_CLIENTS;
+  // bytes of unsent replies a pubsub client can have, 0 means no limit
+  uint64_t pubsubOutputLimit = 32 * 1024 * 1024;
   std::string slowlogPath = "./slowlog";
   uint32_t slowlogLogSlowerThan = CONFIG_DEFAULT_SLOWLOG_LOG_SLOWER_THAN;
   // uint32_t slowlogMaxLen = CONFIG_DEFAULT_SLOWLOG_LOG_MAX_LEN;
@@ -398,11 +416,20 @@ class ServerParams {
   uint32_t binlogRateLimitMB = 64;
   uint32_t netBatchSize = 1024 * 1024;
   uint32_t netBatchTimeoutSec = 10;
+  uint32_t netPipelineBatchMax = 64;
   uint32_t timeoutSecBinlogWaitRsp = 30;
   uint32_t incrPushThreadnum = 4;
   uint32_t fullPushThreadnum = 4;
   uint32_t fullReceiveThreadnum = 4;
+  // the connections used by the slave's fullsync, the files are streamed
+  // over them in parallel. 0 means the stop-and-wait protocol of old versions
+  uint32_t fullSyncStreams = 0;
+  // the checkpoint of a failed streaming fullsync is kept for so long, for
+  // the slave to resume from
+  uint32_t fullSyncResumeSecs = 600;
   uint32_t logRecycleThreadnum = 4;
+  // the slave applies the binlogs of a store in parallel if it's > 1
+  uint32_t incrApplyThreadnum = 1;
   uint32_t truncateBinlogIntervalMs = 1000;
   uint32_t truncateBinlogNum = 50000;
   uint32_t binlogFileSizeMB = 64;
@@ -411,6 +438,8 @@ class ServerParams {
 
   uint32_t keysDefaultLimit = 100;
   uint32_t lockWaitTimeOut = 3600;
+  uint32_t lockShardNum = 1024;
+  bool lockWaitAsync = true;
 
   // parameter for rocksdb
   uint32_t rocksBlockcacheMB = 4096;
@@ -420,8 +449,13 @@ class ServerParams {
   // WriteOptions
   bool rocksDisableWAL = false;
   bool rocksFlushLogAtTrxCommit = false;
+  // fsync the WAL once for the concurrent committers, the WAL writes
+  // are grouped by rocksdb anyway
+  bool rocksGroupWALSync = true;
   bool level0Compress = false;
   bool level1Compress = false;
+  // keep the number of keys of each slot in memory, instead of scanning
+  bool slotStatsEnabled = true;
 
   uint32_t bingLogSendBatch = 256;
   uint32_t bingLogSendBytes = 16 * 1024 * 1024;
@@ -430,6 +464,9 @@ class ServerParams {
   uint32_t migrateReceiveThreadnum = 4;
   uint32_t garbageDeleteThreadnum = 1;
   uint16_t garbageDeleteSize = 30;
+  // drop the garbage slots by compaction filter and sst file deletion,
+  // instead of range tombstones
+  bool garbageDeleteByCompaction = false;
 
   bool clusterEnabled = false;
   bool domainEnabled = false;
@@ -441,6 +478,13 @@ class ServerParams {
   uint32_t migrateDistance = 10000;
   uint16_t migrateBinlogIter = 10;
   uint32_t migrateRateLimitMB = 32;
+  // the receiver asks the sender for sst files of the snapshot,
+  // the sender should support it too
+  bool migrateSstEnabled = false;
+  // the receiver asks the sender for framed snapshot records,
+  // and the sender compresses the frames by snappy if enabled
+  bool migrateFrameEnabled = false;
+  bool migrateFrameCompress = true;
   uint32_t clusterNodeTimeout = 15000;
   bool clusterRequireFullCoverage = true;
   bool clusterSlaveNoFailover = false;
@@ -148,6 +148,10 @@ std::string LocalSession::getRemote() const {
   return "";
 }
 
+Status Session::setResponse(ReplyBuffer&& reply) {
+  return setResponse(reply.toString());
+}
+
 Status LocalSession::setResponse(const std::string& s) {
   INVARIANT(_respBuf.size() == 0);
   std::copy(s.begin(), s.end(), std::back_inserter(_respBuf));
@@ -12,6 +12,7 @@
 #include <vector>
 #include "asio.hpp"
 #include "tendisplus/utils/status.h"
+#include "tendisplus/network/reply_buffer.h"
 
 namespace tendisplus {
 
@@ -31,6 +32,13 @@ class Session : public std::enable_shared_from_this<Session> {
   virtual ~Session();
   uint64_t id() const;
   virtual Status setResponse(const std::string& s) = 0;
+  // the default one flattens the reply, NetSession sends the chunks as
+  // they are.
+  virtual Status setResponse(ReplyBuffer&& reply);
+  // the bytes of replies set but not sent yet
+  virtual uint64_t getPendingRspBytes() const {
+    return 0;
+  }
   const std::vector<std::string>& getArgs() const;
   Status processExtendProtocol();
   SessionCtx* getCtx() const;
@@ -90,6 +98,7 @@ class LocalSession : public Session {
   Status cancel() final;
   int getFd() final;
   std::string getRemote() const final;
+  using Session::setResponse;
   Status setResponse(const std::string& s) final;
   void setArgs(const std::vector<std::string>& args);
   void setArgs(const std::string& cmd);
@@ -0,0 +1,88 @@
+// Copyright (C) 2020 THL A29 Limited, a Tencent company.  All rights reserved.
+// Please refer to the license text that comes with this tendis open source
+// project for additional information.
+
+#include "tendisplus/server/watch_manager.h"
+
+namespace tendisplus {
+
+void WatchManager::watch(uint64_t sessId, const WatchedKey& wk) {
+  std::lock_guard<std::mutex> lk(_mutex);
+  auto& state = _sessions[sessId];
+  for (const auto& v : state.keys) {
+    if (v.dbId == wk.dbId && v.key == wk.key) {
+      return;
+    }
+  }
+  state.keys.push_back(wk);
+  _keys[wk.key].insert(sessId);
+  _watchingCnt.store(_sessions.size(), std::memory_order_relaxed);
+}
+
+void WatchManager::unwatch(uint64_t sessId) {
+  if (_watchingCnt.load(std::memory_order_relaxed) == 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lk(_mutex);
+  auto it = _sessions.find(sessId);
+  if (it == _sessions.end()) {
+    return;
+  }
+  for (const auto& wk : it->second.keys) {
+    auto kit = _keys.find(wk.key);
+    if (kit == _keys.end()) {
+      continue;
+    }
+    kit->second.erase(sessId);
+    if (kit->second.empty()) {
+      _keys.erase(kit);
+    }
+  }
+  _sessions.erase(it);
+  _watchingCnt.store(_sessions.size(), std::memory_order_relaxed);
+}
+
+std::vector<WatchManager::WatchedKey> WatchManager::getWatchedKeys(
+  uint64_t sessId) const {
+  std::lock_guard<std::mutex> lk(_mutex);
+  auto it = _sessions.find(sessId);
+  if (it == _sessions.end()) {
+    return {};
+  }
+  return it->second.keys;
+}
+
+bool WatchManager::isDirty(uint64_t sessId) const {
+  std::lock_guard<std::mutex> lk(_mutex);
+  auto it = _sessions.find(sessId);
+  return it != _sessions.end() && it->second.dirty;
+}
+
+void WatchManager::touchKey(const std::string& key, uint64_t toucherId) {
+  if (_watchingCnt.load(std::memory_order_relaxed) == 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lk(_mutex);
+  auto it = _keys.find(key);
+  if (it == _keys.end()) {
+    return;
+  }
+  for (auto sessId : it->second) {
+    if (sessId != toucherId) {
+      _sessions[sessId].dirty = true;
+    }
+  }
+}
+
+void WatchManager::touchAll() {
+  std::lock_guard<std::mutex> lk(_mutex);
+  for (auto& v : _sessions) {
+    v.second.dirty = true;
+  }
+}
+
+size_t WatchManager::getWatchingCount() const {
+  return _watchingCnt.load(std::memory_order_relaxed);
+}
+
+}  // namespace tendisplus
@@ -0,0 +1,67 @@
+// Copyright (C) 2020 THL A29 Limited, a Tencent company.  All rights reserved.
+// Please refer to the license text that comes with this tendis open source
+// project for additional information.
+
+#ifndef SRC_TENDISPLUS_SERVER_WATCH_MANAGER_H_
+#define SRC_TENDISPLUS_SERVER_WATCH_MANAGER_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace tendisplus {
+
+// WatchManager keeps the keys watched by WATCH. A key locked in LOCK_X by
+// a write command of another session is touched, which makes the EXEC of
+// its watchers fail.
+// Touching happens with the key lock held, and EXEC checks the watchers
+// with the keys locked, so a write can't slip in between.
+// Each watched key also keeps a stamp of its meta RecordValue, EXEC
+// compares it again to catch the changes not done by commands, such as
+// the expired keys deleted in background.
+class WatchManager {
+ public:
+  struct WatchedKey {
+    uint32_t dbId;
+    std::string key;
+    // empty if the key doesn't exist
+    std::string stamp;
+  };
+
+  WatchManager() = default;
+  WatchManager(const WatchManager&) = delete;
+  WatchManager(WatchManager&&) = delete;
+
+  void watch(uint64_t sessId, const WatchedKey& wk);
+  void unwatch(uint64_t sessId);
+  std::vector<WatchedKey> getWatchedKeys(uint64_t sessId) const;
+  // return true if a key watched by the session is touched
+  bool isDirty(uint64_t sessId) const;
+  // the sessions watching the key, except the toucher, are made dirty.
+  // NOTE: keys of all the dbs are touched.
+  void touchKey(const std::string& key, uint64_t toucherId);
+  // for FLUSHALL/FLUSHDB
+  void touchAll();
+  size_t getWatchingCount() const;
+
+ private:
+  struct WatchState {
+    std::vector<WatchedKey> keys;
+    bool dirty = false;
+  };
+  mutable std::mutex _mutex;
+  // key -> sessions watching it
+  std::unordered_map<std::string, std::set<uint64_t>> _keys;
+  std::unordered_map<uint64_t, WatchState> _sessions;
+  // the size of _sessions, so that touching is free without watchers
+  std::atomic<size_t> _watchingCnt{0};
+};
+
+}  // namespace tendisplus
+
+#endif  // SRC_TENDISPLUS_SERVER_WATCH_MANAGER_H_
@@ -0,0 +1,47 @@
+// Copyright (C) 2020 THL A29 Limited, a Tencent company.  All rights reserved.
+// Please refer to the license text that comes with this tendis open source
+// project for additional information.
+
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "tendisplus/server/watch_manager.h"
+
+namespace tendisplus {
+
+TEST(WatchManager, Touch) {
+  WatchManager mgr;
+  mgr.touchKey("a", 1);
+  EXPECT_EQ(mgr.getWatchingCount(), 0U);
+
+  mgr.watch(1, {0, "a", ""});
+  mgr.watch(1, {0, "a", ""});
+  mgr.watch(1, {0, "b", "stamp"});
+  mgr.watch(2, {0, "b", "stamp"});
+  EXPECT_EQ(mgr.getWatchingCount(), 2U);
+  EXPECT_EQ(mgr.getWatchedKeys(1).size(), 2U);
+  EXPECT_EQ(mgr.getWatchedKeys(2)[0].stamp, "stamp");
+
+  // touched by itself
+  mgr.touchKey("a", 1);
+  EXPECT_FALSE(mgr.isDirty(1));
+  mgr.touchKey("c", 3);
+  EXPECT_FALSE(mgr.isDirty(1));
+  mgr.touchKey("a", 3);
+  EXPECT_TRUE(mgr.isDirty(1));
+  EXPECT_FALSE(mgr.isDirty(2));
+
+  mgr.unwatch(1);
+  EXPECT_FALSE(mgr.isDirty(1));
+  EXPECT_EQ(mgr.getWatchedKeys(1).size(), 0U);
+  mgr.touchKey("a", 3);
+  EXPECT_FALSE(mgr.isDirty(1));
+  EXPECT_EQ(mgr.getWatchingCount(), 1U);
+
+  mgr.touchAll();
+  EXPECT_TRUE(mgr.isDirty(2));
+  mgr.unwatch(2);
+  EXPECT_EQ(mgr.getWatchingCount(), 0U);
+}
+
+}  // namespace tendisplus
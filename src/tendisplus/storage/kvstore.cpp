@@ -464,6 +464,41 @@ Expected<Record> SlotsCursor::next() {
   }
 }
 
+Expected<bool> SubKeyVersionChecker::isStale(const RecordKey& rk) {
+  switch (rk.getRecordType()) {
+    case RecordType::RT_HASH_ELE:
+    case RecordType::RT_SET_ELE:
+    case RecordType::RT_ZSET_S_ELE:
+    case RecordType::RT_ZSET_H_ELE:
+    case RecordType::RT_KV_PIECE:
+      break;
+    default:
+      return false;
+  }
+  RecordKey mk(rk.getChunkId(),
+               rk.getDbId(),
+               RecordType::RT_DATA_META,
+               rk.getPrimaryKey(),
+               "");
+  std::string mkEnc = mk.encode();
+  if (mkEnc != _lastMetaKey) {
+    auto expMeta = _txn->getKV(mkEnc);
+    if (expMeta.ok()) {
+      auto expRv = RecordValue::decode(expMeta.value());
+      if (!expRv.ok()) {
+        return expRv.status();
+      }
+      _lastMetaExist = true;
+      _lastMetaVersion = expRv.value().getVersion();
+    } else if (expMeta.status().code() == ErrorCodes::ERR_NOTFOUND) {
+      _lastMetaExist = false;
+    } else {
+      return expMeta.status();
+    }
+    _lastMetaKey = std::move(mkEnc);
+  }
+  return !_lastMetaExist || _lastMetaVersion != rk.getVersion();
+}
 
 KVStore::KVStore(const std::string& id, const std::string& path)
   : _id(id), _dbPath(path), _backupDir(path + "/" + id + "_bak") {
@@ -194,6 +194,26 @@ class SlotsCursor {
   std::unique_ptr<Cursor> _baseCursor;
 };
 
+// The subkeys of a deleted or recreated hash/set/zset or chunked string
+// are left for the compaction filter, see rcd_util::genSubKeyVersion().
+// SubKeyVersionChecker tells them apart while iterating the records in
+// order. The subkeys of one key are adjacent, so the last meta read is
+// cached.
+class SubKeyVersionChecker {
+ public:
+  explicit SubKeyVersionChecker(Transaction* txn) : _txn(txn) {}
+  // whether rk is a subkey whose meta is missing or of another version,
+  // the other records are never stale
+  Expected<bool> isStale(const RecordKey& rk);
+
+ private:
+  Transaction* _txn;
+  // the encoded meta key looked up last time, empty if none
+  std::string _lastMetaKey;
+  bool _lastMetaExist = false;
+  uint64_t _lastMetaVersion = 0;
+};
+
 class Transaction {
  public:
   Transaction() = default;
@@ -223,6 +243,10 @@ class Transaction {
   virtual std::string getKVStoreId() const = 0;
   virtual void setChunkId(uint32_t chunkId) = 0;
   virtual void SetSnapshot() = 0;
+  // rollbackToSavePoint() undoes the writes after the most recent
+  // setSavePoint(), and removes that savepoint.
+  virtual void setSavePoint() = 0;
+  virtual Status rollbackToSavePoint() = 0;
 
   virtual std::unique_ptr<TTLIndexCursor> createTTLIndexCursor(
     std::uint64_t until) = 0;
@@ -235,12 +259,20 @@ class Transaction {
   virtual std::unique_ptr<BinlogCursor> createBinlogCursor() = 0;
 
   virtual Expected<std::string> getKV(const std::string& key) = 0;
+  // get a batch of keys in one round from one snapshot, the results are
+  // in the same order as the keys
+  virtual std::vector<Expected<std::string>> getKVs(
+    const std::vector<std::string>& keys) = 0;
   virtual Status setKV(const std::string& key,
                        const std::string& val,
                        const uint64_t ts = 0) = 0;
   virtual Status delKV(const std::string& key, const uint64_t ts = 0) = 0;
   virtual Status addDeleteRangeBinlog(const std::string& begin,
                                       const std::string& end) = 0;
+  // only add the binlog of setting key, the key is written in other ways,
+  // e.g. ingested by sst files
+  virtual Status addSetBinlog(const std::string& key,
+                              const std::string& val) = 0;
   virtual uint64_t getBinlogTime() = 0;
   virtual void setBinlogTime(uint64_t timestamp) = 0;
   virtual bool isReplOnly() const = 0;
@@ -261,6 +293,137 @@ class Transaction {
   static constexpr uint32_t CHUNKID_DEL_RANGE = 0xFFFFFFFB;
 };
 
+// SharedTxn forwards everything to a transaction not owned by it, except
+// that commit() and rollback() do nothing. The commands run by EXEC get
+// SharedTxns of the session's transaction of each kvstore, so that all of
+// their writes are committed together by EXEC, see SessionCtx::commitExec().
+// A command failing halfway is rolled back to the savepoint set before it.
+class SharedTxn : public Transaction {
+ public:
+  explicit SharedTxn(Transaction* txn) : _txn(txn) {}
+  Expected<uint64_t> commit() final {
+    return _txn->getTxnId();
+  }
+  Status rollback() final {
+    return {ErrorCodes::ERR_OK, ""};
+  }
+  std::unique_ptr<Cursor> createCursor(
+    ColumnFamilyNumber cf, const std::string* iterate_upper_bound) final {
+    return _txn->createCursor(cf, iterate_upper_bound);
+  }
+  Status flushall() final {
+    return _txn->flushall();
+  }
+  Status migrate(const std::string& logKey,
+                 const std::string& logValue) final {
+    return _txn->migrate(logKey, logValue);
+  }
+  std::unique_ptr<RepllogCursorV2> createRepllogCursorV2(
+    uint64_t begin, bool ignoreReadBarrier) final {
+    return _txn->createRepllogCursorV2(begin, ignoreReadBarrier);
+  }
+  Status applyBinlog(const ReplLogValueEntryV2& logEntry) final {
+    return _txn->applyBinlog(logEntry);
+  }
+  Status setBinlogKV(uint64_t binlogId,
+                     const std::string& logKey,
+                     const std::string& logValue) final {
+    return _txn->setBinlogKV(binlogId, logKey, logValue);
+  }
+  Status setBinlogKV(const std::string& logKey,
+                     const std::string& logValue) final {
+    return _txn->setBinlogKV(logKey, logValue);
+  }
+  Status delBinlog(const ReplLogRawV2& log) final {
+    return _txn->delBinlog(log);
+  }
+  uint64_t getBinlogId() const final {
+    return _txn->getBinlogId();
+  }
+  void setBinlogId(uint64_t binlogId) final {
+    _txn->setBinlogId(binlogId);
+  }
+  uint32_t getChunkId() const final {
+    return _txn->getChunkId();
+  }
+  std::string getKVStoreId() const final {
+    return _txn->getKVStoreId();
+  }
+  void setChunkId(uint32_t chunkId) final {
+    _txn->setChunkId(chunkId);
+  }
+  void SetSnapshot() final {
+    _txn->SetSnapshot();
+  }
+  void setSavePoint() final {
+    _txn->setSavePoint();
+  }
+  Status rollbackToSavePoint() final {
+    return _txn->rollbackToSavePoint();
+  }
+  std::unique_ptr<TTLIndexCursor> createTTLIndexCursor(
+    std::uint64_t until) final {
+    return _txn->createTTLIndexCursor(until);
+  }
+  std::unique_ptr<SlotCursor> createSlotCursor(uint32_t slot) final {
+    return _txn->createSlotCursor(slot);
+  }
+  std::unique_ptr<SlotsCursor> createSlotsCursor(uint32_t start,
+                                                 uint32_t end) final {
+    return _txn->createSlotsCursor(start, end);
+  }
+  std::unique_ptr<VersionMetaCursor> createVersionMetaCursor() final {
+    return _txn->createVersionMetaCursor();
+  }
+  std::unique_ptr<BasicDataCursor> createDataCursor() final {
+    return _txn->createDataCursor();
+  }
+  std::unique_ptr<AllDataCursor> createAllDataCursor() final {
+    return _txn->createAllDataCursor();
+  }
+  std::unique_ptr<BinlogCursor> createBinlogCursor() final {
+    return _txn->createBinlogCursor();
+  }
+  Expected<std::string> getKV(const std::string& key) final {
+    return _txn->getKV(key);
+  }
+  std::vector<Expected<std::string>> getKVs(
+    const std::vector<std::string>& keys) final {
+    return _txn->getKVs(keys);
+  }
+  Status setKV(const std::string& key,
+               const std::string& val,
+               const uint64_t ts) final {
+    return _txn->setKV(key, val, ts);
+  }
+  Status delKV(const std::string& key, const uint64_t ts) final {
+    return _txn->delKV(key, ts);
+  }
+  Status addDeleteRangeBinlog(const std::string& begin,
+                              const std::string& end) final {
+    return _txn->addDeleteRangeBinlog(begin, end);
+  }
+  Status addSetBinlog(const std::string& key, const std::string& val) final {
+    return _txn->addSetBinlog(key, val);
+  }
+  uint64_t getBinlogTime() final {
+    return _txn->getBinlogTime();
+  }
+  void setBinlogTime(uint64_t timestamp) final {
+    _txn->setBinlogTime(timestamp);
+  }
+  bool isReplOnly() const final {
+    return _txn->isReplOnly();
+  }
+  uint64_t getTxnId() const final {
+    return _txn->getTxnId();
+  }
+
+ private:
+  // NOTE: not owned by me
+  Transaction* _txn;
+};
+
 class BackupInfo {
  public:
   BackupInfo();
@@ -295,6 +458,11 @@ class BinlogObserver {
 struct KVStoreStat {
   std::atomic<uint64_t> compactFilterCount;
   std::atomic<uint64_t> compactKvExpiredCount;
+  // number of stale subkeys dropped, see rcd_util::genSubKeyVersion()
+  std::atomic<uint64_t> compactSubKeyDroppedCount;
+  // number of records of the garbage slots dropped, see
+  // deleteSlotsByCompaction()
+  std::atomic<uint64_t> compactGarbageDroppedCount;
   // number of request when store is paused
   std::atomic<uint64_t> pausedErrorCount;
   // number of request when store is destroyed
@@ -341,6 +509,8 @@ class KVStore {
   virtual Expected<RecordValue> getKV(const RecordKey& key,
                                       Transaction* txn,
                                       RecordType valueType) = 0;
+  virtual std::vector<Expected<RecordValue>> getKVs(
+    const std::vector<RecordKey>& keys, Transaction* txn) = 0;
   virtual Status setKV(const RecordKey&, const RecordValue&, Transaction*) = 0;
   virtual Status setKV(const Record& kv, Transaction* txn) = 0;
   // TODO(eliotwang) deprecate this member function
@@ -352,6 +522,35 @@ class KVStore {
   virtual Status deleteRange(const std::string& begin,
                              const std::string& end) = 0;
   virtual Status deleteRangeBinlog(uint64_t begin, uint64_t end) = 0;
+  // write the data in [begin, end) seen by txn into sst files under dir,
+  // each file is about maxFileSize at most. return the file names, and
+  // the number of records in keyNum
+  virtual Expected<std::vector<std::string>> exportSst(
+    Transaction* txn,
+    const std::string& begin,
+    const std::string& end,
+    const std::string& dir,
+    uint64_t maxFileSize,
+    uint64_t* keyNum) = 0;
+  // ingest the sst files into the data column family, without binlog.
+  // the files are moved into the db.
+  virtual Status ingestSst(const std::vector<std::string>& files) = 0;
+
+  // the number of keys in the slot kept by the store, ERR_NOTFOUND if
+  // it's unknown. recountSlotKeys() scans the slot and keeps the result.
+  virtual Expected<uint64_t> getSlotKeyCount(uint32_t slot) const = 0;
+  virtual Expected<uint64_t> recountSlotKeys(uint32_t slot) = 0;
+  // forget the key numbers of [begin, end) after they're changed
+  // without txns, such as ingesting sst files
+  virtual void invalidateSlotKeys(uint32_t begin, uint32_t end) = 0;
+  // the approximate bytes of all the records of the slot on disk
+  // and in memtables
+  virtual Expected<uint64_t> getSlotApproximateSize(uint32_t slot) = 0;
+  // delete the records of the slots in [begin, end) without range
+  // tombstones: the sst files inside the range are dropped, and the rest
+  // are compacted with the slots marked as garbage. A DEL_RANGE binlog is
+  // still written for the slaves.
+  virtual Status deleteSlotsByCompaction(uint32_t begin, uint32_t end) = 0;
 
   virtual Status assignBinlogIdIfNeeded(Transaction* txn) = 0;
   virtual void setNextBinlogSeq(uint64_t binlogId, Transaction* txn) = 0;
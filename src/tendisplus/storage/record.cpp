@@ -2,6 +2,8 @@
 // Please refer to the license text that comes with this tendis open source
 // project for additional information.
 
+#include <algorithm>
+#include <atomic>
 #include <type_traits>
 #include <utility>
 #include <memory>
@@ -18,6 +20,7 @@
 #include "tendisplus/utils/status.h"
 #include "tendisplus/utils/string.h"
 #include "tendisplus/utils/invariant.h"
+#include "tendisplus/utils/time.h"
 
 namespace tendisplus {
 
@@ -60,6 +63,7 @@ bool isRealEleType(RecordType keyType, RecordType valueType) {
         return true;
       }
     case RecordType::RT_ZSET_S_ELE:
+    case RecordType::RT_KV_PIECE:
     case RecordType::RT_BINLOG:
     case RecordType::RT_TTL_INDEX:
     case RecordType::RT_META:  // For ts/revision
@@ -97,6 +101,8 @@ uint8_t rt2Char(RecordType t) {
       return 'c';
     case RecordType::RT_ZSET_S_ELE:
       return 'z';
+    case RecordType::RT_KV_PIECE:
+      return 'p';
     case RecordType::RT_TTL_INDEX:
       return std::numeric_limits<uint8_t>::max() - 1;
     // it's convinent (for seek) to have BINLOG to pos
@@ -117,6 +123,7 @@ uint8_t rt2Char(RecordType t) {
 std::string rt2Str(RecordType t) {
   switch (t) {
     case RecordType::RT_KV:
+    case RecordType::RT_KV_PIECE:
       return "STRING";
 
     case RecordType::RT_LIST_META:
@@ -168,6 +175,8 @@ RecordType char2Rt(uint8_t t) {
       return RecordType::RT_ZSET_S_ELE;
     case 'c':
       return RecordType::RT_ZSET_H_ELE;
+    case 'p':
+      return RecordType::RT_KV_PIECE;
     case std::numeric_limits<uint8_t>::max() - 1:
       return RecordType::RT_TTL_INDEX;
     case std::numeric_limits<uint8_t>::max():
@@ -262,7 +271,9 @@ void RecordKey::encodePrefixPk(std::vector<uint8_t>* arr) const {
   arr->push_back(0);
 
   // NOTE(vinchen): version of key, temporarily useless
-  INVARIANT_D(_version == 0);
+  // NOTE: subkeys carry the version of their meta, see
+  // rcd_util::genSubKeyVersion()
+  INVARIANT_D(_version == 0 || _type != RecordType::RT_DATA_META);
   auto v = varintEncode(_version);
   arr->insert(arr->end(), v.begin(), v.end());
 }
@@ -472,7 +483,6 @@ Expected<RecordKey> RecordKey::decode(const std::string& key) {
   }
   size_t versionLen = v.value().second;
   auto version = v.value().first;
-  INVARIANT_D(version == 0);
 
   // sk
   skLen = left - versionLen;
@@ -532,7 +542,7 @@ Expected<bool> RecordKey::validate(const std::string& key, RecordType type) {
     return {ErrorCodes::ERR_DECODE, "invalid version len"};
   }
   auto version = v.value().first;
-  if (version != 0) {
+  if (version != 0 && thisType == RecordType::RT_DATA_META) {
     return {ErrorCodes::ERR_DECODE, "invalid version in record key"};
   }
 
@@ -677,8 +687,11 @@ RecordValue::RecordValue(const std::string& val,
   : RecordValue(val, type, versionEp, ttl) {
   if (oldRV.ok()) {
     setCas(oldRV.value().getCas());
-    setVersion(oldRV.value().getVersion());
-    setPieceSize(oldRV.value().getPieceSize());
+    // NOTE: the new value is not chunked, the pieces of the old one
+    // should be dropped, so don't inherit the version of them
+    if (!oldRV.value().isChunked()) {
+      setVersion(oldRV.value().getVersion());
+    }
   }
 }
 
@@ -690,8 +703,11 @@ RecordValue::RecordValue(const std::string&& val,
   : RecordValue(val, type, versionEp, ttl) {
   if (oldRV.ok()) {
     setCas(oldRV.value().getCas());
-    setVersion(oldRV.value().getVersion());
-    setPieceSize(oldRV.value().getPieceSize());
+    // NOTE: the new value is not chunked, the pieces of the old one
+    // should be dropped, so don't inherit the version of them
+    if (!oldRV.value().isChunked()) {
+      setVersion(oldRV.value().getVersion());
+    }
   }
 }
 
@@ -712,7 +728,6 @@ std::string RecordValue::encode() const {
 
     // version
     offset += varintEncodeBuf(ptr + offset, size - offset, _version);
-    INVARIANT_D(_version == (uint64_t)0);
 
     // versionEP
     offset += varintEncodeBuf(ptr + offset, size - offset, _versionEP + 1);
@@ -726,11 +741,13 @@ std::string RecordValue::encode() const {
     // pieceSize
     // why +1? same as CAS
     offset += varintEncodeBuf(ptr + offset, size - offset, _pieceSize + 1);
-    INVARIANT_D(_pieceSize == (uint64_t)-1);
 
     // totalSize
     offset += varintEncodeBuf(ptr + offset, size - offset, _totalSize + 1);
-    INVARIANT_D(_totalSize == (uint64_t)-1);
+    INVARIANT_D(isChunked()
+                  ? _type == RecordType::RT_KV && _pieceSize > 0 &&
+                    _totalSize != (uint64_t)-1 && _value.empty()
+                  : _totalSize == (uint64_t)-1);
   } else {
     // NOTE(vinchen) : for none DATA META value, the below members is
     // useless. They will take 6 bytes, and always be 0
@@ -790,7 +807,6 @@ Expected<RecordValue> RecordValue::decode(const std::string& value) {
     }
     offset += expt.value().second;
     version = expt.value().first;
-    INVARIANT_D(version == 0);
 
     // versionEP
     expt = varintDecodeFwd(valueCstr + offset, value.size() - offset);
@@ -818,7 +834,6 @@ Expected<RecordValue> RecordValue::decode(const std::string& value) {
     }
     offset += expt.value().second;
     pieceSize = expt.value().first - 1;
-    INVARIANT_D(pieceSize == (uint64_t)-1);
 
     // totalSize
     expt = varintDecodeFwd(valueCstr + offset, value.size() - offset);
@@ -827,7 +842,9 @@ Expected<RecordValue> RecordValue::decode(const std::string& value) {
     }
     offset += expt.value().second;
     totalSize = expt.value().first - 1;
-    INVARIANT_D(totalSize == (uint64_t)-1);
+    if ((pieceSize == (uint64_t)-1) != (totalSize == (uint64_t)-1)) {
+      return {ErrorCodes::ERR_DECODE, "invalid pieceSize or totalSize"};
+    }
 
     if (offset > value.size()) {
       std::stringstream ss;
@@ -841,8 +858,10 @@ Expected<RecordValue> RecordValue::decode(const std::string& value) {
   if (value.size() > offset) {
     rawValue = std::string(value.c_str() + offset, value.size() - offset);
   }
-  return RecordValue(
+  RecordValue rv(
     std::move(rawValue), typeForMeta, versionEP, ttl, cas, version, pieceSize);
+  rv.setTotalSize(totalSize);
+  return std::move(rv);
 }
 
 Expected<bool> RecordValue::validate(const std::string& value,
@@ -903,11 +922,17 @@ Expected<bool> RecordValue::validate(const std::string& value,
   }
   offset += expt.value().second;
   uint64_t totalSize = expt.value().first - 1;
-  if (pieceSize < totalSize) {
-    return {ErrorCodes::ERR_DECODE, "invalid pieceSize"};
-  }
-
-  if (totalSize != value.size() - offset && totalSize != (uint64_t)-1) {
+  if (pieceSize != (uint64_t)-1) {
+    // chunked string, the value is in the pieces
+    if (pieceSize == 0 || totalSize == (uint64_t)-1 ||
+        typeForMeta != RecordType::RT_KV) {
+      return {ErrorCodes::ERR_DECODE, "invalid pieceSize"};
+    }
+    if (value.size() != offset) {
+      return {ErrorCodes::ERR_DECODE, "invalid totalSize"};
+    }
+  } else if (totalSize != value.size() - offset &&
+             totalSize != (uint64_t)-1) {
     return {ErrorCodes::ERR_DECODE, "invalid totalSize"};
   }
 
@@ -1090,12 +1115,39 @@ std::string Record::toString() const {
   return ss.str();
 }
 
+namespace {
+void encodeInlineStr(const std::string& s, std::string* out) {
+  out->append(varintEncodeStr(s.size()));
+  out->append(s);
+}
+
+Expected<std::string> decodeInlineStr(const std::string& val,
+                                      size_t* offset) {
+  const uint8_t* valCstr = reinterpret_cast<const uint8_t*>(val.c_str());
+  auto expt = varintDecodeFwd(valCstr + *offset, val.size() - *offset);
+  if (!expt.ok()) {
+    return expt.status();
+  }
+  *offset += expt.value().second;
+  uint64_t len = expt.value().first;
+  if (len > val.size() - *offset) {
+    return {ErrorCodes::ERR_DECODE, "invalid inline element"};
+  }
+  std::string s = val.substr(*offset, len);
+  *offset += len;
+  return s;
+}
+}  // namespace
+
 HashMetaValue::HashMetaValue() : HashMetaValue(0) {}
 
-HashMetaValue::HashMetaValue(uint64_t count) : _count(count) {}
+HashMetaValue::HashMetaValue(uint64_t count) : _count(count), _inline(false) {}
 
-HashMetaValue::HashMetaValue(HashMetaValue&& o) : _count(o._count) {
+HashMetaValue::HashMetaValue(HashMetaValue&& o)
+  : _count(o._count), _inline(o._inline), _fields(std::move(o._fields)) {
   o._count = 0;
+  o._inline = false;
+  o._fields.clear();
 }
 
 std::string HashMetaValue::encode() const {
@@ -1103,7 +1155,17 @@ std::string HashMetaValue::encode() const {
   value.reserve(128);
   auto countBytes = varintEncode(_count);
   value.insert(value.end(), countBytes.begin(), countBytes.end());
-  return std::string(reinterpret_cast<const char*>(value.data()), value.size());
+  std::string result(reinterpret_cast<const char*>(value.data()),
+                     value.size());
+  if (_inline) {
+    INVARIANT_D(_count == _fields.size());
+    result.push_back(static_cast<char>(INLINE));
+    for (const auto& v : _fields) {
+      encodeInlineStr(v.first, &result);
+      encodeInlineStr(v.second, &result);
+    }
+  }
+  return result;
 }
 
 Expected<HashMetaValue> HashMetaValue::decode(const std::string& val) {
@@ -1117,7 +1179,34 @@ Expected<HashMetaValue> HashMetaValue::decode(const std::string& val) {
   offset += expt.value().second;
   count = expt.value().first;
 
-  return HashMetaValue(count);
+  HashMetaValue meta(count);
+  if (offset == val.size()) {
+    return std::move(meta);
+  }
+  if (valCstr[offset++] != INLINE) {
+    return {ErrorCodes::ERR_DECODE, "invalid hash meta"};
+  }
+  meta._inline = true;
+  while (offset < val.size()) {
+    auto field = decodeInlineStr(val, &offset);
+    if (!field.ok()) {
+      return field.status();
+    }
+    auto value = decodeInlineStr(val, &offset);
+    if (!value.ok()) {
+      return value.status();
+    }
+    // encoded in order, see encode()
+    if (!meta._fields.empty() && meta._fields.back().first >= field.value()) {
+      return {ErrorCodes::ERR_DECODE, "invalid inline hash order"};
+    }
+    meta._fields.emplace_back(std::move(field.value()),
+                              std::move(value.value()));
+  }
+  if (meta._fields.size() != count) {
+    return {ErrorCodes::ERR_DECODE, "invalid inline hash count"};
+  }
+  return std::move(meta);
 }
 
 HashMetaValue& HashMetaValue::operator=(HashMetaValue&& o) {
@@ -1125,7 +1214,11 @@ HashMetaValue& HashMetaValue::operator=(HashMetaValue&& o) {
     return *this;
   }
   _count = o._count;
+  _inline = o._inline;
+  _fields = std::move(o._fields);
   o._count = 0;
+  o._inline = false;
+  o._fields.clear();
   return *this;
 }
 
@@ -1137,6 +1230,55 @@ uint64_t HashMetaValue::getCount() const {
   return _count;
 }
 
+void HashMetaValue::setInline(bool v) {
+  _inline = v;
+  if (!v) {
+    _fields.clear();
+  }
+}
+
+static std::vector<std::pair<std::string, std::string>>::const_iterator
+lowerBoundField(const std::vector<std::pair<std::string, std::string>>& v,
+                const std::string& field) {
+  return std::lower_bound(
+    v.begin(),
+    v.end(),
+    field,
+    [](const std::pair<std::string, std::string>& a, const std::string& b) {
+      return a.first < b;
+    });
+}
+
+const std::string* HashMetaValue::getField(const std::string& field) const {
+  INVARIANT_D(_inline);
+  auto it = lowerBoundField(_fields, field);
+  if (it == _fields.end() || it->first != field) {
+    return nullptr;
+  }
+  return &it->second;
+}
+
+void HashMetaValue::setField(const std::string& field,
+                             const std::string& value) {
+  INVARIANT_D(_inline);
+  auto it = lowerBoundField(_fields, field);
+  if (it != _fields.end() && it->first == field) {
+    _fields[it - _fields.begin()].second = value;
+  } else {
+    _fields.emplace(it, field, value);
+  }
+}
+
+bool HashMetaValue::delField(const std::string& field) {
+  INVARIANT_D(_inline);
+  auto it = lowerBoundField(_fields, field);
+  if (it == _fields.end() || it->first != field) {
+    return false;
+  }
+  _fields.erase(it);
+  return true;
+}
+
 ListMetaValue::ListMetaValue(uint64_t head, uint64_t tail)
   : _head(head), _tail(tail) {}
 
@@ -1204,9 +1346,9 @@ uint64_t ListMetaValue::getTail() const {
   return _tail;
 }
 
-SetMetaValue::SetMetaValue() : _count(0) {}
+SetMetaValue::SetMetaValue() : SetMetaValue(0) {}
 
-SetMetaValue::SetMetaValue(uint64_t count) : _count(count) {}
+SetMetaValue::SetMetaValue(uint64_t count) : _count(count), _inline(false) {}
 
 Expected<SetMetaValue> SetMetaValue::decode(const std::string& val) {
   const uint8_t* valCstr = reinterpret_cast<const uint8_t*>(val.c_str());
@@ -1217,7 +1359,30 @@ Expected<SetMetaValue> SetMetaValue::decode(const std::string& val) {
   }
   offset += expt.value().second;
   uint64_t count = expt.value().first;
-  return SetMetaValue(count);
+
+  SetMetaValue meta(count);
+  if (offset == val.size()) {
+    return std::move(meta);
+  }
+  if (valCstr[offset++] != INLINE) {
+    return {ErrorCodes::ERR_DECODE, "invalid set meta"};
+  }
+  meta._inline = true;
+  while (offset < val.size()) {
+    auto member = decodeInlineStr(val, &offset);
+    if (!member.ok()) {
+      return member.status();
+    }
+    // encoded in order, see encode()
+    if (!meta._members.empty() && meta._members.back() >= member.value()) {
+      return {ErrorCodes::ERR_DECODE, "invalid inline set order"};
+    }
+    meta._members.emplace_back(std::move(member.value()));
+  }
+  if (meta._members.size() != count) {
+    return {ErrorCodes::ERR_DECODE, "invalid inline set count"};
+  }
+  return std::move(meta);
 }
 
 std::string SetMetaValue::encode() const {
@@ -1225,7 +1390,16 @@ std::string SetMetaValue::encode() const {
   value.reserve(8);
   auto countBytes = varintEncode(_count);
   value.insert(value.end(), countBytes.begin(), countBytes.end());
-  return std::string(reinterpret_cast<const char*>(value.data()), value.size());
+  std::string result(reinterpret_cast<const char*>(value.data()),
+                     value.size());
+  if (_inline) {
+    INVARIANT_D(_count == _members.size());
+    result.push_back(static_cast<char>(INLINE));
+    for (const auto& v : _members) {
+      encodeInlineStr(v, &result);
+    }
+  }
+  return result;
 }
 
 void SetMetaValue::setCount(uint64_t count) {
@@ -1236,6 +1410,35 @@ uint64_t SetMetaValue::getCount() const {
   return _count;
 }
 
+void SetMetaValue::setInline(bool v) {
+  _inline = v;
+  if (!v) {
+    _members.clear();
+  }
+}
+
+bool SetMetaValue::hasMember(const std::string& member) const {
+  return std::binary_search(_members.begin(), _members.end(), member);
+}
+
+void SetMetaValue::addMember(const std::string& member) {
+  INVARIANT_D(_inline);
+  auto it = std::lower_bound(_members.begin(), _members.end(), member);
+  if (it == _members.end() || *it != member) {
+    _members.insert(it, member);
+  }
+}
+
+bool SetMetaValue::delMember(const std::string& member) {
+  INVARIANT_D(_inline);
+  auto it = std::lower_bound(_members.begin(), _members.end(), member);
+  if (it == _members.end() || *it != member) {
+    return false;
+  }
+  _members.erase(it);
+  return true;
+}
+
 uint32_t ZSlMetaValue::HEAD_ID = 1;
 
 ZSlMetaValue::ZSlMetaValue() : ZSlMetaValue(0, 0, 0) {}
@@ -1245,7 +1448,8 @@ ZSlMetaValue::ZSlMetaValue(uint8_t lvl, uint32_t count, uint64_t tail)
     _maxLevel(MAX_LAYER),
     _count(count),
     _tail(tail),
-    _posAlloc(ZSlMetaValue::MIN_POS) {
+    _posAlloc(ZSlMetaValue::MIN_POS),
+    _engine(ENGINE_SKIPLIST) {
   // NOTE(vinchen): _maxLevel can't change. If you want to
   // change it, the constructor of ZSlEleValue should add new
   // parameter of it.
@@ -1279,7 +1483,26 @@ std::string ZSlMetaValue::encode() const {
   bytes = varintEncode(_posAlloc);
   value.insert(value.end(), bytes.begin(), bytes.end());
 
-  return std::string(reinterpret_cast<const char*>(value.data()), value.size());
+  // NOTE: skiplist metas are kept in the old format
+  if (_engine != ENGINE_SKIPLIST) {
+    bytes = varintEncode(_engine);
+    value.insert(value.end(), bytes.begin(), bytes.end());
+  }
+
+  std::string result(reinterpret_cast<const char*>(value.data()),
+                     value.size());
+  if (_engine == ENGINE_INLINE) {
+    INVARIANT_D(_count == _inlineEles.size() + 1);
+    for (const auto& v : _inlineEles) {
+      bytes = doubleEncode(v.first);
+      result.append(reinterpret_cast<const char*>(bytes.data()),
+                    bytes.size());
+      encodeInlineStr(v.second, &result);
+    }
+  } else {
+    INVARIANT_D(_inlineEles.empty());
+  }
+  return result;
 }
 
 Expected<ZSlMetaValue> ZSlMetaValue::decode(const std::string& val) {
@@ -1328,6 +1551,38 @@ Expected<ZSlMetaValue> ZSlMetaValue::decode(const std::string& val) {
   offset += expt.value().second;
   result._posAlloc = expt.value().first;
 
+  // _engine
+  if (offset < val.size()) {
+    expt = varintDecodeFwd(keyCstr + offset, val.size() - offset);
+    if (!expt.ok()) {
+      return expt.status();
+    }
+    offset += expt.value().second;
+    if (expt.value().first > ENGINE_INLINE) {
+      return {ErrorCodes::ERR_DECODE, "invalid zset engine"};
+    }
+    result._engine = expt.value().first;
+  }
+
+  // _inlineEles
+  if (result._engine != ENGINE_INLINE) {
+    return result;
+  }
+  while (offset < val.size()) {
+    auto score = doubleDecode(keyCstr + offset, val.size() - offset);
+    if (!score.ok()) {
+      return score.status();
+    }
+    offset += sizeof(double);
+    auto member = decodeInlineStr(val, &offset);
+    if (!member.ok()) {
+      return member.status();
+    }
+    result._inlineEles.emplace_back(score.value(), std::move(member.value()));
+  }
+  if (result._inlineEles.size() + 1 != result._count) {
+    return {ErrorCodes::ERR_DECODE, "invalid inline zset count"};
+  }
   return result;
 }
 
@@ -1662,6 +1917,47 @@ Expected<VersionMeta> VersionMeta::decode(const RecordKey& rk,
 }
 
 namespace rcd_util {
+uint64_t genSubKeyVersion() {
+  static std::atomic<uint64_t> lastVersion(0);
+  uint64_t version = nsSinceEpoch() / 1000;
+  uint64_t last = lastVersion.load(std::memory_order_relaxed);
+  do {
+    if (version <= last) {
+      version = last + 1;
+    }
+  } while (!lastVersion.compare_exchange_weak(
+    last, version, std::memory_order_relaxed));
+  return version;
+}
+
+uint64_t getSubKeyVersion(const Expected<RecordValue>& eMeta) {
+  if (eMeta.ok()) {
+    return eMeta.value().getVersion();
+  }
+  return genSubKeyVersion();
+}
+
+RecordKey makePieceKey(const RecordKey& mk, uint64_t version, uint64_t idx) {
+  INVARIANT_D(mk.getRecordType() == RecordType::RT_DATA_META);
+  return RecordKey(mk.getChunkId(),
+                   mk.getDbId(),
+                   RecordType::RT_KV_PIECE,
+                   mk.getPrimaryKey(),
+                   std::to_string(idx),
+                   version);
+}
+
+bool isVersionedType(RecordType metaType) {
+  switch (metaType) {
+    case RecordType::RT_HASH_META:
+    case RecordType::RT_SET_META:
+    case RecordType::RT_ZSET_META:
+      return true;
+    default:
+      return false;
+  }
+}
+
 Expected<uint64_t> getSubKeyCount(const RecordKey& key,
                                   const RecordValue& val) {
   INVARIANT_D(key.getRecordType() == RecordType::RT_DATA_META);
@@ -1703,6 +1999,67 @@ Expected<uint64_t> getSubKeyCount(const RecordKey& key,
   }
 }
 
+Expected<std::list<Record>> getInlineEles(const RecordKey& mk,
+                                          const RecordValue& meta) {
+  std::list<Record> result;
+  if (meta.getRecordType() == RecordType::RT_HASH_META) {
+    auto v = HashMetaValue::decode(meta.getValue());
+    if (!v.ok()) {
+      return v.status();
+    }
+    if (!v.value().isInline()) {
+      return {ErrorCodes::ERR_NOTFOUND, ""};
+    }
+    for (const auto& field : v.value().getFields()) {
+      result.emplace_back(RecordKey(mk.getChunkId(),
+                                    mk.getDbId(),
+                                    RecordType::RT_HASH_ELE,
+                                    mk.getPrimaryKey(),
+                                    field.first,
+                                    meta.getVersion()),
+                          RecordValue(
+                            field.second, RecordType::RT_HASH_ELE, -1));
+    }
+  } else if (meta.getRecordType() == RecordType::RT_SET_META) {
+    auto v = SetMetaValue::decode(meta.getValue());
+    if (!v.ok()) {
+      return v.status();
+    }
+    if (!v.value().isInline()) {
+      return {ErrorCodes::ERR_NOTFOUND, ""};
+    }
+    for (const auto& member : v.value().getMembers()) {
+      result.emplace_back(RecordKey(mk.getChunkId(),
+                                    mk.getDbId(),
+                                    RecordType::RT_SET_ELE,
+                                    mk.getPrimaryKey(),
+                                    member,
+                                    meta.getVersion()),
+                          RecordValue("", RecordType::RT_SET_ELE, -1));
+    }
+  } else if (meta.getRecordType() == RecordType::RT_ZSET_META) {
+    auto v = ZSlMetaValue::decode(meta.getValue());
+    if (!v.ok()) {
+      return v.status();
+    }
+    if (v.value().getEngine() != ZSlMetaValue::ENGINE_INLINE) {
+      return {ErrorCodes::ERR_NOTFOUND, ""};
+    }
+    for (const auto& ele : v.value().getInlineEles()) {
+      result.emplace_back(RecordKey(mk.getChunkId(),
+                                    mk.getDbId(),
+                                    RecordType::RT_ZSET_H_ELE,
+                                    mk.getPrimaryKey(),
+                                    ele.second,
+                                    meta.getVersion()),
+                          RecordValue(ele.first, RecordType::RT_ZSET_H_ELE));
+    }
+  } else {
+    return {ErrorCodes::ERR_NOTFOUND, ""};
+  }
+  return std::move(result);
+}
+
 std::string makeInvalidErrStr(RecordType type,
                               const std::string& key,
                               uint64_t metaCnt,
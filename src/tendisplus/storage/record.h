@@ -10,6 +10,7 @@
 #include <memory>
 #include <vector>
 #include <limits>
+#include <list>
 #include <sstream>
 #include "tendisplus/utils/status.h"
 #include "tendisplus/storage/kvstore.h"
@@ -54,6 +55,7 @@ enum class RecordType {
   RT_BINLOG,     /* For binlog in RecordKey and RecordValue  */
   RT_TTL_INDEX,  /* For ttl index  in RecordKey and RecordValue  */
   RT_DATA_META,  /* For key type in RecordKey */
+  RT_KV_PIECE,   /* For the pieces of a chunked string in RecordKey */
 };
 
 uint8_t rt2Char(RecordType t);
@@ -74,7 +76,8 @@ bool isRealEleType(RecordType keyType, RecordType valueType);
 // PK is primarykey, its length is described in len(PK)
 // 0
 // VERSION is varint, it means multi-version of record. For *_META, it
-//   always 0. Maybe it would be useful for _ELE. It would be always 0 now.
+//   always 0. For the subkeys of hash/set/zset and the pieces of a
+//   chunked string, it's the version of the meta, see genSubKeyVersion()
 // SK is secondarykey, its length is not stored
 // len(PK) is varint32 stored in bigendian, so we can read from the end
 // backwards. the last 1B are reserved.
@@ -85,8 +88,12 @@ bool isRealEleType(RecordType keyType, RecordType valueType);
 // VERSION is a varint64, for multi-version. Reversed, always 0
 // VERSIONEP is a varint64, for extended protocol. Reversed, always 0
 // CAS is a varint64, for cas cmd
-// PIECESIZE is a varint64, for very big value. Reversed, always 0
-// TOTALSIZE is varint64. Now it is always == UserValue.size().
+// PIECESIZE is a varint64, the size of the pieces of a chunked string.
+//   It's (uint64_t)-1 if the value is not chunked, see
+//   RecordValue::isChunked()
+// TOTALSIZE is varint64, the length of a chunked string, whose UserValue
+//   is empty. It's (uint64_t)-1 if the value is not chunked.
+// PIECESIZE and TOTALSIZE are stored plus one, so (uint64_t)-1 is 0 on disk
 // UserValue is string.
 // ********************************************************************
 
@@ -116,6 +123,9 @@ class RecordKey {
   const std::string& getSecondaryKey() const;
   uint32_t getChunkId() const;
   uint32_t getDbId() const;
+  uint64_t getVersion() const {
+    return _version;
+  }
 
   // an encoded prefix until prefix and a padding zero.
   // mainly for prefix scan.
@@ -237,6 +247,16 @@ class RecordValue {
   uint64_t getTotalSize() const {
     return _totalSize;
   }
+  void setTotalSize(uint64_t size) {
+    _totalSize = size;
+  }
+  // A big string may be saved as chunked, the meta keeps the pieceSize
+  // and the totalSize without value, and the value is split into pieces
+  // of pieceSize, whose RecordKey is (RT_KV_PIECE, pk, idx, version).
+  // The pieces of an old version are dropped by the compaction filter.
+  bool isChunked() const {
+    return _pieceSize != (uint64_t)-1;
+  }
   std::string encode() const;
   static Expected<RecordValue> decode(const std::string& value);
   static Expected<size_t> decodeHdrSize(const std::string& value);
@@ -262,14 +282,9 @@ class RecordValue {
   uint64_t _versionEP;
   // cas
   int64_t _cas;
-  // For very big values, it may split into multi pieces;  reversed
+  // For very big values, it may split into multi pieces, see isChunked()
   uint64_t _pieceSize;
-  // if (_pieceSize > _totalSize)
-  //      _valus.size() == _totalSize
-  // else
-  //      _totalSize > _values.size()
-  // TODO(vinchen) it would be useful for append and bitmap
-  // the whole value size, maybe > _value.size()
+  // the whole value size of a chunked string, _value is empty then
   uint64_t _totalSize;
   std::string _value;
 };
@@ -596,6 +611,19 @@ class ListMetaValue {
   uint64_t _tail;
 };
 
+/*
+A small hash/set is saved inline, its elements are kept in the meta
+instead of RT_HASH_ELE/RT_SET_ELE records, like the ziplist of redis.
+
+HASH_META: COUNT|[INLINE|LEN|FIELD|LEN|VALUE|...]
+SET_META: COUNT|[INLINE|LEN|MEMBER|...]
+
+The callers still maintain COUNT as the number of elements, and the
+elements of an inline meta are accessed by getField()/setField() etc.
+instead of the subkey records. They are decoded into a vector sorted by
+field/member, in the order they are encoded, and looked up by binary
+search.
+*/
 class HashMetaValue {
  public:
   HashMetaValue();
@@ -608,9 +636,27 @@ class HashMetaValue {
   // void setCas(int64_t cas);
   uint64_t getCount() const;
   // uint64_t getCas() const;
+  bool isInline() const {
+    return _inline;
+  }
+  // the fields are cleared when it's no longer inline
+  void setInline(bool v);
+  const std::vector<std::pair<std::string, std::string>>& getFields() const {
+    return _fields;
+  }
+  // nullptr if the field doesn't exist
+  const std::string* getField(const std::string& field) const;
+  void setField(const std::string& field, const std::string& value);
+  // return false if the field doesn't exist
+  bool delField(const std::string& field);
+
+  static constexpr uint8_t INLINE = 1;
 
  private:
   uint64_t _count;
+  bool _inline;
+  // sorted by field
+  std::vector<std::pair<std::string, std::string>> _fields;
 };
 
 class SetMetaValue {
@@ -621,9 +667,26 @@ class SetMetaValue {
   std::string encode() const;
   void setCount(uint64_t count);
   uint64_t getCount() const;
+  bool isInline() const {
+    return _inline;
+  }
+  // the members are cleared when it's no longer inline
+  void setInline(bool v);
+  const std::vector<std::string>& getMembers() const {
+    return _members;
+  }
+  bool hasMember(const std::string& member) const;
+  void addMember(const std::string& member);
+  // return false if the member doesn't exist
+  bool delMember(const std::string& member);
+
+  static constexpr uint8_t INLINE = 1;
 
  private:
   uint64_t _count;
+  bool _inline;
+  // sorted
+  std::vector<std::string> _members;
 };
 
 
@@ -631,7 +694,7 @@ class SetMetaValue {
 
 META: *1
 CHUNK|DBID|ZSET_META|KEY|
-LEVEL|MAX_LEVEL|COUNT+1|TAIL|POSALLOC|
+LEVEL|MAX_LEVEL|COUNT+1|TAIL|POSALLOC|[ENGINE]|
 
 S_ELE: *(COUNT+1)
 CHUNK|DBID|S_ELE|KEY|POS|  -- HEAD_ID(first element)
@@ -641,6 +704,12 @@ H_ELE: *(COUNT)
 CHUNK|DBID|H_ELE|KEY|SUBKEY|
 score
 
+ENGINE is absent for the skiplist above. With ENGINE_INDEX, S_ELE is
+the score index of ZIndex instead, see zindex.h. With ENGINE_INLINE,
+there is neither S_ELE nor H_ELE, the elements follow ENGINE in the
+score order, see ZInline:
+...|ENGINE|[SCORE(8 bytes)|LEN|MEMBER|...]
+
 */
 
 // ZsetSkipListMetaValue
@@ -656,6 +725,22 @@ class ZSlMetaValue {
   uint32_t getCount() const;
   uint64_t getTail() const;
   uint64_t getPosAlloc() const;
+  uint8_t getEngine() const {
+    return _engine;
+  }
+  void setEngine(uint8_t engine) {
+    _engine = engine;
+  }
+  // the (score, member) of an ENGINE_INLINE zset, in the score order
+  const std::vector<std::pair<double, std::string>>& getInlineEles() const {
+    return _inlineEles;
+  }
+  void setInlineEles(std::vector<std::pair<double, std::string>>&& eles) {
+    _inlineEles = std::move(eles);
+  }
+  static constexpr uint8_t ENGINE_SKIPLIST = 0;
+  static constexpr uint8_t ENGINE_INDEX = 1;
+  static constexpr uint8_t ENGINE_INLINE = 2;
   // can not dynamicly change
   static constexpr int8_t MAX_LAYER = ZSKIPLIST_MAXLEVEL;
   static constexpr uint32_t MAX_NUM = (1 << 31);
@@ -671,6 +756,8 @@ class ZSlMetaValue {
   uint32_t _count;
   uint64_t _tail;
   uint64_t _posAlloc;
+  uint8_t _engine;
+  std::vector<std::pair<double, std::string>> _inlineEles;
 };
 
 class ZSlEleValue {
@@ -825,6 +912,28 @@ class VersionMeta {
 namespace rcd_util {
 Expected<uint64_t> getSubKeyCount(const RecordKey& key, const RecordValue& val);
 
+// The subkeys of a hash/set/zset carry the version of its meta, so that
+// deleting a big key only needs to delete the meta. The subkeys left
+// behind are dropped by the compaction filter later.
+// A newly created key gets a new version from here, which is monotonic
+// in one process and based on the wall clock(us), so it would not be
+// the same as the version of an old incarnation of the key.
+uint64_t genSubKeyVersion();
+// the subkey version of a key whose meta is eMeta, a new version is
+// generated if the key doesn't exist.
+uint64_t getSubKeyVersion(const Expected<RecordValue>& eMeta);
+// whether the subkeys of this type of key are versioned, the list is not.
+bool isVersionedType(RecordType metaType);
+// the RecordKey of the idx-th piece of the chunked string whose meta
+// key is mk
+RecordKey makePieceKey(const RecordKey& mk, uint64_t version, uint64_t idx);
+// the elements of an inline hash/set/zset whose meta key is mk, as the
+// RT_HASH_ELE/RT_SET_ELE/RT_ZSET_H_ELE records they would be if not
+// inline.
+// ERR_NOTFOUND if the meta is not inline.
+Expected<std::list<Record>> getInlineEles(const RecordKey& mk,
+                                          const RecordValue& meta);
+
 std::string makeInvalidErrStr(RecordType type,
                               const std::string& key,
                               uint64_t metaCnt,
@@ -10,6 +10,7 @@
 #include <algorithm>
 #include <limits>
 #include "tendisplus/storage/record.h"
+#include "tendisplus/storage/varint.h"
 #include "tendisplus/utils/invariant.h"
 #include "tendisplus/utils/string.h"
 #include "tendisplus/utils/test_util.h"
@@ -196,6 +197,113 @@ TEST(Record, Common) {
   }
 }
 
+TEST(Record, Chunked) {
+  auto mk = RecordKey(1, 2, RecordType::RT_KV, "pk", "");
+  auto rv = RecordValue("", RecordType::RT_KV, 3, 0, -1, 100, 64);
+  rv.setTotalSize(1000);
+  EXPECT_TRUE(rv.isChunked());
+  auto rcd = Record(mk, rv);
+  auto kv = rcd.encode();
+  auto validateV = RecordValue::validate(kv.second);
+  EXPECT_TRUE(validateV.ok());
+  EXPECT_TRUE(validateV.value());
+
+  auto prcd = Record::decode(kv.first, kv.second);
+  EXPECT_TRUE(prcd.ok());
+  EXPECT_EQ(prcd.value(), rcd);
+  const auto& rv1 = prcd.value().getRecordValue();
+  EXPECT_TRUE(rv1.isChunked());
+  EXPECT_EQ(rv1.getPieceSize(), 64U);
+  EXPECT_EQ(rv1.getTotalSize(), 1000U);
+  EXPECT_EQ(rv1.getVersion(), 100U);
+
+  auto pk = rcd_util::makePieceKey(mk, 100, 15);
+  EXPECT_EQ(pk.getRecordType(), RecordType::RT_KV_PIECE);
+  EXPECT_EQ(pk.getSecondaryKey(), "15");
+  EXPECT_EQ(pk.getVersion(), 100U);
+  auto ppk = RecordKey::decode(pk.encode());
+  EXPECT_TRUE(ppk.ok());
+  EXPECT_EQ(ppk.value(), pk);
+}
+
+TEST(Record, InlineMeta) {
+  HashMetaValue hm;
+  hm.setInline(true);
+  hm.setField("f1", "v1");
+  hm.setField("f2", std::string(300, 'x'));
+  hm.setCount(2);
+  auto ehm = HashMetaValue::decode(hm.encode());
+  EXPECT_TRUE(ehm.ok());
+  EXPECT_TRUE(ehm.value().isInline());
+  EXPECT_EQ(ehm.value().getCount(), 2U);
+  EXPECT_EQ(*ehm.value().getField("f2"), std::string(300, 'x'));
+  EXPECT_EQ(ehm.value().getField("f3"), nullptr);
+  // the fields are kept sorted whatever order they are set
+  hm.setField("f0", "v0");
+  hm.setField("f1", "v11");
+  EXPECT_TRUE(hm.delField("f2"));
+  EXPECT_FALSE(hm.delField("f2"));
+  std::vector<std::pair<std::string, std::string>> fields = {{"f0", "v0"},
+                                                             {"f1", "v11"}};
+  EXPECT_EQ(hm.getFields(), fields);
+
+  SetMetaValue sm;
+  sm.setInline(true);
+  sm.addMember("m1");
+  sm.addMember("m2");
+  sm.setCount(2);
+  EXPECT_TRUE(sm.delMember("m1"));
+  EXPECT_FALSE(sm.delMember("m1"));
+  sm.setCount(1);
+  auto esm = SetMetaValue::decode(sm.encode());
+  EXPECT_TRUE(esm.ok());
+  EXPECT_TRUE(esm.value().isInline());
+  EXPECT_TRUE(esm.value().hasMember("m2"));
+  EXPECT_FALSE(esm.value().hasMember("m1"));
+
+  // the old format is still readable
+  auto eold = SetMetaValue::decode(SetMetaValue(3).encode());
+  EXPECT_TRUE(eold.ok());
+  EXPECT_FALSE(eold.value().isInline());
+  EXPECT_EQ(eold.value().getCount(), 3U);
+
+  RecordKey mk(1, 2, RecordType::RT_DATA_META, "pk", "");
+  RecordValue rv(sm.encode(), RecordType::RT_SET_META, -1);
+  auto eles = rcd_util::getInlineEles(mk, rv);
+  EXPECT_TRUE(eles.ok());
+  EXPECT_EQ(eles.value().size(), 1U);
+  EXPECT_EQ(eles.value().front().getRecordKey().getSecondaryKey(), "m2");
+
+  ZSlMetaValue zm(1, 3, 0);
+  zm.setEngine(ZSlMetaValue::ENGINE_INLINE);
+  zm.setInlineEles({{-1.5, "a"}, {2, std::string(300, 'z')}});
+  auto ezm = ZSlMetaValue::decode(zm.encode());
+  EXPECT_TRUE(ezm.ok());
+  EXPECT_EQ(ezm.value().getEngine(), ZSlMetaValue::ENGINE_INLINE);
+  EXPECT_EQ(ezm.value().getCount(), 3U);
+  EXPECT_EQ(ezm.value().getInlineEles(), zm.getInlineEles());
+  // the count doesn't match
+  zm = ZSlMetaValue(1, 2, 0);
+  zm.setEngine(ZSlMetaValue::ENGINE_INLINE);
+  zm.setInlineEles({{1, "a"}, {2, "b"}});
+  std::string bad = zm.encode();
+  bad[2] = 3;
+  EXPECT_FALSE(ZSlMetaValue::decode(bad).ok());
+
+  zm = ZSlMetaValue(1, 2, 0);
+  zm.setEngine(ZSlMetaValue::ENGINE_INLINE);
+  zm.setInlineEles({{3, "m"}});
+  rv = RecordValue(zm.encode(), RecordType::RT_ZSET_META, -1);
+  eles = rcd_util::getInlineEles(mk, rv);
+  EXPECT_TRUE(eles.ok());
+  EXPECT_EQ(eles.value().size(), 1U);
+  EXPECT_EQ(eles.value().front().getRecordKey().getRecordType(),
+            RecordType::RT_ZSET_H_ELE);
+  auto d = doubleDecode(eles.value().front().getRecordValue().getValue());
+  EXPECT_TRUE(d.ok());
+  EXPECT_EQ(d.value(), 3);
+}
+
 TEST(ReplRecordV2, Prefix) {
   uint64_t binlogid =
     (uint64_t)genRand() + std::numeric_limits<uint32_t>::max();
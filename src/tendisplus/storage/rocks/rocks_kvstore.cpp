@@ -6,11 +6,13 @@
 #include <utility>
 #include <string>
 #include <sstream>
+#include <fstream>
 #include <map>
 #include <vector>
 #include <list>
 #include <limits>
 #include <algorithm>
+#include <thread>  // NOLINT
 
 #include "glog/logging.h"
 #include "rapidjson/prettywriter.h"
@@ -19,8 +21,10 @@
 #include "rapidjson/stringbuffer.h"
 #include "rapidjson/error/en.h"
 
+#include "rocksdb/convenience.h"
 #include "rocksdb/db.h"
 #include "rocksdb/slice.h"
+#include "rocksdb/sst_file_writer.h"
 #include "rocksdb/table.h"
 #include "rocksdb/filter_policy.h"
 #include "rocksdb/utilities/backupable_db.h"
@@ -56,6 +60,16 @@ namespace tendisplus {
 #define RESET_PERFCONTEXT()
 #endif
 
+// the chunk id of a key or a prefix of it, the missing bytes are 0
+static uint32_t keyChunkId(const rocksdb::Slice& key) {
+  uint32_t chunkId = 0;
+  for (size_t i = 0; i < sizeof(chunkId); i++) {
+    uint8_t c = i < key.size() ? static_cast<uint8_t>(key[i]) : 0;
+    chunkId = (chunkId << 8) | c;
+  }
+  return chunkId;
+}
+
 RocksKVCursor::RocksKVCursor(std::unique_ptr<rocksdb::Iterator> it)
   : Cursor(), _it(std::move(it)) {
   _it->Seek("");
@@ -128,6 +142,7 @@ RocksTxn::RocksTxn(RocksKVStore* store,
     _store(store),
     _done(false),
     _replOnly(replOnly),
+    _groupSync(false),
     _logOb(ob),
     _session(sess) {}
 
@@ -236,14 +251,18 @@ Expected<uint64_t> RocksTxn::commit() {
   _done = true;
 
   uint64_t binlogTxnId = Transaction::TXNID_UNINITED;
-  const auto guard = MakeGuard([this, &binlogTxnId] {
+  auto start = nsSinceEpoch();
+  const auto guard = MakeGuard([this, &binlogTxnId, start] {
+    if (_txn != nullptr) {
+      _store->addCommitLatency((nsSinceEpoch() - start) / 1000);
+    }
     _txn.reset();
     // for non-replonly mode, we should have binlogTxnId == _txnId
     if (!_replOnly) {
       INVARIANT_D(binlogTxnId == _txnId ||
                   binlogTxnId == Transaction::TXNID_UNINITED);
     }
-    _store->markCommitted(_txnId, binlogTxnId);
+    _store->markCommitted(_binlogId, binlogTxnId);
   });
 
   if (_txn == nullptr) {
@@ -305,10 +324,33 @@ Expected<uint64_t> RocksTxn::commit() {
     binlogTxnId = _txnId;
   }
 
+  // NOTE: the recounts must be checked before commit,
+  // see RocksKVStore::recountSlotKeys()
+  std::vector<bool> recounting;
+  recounting.reserve(_slotKeyDeltas.size());
+  for (const auto& d : _slotKeyDeltas) {
+    recounting.push_back(_store->isSlotKeyRecounting(d.first));
+  }
+
   TEST_SYNC_POINT("RocksTxn::commit()::1");
   TEST_SYNC_POINT("RocksTxn::commit()::2");
   auto s = _txn->Commit();
   if (s.ok()) {
+    for (size_t i = 0; i < _slotKeyDeltas.size(); i++) {
+      _store->addSlotKeys(
+        _slotKeyDeltas[i].first, _slotKeyDeltas[i].second, recounting[i]);
+    }
+    if (_groupSync) {
+      // NOTE: the txn is marked committed after the WAL is synced, so
+      // _highestVisible never exceeds the durable binlog. The txn can't
+      // be undone if the sync fails, and its binlog can't be published
+      // as durable, so it's fatal.
+      auto sync = _store->syncWAL();
+      if (!sync.ok()) {
+        LOG(FATAL) << "store:" << _store->dbId()
+                   << " sync WAL after commit failed:" << sync.toString();
+      }
+    }
     return _txnId;
   } else {
     binlogTxnId = Transaction::TXNID_UNINITED;
@@ -326,7 +368,8 @@ Status RocksTxn::rollback() {
 
   const auto guard = MakeGuard([this] {
     _txn.reset();
-    _store->markCommitted(_txnId, Transaction::TXNID_UNINITED);
+    _slotKeyDeltas.clear();
+    _store->markCommitted(_binlogId, Transaction::TXNID_UNINITED);
   });
 
   if (_txn == nullptr) {
@@ -340,6 +383,48 @@ Status RocksTxn::rollback() {
   }
 }
 
+void RocksTxn::setSavePoint() {
+  INVARIANT_D(!_done && _txn != nullptr);
+  SavePoint sp;
+#ifdef BINLOG_V1
+  sp.binlogs = _binlogs.size();
+#else
+  sp.binlogs = _replLogValues.size();
+#endif
+  sp.slotKeyDeltas = _slotKeyDeltas.size();
+  sp.lastSlotKeyDelta =
+    _slotKeyDeltas.empty() ? 0 : _slotKeyDeltas.back().second;
+  sp.chunkId = _chunkId;
+  _savePoints.push_back(sp);
+  _txn->SetSavePoint();
+}
+
+Status RocksTxn::rollbackToSavePoint() {
+  INVARIANT_D(!_done && _txn != nullptr);
+  if (_savePoints.empty()) {
+    return {ErrorCodes::ERR_INTERNAL, "no savepoint"};
+  }
+  auto s = _txn->RollbackToSavePoint();
+  if (!s.ok()) {
+    return {ErrorCodes::ERR_INTERNAL, s.ToString()};
+  }
+  const auto& sp = _savePoints.back();
+#ifdef BINLOG_V1
+  _binlogs.erase(_binlogs.begin() + sp.binlogs, _binlogs.end());
+#else
+  _replLogValues.erase(_replLogValues.begin() + sp.binlogs,
+                       _replLogValues.end());
+#endif
+  // the last delta may be merged with the ones after the savepoint
+  _slotKeyDeltas.resize(sp.slotKeyDeltas);
+  if (!_slotKeyDeltas.empty()) {
+    _slotKeyDeltas.back().second = sp.lastSlotKeyDelta;
+  }
+  _chunkId = sp.chunkId;
+  _savePoints.pop_back();
+  return {ErrorCodes::ERR_OK, ""};
+}
+
 uint64_t RocksTxn::getTxnId() const {
   return _txnId;
 }
@@ -380,6 +465,49 @@ Expected<std::string> RocksTxn::getKV(const std::string& key) {
   return {ErrorCodes::ERR_INTERNAL, s.ToString()};
 }
 
+std::vector<Expected<std::string>> RocksTxn::getKVs(
+  const std::vector<std::string>& keys) {
+  rocksdb::ReadOptions readOpts;
+  std::vector<rocksdb::Slice> slices;
+  slices.reserve(keys.size());
+  for (const auto& key : keys) {
+    // NOTE: only the data column family, binlogs are never read in batch
+    INVARIANT_D(RecordKey::decodeType(key) != RecordType::RT_BINLOG);
+    slices.emplace_back(key);
+  }
+
+  // NOTE: rocksdb 5.13 has no batched MultiGet, Transaction::MultiGet()
+  // is a loop of Get(), so this saves the calls per key only, not the
+  // lookups. The keys are read from one snapshot: the txn's own if it has
+  // one, or a temporary one, which doesn't make the later writes of the
+  // txn check conflicts. A single key needs none, and taking a snapshot
+  // locks the db mutex.
+  std::unique_ptr<rocksdb::ManagedSnapshot> snapshot;
+  readOpts.snapshot = _txn->GetSnapshot();
+  if (readOpts.snapshot == nullptr && keys.size() > 1) {
+    snapshot.reset(new rocksdb::ManagedSnapshot(_store->getBaseDB()));
+    readOpts.snapshot = snapshot->snapshot();
+  }
+
+  RESET_PERFCONTEXT();
+  std::vector<std::string> values;
+  auto ss = _txn->MultiGet(readOpts, slices, &values);
+  INVARIANT_D(ss.size() == keys.size() && values.size() == keys.size());
+
+  std::vector<Expected<std::string>> result;
+  result.reserve(keys.size());
+  for (size_t i = 0; i < ss.size(); ++i) {
+    if (ss[i].ok()) {
+      result.emplace_back(std::move(values[i]));
+    } else if (ss[i].IsNotFound()) {
+      result.emplace_back(ErrorCodes::ERR_NOTFOUND, ss[i].ToString());
+    } else {
+      result.emplace_back(ErrorCodes::ERR_INTERNAL, ss[i].ToString());
+    }
+  }
+  return result;
+}
+
 Status RocksTxn::setKV(const std::string& key,
                        const std::string& val,
                        const uint64_t ts) {
@@ -388,11 +516,17 @@ Status RocksTxn::setKV(const std::string& key,
   }
 
   RESET_PERFCONTEXT();
+  int64_t delta = 0;
+  auto st = slotKeyDelta(key, false, &delta);
+  if (!st.ok()) {
+    return st;
+  }
   // put data into default column family
   auto s = _txn->Put(key, val);
   if (!s.ok()) {
     return {ErrorCodes::ERR_INTERNAL, s.ToString()};
   }
+  addSlotKeyDelta(key, delta);
 
   if (_store->enableRepllog()) {
     INVARIANT_D(_store->dbId() != CATALOG_NAME);
@@ -423,15 +557,21 @@ Status RocksTxn::delKV(const std::string& key, const uint64_t ts) {
   }
   RESET_PERFCONTEXT();
   rocksdb::Status s;
+  int64_t delta = 0;
   if (RecordKey::decodeType(key) == RecordType::RT_BINLOG) {
     s = _txn->Delete(_store->getBinlogColumnFamilyHandle(), key);
   } else {
+    auto st = slotKeyDelta(key, true, &delta);
+    if (!st.ok()) {
+      return st;
+    }
     s = _txn->Delete(key);
   }
 
   if (!s.ok()) {
     return {ErrorCodes::ERR_INTERNAL, s.ToString()};
   }
+  addSlotKeyDelta(key, delta);
 
   if (_store->enableRepllog()) {
     INVARIANT_D(_store->dbId() != CATALOG_NAME);
@@ -455,6 +595,39 @@ Status RocksTxn::delKV(const std::string& key, const uint64_t ts) {
   return {ErrorCodes::ERR_OK, ""};
 }
 
+Status RocksTxn::slotKeyDelta(const std::string& key,
+                              bool del,
+                              int64_t* delta) {
+  *delta = 0;
+  if (!_store->isSlotKeyCounted(key)) {
+    return {ErrorCodes::ERR_OK, ""};
+  }
+  // NOTE: it's read for update, so that no one else changes the key
+  // before this txn commits
+  std::string value;
+  auto s = _txn->GetForUpdate(rocksdb::ReadOptions(), key, &value);
+  if (s.ok()) {
+    *delta = del ? -1 : 0;
+  } else if (s.IsNotFound()) {
+    *delta = del ? 0 : 1;
+  } else {
+    return {ErrorCodes::ERR_INTERNAL, s.ToString()};
+  }
+  return {ErrorCodes::ERR_OK, ""};
+}
+
+void RocksTxn::addSlotKeyDelta(const std::string& key, int64_t delta) {
+  if (delta == 0) {
+    return;
+  }
+  uint32_t slot = RecordKey::decodeChunkId(key);
+  if (!_slotKeyDeltas.empty() && _slotKeyDeltas.back().first == slot) {
+    _slotKeyDeltas.back().second += delta;
+  } else {
+    _slotKeyDeltas.emplace_back(slot, delta);
+  }
+}
+
 Status RocksTxn::addDeleteRangeBinlog(const std::string& begin,
                                       const std::string& end) {
   if (_replOnly) {
@@ -476,6 +649,20 @@ Status RocksTxn::addDeleteRangeBinlog(const std::string& begin,
   return {ErrorCodes::ERR_OK, ""};
 }
 
+Status RocksTxn::addSetBinlog(const std::string& key, const std::string& val) {
+  if (_replOnly) {
+    return {ErrorCodes::ERR_INTERNAL, "txn is replOnly"};
+  }
+
+  if (_store->enableRepllog()) {
+    INVARIANT_D(_store->dbId() != CATALOG_NAME);
+    setChunkId(RecordKey::decodeChunkId(key));
+    ReplLogValueEntryV2 logVal(ReplOp::REPL_OP_SET, msSinceEpoch(), key, val);
+    _replLogValues.emplace_back(std::move(logVal));
+  }
+  return {ErrorCodes::ERR_OK, ""};
+}
+
 Status RocksTxn::flushall() {
   if (_replOnly) {
     return {ErrorCodes::ERR_INTERNAL, "txn is replOnly"};
@@ -528,17 +715,29 @@ Status RocksTxn::applyBinlog(const ReplLogValueEntryV2& logEntry) {
   switch (logEntry.getOp()) {
     case ReplOp::REPL_OP_SET: {
       // TODO(vinchen): RecordKey::validate()
+      int64_t delta = 0;
+      auto st = slotKeyDelta(logEntry.getOpKey(), false, &delta);
+      if (!st.ok()) {
+        return st;
+      }
       auto s = _txn->Put(logEntry.getOpKey(), logEntry.getOpValue());
       if (!s.ok()) {
         return {ErrorCodes::ERR_INTERNAL, s.ToString()};
       }
+      addSlotKeyDelta(logEntry.getOpKey(), delta);
       break;
     }
     case ReplOp::REPL_OP_DEL: {
+      int64_t delta = 0;
+      auto st = slotKeyDelta(logEntry.getOpKey(), true, &delta);
+      if (!st.ok()) {
+        return st;
+      }
       auto s = _txn->Delete(logEntry.getOpKey());
       if (!s.ok()) {
         return {ErrorCodes::ERR_INTERNAL, s.ToString()};
       }
+      addSlotKeyDelta(logEntry.getOpKey(), delta);
       break;
     }
     case ReplOp::REPL_OP_STMT: {
@@ -649,7 +848,7 @@ RocksTxn::~RocksTxn() {
 
   // _txn.get()->ClearSnapshot();
   _txn.reset();
-  _store->markCommitted(_txnId, Transaction::TXNID_UNINITED);
+  _store->markCommitted(_binlogId, Transaction::TXNID_UNINITED);
 }
 
 RocksOptTxn::RocksOptTxn(RocksKVStore* store,
@@ -665,6 +864,8 @@ RocksOptTxn::RocksOptTxn(RocksKVStore* store,
   // In other words, to the same key, a txn with greater id can be committed
   // before a txn with smaller id, and they have no conflicts, it's wrong.
   // so ensureTxn() should be done in RocksOptTxn's constructor
+  // NOTE: createTransaction() has no lock now. It's fine for binlog v2,
+  // the binlog id is assigned in commit() rather than here.
   ensureTxn();
 }
 
@@ -675,7 +876,8 @@ void RocksOptTxn::ensureTxn() {
   }
   rocksdb::WriteOptions writeOpts;
   writeOpts.disableWAL = _store->getCfg()->rocksDisableWAL;
-  writeOpts.sync = _store->getCfg()->rocksFlushLogAtTrxCommit;
+  _groupSync = _store->isGroupSync();
+  writeOpts.sync = _store->getCfg()->rocksFlushLogAtTrxCommit && !_groupSync;
 
   rocksdb::OptimisticTransactionOptions txnOpts;
 
@@ -727,7 +929,8 @@ void RocksPesTxn::ensureTxn() {
   }
   rocksdb::WriteOptions writeOpts;
   writeOpts.disableWAL = _store->getCfg()->rocksDisableWAL;
-  writeOpts.sync = _store->getCfg()->rocksFlushLogAtTrxCommit;
+  _groupSync = _store->isGroupSync();
+  writeOpts.sync = _store->getCfg()->rocksFlushLogAtTrxCommit && !_groupSync;
 
   rocksdb::TransactionOptions txnOpts;
 
@@ -1095,10 +1298,11 @@ rocksdb::Options RocksKVStore::options() {
   options.table_factory.reset(
     rocksdb::NewBlockBasedTableFactory(table_options));
 
-  if (_enableFilter && dbId() != CATALOG_NAME) {
-    // setup the ttlcompactionfilter expect "catalog" db
+  if (dbId() != CATALOG_NAME) {
+    // setup the ttlcompactionfilter expect "catalog" db. Even if the
+    // expired kvs are not filtered, it's needed to drop stale subkeys.
     options.compaction_filter_factory.reset(
-      new KVTtlCompactionFilterFactory(this));
+      new KVTtlCompactionFilterFactory(this, _enableFilter));
   }
 
   // background listener
@@ -1154,7 +1358,7 @@ bool RocksKVStore::isEmpty(bool ignoreBinlog) const {
 
 Status RocksKVStore::pause() {
   std::lock_guard<std::mutex> lk(_mutex);
-  if (_aliveTxns.size() != 0) {
+  if (_aliveTxnCnt.load() != 0) {
     return {ErrorCodes::ERR_INTERNAL,
             "it's upperlayer's duty to guarantee no pinning txns alive"};
   }
@@ -1165,7 +1369,7 @@ Status RocksKVStore::pause() {
 
 Status RocksKVStore::resume() {
   std::lock_guard<std::mutex> lk(_mutex);
-  if (_aliveTxns.size() != 0) {
+  if (_aliveTxnCnt.load() != 0) {
     return {ErrorCodes::ERR_INTERNAL,
             "it's upperlayer's duty to guarantee no pinning txns alive"};
   }
@@ -1176,12 +1380,22 @@ Status RocksKVStore::resume() {
 
 Status RocksKVStore::stop() {
   std::lock_guard<std::mutex> lk(_mutex);
-  if (_aliveTxns.size() != 0) {
+  if (_aliveTxnCnt.load() != 0) {
     return {ErrorCodes::ERR_INTERNAL,
             "it's upperlayer's duty to guarantee no pinning txns alive"};
   }
   _isRunning = false;
+  // createRocksTxn() counts the txn before checking _isRunning, so one of
+  // them must see the other.
+  if (_aliveTxnCnt.load() != 0) {
+    _isRunning = true;
+    return {ErrorCodes::ERR_INTERNAL,
+            "it's upperlayer's duty to guarantee no pinning txns alive"};
+  }
 
+  if (_optdb || _pesdb) {
+    saveSlotKeys();
+  }
   for (auto* h : _cfHandles) {
     delete h;
   }
@@ -1208,7 +1422,7 @@ Status RocksKVStore::destroy() {
 
 Status RocksKVStore::setMode(StoreMode mode) {
   std::lock_guard<std::mutex> lk(_mutex);
-  if (_aliveTxns.size() != 0) {
+  if (_aliveTxnCnt.load() != 0) {
     return {ErrorCodes::ERR_INTERNAL,
             "it's upperlayer's duty to guarantee no pinning txns alive"};
   }
@@ -1236,7 +1450,8 @@ Status RocksKVStore::setMode(StoreMode mode) {
       INVARIANT_D(0);
   }
 
-  LOG(INFO) << "store:" << dbId() << ",mode:" << static_cast<uint32_t>(_mode)
+  LOG(INFO) << "store:" << dbId()
+            << ",mode:" << static_cast<uint32_t>(_mode.load())
             << ",changes to:" << static_cast<uint32_t>(mode)
             << ",_nextTxnSeq:" << oldSeq << ",changes to:" << _nextTxnSeq;
   _mode = mode;
@@ -1716,14 +1931,14 @@ Expected<uint64_t> RocksKVStore::restart(bool restore,
                       << " to:" << binlogId + 1;
             maxCommitId = binlogId;
             _nextTxnSeq = maxCommitId + 1;
-            _nextBinlogSeq = _nextTxnSeq;
+            _nextBinlogSeq = _nextTxnSeq.load();
             _highestVisible = maxCommitId;
             needDeleteBinlog = true;
           }
         }
       } else if (binlog_expRcd.status().code() == ErrorCodes::ERR_EXHAUST) {
         _nextTxnSeq = nextBinlogSeq;
-        _nextBinlogSeq = _nextTxnSeq;
+        _nextBinlogSeq = _nextTxnSeq.load();
         LOG(INFO) << "store:" << dbId() << " have no binlog, set nextSeq to "
                   << _nextTxnSeq;
         _highestVisible = _nextBinlogSeq - 1;
@@ -1753,7 +1968,7 @@ Expected<uint64_t> RocksKVStore::restart(bool restore,
                       << " to:" << binlogId + 1;
             maxCommitId = binlogId;
             _nextTxnSeq = maxCommitId + 1;
-            _nextBinlogSeq = _nextTxnSeq;
+            _nextBinlogSeq = _nextTxnSeq.load();
             _highestVisible = maxCommitId;
             needDeleteBinlog = true;
           }
@@ -1770,6 +1985,13 @@ Expected<uint64_t> RocksKVStore::restart(bool restore,
       }
     }
 
+    {
+      // the sequence numbers may go back after restoring a backup
+      std::lock_guard<std::mutex> lk(_syncMutex);
+      _syncedSeq = 0;
+    }
+    resetBinlogSlots();
+    loadSlotKeys();
     _isRunning = true;
   }
   {
@@ -1786,9 +2008,11 @@ Expected<uint64_t> RocksKVStore::restart(bool restore,
       maxCommitId = highestVisible;
 
       std::lock_guard<std::mutex> lk(_mutex);
+      INVARIANT_D(_aliveTxnCnt.load() == 0);
       _nextTxnSeq = maxCommitId + 1;
-      _nextBinlogSeq = _nextTxnSeq;
+      _nextBinlogSeq = _nextTxnSeq.load();
       _highestVisible = maxCommitId;
+      resetBinlogSlots();
     }
   }
   return maxCommitId;
@@ -1815,12 +2039,25 @@ RocksKVStore::RocksKVStore(const std::string& id,
     _stats(rocksdb::CreateDBStatistics()),
     _blockCache(blockCache),
     _nextTxnSeq(0),
+    _nextBinlogSeq(Transaction::MIN_VALID_TXNID),
+    _aliveTxnCnt(0),
+    _binlogSlots(new std::atomic<uint64_t>[BINLOG_SLOTS]()),
+    _doneBinlogSeq(Transaction::MIN_VALID_TXNID),
     _highestVisible(Transaction::TXNID_UNINITED),
     _logOb(nullptr),
-    _env(std::make_shared<RocksdbEnv>()) {
+    _env(std::make_shared<RocksdbEnv>()),
+    _syncing(false),
+    _syncedSeq(0),
+    _syncPending(0) {
   if (_cfg->noexpire) {
     _enableFilter = false;
   }
+  if (_cfg->slotStatsEnabled && id != CATALOG_NAME) {
+    _slotKeys.reset(new std::atomic<int64_t>[_cfg->chunkSize]());
+  }
+  if (id != CATALOG_NAME) {
+    _garbageSlots.reset(new std::atomic<uint32_t>[_cfg->chunkSize]());
+  }
 
   Expected<uint64_t> s =
     restart(false, Transaction::MIN_VALID_TXNID, UINT64_MAX, flag);
@@ -2119,8 +2356,28 @@ Expected<std::string> RocksKVStore::copyCkpt(const std::string& dir) {
 
 Expected<std::unique_ptr<Transaction>> RocksKVStore::createTransaction(
   Session* sess) {
-  std::lock_guard<std::mutex> lk(_mutex);
+  if (sess && sess->getCtx()->isInExec()) {
+    // the commands run by EXEC share one transaction per kvstore
+    auto pCtx = sess->getCtx();
+    auto txn = pCtx->getExecTxn(dbId());
+    if (txn == nullptr) {
+      auto etxn = createRocksTxn(sess);
+      if (!etxn.ok()) {
+        return etxn.status();
+      }
+      txn = pCtx->addExecTxn(dbId(), std::move(etxn.value()));
+    }
+    return std::unique_ptr<Transaction>(std::make_unique<SharedTxn>(txn));
+  }
+  return createRocksTxn(sess);
+}
+
+Expected<std::unique_ptr<Transaction>> RocksKVStore::createRocksTxn(
+  Session* sess) {
+  // count the txn first, see stop()
+  _aliveTxnCnt++;
   if (!_isRunning) {
+    _aliveTxnCnt--;
     return {ErrorCodes::ERR_INTERNAL, "db stopped!"};
   }
   uint64_t txnId = _nextTxnSeq++;
@@ -2134,47 +2391,106 @@ Expected<std::unique_ptr<Transaction>> RocksKVStore::createTransaction(
 #endif
   std::unique_ptr<Transaction> ret = nullptr;
 
-  // TODO(vinchen): should new RocksTxn out of mutex?
   if (_txnMode == TxnMode::TXN_OPT) {
     ret.reset(new RocksOptTxn(this, txnId, replOnly, _logOb, sess));
   } else {
     ret.reset(new RocksPesTxn(this, txnId, replOnly, _logOb, sess));
   }
-  addUnCommitedTxnInLock(txnId);
   return std::move(ret);
 }
 
 Status RocksKVStore::assignBinlogIdIfNeeded(Transaction* txn) {
   if (txn->getBinlogId() == Transaction::TXNID_UNINITED) {
-    std::lock_guard<std::mutex> lk(_mutex);
     uint64_t binlogId = _nextBinlogSeq++;
-
+    waitBinlogSlot(binlogId);
     txn->setBinlogId(binlogId);
-    INVARIANT_D(_aliveBinlogs.find(binlogId) == _aliveBinlogs.end());
-    _aliveBinlogs.insert({binlogId, {false, txn->getTxnId()}});
-
-    auto it = _aliveTxns.find(txn->getTxnId());
-    INVARIANT_D(it != _aliveTxns.end() && !it->second.first);
-
-    it->second.second = binlogId;
   }
 
   return {ErrorCodes::ERR_OK, ""};
 }
 
 void RocksKVStore::setNextBinlogSeq(uint64_t binlogId, Transaction* txn) {
-  std::lock_guard<std::mutex> lk(_mutex);
   INVARIANT_D(txn->isReplOnly());
 
-  _nextBinlogSeq = binlogId + 1;
-
+  uint64_t next = _nextBinlogSeq.load();
+  do {
+    if (binlogId < next) {
+      // the master resends the binlogs after the slave failed to commit
+      // them, they're done but invisible, see markBinlogDone()
+      if (binlogId <= _highestVisible.load()) {
+        INVARIANT_D(0);
+        LOG(ERROR) << "store:" << dbId() << " binlogId:" << binlogId
+                   << " is less than nextBinlogSeq:" << next;
+      }
+      txn->setBinlogId(binlogId);
+      return;
+    }
+  } while (!_nextBinlogSeq.compare_exchange_weak(next, binlogId + 1));
+
+  // the binlogs between next and binlogId are absent in the master (rolled
+  // back), skip them.
+  uint64_t done = next;
+  if (!_doneBinlogSeq.compare_exchange_strong(done, binlogId)) {
+    for (uint64_t id = next; id < binlogId; id++) {
+      waitBinlogSlot(id);
+      markBinlogDone(id, false);
+    }
+  }
+  waitBinlogSlot(binlogId);
   txn->setBinlogId(binlogId);
-  INVARIANT_D(_aliveBinlogs.find(binlogId) == _aliveBinlogs.end());
-  _aliveBinlogs.insert({binlogId, {false, txn->getTxnId()}});
-  auto it = _aliveTxns.find(txn->getTxnId());
-  INVARIANT_D(it != _aliveTxns.end() && !it->second.first);
+}
+
+void RocksKVStore::resetBinlogSlots() {
+  INVARIANT_D(_aliveTxnCnt.load() == 0);
+  for (uint64_t i = 0; i < BINLOG_SLOTS; i++) {
+    _binlogSlots[i] = 0;
+  }
+  _doneBinlogSeq = _nextBinlogSeq.load();
+}
+
+void RocksKVStore::waitBinlogSlot(uint64_t binlogId) {
+  // the slot is reused by binlogId after binlogId - BINLOG_SLOTS is done
+  while (binlogId - _doneBinlogSeq.load() >= BINLOG_SLOTS) {
+    std::this_thread::yield();
+  }
+}
+
+void RocksKVStore::markBinlogDone(uint64_t binlogId, bool visible) {
+  if (binlogId < _doneBinlogSeq.load()) {
+    // a binlog resent to the slave after it was rolled back, all the
+    // binlogs before it are done, see setNextBinlogSeq()
+    if (visible) {
+      uint64_t hv = _highestVisible.load();
+      while (hv < binlogId &&
+             !_highestVisible.compare_exchange_weak(hv, binlogId)) {
+      }
+    }
+    return;
+  }
+  _binlogSlots[binlogId % BINLOG_SLOTS].store((binlogId << 1) | visible);
 
-  it->second.second = binlogId;
+  // As things run parallel, binlogs are done out of order. The one which
+  // finds the slot of _doneBinlogSeq done pushes the watermark forward.
+  // NOTE: the slot is stored before _doneBinlogSeq is loaded, and the
+  // watermark is moved before the next slot is loaded, so at least one of
+  // the two threads sees the other one's binlog done.
+  uint64_t done = _doneBinlogSeq.load();
+  while (true) {
+    uint64_t slot = _binlogSlots[done % BINLOG_SLOTS].load();
+    if ((slot >> 1) != done) {
+      break;
+    }
+    if (!_doneBinlogSeq.compare_exchange_strong(done, done + 1)) {
+      continue;
+    }
+    if (slot & 1) {
+      uint64_t hv = _highestVisible.load();
+      while (hv < done && !_highestVisible.compare_exchange_weak(hv, done)) {
+      }
+      INVARIANT_D(_highestVisible.load() < _nextBinlogSeq.load());
+    }
+    done++;
+  }
 }
 
 rocksdb::OptimisticTransactionDB* RocksKVStore::getUnderlayerOptDB() {
@@ -2186,77 +2502,66 @@ rocksdb::TransactionDB* RocksKVStore::getUnderlayerPesDB() {
 }
 
 uint64_t RocksKVStore::getHighestBinlogId() const {
-  std::lock_guard<std::mutex> lk(_mutex);
-  return _highestVisible;
+  return _highestVisible.load();
 }
 
 uint64_t RocksKVStore::getNextBinlogSeq() const {
-  std::lock_guard<std::mutex> lk(_mutex);
-  return _nextBinlogSeq;
+  return _nextBinlogSeq.load();
 }
 
 rocksdb::DB* RocksKVStore::getBaseDB() const {
   return _optdb.get() ? _optdb->GetBaseDB() : _pesdb->GetBaseDB();
 }
 
-void RocksKVStore::addUnCommitedTxnInLock(uint64_t txnId) {
-  if (_aliveTxns.find(txnId) != _aliveTxns.end()) {
-    LOG(FATAL) << "BUG: txnid:" << txnId << " double add uncommitted";
+void RocksKVStore::markCommitted(uint64_t binlogId, uint64_t binlogTxnId) {
+  if (binlogId != Transaction::TXNID_UNINITED) {
+    markBinlogDone(binlogId, binlogTxnId != Transaction::TXNID_UNINITED);
   }
-  _aliveTxns.insert({txnId, {false, Transaction::TXNID_UNINITED}});
+  _aliveTxnCnt--;
 }
 
-void RocksKVStore::markCommitted(uint64_t txnId, uint64_t binlogTxnId) {
-  std::lock_guard<std::mutex> lk(_mutex);
-  markCommittedInLock(txnId, binlogTxnId);
+bool RocksKVStore::isGroupSync() const {
+  return _cfg->rocksGroupWALSync && _cfg->rocksFlushLogAtTrxCommit &&
+    !_cfg->rocksDisableWAL;
 }
 
-std::set<uint64_t> RocksKVStore::getUncommittedTxns() const {
-  std::lock_guard<std::mutex> lk(_mutex);
-  std::set<uint64_t> result;
-  for (auto& kv : _aliveTxns) {
-    if (!kv.second.first) {
-      result.insert(kv.first);
+Status RocksKVStore::syncWAL() {
+  // the txn has been written into the WAL, so the latest sequence number
+  // covers it.
+  uint64_t seq = getBaseDB()->GetLatestSequenceNumber();
+  std::unique_lock<std::mutex> lk(_syncMutex);
+  if (_syncedSeq >= seq) {
+    return {ErrorCodes::ERR_OK, ""};
+  }
+  _syncPending++;
+  while (_syncedSeq < seq) {
+    if (_syncing) {
+      _syncCv.wait(lk);
+      continue;
+    }
+    // become the leader, sync for all the pending committers
+    _syncing = true;
+    uint64_t target = getBaseDB()->GetLatestSequenceNumber();
+    _walSyncBatchSize.add(_syncPending);
+    _syncPending = 0;
+    lk.unlock();
+    auto s = getBaseDB()->SyncWAL();
+    lk.lock();
+    _syncing = false;
+    if (s.ok()) {
+      _syncedSeq = std::max(_syncedSeq, target);
+    }
+    _syncCv.notify_all();
+    if (!s.ok()) {
+      LOG(ERROR) << "store:" << dbId() << " SyncWAL failed:" << s.ToString();
+      return {ErrorCodes::ERR_INTERNAL, s.ToString()};
     }
   }
-  return result;
+  return {ErrorCodes::ERR_OK, ""};
 }
 
-void RocksKVStore::markCommittedInLock(uint64_t txnId, uint64_t binlogTxnId) {
-  if (!_isRunning) {
-    LOG(FATAL) << "BUG: _uncommittedTxns not empty after stopped";
-  }
-
-  auto it = _aliveTxns.find(txnId);
-  INVARIANT_D(it != _aliveTxns.end());
-  INVARIANT_D(!it->second.first);
-
-  it->second.first = true;
-  auto binlogId = it->second.second;
-  _aliveTxns.erase(it);
-
-  if (binlogId != Transaction::TXNID_UNINITED) {
-    auto i = _aliveBinlogs.find(binlogId);
-    INVARIANT_D(i != _aliveBinlogs.end());
-    INVARIANT_D(i->second.second == txnId ||
-                i->second.second == Transaction::TXNID_UNINITED);  // rollback
-
-    i->second.first = true;
-    i->second.second = binlogTxnId;
-    if (i == _aliveBinlogs.begin()) {
-      while (i != _aliveBinlogs.end()) {
-        if (!i->second.first) {
-          break;
-        }
-
-        if (i->second.second != Transaction::TXNID_UNINITED) {
-          _highestVisible = i->first;
-          INVARIANT_D(_highestVisible <= _nextBinlogSeq);
-        }
-        i = _aliveBinlogs.erase(i);
-      }
-    }
-  }
+uint64_t RocksKVStore::getAliveTxnCount() const {
+  return _aliveTxnCnt.load();
 }
 
 Expected<RecordValue> RocksKVStore::getKV(const RecordKey& key,
@@ -2283,6 +2588,28 @@ Expected<RecordValue> RocksKVStore::getKV(const RecordKey& key,
   return eValue;
 }
 
+std::vector<Expected<RecordValue>> RocksKVStore::getKVs(
+  const std::vector<RecordKey>& keys, Transaction* txn) {
+  INVARIANT_D(txn->getKVStoreId() == dbId());
+  std::vector<std::string> encoded;
+  encoded.reserve(keys.size());
+  for (const auto& key : keys) {
+    encoded.emplace_back(key.encode());
+  }
+  auto values = txn->getKVs(encoded);
+
+  std::vector<Expected<RecordValue>> result;
+  result.reserve(values.size());
+  for (auto& v : values) {
+    if (!v.ok()) {
+      result.emplace_back(v.status());
+    } else {
+      result.emplace_back(RecordValue::decode(v.value()));
+    }
+  }
+  return result;
+}
+
 Status RocksKVStore::setKV(const RecordKey& key,
                            const RecordValue& value,
                            Transaction* txn) {
@@ -2343,9 +2670,40 @@ Status RocksKVStore::deleteRangeWithoutBinlog(
   //  use greater than rocksdb 5.18
   rocksdb::Slice sBegin(begin);
   rocksdb::Slice sEnd(end);
+
+  // the slots covered by the range have no key after it, the others
+  // deleted partly are recounted later
+  std::unique_lock<std::mutex> lk(_slotKeysMutex, std::defer_lock);
+  std::vector<uint32_t> emptied;
+  if (_slotKeys && column_family == getDataColumnFamilyHandle()) {
+    lk.lock();
+    uint32_t last = std::min(keyChunkId(end), _cfg->chunkSize - 1);
+    for (uint32_t slot = keyChunkId(begin); slot <= last; slot++) {
+      auto lo = RecordKey(slot, 0, RecordType::RT_INVALID, "", "")
+                  .prefixChunkid();
+      auto hi = RecordKey(slot + 1, 0, RecordType::RT_INVALID, "", "")
+                  .prefixChunkid();
+      if (lo >= end || begin >= hi) {
+        continue;
+      }
+      if (begin <= lo && hi <= end) {
+        _slotKeys[slot] = SLOT_KEYS_SCANNING;
+        emptied.push_back(slot);
+      } else {
+        _slotKeys[slot] = SLOT_KEYS_UNKNOWN;
+      }
+    }
+  }
+
   rocksdb::DB* db = getBaseDB();
   auto s = db->DeleteRange(
     rocksdb::WriteOptions(), column_family, sBegin.ToString(), sEnd.ToString());
+  for (auto slot : emptied) {
+    // the writes during DeleteRange() have made it UNKNOWN
+    int64_t expected = SLOT_KEYS_SCANNING;
+    _slotKeys[slot].compare_exchange_strong(
+      expected, s.ok() ? 0 : SLOT_KEYS_UNKNOWN);
+  }
   if (!s.ok()) {
     LOG(ERROR) << "deleteRange failed:" << s.ToString();
     return {ErrorCodes::ERR_INTERNAL, s.ToString()};
@@ -2362,6 +2720,402 @@ Status RocksKVStore::deleteRangeBinlog(uint64_t begin, uint64_t end) {
     getBinlogColumnFamilyHandle(), beginKeyStr, endKeyStr);
 }
 
+Status RocksKVStore::deleteSlotsByCompaction(uint32_t begin, uint32_t end) {
+  if (!_garbageSlots || begin >= end || end > _cfg->chunkSize) {
+    return {ErrorCodes::ERR_INTERNAL, "invalid slot range"};
+  }
+  auto sBegin = RecordKey(begin, 0, RecordType::RT_INVALID, "", "")
+                  .prefixChunkid();
+  auto sEnd = RecordKey(end, 0, RecordType::RT_INVALID, "", "")
+                .prefixChunkid();
+  rocksdb::Slice b(sBegin);
+  rocksdb::Slice e(sEnd);
+
+  // the slots have no key after it, same as deleteRangeWithoutBinlog()
+  std::unique_lock<std::mutex> lk(_slotKeysMutex, std::defer_lock);
+  if (_slotKeys) {
+    lk.lock();
+    for (uint32_t slot = begin; slot < end; slot++) {
+      _slotKeys[slot] = SLOT_KEYS_SCANNING;
+    }
+  }
+  for (uint32_t slot = begin; slot < end; slot++) {
+    _garbageSlots[slot].fetch_add(1);
+  }
+  rocksdb::Status s;
+  {
+    const auto guard = MakeGuard([&] {
+      for (uint32_t slot = begin; slot < end; slot++) {
+        _garbageSlots[slot].fetch_sub(1);
+      }
+    });
+    auto db = getBaseDB();
+    // the files inside the range are dropped without rewriting them, the
+    // records left in L0, the memtables and the files across the border
+    // are dropped by the compaction filter
+    s = rocksdb::DeleteFilesInRange(
+      db, getDataColumnFamilyHandle(), &b, &e, false);
+    if (s.ok()) {
+      auto opts = rocksdb::CompactRangeOptions();
+      opts.bottommost_level_compaction =
+        rocksdb::BottommostLevelCompaction::kForce;
+      s = db->CompactRange(opts, getDataColumnFamilyHandle(), &b, &e);
+    }
+    // the compaction filter keeps the records a snapshot still sees, so
+    // the compaction finishing doesn't mean the slots are empty, the
+    // records left are deleted by a DeleteRange()
+    auto leftInRange = [&]() -> rocksdb::Status {
+      rocksdb::ReadOptions readOpts;
+      readOpts.iterate_upper_bound = &e;
+      std::unique_ptr<rocksdb::Iterator> iter(
+        db->NewIterator(readOpts, getDataColumnFamilyHandle()));
+      iter->Seek(b);
+      if (!iter->status().ok()) {
+        return iter->status();
+      }
+      return iter->Valid() ? rocksdb::Status::Incomplete("records left")
+                           : rocksdb::Status::OK();
+    };
+    if (s.ok()) {
+      s = leftInRange();
+    }
+    if (s.IsIncomplete()) {
+      LOG(WARNING) << "deleteSlotsByCompaction left records, from:" << begin
+                   << " to:" << end << ", delete them by DeleteRange";
+      s = db->DeleteRange(
+        rocksdb::WriteOptions(), getDataColumnFamilyHandle(), b, e);
+      if (s.ok()) {
+        s = leftInRange();
+      }
+    }
+  }
+  if (_slotKeys) {
+    for (uint32_t slot = begin; slot < end; slot++) {
+      int64_t expected = SLOT_KEYS_SCANNING;
+      _slotKeys[slot].compare_exchange_strong(
+        expected, s.ok() ? 0 : SLOT_KEYS_UNKNOWN);
+    }
+    lk.unlock();
+  }
+  if (!s.ok()) {
+    LOG(ERROR) << "deleteSlotsByCompaction failed, from:" << begin
+               << " to:" << end << " " << s.ToString();
+    return {ErrorCodes::ERR_INTERNAL, s.ToString()};
+  }
+
+  auto txn = createTransaction(nullptr);
+  if (!txn.ok()) {
+    return txn.status();
+  }
+  auto ret = txn.value()->addDeleteRangeBinlog(sBegin, sEnd);
+  if (!ret.ok()) {
+    return ret;
+  }
+  return txn.value()->commit().status();
+}
+
+bool RocksKVStore::isGarbageKey(const rocksdb::Slice& key) const {
+  if (!_garbageSlots) {
+    return false;
+  }
+  uint32_t chunkId = keyChunkId(key);
+  return chunkId < _cfg->chunkSize && _garbageSlots[chunkId].load() > 0;
+}
+
+Expected<std::vector<std::string>> RocksKVStore::exportSst(
+  Transaction* txn,
+  const std::string& begin,
+  const std::string& end,
+  const std::string& dir,
+  uint64_t maxFileSize,
+  uint64_t* keyNum) {
+  std::vector<std::string> files;
+  *keyNum = 0;
+  try {
+    filesystem::create_directories(dir);
+  } catch (const std::exception& ex) {
+    return {ErrorCodes::ERR_INTERNAL, ex.what()};
+  }
+  rocksdb::SstFileWriter writer(rocksdb::EnvOptions(), options());
+  bool opened = false;
+  auto finish = [&writer, &opened]() -> Status {
+    opened = false;
+    auto s = writer.Finish();
+    if (!s.ok()) {
+      return {ErrorCodes::ERR_INTERNAL, s.ToString()};
+    }
+    return {ErrorCodes::ERR_OK, ""};
+  };
+
+  auto cursor = txn->createCursor(ColumnFamilyNumber::ColumnFamily_Default,
+                                  &end);
+  cursor->seek(begin);
+  // the subkeys of a deleted key are left for the compaction filter
+  SubKeyVersionChecker versionChecker(txn);
+  while (true) {
+    auto expRcd = cursor->next();
+    if (expRcd.status().code() == ErrorCodes::ERR_EXHAUST) {
+      break;
+    } else if (!expRcd.ok()) {
+      return expRcd.status();
+    }
+    auto stale = versionChecker.isStale(expRcd.value().getRecordKey());
+    if (!stale.ok()) {
+      return stale.status();
+    }
+    if (stale.value()) {
+      continue;
+    }
+    if (!opened) {
+      std::string name = dir + "/" + std::to_string(files.size()) + ".sst";
+      auto s = writer.Open(name);
+      if (!s.ok()) {
+        return {ErrorCodes::ERR_INTERNAL, s.ToString()};
+      }
+      files.emplace_back(std::move(name));
+      opened = true;
+    }
+    auto kv = expRcd.value().encode();
+    auto s = writer.Put(kv.first, kv.second);
+    if (!s.ok()) {
+      return {ErrorCodes::ERR_INTERNAL, s.ToString()};
+    }
+    (*keyNum)++;
+    if (writer.FileSize() >= maxFileSize) {
+      auto st = finish();
+      if (!st.ok()) {
+        return st;
+      }
+    }
+  }
+  if (opened) {
+    auto st = finish();
+    if (!st.ok()) {
+      return st;
+    }
+  }
+  return files;
+}
+
+Status RocksKVStore::ingestSst(const std::vector<std::string>& files) {
+  if (files.empty()) {
+    return {ErrorCodes::ERR_OK, ""};
+  }
+  rocksdb::IngestExternalFileOptions opts;
+  opts.move_files = true;
+  auto s = getBaseDB()->IngestExternalFile(
+    getDataColumnFamilyHandle(), files, opts);
+  if (!s.ok()) {
+    LOG(ERROR) << "ingest sst failed:" << s.ToString();
+    return {ErrorCodes::ERR_INTERNAL, s.ToString()};
+  }
+  return {ErrorCodes::ERR_OK, ""};
+}
+
+bool RocksKVStore::isSlotKeyCounted(const std::string& key) const {
+  return _slotKeys && key.size() > RecordKey::getHdrSize() &&
+    RecordKey::decodeType(key) == RecordType::RT_DATA_META &&
+    RecordKey::decodeChunkId(key) < _cfg->chunkSize;
+}
+
+bool RocksKVStore::isSlotKeyRecounting(uint32_t slot) const {
+  return _slotKeys && slot < _cfg->chunkSize &&
+    isPendingSlotKeys(_slotKeys[slot].load());
+}
+
+void RocksKVStore::addSlotKeys(uint32_t slot, int64_t delta, bool recounting) {
+  if (!_slotKeys || slot >= _cfg->chunkSize) {
+    return;
+  }
+  auto& counter = _slotKeys[slot];
+  int64_t v = counter.load();
+  while (v != SLOT_KEYS_UNKNOWN) {
+    int64_t nv = SLOT_KEYS_UNKNOWN;
+    if (v == SLOT_KEYS_SCANNING) {
+      // the txn may be in the snapshot or not
+      nv = SLOT_KEYS_UNKNOWN;
+    } else if (isPendingSlotKeys(v)) {
+      nv = recounting ? v + delta : SLOT_KEYS_UNKNOWN;
+    } else if (v + delta >= 0) {
+      nv = v + delta;
+    }
+    if (counter.compare_exchange_weak(v, nv)) {
+      break;
+    }
+  }
+}
+
+Expected<uint64_t> RocksKVStore::getSlotKeyCount(uint32_t slot) const {
+  if (!_slotKeys || slot >= _cfg->chunkSize) {
+    return {ErrorCodes::ERR_NOTFOUND, "slot stats disabled"};
+  }
+  int64_t v = _slotKeys[slot].load();
+  if (v < 0) {
+    return {ErrorCodes::ERR_NOTFOUND, "unknown key number"};
+  }
+  return static_cast<uint64_t>(v);
+}
+
+Expected<uint64_t> RocksKVStore::recountSlotKeys(uint32_t slot) {
+  if (slot >= _cfg->chunkSize) {
+    return {ErrorCodes::ERR_INTERNAL, "invalid slot:" + std::to_string(slot)};
+  }
+  std::lock_guard<std::mutex> lk(_slotKeysMutex);
+  std::atomic<int64_t>* counter = _slotKeys ? &_slotKeys[slot] : nullptr;
+  if (counter) {
+    counter->store(SLOT_KEYS_SCANNING);
+  }
+  auto ptxn = createTransaction(nullptr);
+  if (!ptxn.ok()) {
+    if (counter) {
+      counter->store(SLOT_KEYS_UNKNOWN);
+    }
+    return ptxn.status();
+  }
+  // the cursor holds the snapshot since it's created
+  auto cursor = ptxn.value()->createSlotCursor(slot);
+  if (counter) {
+    int64_t expected = SLOT_KEYS_SCANNING;
+    counter->compare_exchange_strong(expected, SLOT_KEYS_PENDING);
+  }
+
+  uint64_t n = 0;
+  while (true) {
+    auto expRcd = cursor->next();
+    if (expRcd.status().code() == ErrorCodes::ERR_EXHAUST) {
+      break;
+    }
+    if (!expRcd.ok()) {
+      if (counter) {
+        counter->store(SLOT_KEYS_UNKNOWN);
+      }
+      return expRcd.status();
+    }
+    n++;
+  }
+  if (!counter) {
+    return n;
+  }
+  int64_t v = counter->load();
+  while (isPendingSlotKeys(v)) {
+    int64_t nv = static_cast<int64_t>(n) + (v - SLOT_KEYS_PENDING);
+    if (nv < 0) {
+      nv = SLOT_KEYS_UNKNOWN;
+    }
+    if (counter->compare_exchange_weak(v, nv)) {
+      return nv < 0 ? n : static_cast<uint64_t>(nv);
+    }
+  }
+  return n;
+}
+
+void RocksKVStore::invalidateSlotKeys(uint32_t begin, uint32_t end) {
+  if (!_slotKeys) {
+    return;
+  }
+  for (uint32_t slot = begin; slot < std::min(end, _cfg->chunkSize); slot++) {
+    _slotKeys[slot] = SLOT_KEYS_UNKNOWN;
+  }
+}
+
+Expected<uint64_t> RocksKVStore::getSlotApproximateSize(uint32_t slot) {
+  if (!_isRunning) {
+    return {ErrorCodes::ERR_INTERNAL, "db stopped!"};
+  }
+  auto begin =
+    RecordKey(slot, 0, RecordType::RT_INVALID, "", "").prefixChunkid();
+  auto end =
+    RecordKey(slot + 1, 0, RecordType::RT_INVALID, "", "").prefixChunkid();
+  rocksdb::Range range(begin, end);
+  uint64_t size = 0;
+  getBaseDB()->GetApproximateSizes(
+    getDataColumnFamilyHandle(),
+    &range,
+    1,
+    &size,
+    static_cast<uint8_t>(
+      rocksdb::DB::SizeApproximationFlags::INCLUDE_FILES |
+      rocksdb::DB::SizeApproximationFlags::INCLUDE_MEMTABLES));
+  return size;
+}
+
+std::string RocksKVStore::slotKeysFile() const {
+  return dbPath() + "/" + dbId() + "/SLOTKEYS";
+}
+
+// The file is removed once loaded, so the numbers are lost if the store
+// isn't stopped cleanly. They're all 0 if there is no key, otherwise
+// unknown until recounted.
+void RocksKVStore::loadSlotKeys() {
+  if (!_slotKeys) {
+    return;
+  }
+  const uint32_t slots = _cfg->chunkSize;
+  std::vector<int64_t> counts;
+  std::string file = slotKeysFile();
+  {
+    std::ifstream in(file);
+    uint32_t n = 0;
+    if (in && (in >> n) && n == slots) {
+      counts.resize(n);
+      for (uint32_t i = 0; i < n; i++) {
+        if (!(in >> counts[i]) || counts[i] < SLOT_KEYS_UNKNOWN) {
+          counts.clear();
+          break;
+        }
+      }
+    }
+  }
+  std::error_code ec;
+  filesystem::remove(file, ec);
+  filesystem::remove(file + ".tmp", ec);
+
+  if (!counts.empty()) {
+    for (uint32_t i = 0; i < slots; i++) {
+      _slotKeys[i] = counts[i];
+    }
+    LOG(INFO) << "store:" << dbId() << " slot key numbers loaded";
+    return;
+  }
+  std::unique_ptr<rocksdb::Iterator> iter(getBaseDB()->NewIterator(
+    rocksdb::ReadOptions(), getDataColumnFamilyHandle()));
+  iter->SeekToFirst();
+  bool empty = iter->status().ok() &&
+    (!iter->Valid() || keyChunkId(iter->key().ToString()) >= slots);
+  for (uint32_t i = 0; i < slots; i++) {
+    _slotKeys[i] = empty ? 0 : SLOT_KEYS_UNKNOWN;
+  }
+  LOG(INFO) << "store:" << dbId()
+            << " slot key numbers reset, empty:" << empty;
+}
+
+void RocksKVStore::saveSlotKeys() {
+  if (!_slotKeys) {
+    return;
+  }
+  std::string file = slotKeysFile();
+  std::string tmpFile = file + ".tmp";
+  {
+    std::ofstream out(tmpFile, std::ios::trunc);
+    out << _cfg->chunkSize << "\n";
+    for (uint32_t i = 0; i < _cfg->chunkSize; i++) {
+      int64_t v = _slotKeys[i].load();
+      out << (v < 0 ? SLOT_KEYS_UNKNOWN : v) << "\n";
+    }
+    out.close();
+    if (!out) {
+      LOG(WARNING) << "store:" << dbId() << " save " << tmpFile << " failed";
+      return;
+    }
+  }
+  std::error_code ec;
+  filesystem::rename(tmpFile, file, ec);
+  if (ec) {
+    LOG(WARNING) << "store:" << dbId() << " rename " << tmpFile
+                 << " failed:" << ec.message();
+  }
+}
+
 void RocksKVStore::initRocksProperties() {
   _rocksIntProperties = {
     {"rocksdb.num-immutable-mem-table", "num_immutable_mem_table"},
@@ -2434,6 +3188,22 @@ bool RocksKVStore::getIntProperty(const std::string& property,
   return ok;
 }
 
+Expected<std::string> RocksKVStore::getDataKVNoTxn(
+  const std::string& key) const {
+  if (!_isRunning) {
+    return {ErrorCodes::ERR_INTERNAL, "db stopped!"};
+  }
+  // NOTE: the data column family is the default one
+  std::string value;
+  auto s = getBaseDB()->Get(rocksdb::ReadOptions(), key, &value);
+  if (s.ok()) {
+    return value;
+  } else if (s.IsNotFound()) {
+    return {ErrorCodes::ERR_NOTFOUND, s.ToString()};
+  }
+  return {ErrorCodes::ERR_INTERNAL, s.ToString()};
+}
+
 bool RocksKVStore::getProperty(const std::string& property,
                                std::string* value) const {
   bool ok = false;
@@ -2598,31 +3368,55 @@ void RocksKVStore::appendJSONStat(
   w.Uint64(_hasBackup);
   w.Key("next_txn_seq");
   w.Uint64(_nextTxnSeq);
-  w.Key("next_binlog_seq");
-  w.Uint64(_nextBinlogSeq);
   {
-    std::lock_guard<std::mutex> lk(_mutex);
+    uint64_t done = _doneBinlogSeq.load();
+    uint64_t next = _nextBinlogSeq.load();
+    uint64_t alive = next > done ? next - done : 0;
+    w.Key("next_binlog_seq");
+    w.Uint64(next);
     w.Key("alive_txns");
-    w.Uint64(_aliveTxns.size());
+    w.Uint64(_aliveTxnCnt.load());
     w.Key("alive_binlogs");
-    w.Uint64(_aliveBinlogs.size());
+    w.Uint64(alive);
     w.Key("min_alive_binlog");
-    w.Uint64(_aliveBinlogs.size() ? _aliveBinlogs.begin()->first : 0);
+    w.Uint64(alive ? done : 0);
     w.Key("max_alive_binlog");
-    w.Uint64(_aliveBinlogs.size() ? _aliveBinlogs.rbegin()->first : 0);
+    w.Uint64(alive ? next - 1 : 0);
     w.Key("high_visible");
-    w.Uint64(_highestVisible);
+    w.Uint64(_highestVisible.load());
   }
 
   w.Key("compact_filter_count");
   w.Uint64(stat.compactFilterCount.load(std::memory_order_relaxed));
   w.Key("compact_kvexpired_count");
   w.Uint64(stat.compactKvExpiredCount.load(std::memory_order_relaxed));
+  w.Key("compact_subkey_dropped_count");
+  w.Uint64(stat.compactSubKeyDroppedCount.load(std::memory_order_relaxed));
+  w.Key("compact_garbage_dropped_count");
+  w.Uint64(stat.compactGarbageDroppedCount.load(std::memory_order_relaxed));
   w.Key("paused_error_count");
   w.Uint64(stat.pausedErrorCount.load(std::memory_order_relaxed));
   w.Key("destroyed_error_count");
   w.Uint64(stat.destroyedErrorCount.load(std::memory_order_relaxed));
 
+  auto appendHistogram = [&w](const char* name, const Histogram& h) {
+    w.Key(name);
+    w.StartObject();
+    w.Key("count");
+    w.Uint64(h.count());
+    w.Key("avg");
+    w.Uint64(h.avg());
+    w.Key("p50");
+    w.Uint64(h.percentile(50));
+    w.Key("p99");
+    w.Uint64(h.percentile(99));
+    w.Key("max");
+    w.Uint64(h.max());
+    w.EndObject();
+  };
+  appendHistogram("wal_sync_batch_size", _walSyncBatchSize);
+  appendHistogram("commit_latency_us", _commitLatencyUs);
+
   w.Key("rocksdb");
   w.StartObject();
   if (_isRunning) {
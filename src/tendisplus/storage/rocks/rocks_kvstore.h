@@ -5,11 +5,13 @@
 #ifndef SRC_TENDISPLUS_STORAGE_ROCKS_ROCKS_KVSTORE_H_
 #define SRC_TENDISPLUS_STORAGE_ROCKS_ROCKS_KVSTORE_H_
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <iostream>
 #include <set>
 #include <mutex>  // NOLINT
+#include <condition_variable>  // NOLINT
 #include <map>
 #include <unordered_map>
 #include <vector>
@@ -23,6 +25,7 @@
 
 #include "tendisplus/server/server_params.h"
 #include "tendisplus/storage/kvstore.h"
+#include "tendisplus/utils/histogram.h"
 
 namespace tendisplus {
 
@@ -62,14 +65,19 @@ class RocksTxn : public Transaction {
 
   Expected<uint64_t> commit() final;
   Status rollback() final;
+  void setSavePoint() final;
+  Status rollbackToSavePoint() final;
   // getKV: get data from chosen column family
   Expected<std::string> getKV(const std::string& key) final;
+  std::vector<Expected<std::string>> getKVs(
+    const std::vector<std::string>& keys) final;
   Status setKV(const std::string& key,
                const std::string& val,
                const uint64_t ts = 0) final;
   Status delKV(const std::string& key, const uint64_t ts = 0) final;
   Status addDeleteRangeBinlog(const std::string& begin,
                               const std::string& end) final;
+  Status addSetBinlog(const std::string& key, const std::string& val) final;
 #ifdef BINLOG_V1
   Status applyBinlog(const std::list<ReplLog>& txnLog) final;
   Status truncateBinlog(const std::list<ReplLog>& txnLog) final;
@@ -106,6 +114,11 @@ class RocksTxn : public Transaction {
 
  protected:
   virtual void ensureTxn() {}
+  // get the change of the key number of the slot if the key is set or
+  // deleted, 0 if the key is not a counted meta
+  Status slotKeyDelta(const std::string& key, bool del, int64_t* delta);
+  // record the change of the key written, it's applied after commit
+  void addSlotKeyDelta(const std::string& key, int64_t delta);
 
   uint64_t _txnId;
   uint64_t _binlogId;
@@ -124,11 +137,23 @@ class RocksTxn : public Transaction {
 #else
   std::vector<ReplLogValueEntryV2> _replLogValues;
 #endif
+  // slot -> the change of its key number
+  std::vector<std::pair<uint32_t, int64_t>> _slotKeyDeltas;
+  // what to restore besides the rocksdb txn on rollbackToSavePoint()
+  struct SavePoint {
+    size_t binlogs;
+    size_t slotKeyDeltas;
+    int64_t lastSlotKeyDelta;
+    uint32_t chunkId;
+  };
+  std::vector<SavePoint> _savePoints;
 
   // if rollback/commit has been explicitly called
   bool _done;
 
   bool _replOnly;
+  // the WAL is synced by RocksKVStore::syncWAL() after commit
+  bool _groupSync;
 
   std::shared_ptr<BinlogObserver> _logOb;
   Session* _session;
@@ -220,6 +245,8 @@ class RocksKVStore : public KVStore {
   Expected<RecordValue> getKV(const RecordKey& key,
                               Transaction* txn,
                               RecordType valueType) final;
+  std::vector<Expected<RecordValue>> getKVs(const std::vector<RecordKey>& keys,
+                                            Transaction* txn) final;
   Status setKV(const Record& kv, Transaction* txn) final;
   Status setKV(const RecordKey& key,
                const RecordValue& val,
@@ -234,6 +261,29 @@ class RocksKVStore : public KVStore {
                                   const std::string& begin,
                                   const std::string& end);
   Status deleteRangeBinlog(uint64_t begin, uint64_t end);
+  Expected<std::vector<std::string>> exportSst(Transaction* txn,
+                                               const std::string& begin,
+                                               const std::string& end,
+                                               const std::string& dir,
+                                               uint64_t maxFileSize,
+                                               uint64_t* keyNum) final;
+  Status ingestSst(const std::vector<std::string>& files) final;
+  Expected<uint64_t> getSlotKeyCount(uint32_t slot) const final;
+  Expected<uint64_t> recountSlotKeys(uint32_t slot) final;
+  void invalidateSlotKeys(uint32_t begin, uint32_t end) final;
+  Expected<uint64_t> getSlotApproximateSize(uint32_t slot) final;
+  Status deleteSlotsByCompaction(uint32_t begin, uint32_t end) final;
+  // whether the key is in a slot being deleted by deleteSlotsByCompaction(),
+  // the compaction filter drops it
+  bool isGarbageKey(const rocksdb::Slice& key) const;
+  // whether the key is a meta whose slot has a key counter
+  bool isSlotKeyCounted(const std::string& key) const;
+  // whether the recount of the slot has taken its snapshot, the txns
+  // check it before commit, see recountSlotKeys()
+  bool isSlotKeyRecounting(uint32_t slot) const;
+  // apply the change committed by a txn, recounting is what the txn saw
+  // from isSlotKeyRecounting() before commit
+  void addSlotKeys(uint32_t slot, int64_t delta, bool recounting);
 
 #ifdef BINLOG_V1
   Status applyBinlog(const std::list<ReplLog>& txnLog, Transaction* txn) final;
@@ -305,15 +355,28 @@ class RocksKVStore : public KVStore {
   void appendJSONStat(
     rapidjson::PrettyWriter<rapidjson::StringBuffer>&) const final;
 
+  // binlogId is the binlog assigned to the txn, TXNID_UNINITED if none.
   // if binlogTxnId == Transaction::TXNID_UNINITED, it mean rollback
-  void markCommitted(uint64_t txnId, uint64_t binlogTxnId);
+  void markCommitted(uint64_t binlogId, uint64_t binlogTxnId);
+  // whether the committed txns sync the WAL together by syncWAL()
+  bool isGroupSync() const;
+  // wait until the WAL is synced up to the latest write. The concurrent
+  // committers are synced by one of them with one SyncWAL().
+  // NOTE: only the fsync is batched here. The WAL writes are grouped by
+  // the rocksdb write thread already, whose leader appends the batches of
+  // its followers. Without this, a sync write holds the write thread
+  // during its fsync, and the next write group waits for it.
+  Status syncWAL();
+  void addCommitLatency(uint64_t us) {
+    _commitLatencyUs.add(us);
+  }
   rocksdb::OptimisticTransactionDB* getUnderlayerOptDB();
   rocksdb::TransactionDB* getUnderlayerPesDB();
 
   uint64_t getHighestBinlogId() const final;
 
   // NOTE(deyukong): this api is only for debug
-  std::set<uint64_t> getUncommittedTxns() const;
+  uint64_t getAliveTxnCount() const;
 
   const std::shared_ptr<ServerParams>& getCfg() const {
     return _cfg;
@@ -335,6 +398,9 @@ class RocksKVStore : public KVStore {
   rocksdb::ColumnFamilyHandle* getDataColumnFamilyHandle() {
     return _cfHandles[0];
   }
+  // get a record of the data column family without txn, it's for the
+  // compaction filter which can't create txns.
+  Expected<std::string> getDataKVNoTxn(const std::string& key) const;
   rocksdb::ColumnFamilyHandle* getBinlogColumnFamilyHandle() {
     if (_cfg->binlogUsingDefaultCF == true) {
       return _cfHandles[0];
@@ -342,11 +408,13 @@ class RocksKVStore : public KVStore {
       return _cfHandles[1];
     }
   }
+  rocksdb::DB* getBaseDB() const;
 
  private:
-  rocksdb::DB* getBaseDB() const;
-  void addUnCommitedTxnInLock(uint64_t txnId);
-  void markCommittedInLock(uint64_t txnId, uint64_t binlogTxnId);
+  Expected<std::unique_ptr<Transaction>> createRocksTxn(Session* sess);
+  void resetBinlogSlots();
+  void waitBinlogSlot(uint64_t binlogId);
+  void markBinlogDone(uint64_t binlogId, bool visible);
   rocksdb::Options options();
   Expected<bool> deleteBinlog(uint64_t start);
   void initRocksProperties();
@@ -354,12 +422,15 @@ class RocksKVStore : public KVStore {
                                        BackupInfo* result);
   Expected<std::string> loadCopy(const std::string& dir);
   Expected<std::string> copyCkpt(const std::string& dir);
+  std::string slotKeysFile() const;
+  void loadSlotKeys();
+  void saveSlotKeys();
 
  private:
   mutable std::mutex _mutex;
 
   const std::shared_ptr<ServerParams> _cfg;
-  bool _isRunning;
+  std::atomic<bool> _isRunning;
   // _isPaused = true, it means that the rocksdb can't do any
   // get/set operations. But the rocksdb is running. It can be
   // reopen again.
@@ -368,7 +439,7 @@ class RocksKVStore : public KVStore {
   bool _enableFilter;
   bool _enableRepllog;
 
-  KVStore::StoreMode _mode;
+  std::atomic<KVStore::StoreMode> _mode;
 
   const TxnMode _txnMode;
 
@@ -378,7 +449,7 @@ class RocksKVStore : public KVStore {
   std::shared_ptr<rocksdb::Statistics> _stats;
   std::shared_ptr<rocksdb::Cache> _blockCache;
 
-  uint64_t _nextTxnSeq;
+  std::atomic<uint64_t> _nextTxnSeq;
 #ifdef BINLOG_V1
   // NOTE(deyukong): sorted data-structure is required here.
   // we rely on the data order to maintain active txns' watermark.
@@ -393,25 +464,54 @@ class RocksKVStore : public KVStore {
   // push _highestVisible forward.
   std::map<uint64_t, std::pair<bool, uint64_t>> _aliveTxns;
 #else
-  uint64_t _nextBinlogSeq;  // high water level for binlog id
-  // <txnId, <commit_or_not, binlogId>>
-  std::unordered_map<uint64_t, std::pair<bool, uint64_t>> _aliveTxns;
-
-  // As things run parallel, there will be false-holes in _aliveBinlogs.
-  // Fortunely, when _aliveBinlogs.begin() changes from uncommitted to
-  // committed, we have a chance to remove all the continuous committed
-  // binlogIds follows it, and push _highestVisible forward.
-  // <binlogId, <commit_or_not, txnId>>
-  std::map<uint64_t, std::pair<bool, uint64_t>> _aliveBinlogs;
+  // high water level for binlog id
+  std::atomic<uint64_t> _nextBinlogSeq;
+  std::atomic<uint64_t> _aliveTxnCnt;
+
+  // A ring of commit slots, the slot of binlogId is set to
+  // (binlogId << 1 | visible) when the txn of binlogId is done. The
+  // binlogs before _doneBinlogSeq are all done, and a binlog is assigned
+  // only if its slot is free, see waitBinlogSlot().
+  static constexpr uint64_t BINLOG_SLOTS = 1 << 14;
+  std::unique_ptr<std::atomic<uint64_t>[]> _binlogSlots;
+  std::atomic<uint64_t> _doneBinlogSeq;
 #endif
 
   // NOTE(deyukong): _highestVisible is the largest committed binlog
-  // before _aliveTxns.begin()
-  // TOD0(vinchen) : make it actomic?
-  uint64_t _highestVisible;  // low water level for binlog id
+  // before _doneBinlogSeq
+  std::atomic<uint64_t> _highestVisible;  // low water level for binlog id
 
   std::shared_ptr<BinlogObserver> _logOb;
   std::shared_ptr<RocksdbEnv> _env;
+
+  // group WAL sync, guarded by _syncMutex
+  std::mutex _syncMutex;
+  std::condition_variable _syncCv;
+  bool _syncing;
+  // the WAL has been synced up to _syncedSeq
+  uint64_t _syncedSeq;
+  // number of committers waiting for the next SyncWAL()
+  uint64_t _syncPending;
+  Histogram _walSyncBatchSize;
+  Histogram _commitLatencyUs;
+
+  // The key number of each slot, or one of the states below. A recount
+  // sets SCANNING, takes the snapshot, then sets PENDING, and the changes
+  // committed after that are added to PENDING until the scan finishes.
+  // The changes that can't tell whether they're in the snapshot turn the
+  // slot UNKNOWN. The numbers are saved in slotKeysFile() when stopped.
+  static constexpr int64_t SLOT_KEYS_UNKNOWN = -1;
+  static constexpr int64_t SLOT_KEYS_SCANNING = -2;
+  static constexpr int64_t SLOT_KEYS_PENDING = INT64_MIN / 2;
+  static bool isPendingSlotKeys(int64_t v) {
+    return v < SLOT_KEYS_PENDING / 2;
+  }
+  // serializes the recounts and the range deletions
+  std::mutex _slotKeysMutex;
+  std::unique_ptr<std::atomic<int64_t>[]> _slotKeys;
+  // the number of deleteSlotsByCompaction() running on each slot
+  std::unique_ptr<std::atomic<uint32_t>[]> _garbageSlots;
+
   std::map<std::string, std::string> _rocksIntProperties;
   std::map<std::string, std::string> _rocksStringProperties;
   std::vector<rocksdb::ColumnFamilyHandle*> _cfHandles;
@@ -6,6 +6,7 @@
 #include <utility>
 #include <limits>
 #include <thread>  // NOLINT
+#include <vector>
 
 #include "glog/logging.h"
 #include "gtest/gtest.h"
@@ -887,6 +888,493 @@ TEST(RocksKVStore, Stop) {
   EXPECT_TRUE(exptCommitId.ok());
 }
 
+TEST(RocksKVStore, GroupWALSync) {
+  auto cfg = genParams();
+  cfg->rocksFlushLogAtTrxCommit = true;
+  EXPECT_TRUE(filesystem::create_directory("db"));
+  EXPECT_TRUE(filesystem::create_directory("log"));
+  const auto guard = MakeGuard([] {
+    filesystem::remove_all("./log");
+    filesystem::remove_all("./db");
+  });
+  auto blockCache =
+    rocksdb::NewLRUCache(cfg->rocksBlockcacheMB * 1024 * 1024LL, 4);
+  auto kvstore = std::make_unique<RocksKVStore>("0", cfg, blockCache);
+  EXPECT_TRUE(kvstore->isGroupSync());
+
+  std::vector<std::thread> threads;
+  for (uint32_t i = 0; i < 8; i++) {
+    threads.emplace_back([&kvstore, i]() {
+      for (uint32_t j = 0; j < 100; j++) {
+        auto eTxn = kvstore->createTransaction(nullptr);
+        EXPECT_TRUE(eTxn.ok());
+        auto rtxn = dynamic_cast<RocksTxn*>(eTxn.value().get());
+        EXPECT_FALSE(rtxn->getRocksdbTxn()->GetWriteOptions()->sync);
+        RecordKey rk(0,
+                     0,
+                     RecordType::RT_KV,
+                     std::to_string(i) + "_" + std::to_string(j),
+                     "");
+        RecordValue rv("v", RecordType::RT_KV, -1);
+        EXPECT_TRUE(kvstore->setKV(rk, rv, eTxn.value().get()).ok());
+        EXPECT_TRUE(eTxn.value()->commit().ok());
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  // all the binlogs are visible after their WAL synced
+  EXPECT_EQ(kvstore->getHighestBinlogId() + 1, kvstore->getNextBinlogSeq());
+  testMaxBinlogId(kvstore);
+}
+
+// a microbenchmark of the commit path, the WAL is disabled so that the
+// cost is mostly the txn/binlog id bookkeeping.
+TEST(RocksKVStore, CommitBench) {
+  auto cfg = genParams();
+  cfg->rocksDisableWAL = true;
+  EXPECT_TRUE(filesystem::create_directory("db"));
+  EXPECT_TRUE(filesystem::create_directory("log"));
+  const auto guard = MakeGuard([] {
+    filesystem::remove_all("./log");
+    filesystem::remove_all("./db");
+  });
+  auto blockCache =
+    rocksdb::NewLRUCache(cfg->rocksBlockcacheMB * 1024 * 1024LL, 4);
+  auto kvstore = std::make_unique<RocksKVStore>("0", cfg, blockCache);
+
+  const uint32_t threadNum = 16;
+  const uint32_t txnNum = 10000;
+  uint64_t nextSeq = kvstore->getNextBinlogSeq();
+  auto start = nsSinceEpoch();
+  std::vector<std::thread> threads;
+  for (uint32_t i = 0; i < threadNum; i++) {
+    threads.emplace_back([&kvstore, i]() {
+      for (uint32_t j = 0; j < txnNum; j++) {
+        auto eTxn = kvstore->createTransaction(nullptr);
+        EXPECT_TRUE(eTxn.ok());
+        RecordKey rk(
+          i, 0, RecordType::RT_KV, std::to_string(j % 100), "");
+        RecordValue rv("v", RecordType::RT_KV, -1);
+        EXPECT_TRUE(kvstore->setKV(rk, rv, eTxn.value().get()).ok());
+        // rollback some of them, to leave holes in the binlog ids
+        if (j % 10 == 0) {
+          EXPECT_TRUE(eTxn.value()->rollback().ok());
+        } else {
+          EXPECT_TRUE(eTxn.value()->commit().ok());
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  auto costUs = (nsSinceEpoch() - start) / 1000;
+  LOG(INFO) << "CommitBench threads:" << threadNum << " txns:"
+            << threadNum * txnNum << " cost:" << costUs << "us, "
+            << threadNum * txnNum * 1000000 / (costUs + 1) << " txns/s";
+
+  EXPECT_EQ(kvstore->getAliveTxnCount(), 0);
+  // the rolled back txns don't take binlog ids
+  EXPECT_EQ(kvstore->getNextBinlogSeq() - nextSeq, threadNum * txnNum / 10 * 9);
+  EXPECT_EQ(kvstore->getHighestBinlogId() + 1, kvstore->getNextBinlogSeq());
+}
+
+TEST(RocksKVStore, GetKVs) {
+  auto cfg = genParams();
+  EXPECT_TRUE(filesystem::create_directory("db"));
+  EXPECT_TRUE(filesystem::create_directory("log"));
+  const auto guard = MakeGuard([] {
+    filesystem::remove_all("./log");
+    filesystem::remove_all("./db");
+  });
+  auto blockCache =
+    rocksdb::NewLRUCache(cfg->rocksBlockcacheMB * 1024 * 1024LL, 4);
+  auto kvstore = std::make_unique<RocksKVStore>("0", cfg, blockCache);
+
+  auto eTxn = kvstore->createTransaction(nullptr);
+  EXPECT_TRUE(eTxn.ok());
+  std::unique_ptr<Transaction> txn = std::move(eTxn.value());
+  for (uint32_t i = 0; i < 10; i += 2) {
+    Status s = kvstore->setKV(
+      Record(RecordKey(i, 0, RecordType::RT_KV, std::to_string(i), ""),
+             RecordValue(std::to_string(i), RecordType::RT_KV, -1)),
+      txn.get());
+    EXPECT_TRUE(s.ok());
+  }
+  EXPECT_TRUE(txn->commit().ok());
+
+  eTxn = kvstore->createTransaction(nullptr);
+  EXPECT_TRUE(eTxn.ok());
+  txn = std::move(eTxn.value());
+  // uncommitted writes of the txn itself are visible
+  Status s = kvstore->setKV(
+    Record(RecordKey(1, 0, RecordType::RT_KV, "1", ""),
+           RecordValue("1", RecordType::RT_KV, -1)),
+    txn.get());
+  EXPECT_TRUE(s.ok());
+
+  std::vector<RecordKey> keys;
+  for (uint32_t i = 9; i < 10; --i) {
+    keys.emplace_back(i, 0, RecordType::RT_KV, std::to_string(i), "");
+  }
+  auto values = kvstore->getKVs(keys, txn.get());
+  ASSERT_EQ(values.size(), keys.size());
+  for (size_t j = 0; j < keys.size(); ++j) {
+    uint32_t i = 9 - j;
+    if (i % 2 == 0 || i == 1) {
+      ASSERT_TRUE(values[j].ok()) << i;
+      EXPECT_EQ(values[j].value().getValue(), std::to_string(i));
+    } else {
+      EXPECT_EQ(values[j].status().code(), ErrorCodes::ERR_NOTFOUND) << i;
+    }
+  }
+}
+
+TEST(RocksKVStore, SavePoint) {
+  auto cfg = genParams();
+  EXPECT_TRUE(filesystem::create_directory("db"));
+  EXPECT_TRUE(filesystem::create_directory("log"));
+  const auto guard = MakeGuard([] {
+    filesystem::remove_all("./log");
+    filesystem::remove_all("./db");
+  });
+  auto blockCache =
+    rocksdb::NewLRUCache(cfg->rocksBlockcacheMB * 1024 * 1024LL, 4);
+  auto kvstore = std::make_unique<RocksKVStore>("0", cfg, blockCache);
+
+  auto eTxn = kvstore->createTransaction(nullptr);
+  EXPECT_TRUE(eTxn.ok());
+  std::unique_ptr<Transaction> txn = std::move(eTxn.value());
+  EXPECT_FALSE(txn->rollbackToSavePoint().ok());
+
+  RecordKey rka(0, 0, RecordType::RT_KV, "a", "");
+  RecordKey rkb(1, 0, RecordType::RT_KV, "b", "");
+  Status s = kvstore->setKV(
+    Record(rka, RecordValue("a", RecordType::RT_KV, -1)), txn.get());
+  EXPECT_TRUE(s.ok());
+  txn->setSavePoint();
+  s = kvstore->setKV(
+    Record(rkb, RecordValue("b", RecordType::RT_KV, -1)), txn.get());
+  EXPECT_TRUE(s.ok());
+  s = kvstore->delKV(rka, txn.get());
+  EXPECT_TRUE(s.ok());
+  EXPECT_TRUE(txn->rollbackToSavePoint().ok());
+  // the savepoint is removed
+  EXPECT_FALSE(txn->rollbackToSavePoint().ok());
+  EXPECT_TRUE(kvstore->getKV(rka, txn.get()).ok());
+  EXPECT_EQ(kvstore->getKV(rkb, txn.get()).status().code(),
+            ErrorCodes::ERR_NOTFOUND);
+  auto exptCommitId = txn->commit();
+  EXPECT_TRUE(exptCommitId.ok());
+
+  // the binlog only has the writes before the savepoint
+  eTxn = kvstore->createTransaction(nullptr);
+  EXPECT_TRUE(eTxn.ok());
+  txn = std::move(eTxn.value());
+  EXPECT_TRUE(kvstore->getKV(rka, txn.get()).ok());
+  EXPECT_EQ(kvstore->getKV(rkb, txn.get()).status().code(),
+            ErrorCodes::ERR_NOTFOUND);
+  auto bcursor = txn->createRepllogCursorV2(Transaction::MIN_VALID_TXNID);
+  int32_t cnt = 0;
+  while (true) {
+    auto v = bcursor->nextV2();
+    if (!v.ok()) {
+      EXPECT_EQ(v.status().code(), ErrorCodes::ERR_EXHAUST);
+      break;
+    }
+    const auto& entrys = v.value().getReplLogValueEntrys();
+    ASSERT_EQ(entrys.size(), 1U);
+    EXPECT_EQ(entrys[0].getOpKey(), rka.encode());
+    EXPECT_EQ(v.value().getReplLogValue().getChunkId(), 0U);
+    cnt++;
+  }
+  EXPECT_EQ(cnt, 1);
+}
+
+TEST(RocksKVStore, ExportIngestSst) {
+  auto cfg = genParams();
+  EXPECT_TRUE(filesystem::create_directory("db"));
+  EXPECT_TRUE(filesystem::create_directory("log"));
+  const auto guard = MakeGuard([] {
+    filesystem::remove_all("./log");
+    filesystem::remove_all("./db");
+  });
+  auto blockCache =
+    rocksdb::NewLRUCache(cfg->rocksBlockcacheMB * 1024 * 1024LL, 4);
+  auto src = std::make_unique<RocksKVStore>("0", cfg, blockCache);
+  auto dst = std::make_unique<RocksKVStore>("1", cfg, blockCache);
+  auto genRecord = [](uint32_t chunk, const std::string& key) {
+    return Record(RecordKey(chunk, 0, RecordType::RT_KV, key, ""),
+                  RecordValue(key, RecordType::RT_KV, -1));
+  };
+
+  auto eTxn = src->createTransaction(nullptr);
+  EXPECT_TRUE(eTxn.ok());
+  std::unique_ptr<Transaction> txn = std::move(eTxn.value());
+  for (uint32_t i = 0; i < 10; ++i) {
+    EXPECT_TRUE(src->setKV(genRecord(i, std::to_string(i)), txn.get()).ok());
+  }
+  EXPECT_TRUE(txn->commit().ok());
+
+  eTxn = src->createTransaction(nullptr);
+  EXPECT_TRUE(eTxn.ok());
+  std::unique_ptr<Transaction> snapTxn = std::move(eTxn.value());
+  snapTxn->SetSnapshot();
+  // the write after the snapshot is not exported
+  eTxn = src->createTransaction(nullptr);
+  EXPECT_TRUE(eTxn.ok());
+  txn = std::move(eTxn.value());
+  EXPECT_TRUE(src->setKV(genRecord(3, "late"), txn.get()).ok());
+  EXPECT_TRUE(txn->commit().ok());
+
+  uint64_t keyNum = 0;
+  auto files = src->exportSst(snapTxn.get(),
+                              RecordKey(2, 0, RecordType::RT_KV, "", "")
+                                .prefixChunkid(),
+                              RecordKey(5, 0, RecordType::RT_KV, "", "")
+                                .prefixChunkid(),
+                              "./db/sst",
+                              64 * 1024 * 1024,
+                              &keyNum);
+  ASSERT_TRUE(files.ok());
+  EXPECT_EQ(keyNum, 3U);
+  EXPECT_EQ(files.value().size(), 1U);
+  EXPECT_TRUE(dst->ingestSst(files.value()).ok());
+
+  eTxn = dst->createTransaction(nullptr);
+  EXPECT_TRUE(eTxn.ok());
+  txn = std::move(eTxn.value());
+  for (uint32_t i = 0; i < 10; ++i) {
+    auto rk = genRecord(i, std::to_string(i)).getRecordKey();
+    auto v = dst->getKV(rk, txn.get());
+    if (i >= 2 && i < 5) {
+      EXPECT_TRUE(v.ok()) << i;
+    } else {
+      EXPECT_EQ(v.status().code(), ErrorCodes::ERR_NOTFOUND) << i;
+    }
+  }
+  auto v = dst->getKV(genRecord(3, "late").getRecordKey(), txn.get());
+  EXPECT_EQ(v.status().code(), ErrorCodes::ERR_NOTFOUND);
+  // no binlog is written by ingesting
+  EXPECT_EQ(dst->getBinlogCnt(txn.get()).value(), 0U);
+}
+
+TEST(RocksKVStore, SlotKeyCount) {
+  auto cfg = genParams();
+  EXPECT_TRUE(filesystem::create_directory("db"));
+  EXPECT_TRUE(filesystem::create_directory("log"));
+  const auto guard = MakeGuard([] {
+    filesystem::remove_all("./log");
+    filesystem::remove_all("./db");
+  });
+  auto blockCache =
+    rocksdb::NewLRUCache(cfg->rocksBlockcacheMB * 1024 * 1024LL, 4);
+  auto kvstore = std::make_unique<RocksKVStore>("0", cfg, blockCache);
+  auto keyCount = [&kvstore](uint32_t slot) -> int64_t {
+    auto n = kvstore->getSlotKeyCount(slot);
+    return n.ok() ? static_cast<int64_t>(n.value()) : -1;
+  };
+  auto write = [&kvstore](uint32_t slot,
+                          const std::vector<std::string>& sets,
+                          const std::vector<std::string>& dels,
+                          bool commit) {
+    auto eTxn = kvstore->createTransaction(nullptr);
+    EXPECT_TRUE(eTxn.ok());
+    auto txn = std::move(eTxn.value());
+    for (const auto& k : sets) {
+      RecordKey rk(slot, 0, RecordType::RT_KV, k, "");
+      RecordValue rv("v", RecordType::RT_KV, -1);
+      EXPECT_TRUE(kvstore->setKV(rk, rv, txn.get()).ok());
+      // the elements are not counted
+      RecordKey ek(slot, 0, RecordType::RT_HASH_ELE, k, "f");
+      RecordValue ev("v", RecordType::RT_HASH_ELE, -1);
+      EXPECT_TRUE(kvstore->setKV(ek, ev, txn.get()).ok());
+    }
+    for (const auto& k : dels) {
+      RecordKey rk(slot, 0, RecordType::RT_KV, k, "");
+      EXPECT_TRUE(kvstore->delKV(rk, txn.get()).ok());
+    }
+    if (commit) {
+      EXPECT_TRUE(txn->commit().ok());
+    } else {
+      EXPECT_TRUE(txn->rollback().ok());
+    }
+  };
+  EXPECT_EQ(keyCount(1), 0);
+
+  write(1, {"a", "b", "a"}, {}, true);
+  EXPECT_EQ(keyCount(1), 2);
+  write(1, {"c"}, {"b", "x"}, true);
+  EXPECT_EQ(keyCount(1), 2);
+  write(1, {"d"}, {"a"}, false);
+  EXPECT_EQ(keyCount(1), 2);
+  EXPECT_EQ(kvstore->recountSlotKeys(1).value(), 2U);
+  EXPECT_EQ(keyCount(2), 0);
+
+  // the writes during a recount are added to it
+  std::vector<std::thread> threads;
+  for (uint32_t i = 0; i < 4; i++) {
+    threads.emplace_back([&write, i]() {
+      for (uint32_t j = 0; j < 100; j++) {
+        write(2, {std::to_string(i) + "_" + std::to_string(j)}, {}, true);
+      }
+    });
+  }
+  for (uint32_t i = 0; i < 10; i++) {
+    EXPECT_TRUE(kvstore->recountSlotKeys(2).ok());
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  EXPECT_TRUE(keyCount(2) == 400 || keyCount(2) == -1);
+  EXPECT_EQ(kvstore->recountSlotKeys(2).value(), 400U);
+  EXPECT_EQ(keyCount(2), 400);
+
+  // the numbers are kept by a clean restart
+  EXPECT_TRUE(kvstore->stop().ok());
+  EXPECT_TRUE(kvstore->restart(false).ok());
+  EXPECT_EQ(keyCount(1), 2);
+  EXPECT_EQ(keyCount(2), 400);
+  EXPECT_GT(kvstore->getSlotApproximateSize(2).value(), 0U);
+
+  // the slot covered by the range is emptied, the others are unknown
+  auto prefix = [](uint32_t slot) {
+    return RecordKey(slot, 0, RecordType::RT_INVALID, "", "").prefixChunkid();
+  };
+  auto mid = RecordKey(2, 0, RecordType::RT_KV, "2", "").prefixSlotType();
+  EXPECT_TRUE(kvstore->deleteRange(prefix(1), mid).ok());
+  EXPECT_EQ(keyCount(1), 0);
+  EXPECT_EQ(keyCount(2), -1);
+  EXPECT_EQ(kvstore->recountSlotKeys(2).value(), 400U);
+  kvstore->invalidateSlotKeys(1, 3);
+  EXPECT_EQ(keyCount(1), -1);
+  EXPECT_EQ(keyCount(2), -1);
+  EXPECT_EQ(kvstore->recountSlotKeys(1).value(), 0U);
+
+  // the numbers are unknown after an unclean stop
+  EXPECT_TRUE(kvstore->stop().ok());
+  filesystem::remove("./db/0/SLOTKEYS");
+  EXPECT_TRUE(kvstore->restart(false).ok());
+  EXPECT_EQ(keyCount(1), -1);
+  EXPECT_EQ(kvstore->recountSlotKeys(2).value(), 400U);
+  EXPECT_EQ(keyCount(2), 400);
+}
+
+TEST(RocksKVStore, DeleteSlotsByCompaction) {
+  auto cfg = genParams();
+  EXPECT_TRUE(filesystem::create_directory("db"));
+  EXPECT_TRUE(filesystem::create_directory("log"));
+  const auto guard = MakeGuard([] {
+    filesystem::remove_all("./log");
+    filesystem::remove_all("./db");
+  });
+  auto blockCache =
+    rocksdb::NewLRUCache(cfg->rocksBlockcacheMB * 1024 * 1024LL, 4);
+  auto kvstore = std::make_unique<RocksKVStore>("0", cfg, blockCache);
+  auto write = [&kvstore](uint32_t slot, uint32_t num) {
+    auto eTxn = kvstore->createTransaction(nullptr);
+    EXPECT_TRUE(eTxn.ok());
+    for (uint32_t i = 0; i < num; i++) {
+      RecordKey rk(slot, 0, RecordType::RT_KV, std::to_string(i), "");
+      RecordValue rv("v", RecordType::RT_KV, -1);
+      EXPECT_TRUE(kvstore->setKV(rk, rv, eTxn.value().get()).ok());
+    }
+    EXPECT_TRUE(eTxn.value()->commit().ok());
+  };
+  auto exists = [&kvstore](uint32_t slot, uint32_t i) {
+    auto eTxn = kvstore->createTransaction(nullptr);
+    EXPECT_TRUE(eTxn.ok());
+    RecordKey rk(slot, 0, RecordType::RT_KV, std::to_string(i), "");
+    return kvstore->getKV(rk, eTxn.value().get()).ok();
+  };
+
+  // some records are in the sst files, some in the memtable
+  for (uint32_t slot = 1; slot <= 4; slot++) {
+    write(slot, 100);
+  }
+  EXPECT_TRUE(kvstore->fullCompact().ok());
+  for (uint32_t slot = 1; slot <= 4; slot++) {
+    write(slot, 200);
+  }
+
+  EXPECT_FALSE(kvstore->deleteSlotsByCompaction(3, 3).ok());
+  EXPECT_TRUE(kvstore->deleteSlotsByCompaction(2, 4).ok());
+  EXPECT_GT(kvstore->stat.compactGarbageDroppedCount.load(), 0U);
+  for (uint32_t i = 0; i < 200; i++) {
+    EXPECT_TRUE(exists(1, i));
+    EXPECT_FALSE(exists(2, i));
+    EXPECT_FALSE(exists(3, i));
+    EXPECT_TRUE(exists(4, i));
+  }
+  EXPECT_EQ(kvstore->getSlotKeyCount(2).value(), 0U);
+  EXPECT_EQ(kvstore->getSlotKeyCount(3).value(), 0U);
+  EXPECT_EQ(kvstore->getSlotKeyCount(4).value(), 200U);
+
+  // the slots are not garbage any more
+  write(2, 10);
+  EXPECT_TRUE(kvstore->fullCompact().ok());
+  EXPECT_TRUE(exists(2, 9));
+  EXPECT_EQ(kvstore->recountSlotKeys(2).value(), 10U);
+
+  // the records a snapshot still sees are not dropped by the compaction
+  // filter, they must be gone anyway
+  write(5, 100);
+  EXPECT_TRUE(kvstore->fullCompact().ok());
+  write(5, 200);
+  auto db = kvstore->getBaseDB();
+  auto snapshot = db->GetSnapshot();
+  EXPECT_TRUE(kvstore->deleteSlotsByCompaction(5, 6).ok());
+  for (uint32_t i = 0; i < 200; i++) {
+    EXPECT_FALSE(exists(5, i));
+  }
+  EXPECT_EQ(kvstore->recountSlotKeys(5).value(), 0U);
+  db->ReleaseSnapshot(snapshot);
+}
+
+TEST(RocksKVStore, SubKeyVersionChecker) {
+  auto cfg = genParams();
+  EXPECT_TRUE(filesystem::create_directory("db"));
+  EXPECT_TRUE(filesystem::create_directory("log"));
+  const auto guard = MakeGuard([] {
+    filesystem::remove_all("./log");
+    filesystem::remove_all("./db");
+  });
+  auto blockCache =
+    rocksdb::NewLRUCache(cfg->rocksBlockcacheMB * 1024 * 1024LL, 4);
+  auto kvstore = std::make_unique<RocksKVStore>("0", cfg, blockCache);
+  auto eTxn = kvstore->createTransaction(nullptr);
+  EXPECT_TRUE(eTxn.ok());
+  auto txn = eTxn.value().get();
+
+  RecordKey mk(0, 0, RecordType::RT_DATA_META, "h", "");
+  RecordValue mv(HashMetaValue().encode(), RecordType::RT_HASH_META, -1);
+  mv.setVersion(5);
+  EXPECT_TRUE(kvstore->setKV(mk, mv, txn).ok());
+  EXPECT_TRUE(txn->commit().ok());
+
+  eTxn = kvstore->createTransaction(nullptr);
+  EXPECT_TRUE(eTxn.ok());
+  SubKeyVersionChecker checker(eTxn.value().get());
+  EXPECT_FALSE(checker.isStale(mk).value());
+  EXPECT_FALSE(
+    checker.isStale(RecordKey(0, 0, RecordType::RT_HASH_ELE, "h", "f", 5))
+      .value());
+  EXPECT_TRUE(
+    checker.isStale(RecordKey(0, 0, RecordType::RT_HASH_ELE, "h", "f", 4))
+      .value());
+  // the meta is gone
+  EXPECT_TRUE(
+    checker.isStale(RecordKey(0, 0, RecordType::RT_SET_ELE, "s", "m", 0))
+      .value());
+  // the records not versioned
+  EXPECT_FALSE(
+    checker.isStale(RecordKey(0, 0, RecordType::RT_LIST_ELE, "l", "0", 0))
+      .value());
+}
+
 void commonRoutine(RocksKVStore* kvstore) {
   auto eTxn1 = kvstore->createTransaction(nullptr);
   auto eTxn2 = kvstore->createTransaction(nullptr);
@@ -895,11 +1383,7 @@ void commonRoutine(RocksKVStore* kvstore) {
   std::unique_ptr<Transaction> txn1 = std::move(eTxn1.value());
   std::unique_ptr<Transaction> txn2 = std::move(eTxn2.value());
 
-  std::set<uint64_t> uncommitted = kvstore->getUncommittedTxns();
-  EXPECT_NE(uncommitted.find(dynamic_cast<RocksTxn*>(txn1.get())->getTxnId()),
-            uncommitted.end());
-  EXPECT_NE(uncommitted.find(dynamic_cast<RocksTxn*>(txn2.get())->getTxnId()),
-            uncommitted.end());
+  EXPECT_EQ(kvstore->getAliveTxnCount(), 2);
 
   Status s = kvstore->setKV(Record(RecordKey(0, 0, RecordType::RT_KV, "a", ""),
                                    RecordValue("txn1", RecordType::RT_KV, -1)),
@@ -922,23 +1406,15 @@ void commonRoutine(RocksKVStore* kvstore) {
     EXPECT_EQ(exptCommitId.ok(), true);
     exptCommitId = txn1->commit();
     EXPECT_EQ(exptCommitId.status().code(), ErrorCodes::ERR_COMMIT_RETRY);
-    uncommitted = kvstore->getUncommittedTxns();
-    EXPECT_EQ(uncommitted.find(dynamic_cast<RocksTxn*>(txn1.get())->getTxnId()),
-              uncommitted.end());
-    EXPECT_EQ(uncommitted.find(dynamic_cast<RocksTxn*>(txn2.get())->getTxnId()),
-              uncommitted.end());
+    EXPECT_EQ(kvstore->getAliveTxnCount(), 0);
   } else {
     EXPECT_EQ(s.code(), ErrorCodes::ERR_INTERNAL);
     s = txn2->rollback();
     EXPECT_EQ(s.code(), ErrorCodes::ERR_OK);
     Expected<uint64_t> exptCommitId = txn1->commit();
     EXPECT_EQ(exptCommitId.ok(), true);
-    uncommitted = kvstore->getUncommittedTxns();
     // TODO(qingping209): check txn1.get() is nullptr
-    EXPECT_EQ(uncommitted.find(dynamic_cast<RocksTxn*>(txn1.get())->getTxnId()),
-              uncommitted.end());
-    EXPECT_EQ(uncommitted.find(dynamic_cast<RocksTxn*>(txn2.get())->getTxnId()),
-              uncommitted.end());
+    EXPECT_EQ(kvstore->getAliveTxnCount(), 0);
   }
 }
 
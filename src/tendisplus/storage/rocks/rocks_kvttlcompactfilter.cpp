@@ -16,18 +16,27 @@
 namespace tendisplus {
 class KVTtlCompactionFilter : public CompactionFilter {
  public:
-  explicit KVTtlCompactionFilter(KVStore* store, uint64_t current_time)
-    : _store(store), _currentTime(current_time) {}
+  KVTtlCompactionFilter(RocksKVStore* store,
+                        bool filterExpired,
+                        uint64_t current_time)
+    : _store(store),
+      _filterExpired(filterExpired),
+      _currentTime(current_time) {}
 
   ~KVTtlCompactionFilter() override {
     TEST_SYNC_POINT_CALLBACK("InspectKvTtlExpiredCount", &_expiredCount);
     TEST_SYNC_POINT_CALLBACK("InspectKvTtlFilterCount", &_filterCount);
+    TEST_SYNC_POINT_CALLBACK("InspectSubKeyDroppedCount", &_subKeyDropped);
 
     // do something statistics here
     _store->stat.compactFilterCount.fetch_add(_filterCount,
                                               std::memory_order_relaxed);
     _store->stat.compactKvExpiredCount.fetch_add(_expiredCount,
                                                  std::memory_order_relaxed);
+    _store->stat.compactSubKeyDroppedCount.fetch_add(
+      _subKeyDropped, std::memory_order_relaxed);
+    _store->stat.compactGarbageDroppedCount.fetch_add(
+      _garbageDropped, std::memory_order_relaxed);
   }
 
   const char* Name() const override {
@@ -43,8 +52,15 @@ class KVTtlCompactionFilter : public CompactionFilter {
     RecordType vt;
     uint64_t ttl;
     _filterCount++;
+    if (_store->isGarbageKey(key)) {
+      _garbageDropped++;
+      return true;
+    }
     switch (type) {
       case RecordType::RT_DATA_META:
+        if (!_filterExpired) {
+          break;
+        }
         vt =
           RecordValue::decodeType(existing_value.data(), existing_value.size());
         if (vt == RecordType::RT_KV) {
@@ -54,11 +70,22 @@ class KVTtlCompactionFilter : public CompactionFilter {
             // Expired
             _expiredCount++;
             _expiredSize += key.size() + existing_value.size();
+            uncountExpiredKey(key, existing_value);
 
             return true;
           }
         }
         break;
+      case RecordType::RT_HASH_ELE:
+      case RecordType::RT_SET_ELE:
+      case RecordType::RT_ZSET_S_ELE:
+      case RecordType::RT_ZSET_H_ELE:
+      case RecordType::RT_KV_PIECE:
+        if (isStaleSubKey(key)) {
+          _subKeyDropped++;
+          return true;
+        }
+        break;
       case RecordType::RT_INVALID:
         // TODO(vinchen): make sure
         INVARIANT_D(0);
@@ -70,7 +97,80 @@ class KVTtlCompactionFilter : public CompactionFilter {
   }
 
  private:
-  KVStore* _store;
+  // the key is gone if the latest version of it is dropped.
+  // NOTE: the same value written twice, or a write racing with the
+  // compaction, may make the key number off by one, the number turns
+  // unknown and gets recounted if it goes negative.
+  void uncountExpiredKey(const rocksdb::Slice& key,
+                         const rocksdb::Slice& value) const {
+    std::string k = key.ToString();
+    if (!_store->isSlotKeyCounted(k)) {
+      return;
+    }
+    auto latest = _store->getDataKVNoTxn(k);
+    if (latest.ok() && latest.value() == value.ToString()) {
+      _store->addSlotKeys(RecordKey::decodeChunkId(k), -1, false);
+    }
+  }
+
+  static RecordType metaTypeOf(RecordType eleType) {
+    switch (eleType) {
+      case RecordType::RT_HASH_ELE:
+        return RecordType::RT_HASH_META;
+      case RecordType::RT_SET_ELE:
+        return RecordType::RT_SET_META;
+      case RecordType::RT_ZSET_S_ELE:
+      case RecordType::RT_ZSET_H_ELE:
+        return RecordType::RT_ZSET_META;
+      case RecordType::RT_KV_PIECE:
+        return RecordType::RT_KV;
+      default:
+        INVARIANT_D(0);
+        return RecordType::RT_INVALID;
+    }
+  }
+
+  // A subkey is stale if its key is deleted or recreated, that is, the
+  // meta doesn't exist, or its type or version is different from the
+  // subkey. The subkeys of one key are adjacent, so the last meta looked
+  // up is cached. If the meta can't be read, the subkey is kept.
+  bool isStaleSubKey(const rocksdb::Slice& key) const {
+    auto expRk = RecordKey::decode(key.ToString());
+    if (!expRk.ok()) {
+      return false;
+    }
+    const RecordKey& rk = expRk.value();
+    RecordKey mk(rk.getChunkId(),
+                 rk.getDbId(),
+                 RecordType::RT_DATA_META,
+                 rk.getPrimaryKey(),
+                 "");
+    std::string mkEnc = mk.encode();
+    if (!_lastMetaValid || mkEnc != _lastMetaKey) {
+      _lastMetaValid = false;
+      auto expMeta = _store->getDataKVNoTxn(mkEnc);
+      if (expMeta.ok()) {
+        auto expRv = RecordValue::decode(expMeta.value());
+        if (!expRv.ok()) {
+          return false;
+        }
+        _lastMetaExist = true;
+        _lastMetaType = expRv.value().getRecordType();
+        _lastMetaVersion = expRv.value().getVersion();
+      } else if (expMeta.status().code() == ErrorCodes::ERR_NOTFOUND) {
+        _lastMetaExist = false;
+      } else {
+        return false;
+      }
+      _lastMetaKey = std::move(mkEnc);
+      _lastMetaValid = true;
+    }
+    return !_lastMetaExist || _lastMetaType != metaTypeOf(rk.getRecordType()) ||
+      _lastMetaVersion != rk.getVersion();
+  }
+
+  RocksKVStore* _store;
+  const bool _filterExpired;
   // millisecond, same as ttl in the record
   const uint64_t _currentTime;
   // It is safe to not using std::atomic since the compaction filter,
@@ -79,6 +179,14 @@ class KVTtlCompactionFilter : public CompactionFilter {
   mutable uint64_t _expiredCount = 0;
   mutable uint64_t _expiredSize = 0;
   mutable uint64_t _filterCount = 0;
+  mutable uint64_t _subKeyDropped = 0;
+  mutable uint64_t _garbageDropped = 0;
+  // the meta looked up last time
+  mutable bool _lastMetaValid = false;
+  mutable std::string _lastMetaKey;
+  mutable bool _lastMetaExist = false;
+  mutable RecordType _lastMetaType = RecordType::RT_INVALID;
+  mutable uint64_t _lastMetaVersion = 0;
 };
 
 std::unique_ptr<CompactionFilter>
@@ -96,7 +204,7 @@ KVTtlCompactionFilterFactory::CreateCompactionFilter(
   }
 
   return std::unique_ptr<CompactionFilter>(
-    new KVTtlCompactionFilter(_store, currentTs));
+    new KVTtlCompactionFilter(_store, _filterExpired, currentTs));
 }
 
 }  // namespace tendisplus
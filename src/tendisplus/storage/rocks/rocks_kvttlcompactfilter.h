@@ -21,7 +21,8 @@ struct KVTTLCompactionContext {
 
 class KVTtlCompactionFilterFactory : public CompactionFilterFactory {
  public:
-  explicit KVTtlCompactionFilterFactory(KVStore* store) : _store(store) {}
+  KVTtlCompactionFilterFactory(RocksKVStore* store, bool filterExpired)
+    : _store(store), _filterExpired(filterExpired) {}
 
   const char* Name() const override {
     return "KVTTLCompactionFilterFactory";
@@ -31,7 +32,9 @@ class KVTtlCompactionFilterFactory : public CompactionFilterFactory {
     const CompactionFilter::Context& /*context*/) override;
 
  private:
-  KVStore* _store;
+  RocksKVStore* _store;
+  // whether to drop the expired kvs
+  bool _filterExpired;
 };
 
 }  // namespace tendisplus
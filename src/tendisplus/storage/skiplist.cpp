@@ -7,6 +7,8 @@
 #include <map>
 #include <utility>
 #include "tendisplus/storage/skiplist.h"
+#include "tendisplus/storage/zindex.h"
+#include "tendisplus/storage/zinline.h"
 #include "tendisplus/utils/invariant.h"
 #include "tendisplus/server/session.h"
 
@@ -65,7 +67,8 @@ SkipList::SkipList(uint32_t chunkId,
                    uint32_t dbId,
                    const std::string& pk,
                    const ZSlMetaValue& meta,
-                   PStore store)
+                   PStore store,
+                   uint64_t version)
   : nGetFromCache(0),
     nGetFromStore(0),
     nInserted(0),
@@ -79,8 +82,30 @@ SkipList::SkipList(uint32_t chunkId,
     _chunkId(chunkId),
     _dbId(dbId),
     _pk(pk),
+    _version(version),
     _store(store) {}
 
+Expected<double> SkipList::getScore(const std::string& subkey,
+                                    Transaction* txn) {
+  RecordKey hk(
+    _chunkId, _dbId, RecordType::RT_ZSET_H_ELE, _pk, subkey, _version);
+  return getHashScore(_store, hk, txn);
+}
+
+Status SkipList::setScore(const std::string& subkey,
+                          double score,
+                          Transaction* txn) {
+  RecordKey hk(
+    _chunkId, _dbId, RecordType::RT_ZSET_H_ELE, _pk, subkey, _version);
+  return setHashScore(_store, hk, score, txn);
+}
+
+Status SkipList::delScore(const std::string& subkey, Transaction* txn) {
+  RecordKey hk(
+    _chunkId, _dbId, RecordType::RT_ZSET_H_ELE, _pk, subkey, _version);
+  return _store->delKV(hk, txn);
+}
+
 uint8_t SkipList::randomLevel() {
   static thread_local std::mt19937 generator(
     std::chrono::system_clock::now().time_since_epoch().count());
@@ -151,7 +176,8 @@ Expected<ZSlEleValue*> SkipList::getNode(uint64_t pointer, Transaction* txn) {
     return it->second.get();
   }
   std::string pointerStr = std::to_string(pointer);
-  RecordKey rk(_chunkId, _dbId, RecordType::RT_ZSET_S_ELE, _pk, pointerStr);
+  RecordKey rk(
+    _chunkId, _dbId, RecordType::RT_ZSET_S_ELE, _pk, pointerStr, _version);
   Expected<RecordValue> rv = _store->getKV(rk, txn);
   if (!rv.ok()) {
     return rv.status();
@@ -172,16 +198,24 @@ Status SkipList::delNode(uint64_t pointer, Transaction* txn) {
   // TODO(vinchen)
   cache.erase(pointer);
   ++nDeleted;
-  RecordKey rk(
-    _chunkId, _dbId, RecordType::RT_ZSET_S_ELE, _pk, std::to_string(pointer));
+  RecordKey rk(_chunkId,
+               _dbId,
+               RecordType::RT_ZSET_S_ELE,
+               _pk,
+               std::to_string(pointer),
+               _version);
   return _store->delKV(rk, txn);
 }
 
 Status SkipList::saveNode(uint64_t pointer,
                           const ZSlEleValue& val,
                           Transaction* txn) {
-  RecordKey rk(
-    _chunkId, _dbId, RecordType::RT_ZSET_S_ELE, _pk, std::to_string(pointer));
+  RecordKey rk(_chunkId,
+               _dbId,
+               RecordType::RT_ZSET_S_ELE,
+               _pk,
+               std::to_string(pointer),
+               _version);
   RecordValue rv(val.encode(), RecordType::RT_ZSET_S_ELE, -1);
 
   // NOTE(vinchen): after saveNode, reset the change flag in ZSLEleValue
@@ -210,9 +244,21 @@ Status SkipList::save(Transaction* txn,
   uint64_t ttl = oldValue.ok() ? oldValue.value().getTtl() : 0;
   RecordValue rv(
     mv.encode(), RecordType::RT_ZSET_META, versionEP, ttl, oldValue);
+  rv.setVersion(_version);
   return _store->setKV(rk, rv, txn);
 }
 
+Status SkipList::drop(Transaction* txn) {
+  INVARIANT_D(_count == 1);
+  RecordKey head(_chunkId,
+                 _dbId,
+                 RecordType::RT_ZSET_S_ELE,
+                 _pk,
+                 std::to_string(ZSlMetaValue::HEAD_ID),
+                 _version);
+  return _store->delKV(head, txn);
+}
+
 Status SkipList::removeInternal(uint64_t pos,
                                 const std::vector<uint64_t>& update,
                                 Transaction* txn) {
@@ -716,6 +762,67 @@ Expected<uint64_t> SkipList::lastInLexRange(const Zlexrangespec& range,
   return pos;
 }
 
+Expected<uint32_t> SkipList::countInRange(const Zrangespec& range,
+                                          Transaction* txn) {
+  auto f = firstInRange(range, txn);
+  if (!f.ok()) {
+    return f.status();
+  }
+  if (f.value() == SKIPLIST_INVALID_POS) {
+    return 0;
+  }
+  auto first = getCacheNode(f.value());
+  Expected<uint32_t> rk = rank(first->getScore(), first->getSubKey(), txn);
+  if (!rk.ok()) {
+    return rk.status();
+  }
+  // getCount()-1 : total skiplist nodes exclude head
+  uint32_t count = (getCount() - 1 - (rk.value() - 1));
+  auto l = lastInRange(range, txn);
+  if (!l.ok()) {
+    return l.status();
+  }
+  if (l.value() == SKIPLIST_INVALID_POS) {
+    return count;
+  }
+  auto last = getCacheNode(l.value());
+  rk = rank(last->getScore(), last->getSubKey(), txn);
+  if (!rk.ok()) {
+    return rk.status();
+  }
+  return count - (getCount() - 1 - rk.value());
+}
+
+Expected<uint32_t> SkipList::countInLexRange(const Zlexrangespec& range,
+                                             Transaction* txn) {
+  auto f = firstInLexRange(range, txn);
+  if (!f.ok()) {
+    return f.status();
+  }
+  if (f.value() == SKIPLIST_INVALID_POS) {
+    return 0;
+  }
+  auto first = getCacheNode(f.value());
+  Expected<uint32_t> rk = rank(first->getScore(), first->getSubKey(), txn);
+  if (!rk.ok()) {
+    return rk.status();
+  }
+  uint32_t count = (getCount() - 1 - (rk.value() - 1));
+  auto l = lastInLexRange(range, txn);
+  if (!l.ok()) {
+    return l.status();
+  }
+  if (l.value() == SKIPLIST_INVALID_POS) {
+    return count;
+  }
+  auto last = getCacheNode(l.value());
+  rk = rank(last->getScore(), last->getSubKey(), txn);
+  if (!rk.ok()) {
+    return rk.status();
+  }
+  return count - (getCount() - 1 - rk.value());
+}
+
 Expected<std::list<std::pair<double, std::string>>> SkipList::scanByScore(
   const Zrangespec& range,
   uint64_t offset,
@@ -1075,4 +1182,182 @@ uint64_t SkipList::getAlloc() const {
 uint64_t SkipList::getTail() const {
   return _tail;
 }
+
+Expected<double> getHashScore(PStore store,
+                              const RecordKey& hk,
+                              Transaction* txn) {
+  auto eValue = store->getKV(hk, txn);
+  if (!eValue.ok()) {
+    return eValue.status();
+  }
+  return ::tendisplus::doubleDecode(eValue.value().getValue());
+}
+
+Status setHashScore(PStore store,
+                    const RecordKey& hk,
+                    double score,
+                    Transaction* txn) {
+  RecordValue hv(score, RecordType::RT_ZSET_H_ELE);
+  return store->setKV(hk, hv, txn);
+}
+
+Expected<PZSetEngine> openZSet(uint32_t chunkId,
+                               uint32_t dbId,
+                               const std::string& pk,
+                               const RecordValue& mv,
+                               PStore store) {
+  auto eMeta = ZSlMetaValue::decode(mv.getValue());
+  if (!eMeta.ok()) {
+    return eMeta.status();
+  }
+  PZSetEngine zset;
+  if (eMeta.value().getEngine() == ZSlMetaValue::ENGINE_INDEX) {
+    zset = std::make_unique<ZIndex>(
+      chunkId, dbId, pk, eMeta.value(), store, mv.getVersion());
+  } else if (eMeta.value().getEngine() == ZSlMetaValue::ENGINE_INLINE) {
+    zset = std::make_unique<ZInline>(
+      chunkId, dbId, pk, eMeta.value(), store, mv.getVersion());
+  } else {
+    zset = std::make_unique<SkipList>(
+      chunkId, dbId, pk, eMeta.value(), store, mv.getVersion());
+  }
+  return std::move(zset);
+}
+
+Expected<PZSetEngine> createZSet(uint32_t chunkId,
+                                 uint32_t dbId,
+                                 const std::string& pk,
+                                 uint8_t engine,
+                                 uint64_t version,
+                                 PStore store,
+                                 Transaction* txn) {
+  // head node also included into the count
+  ZSlMetaValue meta(1 /*lvl*/, 1 /*count*/, 0 /*tail*/);
+  if (engine == ZSlMetaValue::ENGINE_INDEX) {
+    meta.setEngine(engine);
+    auto zi =
+      std::make_unique<ZIndex>(chunkId, dbId, pk, meta, store, version);
+    Status s = zi->init(txn);
+    if (!s.ok()) {
+      return s;
+    }
+    return PZSetEngine(std::move(zi));
+  } else if (engine == ZSlMetaValue::ENGINE_INLINE) {
+    meta.setEngine(engine);
+    return PZSetEngine(
+      std::make_unique<ZInline>(chunkId, dbId, pk, meta, store, version));
+  }
+
+  RecordKey head(chunkId,
+                 dbId,
+                 RecordType::RT_ZSET_S_ELE,
+                 pk,
+                 std::to_string(ZSlMetaValue::HEAD_ID),
+                 version);
+  ZSlEleValue headVal;
+  RecordValue subRv(headVal.encode(), RecordType::RT_ZSET_S_ELE, -1);
+  Status s = store->setKV(head, subRv, txn);
+  if (!s.ok()) {
+    return s;
+  }
+  return PZSetEngine(
+    std::make_unique<SkipList>(chunkId, dbId, pk, meta, store, version));
+}
+
+Expected<PZSetEngine> convertZSet(uint32_t chunkId,
+                                  uint32_t dbId,
+                                  const std::string& pk,
+                                  const RecordValue& mv,
+                                  uint8_t engine,
+                                  PStore store,
+                                  Transaction* txn) {
+  auto eOld = openZSet(chunkId, dbId, pk, mv, store);
+  if (!eOld.ok()) {
+    return eOld.status();
+  }
+  return convertZSet(chunkId,
+                     dbId,
+                     pk,
+                     std::move(eOld.value()),
+                     engine,
+                     mv.getVersion(),
+                     store,
+                     txn);
+}
+
+Expected<PZSetEngine> convertZSet(uint32_t chunkId,
+                                  uint32_t dbId,
+                                  const std::string& pk,
+                                  PZSetEngine&& zset,
+                                  uint8_t engine,
+                                  uint64_t version,
+                                  PStore store,
+                                  Transaction* txn) {
+  uint8_t oldEngine = zset->getEngine();
+  if (oldEngine == engine) {
+    return std::move(zset);
+  }
+  uint32_t count = zset->getCount() - 1;
+  std::list<std::pair<double, std::string>> eles;
+  if (count > 0) {
+    auto eList = zset->scanByRank(0, count, false, txn);
+    if (!eList.ok()) {
+      return eList.status();
+    }
+    eles = std::move(eList.value());
+  }
+
+  // an inline zset has no member->score record
+  if (engine == ZSlMetaValue::ENGINE_INLINE) {
+    for (const auto& v : eles) {
+      Status s = zset->delScore(v.second, txn);
+      if (!s.ok()) {
+        return s;
+      }
+    }
+  }
+
+  // the skiplist and ZIndex only write RT_ZSET_S_ELE records, drop them
+  if (oldEngine != ZSlMetaValue::ENGINE_INLINE) {
+    RecordKey fakeRk(
+      chunkId, dbId, RecordType::RT_ZSET_S_ELE, pk, "", version);
+    std::string prefix = fakeRk.prefixPk();
+    auto cursor = txn->createDataCursor();
+    cursor->seek(prefix);
+    while (true) {
+      auto expRcd = cursor->next();
+      if (expRcd.status().code() == ErrorCodes::ERR_EXHAUST) {
+        break;
+      } else if (!expRcd.ok()) {
+        return expRcd.status();
+      }
+      const RecordKey& rk = expRcd.value().getRecordKey();
+      if (rk.prefixPk() != prefix) {
+        break;
+      }
+      Status s = store->delKV(rk, txn);
+      if (!s.ok()) {
+        return s;
+      }
+    }
+  }
+
+  auto eNew = createZSet(chunkId, dbId, pk, engine, version, store, txn);
+  if (!eNew.ok()) {
+    return eNew.status();
+  }
+  for (const auto& v : eles) {
+    Status s = eNew.value()->insert(v.first, v.second, txn);
+    if (!s.ok()) {
+      return s;
+    }
+    if (oldEngine == ZSlMetaValue::ENGINE_INLINE) {
+      s = eNew.value()->setScore(v.second, v.first, txn);
+      if (!s.ok()) {
+        return s;
+      }
+    }
+  }
+  return std::move(eNew.value());
+}
 }  // namespace tendisplus
@@ -22,7 +22,125 @@ namespace tendisplus {
 using Zrangespec = redis_port::Zrangespec;
 using Zlexrangespec = redis_port::Zlexrangespec;
 const uint64_t SKIPLIST_INVALID_POS = (uint64_t)-1;
-class SkipList {
+
+int compareStringObjectsForLexRange(const std::string& a,
+                                    const std::string& b);
+bool zslValueGteMin(double value, const Zrangespec& spec);
+bool zslValueLteMax(double value, const Zrangespec& spec);
+bool zslLexValueGteMin(const std::string& value, const Zlexrangespec& spec);
+bool zslLexValueLteMax(const std::string& value, const Zlexrangespec& spec);
+
+// the score order of the elements of a zset. The member->score records
+// (RT_ZSET_H_ELE) are maintained by the callers with setScore() and
+// delScore().
+// NOTE: getCount() includes the head node of a skiplist, so it's 1 for
+// an empty zset, whatever the engine is.
+class ZSetEngine {
+ public:
+  virtual ~ZSetEngine() = default;
+  // see ZSlMetaValue::getEngine()
+  virtual uint8_t getEngine() const = 0;
+  // the score of the member, ERR_NOTFOUND if it's not in the zset
+  virtual Expected<double> getScore(const std::string& subkey,
+                                    Transaction* txn) = 0;
+  virtual Status setScore(const std::string& subkey,
+                          double score,
+                          Transaction* txn) = 0;
+  virtual Status delScore(const std::string& subkey, Transaction* txn) = 0;
+  virtual Status insert(double score,
+                        const std::string& subkey,
+                        Transaction* txn) = 0;
+  virtual Status remove(double score,
+                        const std::string& subkey,
+                        Transaction* txn) = 0;
+  // 1-based rank
+  virtual Expected<uint32_t> rank(double score,
+                                  const std::string& subkey,
+                                  Transaction* txn) = 0;
+  virtual Expected<uint32_t> countInRange(const Zrangespec& range,
+                                          Transaction* txn) = 0;
+  virtual Expected<uint32_t> countInLexRange(const Zlexrangespec& range,
+                                             Transaction* txn) = 0;
+  virtual Expected<std::list<std::pair<double, std::string>>> scanByLex(
+    const Zlexrangespec& range,
+    uint64_t offset,
+    uint64_t limit,
+    bool rev,
+    Transaction* txn) = 0;
+  virtual Expected<std::list<std::pair<double, std::string>>> scanByRank(
+    int64_t start, int64_t len, bool rev, Transaction* txn) = 0;
+  virtual Expected<std::list<std::pair<double, std::string>>> scanByScore(
+    const Zrangespec& range,
+    uint64_t offset,
+    uint64_t limit,
+    bool rev,
+    Transaction* txn) = 0;
+  virtual Expected<std::list<std::pair<double, std::string>>>
+  removeRangeByScore(const Zrangespec& range, Transaction* txn) = 0;
+  virtual Expected<std::list<std::pair<double, std::string>>>
+  removeRangeByLex(const Zlexrangespec& range, Transaction* txn) = 0;
+  // 1-based index
+  virtual Expected<std::list<std::pair<double, std::string>>>
+  removeRangeByRank(uint32_t start, uint32_t end, Transaction* txn) = 0;
+  // save the changes and the meta
+  virtual Status save(Transaction* txn,
+                      const Expected<RecordValue>& oldValue,
+                      uint64_t versionEP) = 0;
+  // delete the records left by an empty zset, the meta is deleted by
+  // the caller
+  virtual Status drop(Transaction* txn) = 0;
+  virtual uint32_t getCount() const = 0;
+};
+
+using PZSetEngine = std::unique_ptr<ZSetEngine>;
+
+// open the zset of the meta mv, with the engine saved in mv
+Expected<PZSetEngine> openZSet(uint32_t chunkId,
+                               uint32_t dbId,
+                               const std::string& pk,
+                               const RecordValue& mv,
+                               PStore store);
+
+// write the initial records of an empty zset, the meta is written by
+// ZSetEngine::save()
+Expected<PZSetEngine> createZSet(uint32_t chunkId,
+                                 uint32_t dbId,
+                                 const std::string& pk,
+                                 uint8_t engine,
+                                 uint64_t version,
+                                 PStore store,
+                                 Transaction* txn);
+
+// rewrite the zset of the meta mv with the engine, it's O(N). The meta
+// is written by ZSetEngine::save() of the returned one.
+Expected<PZSetEngine> convertZSet(uint32_t chunkId,
+                                  uint32_t dbId,
+                                  const std::string& pk,
+                                  const RecordValue& mv,
+                                  uint8_t engine,
+                                  PStore store,
+                                  Transaction* txn);
+
+// the same as above, with the opened zset of the subkey version
+Expected<PZSetEngine> convertZSet(uint32_t chunkId,
+                                  uint32_t dbId,
+                                  const std::string& pk,
+                                  PZSetEngine&& zset,
+                                  uint8_t engine,
+                                  uint64_t version,
+                                  PStore store,
+                                  Transaction* txn);
+
+// the member->score records of the skiplist and ZIndex
+Expected<double> getHashScore(PStore store,
+                              const RecordKey& hk,
+                              Transaction* txn);
+Status setHashScore(PStore store,
+                    const RecordKey& hk,
+                    double score,
+                    Transaction* txn);
+
+class SkipList : public ZSetEngine {
  public:
   using PSE = std::unique_ptr<ZSlEleValue>;
   using PSE_MAP = std::map<uint64_t, SkipList::PSE>;
@@ -30,12 +148,30 @@ class SkipList {
            uint32_t dbId,
            const std::string& pk,
            const ZSlMetaValue& meta,
-           PStore store);
-  Status insert(double score, const std::string& subkey, Transaction* txn);
-  Status remove(double score, const std::string& subkey, Transaction* txn);
+           PStore store,
+           uint64_t version = 0);
+  uint8_t getEngine() const override {
+    return ZSlMetaValue::ENGINE_SKIPLIST;
+  }
+  Expected<double> getScore(const std::string& subkey,
+                            Transaction* txn) override;
+  Status setScore(const std::string& subkey,
+                  double score,
+                  Transaction* txn) override;
+  Status delScore(const std::string& subkey, Transaction* txn) override;
+  Status insert(double score,
+                const std::string& subkey,
+                Transaction* txn) override;
+  Status remove(double score,
+                const std::string& subkey,
+                Transaction* txn) override;
   Expected<uint32_t> rank(double score,
                           const std::string& subkey,
-                          Transaction* txn);
+                          Transaction* txn) override;
+  Expected<uint32_t> countInRange(const Zrangespec& range,
+                                  Transaction* txn) override;
+  Expected<uint32_t> countInLexRange(const Zlexrangespec& range,
+                                     Transaction* txn) override;
 
   Expected<bool> isInRange(const Zrangespec& spec, Transaction* txn);
   Expected<bool> isInLexRange(const Zlexrangespec& spec, Transaction* txn);
@@ -53,33 +189,34 @@ class SkipList {
     uint64_t offset,
     uint64_t limit,
     bool rev,
-    Transaction* txn);
+    Transaction* txn) override;
   Expected<std::list<std::pair<double, std::string>>> scanByRank(
-    int64_t start, int64_t len, bool rev, Transaction* txn);
+    int64_t start, int64_t len, bool rev, Transaction* txn) override;
 
   Expected<std::list<std::pair<double, std::string>>> scanByScore(
     const Zrangespec& range,
     uint64_t offset,
     uint64_t limit,
     bool rev,
-    Transaction* txn);
+    Transaction* txn) override;
 
   Expected<std::list<std::pair<double, std::string>>> removeRangeByScore(
-    const Zrangespec& range, Transaction* txn);
+    const Zrangespec& range, Transaction* txn) override;
 
   Expected<std::list<std::pair<double, std::string>>> removeRangeByLex(
-    const Zlexrangespec& range, Transaction* txn);
+    const Zlexrangespec& range, Transaction* txn) override;
 
   // 1-based index
   Expected<std::list<std::pair<double, std::string>>> removeRangeByRank(
-    uint32_t start, uint32_t end, Transaction* txn);
+    uint32_t start, uint32_t end, Transaction* txn) override;
 
 
   Status save(Transaction* txn,
               const Expected<RecordValue>& oldValue,
-              uint64_t versionEP);
+              uint64_t versionEP) override;
+  Status drop(Transaction* txn) override;
   Status traverse(std::stringstream& ss, Transaction* txn);
-  uint32_t getCount() const;
+  uint32_t getCount() const override;
   uint64_t getAlloc() const;
   uint64_t getTail() const;
   uint8_t getLevel() const;
@@ -109,6 +246,8 @@ class SkipList {
   uint32_t _chunkId;
   uint32_t _dbId;
   std::string _pk;
+  // the subkey version, see rcd_util::genSubKeyVersion()
+  uint64_t _version;
   PStore _store;
   PSE_MAP cache;
 };
@@ -11,6 +11,8 @@
 #include "tendisplus/utils/scopeguard.h"
 #include "tendisplus/utils/portable.h"
 #include "tendisplus/storage/skiplist.h"
+#include "tendisplus/storage/zindex.h"
+#include "tendisplus/storage/zinline.h"
 #include "tendisplus/storage/kvstore.h"
 #include "tendisplus/storage/rocks/rocks_kvstore.h"
 #include "tendisplus/server/server_params.h"
@@ -449,4 +451,282 @@ TEST(SkipList, Common) {
   LOG(INFO) << "skiplist level:" << static_cast<uint32_t>(sl.getLevel());
 }
 
+TEST(ZIndex, Encode) {
+  std::vector<double> scores = {-INFINITY, -1e100, -2.5, -1, -1e-300, 0,
+                                1e-300, 1, 2.5, 1e100, INFINITY};
+  for (size_t i = 0; i < scores.size(); ++i) {
+    std::string s = ZIndex::encodeScore(scores[i]);
+    EXPECT_EQ(ZIndex::decodeScore(s), scores[i]);
+    if (i > 0) {
+      EXPECT_LT(ZIndex::encodeScore(scores[i - 1]), s);
+    }
+  }
+  EXPECT_EQ(ZIndex::encodeScore(-0.0), ZIndex::encodeScore(0.0));
+
+  // members with 0x00 keep their order
+  std::vector<std::string> members = {std::string(""),
+                                      std::string("\0", 1),
+                                      std::string("\0\0", 2),
+                                      std::string("\0a", 2),
+                                      std::string("a"),
+                                      std::string("a\0", 2),
+                                      std::string("a\x01", 2),
+                                      std::string("b")};
+  for (size_t i = 0; i < members.size(); ++i) {
+    std::string e = ZIndex::encodeEntry(1, members[i]);
+    auto d = ZIndex::decodeEntry(e);
+    ASSERT_TRUE(d.ok());
+    EXPECT_EQ(d.value().first, 1);
+    EXPECT_EQ(d.value().second, members[i]);
+    if (i > 0) {
+      EXPECT_LT(ZIndex::encodeEntry(1, members[i - 1]), e);
+    }
+  }
+}
+
+TEST(ZIndex, Common) {
+  auto cfg = genParams();
+  EXPECT_TRUE(filesystem::create_directory("db"));
+  EXPECT_TRUE(filesystem::create_directory("log"));
+  const auto guard = MakeGuard([] {
+    filesystem::remove_all("./log");
+    filesystem::remove_all("./db");
+  });
+  auto blockCache =
+    rocksdb::NewLRUCache(cfg->rocksBlockcacheMB * 1024 * 1024LL, 4);
+  auto store = std::shared_ptr<KVStore>(new RocksKVStore("0", cfg, blockCache));
+
+  auto eTxn1 = store->createTransaction(nullptr);
+  EXPECT_TRUE(eTxn1.ok());
+  auto ezi = createZSet(
+    0, 0, "test", ZSlMetaValue::ENGINE_INDEX, 0, store, eTxn1.value().get());
+  ASSERT_TRUE(ezi.ok());
+  PZSetEngine& zi = ezi.value();
+  EXPECT_TRUE(eTxn1.value()->commit().ok());
+
+  // enough elements to split the blocks
+  constexpr uint32_t CNT = 3000;
+  std::vector<uint32_t> keys;
+  for (uint32_t i = 1; i <= CNT; ++i) {
+    keys.push_back(i);
+  }
+  std::random_shuffle(keys.begin(), keys.end());
+  for (size_t i = 0; i < keys.size(); i += 100) {
+    auto eTxn = store->createTransaction(nullptr);
+    EXPECT_TRUE(eTxn.ok());
+    for (size_t j = i; j < i + 100; ++j) {
+      Status s = zi->insert(
+        keys[j] - 1000, std::to_string(keys[j]), eTxn.value().get());
+      EXPECT_TRUE(s.ok()) << s.toString();
+    }
+    Status s = zi->save(eTxn.value().get(), {ErrorCodes::ERR_NOTFOUND, ""}, -1);
+    EXPECT_TRUE(s.ok());
+    EXPECT_TRUE(eTxn.value()->commit().ok());
+  }
+  EXPECT_EQ(zi->getCount(), CNT + 1);
+
+  auto eTxn = store->createTransaction(nullptr);
+  EXPECT_TRUE(eTxn.ok());
+  Transaction* txn = eTxn.value().get();
+  for (uint32_t i = 1; i <= CNT; i += 7) {
+    auto expRank = zi->rank(i - 1000.0, std::to_string(i), txn);
+    ASSERT_TRUE(expRank.ok());
+    EXPECT_EQ(expRank.value(), i);
+  }
+
+  auto expList = zi->scanByRank(0, CNT, false, txn);
+  ASSERT_TRUE(expList.ok());
+  uint32_t i = 1;
+  for (const auto& v : expList.value()) {
+    EXPECT_EQ(v.first, i - 1000.0);
+    EXPECT_EQ(v.second, std::to_string(i));
+    ++i;
+  }
+  EXPECT_EQ(i, CNT + 1);
+
+  expList = zi->scanByRank(10, 5, true, txn);
+  ASSERT_TRUE(expList.ok());
+  ASSERT_EQ(expList.value().size(), 5U);
+  EXPECT_EQ(expList.value().front().second, std::to_string(CNT - 10));
+  EXPECT_EQ(expList.value().back().second, std::to_string(CNT - 14));
+
+  Zrangespec range = {-500, 500, 1, 0};
+  auto expCnt = zi->countInRange(range, txn);
+  ASSERT_TRUE(expCnt.ok());
+  EXPECT_EQ(expCnt.value(), 1000U);
+
+  expList = zi->scanByScore(range, 10, 3, false, txn);
+  ASSERT_TRUE(expList.ok());
+  ASSERT_EQ(expList.value().size(), 3U);
+  EXPECT_EQ(expList.value().front().first, -489);
+
+  expList = zi->scanByScore(range, 10, 3, true, txn);
+  ASSERT_TRUE(expList.ok());
+  ASSERT_EQ(expList.value().size(), 3U);
+  EXPECT_EQ(expList.value().front().first, 490);
+  EXPECT_EQ(expList.value().back().first, 488);
+
+  // remove the first 1000 ones, the first blocks are dropped
+  expList = zi->removeRangeByRank(1, 1000, txn);
+  ASSERT_TRUE(expList.ok());
+  EXPECT_EQ(expList.value().size(), 1000U);
+  EXPECT_EQ(zi->getCount(), CNT - 1000 + 1);
+  range = {-INFINITY, INFINITY, 0, 0};
+  expCnt = zi->countInRange(range, txn);
+  ASSERT_TRUE(expCnt.ok());
+  EXPECT_EQ(expCnt.value(), CNT - 1000);
+  auto expRank = zi->rank(1001 - 1000.0, std::to_string(1001), txn);
+  ASSERT_TRUE(expRank.ok());
+  EXPECT_EQ(expRank.value(), 1U);
+  EXPECT_TRUE(zi->save(txn, {ErrorCodes::ERR_NOTFOUND, ""}, -1).ok());
+  EXPECT_TRUE(txn->commit().ok());
+}
+
+TEST(ZIndex, Convert) {
+  auto cfg = genParams();
+  EXPECT_TRUE(filesystem::create_directory("db"));
+  EXPECT_TRUE(filesystem::create_directory("log"));
+  const auto guard = MakeGuard([] {
+    filesystem::remove_all("./log");
+    filesystem::remove_all("./db");
+  });
+  auto blockCache =
+    rocksdb::NewLRUCache(cfg->rocksBlockcacheMB * 1024 * 1024LL, 4);
+  auto store = std::shared_ptr<KVStore>(new RocksKVStore("0", cfg, blockCache));
+
+  auto eTxn = store->createTransaction(nullptr);
+  EXPECT_TRUE(eTxn.ok());
+  Transaction* txn = eTxn.value().get();
+  auto esl = createZSet(
+    0, 0, "test", ZSlMetaValue::ENGINE_SKIPLIST, 0, store, txn);
+  ASSERT_TRUE(esl.ok());
+  constexpr uint32_t CNT = 500;
+  for (uint32_t i = 1; i <= CNT; ++i) {
+    EXPECT_TRUE(esl.value()->insert(i, std::to_string(i), txn).ok());
+  }
+  EXPECT_TRUE(
+    esl.value()->save(txn, {ErrorCodes::ERR_NOTFOUND, ""}, -1).ok());
+
+  RecordKey mk(0, 0, RecordType::RT_ZSET_META, "test", "");
+  auto emv = store->getKV(mk, txn);
+  ASSERT_TRUE(emv.ok());
+  auto ezi = convertZSet(0,
+                         0,
+                         "test",
+                         emv.value(),
+                         ZSlMetaValue::ENGINE_INDEX,
+                         store,
+                         txn);
+  ASSERT_TRUE(ezi.ok()) << ezi.status().toString();
+  EXPECT_TRUE(ezi.value()->save(txn, emv, -1).ok());
+
+  // the skiplist nodes are gone
+  RecordKey head(0,
+                 0,
+                 RecordType::RT_ZSET_S_ELE,
+                 "test",
+                 std::to_string(ZSlMetaValue::HEAD_ID));
+  EXPECT_EQ(store->getKV(head, txn).status().code(),
+            ErrorCodes::ERR_NOTFOUND);
+
+  emv = store->getKV(mk, txn);
+  ASSERT_TRUE(emv.ok());
+  auto ezs = openZSet(0, 0, "test", emv.value(), store);
+  ASSERT_TRUE(ezs.ok());
+  EXPECT_EQ(ezs.value()->getCount(), CNT + 1);
+  auto expList = ezs.value()->scanByRank(0, CNT, true, txn);
+  ASSERT_TRUE(expList.ok());
+  EXPECT_EQ(expList.value().size(), CNT);
+  EXPECT_EQ(expList.value().front().second, std::to_string(CNT));
+  EXPECT_TRUE(txn->commit().ok());
+}
+
+TEST(ZInline, Common) {
+  auto cfg = genParams();
+  EXPECT_TRUE(filesystem::create_directory("db"));
+  EXPECT_TRUE(filesystem::create_directory("log"));
+  const auto guard = MakeGuard([] {
+    filesystem::remove_all("./log");
+    filesystem::remove_all("./db");
+  });
+  auto blockCache =
+    rocksdb::NewLRUCache(cfg->rocksBlockcacheMB * 1024 * 1024LL, 4);
+  auto store = std::shared_ptr<KVStore>(new RocksKVStore("0", cfg, blockCache));
+
+  auto eTxn = store->createTransaction(nullptr);
+  EXPECT_TRUE(eTxn.ok());
+  Transaction* txn = eTxn.value().get();
+  auto ezs = createZSet(
+    0, 0, "test", ZSlMetaValue::ENGINE_INLINE, 0, store, txn);
+  ASSERT_TRUE(ezs.ok());
+  PZSetEngine& zs = ezs.value();
+  constexpr uint32_t CNT = 20;
+  for (uint32_t i = CNT; i >= 1; --i) {
+    EXPECT_TRUE(zs->insert(i, std::to_string(i), txn).ok());
+  }
+  EXPECT_EQ(zs->getCount(), CNT + 1);
+  auto expScore = zs->getScore("7", txn);
+  ASSERT_TRUE(expScore.ok());
+  EXPECT_EQ(expScore.value(), 7);
+  EXPECT_EQ(zs->getScore("x", txn).status().code(), ErrorCodes::ERR_NOTFOUND);
+  auto expRank = zs->rank(7, "7", txn);
+  ASSERT_TRUE(expRank.ok());
+  EXPECT_EQ(expRank.value(), 7U);
+
+  auto expList = zs->scanByRank(2, 3, true, txn);
+  ASSERT_TRUE(expList.ok());
+  ASSERT_EQ(expList.value().size(), 3U);
+  EXPECT_EQ(expList.value().front().second, "18");
+  EXPECT_EQ(expList.value().back().second, "16");
+
+  Zrangespec range = {5, 10, 1, 0};
+  auto expCnt = zs->countInRange(range, txn);
+  ASSERT_TRUE(expCnt.ok());
+  EXPECT_EQ(expCnt.value(), 5U);
+  expList = zs->scanByScore(range, 1, 2, true, txn);
+  ASSERT_TRUE(expList.ok());
+  ASSERT_EQ(expList.value().size(), 2U);
+  EXPECT_EQ(expList.value().front().first, 9);
+  EXPECT_EQ(expList.value().back().first, 8);
+
+  expList = zs->removeRangeByRank(1, 5, txn);
+  ASSERT_TRUE(expList.ok());
+  EXPECT_EQ(expList.value().size(), 5U);
+  EXPECT_TRUE(zs->remove(20, "20", txn).ok());
+  EXPECT_FALSE(zs->remove(20, "20", txn).ok());
+  EXPECT_EQ(zs->getCount(), CNT - 6 + 1);
+  EXPECT_TRUE(zs->save(txn, {ErrorCodes::ERR_NOTFOUND, ""}, -1).ok());
+
+  // the scores are in the meta only
+  RecordKey hk(0, 0, RecordType::RT_ZSET_H_ELE, "test", "7");
+  EXPECT_EQ(store->getKV(hk, txn).status().code(), ErrorCodes::ERR_NOTFOUND);
+
+  // the skiplist gets both the nodes and the scores
+  RecordKey mk(0, 0, RecordType::RT_ZSET_META, "test", "");
+  auto emv = store->getKV(mk, txn);
+  ASSERT_TRUE(emv.ok());
+  auto esl = convertZSet(0,
+                         0,
+                         "test",
+                         emv.value(),
+                         ZSlMetaValue::ENGINE_SKIPLIST,
+                         store,
+                         txn);
+  ASSERT_TRUE(esl.ok()) << esl.status().toString();
+  EXPECT_TRUE(esl.value()->save(txn, emv, -1).ok());
+  emv = store->getKV(mk, txn);
+  ASSERT_TRUE(emv.ok());
+  auto ezs2 = openZSet(0, 0, "test", emv.value(), store);
+  ASSERT_TRUE(ezs2.ok());
+  EXPECT_EQ(ezs2.value()->getEngine(), ZSlMetaValue::ENGINE_SKIPLIST);
+  EXPECT_EQ(ezs2.value()->getCount(), CNT - 6 + 1);
+  expScore = ezs2.value()->getScore("7", txn);
+  ASSERT_TRUE(expScore.ok());
+  EXPECT_EQ(expScore.value(), 7);
+  expRank = ezs2.value()->rank(7, "7", txn);
+  ASSERT_TRUE(expRank.ok());
+  EXPECT_EQ(expRank.value(), 2U);
+  EXPECT_TRUE(txn->commit().ok());
+}
+
 }  // namespace tendisplus
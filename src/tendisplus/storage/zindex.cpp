@@ -0,0 +1,748 @@
+// Copyright (C) 2020 THL A29 Limited, a Tencent company.  All rights reserved.
+// Please refer to the license text that comes with this tendis open source
+// project for additional information.
+
+#include <string.h>
+
+#include <algorithm>
+#include <list>
+#include <string>
+#include <utility>
+
+#include "tendisplus/storage/zindex.h"
+#include "tendisplus/storage/varint.h"
+#include "tendisplus/utils/invariant.h"
+
+namespace tendisplus {
+
+namespace {
+const char ENTRY_TAG = 'e';
+const char BLOCK_TAG = 'b';
+// greater than all the entries
+const char END_TAG = 'f';
+const std::string FIRST_BLOCK = std::string("b\0", 2);  // NOLINT
+
+// the first subkey of the entries in a block
+std::string blockStart(const std::string& block) {
+  if (block == FIRST_BLOCK) {
+    return std::string(1, ENTRY_TAG);
+  }
+  return block.substr(1);
+}
+
+Expected<uint32_t> decodeBlockCount(const RecordValue& rv) {
+  const std::string& val = rv.getValue();
+  auto expt = varintDecodeFwd(reinterpret_cast<const uint8_t*>(val.data()),
+                              val.size());
+  if (!expt.ok()) {
+    return expt.status();
+  }
+  return static_cast<uint32_t>(expt.value().first);
+}
+
+// the subkey of the score bound, the entries with the score are before
+// it if after is true
+std::string scoreBound(double score, bool after) {
+  std::string buf = ZIndex::encodeScore(score);
+  if (after) {
+    int i = static_cast<int>(buf.size()) - 1;
+    for (; i >= 0; --i) {
+      if (static_cast<uint8_t>(buf[i]) != 0xff) {
+        buf[i] = static_cast<char>(static_cast<uint8_t>(buf[i]) + 1);
+        break;
+      }
+      buf[i] = 0;
+    }
+    if (i < 0) {
+      return std::string(1, END_TAG);
+    }
+  }
+  return ENTRY_TAG + buf;
+}
+}  // namespace
+
+ZIndex::ZIndex(uint32_t chunkId,
+               uint32_t dbId,
+               const std::string& pk,
+               const ZSlMetaValue& meta,
+               PStore store,
+               uint64_t version)
+  : _chunkId(chunkId),
+    _dbId(dbId),
+    _pk(pk),
+    _version(version),
+    _store(store),
+    _count(meta.getCount()) {
+  _prefix = genKey("").prefixPk();
+}
+
+std::string ZIndex::encodeScore(double score) {
+  // NOTE: -0.0 and 0.0 are the same score
+  if (score == 0) {
+    score = 0;
+  }
+  uint64_t bits = 0;
+  memcpy(&bits, &score, sizeof(bits));
+  if (bits >> 63) {
+    bits = ~bits;
+  } else {
+    bits |= (1ULL << 63);
+  }
+  char buf[sizeof(bits)];
+  int64Encode(buf, bits);
+  return std::string(buf, sizeof(buf));
+}
+
+double ZIndex::decodeScore(const std::string& buf) {
+  INVARIANT_D(buf.size() == sizeof(uint64_t));
+  uint64_t bits = int64Decode(buf.data());
+  if (bits >> 63) {
+    bits &= ~(1ULL << 63);
+  } else {
+    bits = ~bits;
+  }
+  double score = 0;
+  memcpy(&score, &bits, sizeof(score));
+  return score;
+}
+
+std::string ZIndex::encodeEntry(double score, const std::string& subkey) {
+  std::string result;
+  result.reserve(1 + sizeof(uint64_t) + subkey.size() + 2);
+  result.push_back(ENTRY_TAG);
+  result.append(encodeScore(score));
+  // escape 0x00 so that the entries are in (score, subkey) order
+  for (char c : subkey) {
+    result.push_back(c);
+    if (c == '\0') {
+      result.push_back('\xff');
+    }
+  }
+  result.append(2, '\0');
+  return result;
+}
+
+Expected<std::pair<double, std::string>> ZIndex::decodeEntry(
+  const std::string& sk) {
+  const size_t hdrSize = 1 + sizeof(uint64_t);
+  if (sk.size() < hdrSize + 2 || sk[0] != ENTRY_TAG) {
+    return {ErrorCodes::ERR_DECODE, "invalid zset entry"};
+  }
+  double score = decodeScore(sk.substr(1, sizeof(uint64_t)));
+  std::string subkey;
+  subkey.reserve(sk.size() - hdrSize - 2);
+  for (size_t i = hdrSize; i + 1 < sk.size(); ++i) {
+    if (sk[i] != '\0') {
+      subkey.push_back(sk[i]);
+      continue;
+    }
+    if (sk[i + 1] == '\0' && i + 2 == sk.size()) {
+      return std::make_pair(score, std::move(subkey));
+    }
+    if (sk[i + 1] != '\xff') {
+      break;
+    }
+    subkey.push_back('\0');
+    ++i;
+  }
+  return {ErrorCodes::ERR_DECODE, "invalid zset entry"};
+}
+
+Expected<double> ZIndex::getScore(const std::string& subkey,
+                                  Transaction* txn) {
+  RecordKey hk(
+    _chunkId, _dbId, RecordType::RT_ZSET_H_ELE, _pk, subkey, _version);
+  return getHashScore(_store, hk, txn);
+}
+
+Status ZIndex::setScore(const std::string& subkey,
+                        double score,
+                        Transaction* txn) {
+  RecordKey hk(
+    _chunkId, _dbId, RecordType::RT_ZSET_H_ELE, _pk, subkey, _version);
+  return setHashScore(_store, hk, score, txn);
+}
+
+Status ZIndex::delScore(const std::string& subkey, Transaction* txn) {
+  RecordKey hk(
+    _chunkId, _dbId, RecordType::RT_ZSET_H_ELE, _pk, subkey, _version);
+  return _store->delKV(hk, txn);
+}
+
+RecordKey ZIndex::genKey(const std::string& sk) const {
+  return RecordKey(
+    _chunkId, _dbId, RecordType::RT_ZSET_S_ELE, _pk, sk, _version);
+}
+
+Expected<std::string> ZIndex::getSubKey(const Record& rcd) const {
+  const RecordKey& rk = rcd.getRecordKey();
+  if (rk.prefixPk() != _prefix) {
+    return {ErrorCodes::ERR_EXHAUST, ""};
+  }
+  return rk.getSecondaryKey();
+}
+
+Status ZIndex::init(Transaction* txn) {
+  return setBlock(FIRST_BLOCK, 0, txn);
+}
+
+Status ZIndex::setBlock(const std::string& block,
+                        uint32_t count,
+                        Transaction* txn) {
+  RecordValue rv(varintEncodeStr(count), RecordType::RT_ZSET_S_ELE, -1);
+  return _store->setKV(genKey(block), rv, txn);
+}
+
+Status ZIndex::delBlock(const std::string& block, Transaction* txn) {
+  return _store->delKV(genKey(block), txn);
+}
+
+// NOTE: the entry should be written before, so that the seek always
+// stops at a record of this zset
+Expected<std::pair<std::string, uint32_t>> ZIndex::findBlock(
+  const std::string& entry, Transaction* txn) {
+  std::string block = BLOCK_TAG + entry;
+  std::string target = genKey(block).encode();
+  auto cursor = txn->createDataCursor();
+  cursor->seek(target);
+  auto expKey = cursor->key();
+  if (!expKey.ok()) {
+    return expKey.status();
+  }
+  if (expKey.value() != target) {
+    Status s = cursor->prev();
+    if (!s.ok()) {
+      return s;
+    }
+  }
+  auto expRcd = cursor->next();
+  if (!expRcd.ok()) {
+    return expRcd.status();
+  }
+  auto expSk = getSubKey(expRcd.value());
+  if (!expSk.ok() || expSk.value().empty() ||
+      expSk.value()[0] != BLOCK_TAG) {
+    return {ErrorCodes::ERR_INTERNAL, "zset block not found"};
+  }
+  auto expCnt = decodeBlockCount(expRcd.value().getRecordValue());
+  if (!expCnt.ok()) {
+    return expCnt.status();
+  }
+  return std::make_pair(expSk.value(), expCnt.value());
+}
+
+Status ZIndex::splitBlock(const std::string& block,
+                          uint32_t count,
+                          Transaction* txn) {
+  uint32_t half = count / 2;
+  auto cursor = txn->createDataCursor();
+  cursor->seek(_prefix + blockStart(block));
+  std::string mid;
+  for (uint32_t i = 0; i <= half; ++i) {
+    auto expRcd = cursor->next();
+    if (!expRcd.ok()) {
+      return expRcd.status();
+    }
+    auto expSk = getSubKey(expRcd.value());
+    if (!expSk.ok()) {
+      return {ErrorCodes::ERR_INTERNAL, "zset block count mismatch"};
+    }
+    mid = expSk.value();
+  }
+  Status s = setBlock(block, half, txn);
+  if (!s.ok()) {
+    return s;
+  }
+  return setBlock(BLOCK_TAG + mid, count - half, txn);
+}
+
+Status ZIndex::insert(double score,
+                      const std::string& subkey,
+                      Transaction* txn) {
+  std::string entry = encodeEntry(score, subkey);
+  RecordValue rv(std::string(), RecordType::RT_ZSET_S_ELE, -1);
+  Status s = _store->setKV(genKey(entry), rv, txn);
+  if (!s.ok()) {
+    return s;
+  }
+  auto expBlock = findBlock(entry, txn);
+  if (!expBlock.ok()) {
+    return expBlock.status();
+  }
+  const std::string& block = expBlock.value().first;
+  uint32_t count = expBlock.value().second + 1;
+  if (count >= 2 * BLOCK_SIZE) {
+    s = splitBlock(block, count, txn);
+  } else {
+    s = setBlock(block, count, txn);
+  }
+  if (!s.ok()) {
+    return s;
+  }
+  ++_count;
+  return {ErrorCodes::ERR_OK, ""};
+}
+
+Status ZIndex::remove(double score,
+                      const std::string& subkey,
+                      Transaction* txn) {
+  std::string entry = encodeEntry(score, subkey);
+  RecordKey rk = genKey(entry);
+  auto expv = _store->getKV(rk, txn);
+  if (!expv.ok()) {
+    return expv.status();
+  }
+  auto expBlock = findBlock(entry, txn);
+  if (!expBlock.ok()) {
+    return expBlock.status();
+  }
+  Status s = _store->delKV(rk, txn);
+  if (!s.ok()) {
+    return s;
+  }
+  const std::string& block = expBlock.value().first;
+  uint32_t count = expBlock.value().second - 1;
+  if (block == FIRST_BLOCK) {
+    s = setBlock(block, count, txn);
+  } else if (count == 0) {
+    s = delBlock(block, txn);
+  } else if (block.compare(1, std::string::npos, entry) == 0) {
+    // the first entry is removed, rename the block to the next one
+    auto cursor = txn->createDataCursor();
+    cursor->seek(_prefix + entry);
+    auto expRcd = cursor->next();
+    if (!expRcd.ok()) {
+      return expRcd.status();
+    }
+    auto expSk = getSubKey(expRcd.value());
+    if (!expSk.ok()) {
+      return {ErrorCodes::ERR_INTERNAL, "zset block count mismatch"};
+    }
+    s = delBlock(block, txn);
+    if (!s.ok()) {
+      return s;
+    }
+    s = setBlock(BLOCK_TAG + expSk.value(), count, txn);
+  } else {
+    s = setBlock(block, count, txn);
+  }
+  if (!s.ok()) {
+    return s;
+  }
+  --_count;
+  return {ErrorCodes::ERR_OK, ""};
+}
+
+Expected<uint32_t> ZIndex::countBefore(const std::string& bound,
+                                       Transaction* txn) {
+  auto cursor = txn->createDataCursor();
+  cursor->seek(_prefix + BLOCK_TAG);
+  // the entries before the block containing the bound
+  uint32_t before = 0;
+  uint32_t sum = 0;
+  std::string start(1, ENTRY_TAG);
+  while (true) {
+    auto expRcd = cursor->next();
+    if (expRcd.status().code() == ErrorCodes::ERR_EXHAUST) {
+      break;
+    } else if (!expRcd.ok()) {
+      return expRcd.status();
+    }
+    auto expSk = getSubKey(expRcd.value());
+    if (!expSk.ok() || expSk.value()[0] != BLOCK_TAG) {
+      break;
+    }
+    std::string s = blockStart(expSk.value());
+    if (s >= bound) {
+      break;
+    }
+    auto expCnt = decodeBlockCount(expRcd.value().getRecordValue());
+    if (!expCnt.ok()) {
+      return expCnt.status();
+    }
+    before = sum;
+    start = std::move(s);
+    sum += expCnt.value();
+  }
+
+  cursor->seek(_prefix + start);
+  while (true) {
+    auto expRcd = cursor->next();
+    if (expRcd.status().code() == ErrorCodes::ERR_EXHAUST) {
+      break;
+    } else if (!expRcd.ok()) {
+      return expRcd.status();
+    }
+    auto expSk = getSubKey(expRcd.value());
+    if (!expSk.ok() || expSk.value() >= bound) {
+      break;
+    }
+    ++before;
+  }
+  return before;
+}
+
+Expected<std::list<std::pair<double, std::string>>> ZIndex::scanFromRank(
+  uint32_t start, uint32_t len, Transaction* txn) {
+  std::list<std::pair<double, std::string>> result;
+  uint32_t total = _count - 1;
+  if (start >= total || len == 0) {
+    return result;
+  }
+
+  // find the block from the nearer end
+  auto cursor = txn->createDataCursor();
+  std::string block;
+  uint32_t base = 0;
+  if (start < total / 2) {
+    cursor->seek(_prefix + BLOCK_TAG);
+    while (true) {
+      auto expRcd = cursor->next();
+      if (!expRcd.ok()) {
+        return expRcd.status();
+      }
+      auto expSk = getSubKey(expRcd.value());
+      if (!expSk.ok() || expSk.value()[0] != BLOCK_TAG) {
+        return {ErrorCodes::ERR_INTERNAL, "zset block count mismatch"};
+      }
+      auto expCnt = decodeBlockCount(expRcd.value().getRecordValue());
+      if (!expCnt.ok()) {
+        return expCnt.status();
+      }
+      if (base + expCnt.value() > start) {
+        block = expSk.value();
+        break;
+      }
+      base += expCnt.value();
+    }
+  } else {
+    // the first entry is right after the last block
+    cursor->seek(_prefix + ENTRY_TAG);
+    Status s = cursor->prev();
+    if (!s.ok()) {
+      return s;
+    }
+    uint32_t after = 0;
+    while (true) {
+      auto expRcd = cursor->next();
+      if (!expRcd.ok()) {
+        return expRcd.status();
+      }
+      auto expSk = getSubKey(expRcd.value());
+      if (!expSk.ok() || expSk.value()[0] != BLOCK_TAG) {
+        return {ErrorCodes::ERR_INTERNAL, "zset block count mismatch"};
+      }
+      auto expCnt = decodeBlockCount(expRcd.value().getRecordValue());
+      if (!expCnt.ok()) {
+        return expCnt.status();
+      }
+      after += expCnt.value();
+      if (after >= total - start || expSk.value() == FIRST_BLOCK) {
+        block = expSk.value();
+        base = total - std::min(after, total);
+        break;
+      }
+      // back to the current block, then the previous one
+      s = cursor->prev();
+      if (s.ok()) {
+        s = cursor->prev();
+      }
+      if (!s.ok()) {
+        return s;
+      }
+    }
+  }
+
+  cursor->seek(_prefix + blockStart(block));
+  uint32_t skip = start - base;
+  while (result.size() < len) {
+    auto expRcd = cursor->next();
+    if (expRcd.status().code() == ErrorCodes::ERR_EXHAUST) {
+      break;
+    } else if (!expRcd.ok()) {
+      return expRcd.status();
+    }
+    auto expSk = getSubKey(expRcd.value());
+    if (!expSk.ok() || expSk.value()[0] != ENTRY_TAG) {
+      break;
+    }
+    if (skip > 0) {
+      --skip;
+      continue;
+    }
+    auto expEle = decodeEntry(expSk.value());
+    if (!expEle.ok()) {
+      return expEle.status();
+    }
+    result.emplace_back(std::move(expEle.value()));
+  }
+  return result;
+}
+
+Expected<std::list<std::pair<double, std::string>>> ZIndex::scanRange(
+  const std::string& lo,
+  const std::string& hi,
+  uint64_t offset,
+  uint64_t limit,
+  bool rev,
+  Transaction* txn) {
+  std::list<std::pair<double, std::string>> result;
+  if (lo >= hi) {
+    return result;
+  }
+  if (rev) {
+    // scan the ranks backward
+    auto expLo = countBefore(lo, txn);
+    if (!expLo.ok()) {
+      return expLo.status();
+    }
+    auto expHi = countBefore(hi, txn);
+    if (!expHi.ok()) {
+      return expHi.status();
+    }
+    uint64_t cnt = expHi.value() - expLo.value();
+    if (offset >= cnt) {
+      return result;
+    }
+    uint64_t n = std::min(limit, cnt - offset);
+    auto expList =
+      scanFromRank(expHi.value() - offset - n, static_cast<uint32_t>(n), txn);
+    if (!expList.ok()) {
+      return expList.status();
+    }
+    expList.value().reverse();
+    return std::move(expList.value());
+  }
+
+  auto cursor = txn->createDataCursor();
+  cursor->seek(_prefix + lo);
+  while (result.size() < limit) {
+    auto expRcd = cursor->next();
+    if (expRcd.status().code() == ErrorCodes::ERR_EXHAUST) {
+      break;
+    } else if (!expRcd.ok()) {
+      return expRcd.status();
+    }
+    auto expSk = getSubKey(expRcd.value());
+    if (!expSk.ok() || expSk.value() >= hi) {
+      break;
+    }
+    if (offset > 0) {
+      --offset;
+      continue;
+    }
+    auto expEle = decodeEntry(expSk.value());
+    if (!expEle.ok()) {
+      return expEle.status();
+    }
+    result.emplace_back(std::move(expEle.value()));
+  }
+  return result;
+}
+
+// NOTE: like the skiplist, lex ranges assume all the scores are the same,
+// the score of the first entry is used.
+Expected<std::pair<std::string, std::string>> ZIndex::lexBounds(
+  const Zlexrangespec& range, Transaction* txn) {
+  auto cursor = txn->createDataCursor();
+  cursor->seek(_prefix + ENTRY_TAG);
+  auto expRcd = cursor->next();
+  if (expRcd.status().code() == ErrorCodes::ERR_EXHAUST) {
+    return std::make_pair(std::string(1, END_TAG), std::string(1, END_TAG));
+  } else if (!expRcd.ok()) {
+    return expRcd.status();
+  }
+  auto expSk = getSubKey(expRcd.value());
+  if (!expSk.ok()) {
+    return std::make_pair(std::string(1, END_TAG), std::string(1, END_TAG));
+  }
+  auto expEle = decodeEntry(expSk.value());
+  if (!expEle.ok()) {
+    return expEle.status();
+  }
+  double score = expEle.value().first;
+  auto bound = [score](const std::string& s, bool after) {
+    if (s == ZLEXMIN) {
+      return std::string(1, ENTRY_TAG);
+    } else if (s == ZLEXMAX) {
+      return std::string(1, END_TAG);
+    }
+    std::string result = encodeEntry(score, s);
+    if (after) {
+      result.push_back('\0');
+    }
+    return result;
+  };
+  return std::make_pair(bound(range.min, range.minex),
+                        bound(range.max, !range.maxex));
+}
+
+Expected<uint32_t> ZIndex::rank(double score,
+                                const std::string& subkey,
+                                Transaction* txn) {
+  auto expCnt = countBefore(encodeEntry(score, subkey), txn);
+  if (!expCnt.ok()) {
+    return expCnt.status();
+  }
+  return expCnt.value() + 1;
+}
+
+Expected<uint32_t> ZIndex::countInRange(const Zrangespec& range,
+                                        Transaction* txn) {
+  std::string lo = scoreBound(range.min, range.minex);
+  std::string hi = scoreBound(range.max, !range.maxex);
+  if (lo >= hi) {
+    return 0;
+  }
+  auto expLo = countBefore(lo, txn);
+  if (!expLo.ok()) {
+    return expLo.status();
+  }
+  auto expHi = countBefore(hi, txn);
+  if (!expHi.ok()) {
+    return expHi.status();
+  }
+  return expHi.value() - expLo.value();
+}
+
+Expected<uint32_t> ZIndex::countInLexRange(const Zlexrangespec& range,
+                                           Transaction* txn) {
+  auto expBounds = lexBounds(range, txn);
+  if (!expBounds.ok()) {
+    return expBounds.status();
+  }
+  const auto& bounds = expBounds.value();
+  if (bounds.first >= bounds.second) {
+    return 0;
+  }
+  auto expLo = countBefore(bounds.first, txn);
+  if (!expLo.ok()) {
+    return expLo.status();
+  }
+  auto expHi = countBefore(bounds.second, txn);
+  if (!expHi.ok()) {
+    return expHi.status();
+  }
+  return expHi.value() - expLo.value();
+}
+
+Expected<std::list<std::pair<double, std::string>>> ZIndex::scanByLex(
+  const Zlexrangespec& range,
+  uint64_t offset,
+  uint64_t limit,
+  bool rev,
+  Transaction* txn) {
+  auto expBounds = lexBounds(range, txn);
+  if (!expBounds.ok()) {
+    return expBounds.status();
+  }
+  return scanRange(expBounds.value().first,
+                   expBounds.value().second,
+                   offset,
+                   limit,
+                   rev,
+                   txn);
+}
+
+Expected<std::list<std::pair<double, std::string>>> ZIndex::scanByScore(
+  const Zrangespec& range,
+  uint64_t offset,
+  uint64_t limit,
+  bool rev,
+  Transaction* txn) {
+  return scanRange(scoreBound(range.min, range.minex),
+                   scoreBound(range.max, !range.maxex),
+                   offset,
+                   limit,
+                   rev,
+                   txn);
+}
+
+Expected<std::list<std::pair<double, std::string>>> ZIndex::scanByRank(
+  int64_t start, int64_t len, bool rev, Transaction* txn) {
+  int64_t total = _count - 1;
+  if (rev) {
+    start = total - start - len;
+  }
+  if (start < 0) {
+    len += start;
+    start = 0;
+  }
+  if (len <= 0) {
+    return std::list<std::pair<double, std::string>>();
+  }
+  auto expList = scanFromRank(
+    static_cast<uint32_t>(start), static_cast<uint32_t>(len), txn);
+  if (!expList.ok()) {
+    return expList.status();
+  }
+  if (rev) {
+    expList.value().reverse();
+  }
+  return std::move(expList.value());
+}
+
+Expected<std::list<std::pair<double, std::string>>> ZIndex::removeList(
+  std::list<std::pair<double, std::string>>&& eles, Transaction* txn) {
+  for (const auto& v : eles) {
+    Status s = remove(v.first, v.second, txn);
+    if (!s.ok()) {
+      return s;
+    }
+  }
+  return std::move(eles);
+}
+
+Expected<std::list<std::pair<double, std::string>>>
+ZIndex::removeRangeByScore(const Zrangespec& range, Transaction* txn) {
+  auto expList = scanByScore(range, 0, -1, false, txn);
+  if (!expList.ok()) {
+    return expList.status();
+  }
+  return removeList(std::move(expList.value()), txn);
+}
+
+Expected<std::list<std::pair<double, std::string>>> ZIndex::removeRangeByLex(
+  const Zlexrangespec& range, Transaction* txn) {
+  auto expList = scanByLex(range, 0, -1, false, txn);
+  if (!expList.ok()) {
+    return expList.status();
+  }
+  return removeList(std::move(expList.value()), txn);
+}
+
+Expected<std::list<std::pair<double, std::string>>> ZIndex::removeRangeByRank(
+  uint32_t start, uint32_t end, Transaction* txn) {
+  if (start == 0 || end < start) {
+    return std::list<std::pair<double, std::string>>();
+  }
+  auto expList = scanFromRank(start - 1, end - start + 1, txn);
+  if (!expList.ok()) {
+    return expList.status();
+  }
+  return removeList(std::move(expList.value()), txn);
+}
+
+Status ZIndex::save(Transaction* txn,
+                    const Expected<RecordValue>& oldValue,
+                    uint64_t versionEP) {
+  RecordKey rk(_chunkId, _dbId, RecordType::RT_ZSET_META, _pk, "");
+  ZSlMetaValue mv(1 /*lvl*/, _count, 0 /*tail*/);
+  mv.setEngine(ZSlMetaValue::ENGINE_INDEX);
+  uint64_t ttl = oldValue.ok() ? oldValue.value().getTtl() : 0;
+  RecordValue rv(
+    mv.encode(), RecordType::RT_ZSET_META, versionEP, ttl, oldValue);
+  rv.setVersion(_version);
+  return _store->setKV(rk, rv, txn);
+}
+
+Status ZIndex::drop(Transaction* txn) {
+  INVARIANT_D(_count == 1);
+  return delBlock(FIRST_BLOCK, txn);
+}
+
+uint32_t ZIndex::getCount() const {
+  return _count;
+}
+
+}  // namespace tendisplus
@@ -0,0 +1,141 @@
+// Copyright (C) 2020 THL A29 Limited, a Tencent company.  All rights reserved.
+// Please refer to the license text that comes with this tendis open source
+// project for additional information.
+
+#ifndef SRC_TENDISPLUS_STORAGE_ZINDEX_H_
+#define SRC_TENDISPLUS_STORAGE_ZINDEX_H_
+
+#include <list>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "tendisplus/storage/skiplist.h"
+
+namespace tendisplus {
+
+// ZIndex keeps the score order of a zset in the key order of the kvstore,
+// no pointer is persisted, so an insert or a remove only writes the entry
+// and the counter of its block.
+// All records are RT_ZSET_S_ELE with the subkey version of the zset:
+// entry: 'e'|score(8 bytes, order-preserving)|escaped member|"\0\0"
+//        the value is empty
+// block: 'b'|the subkey of its first entry, the value is varint(count)
+//        the first block is "b\0" which is always there, the entries
+//        before the second block belong to it
+// The rank of an entry is the sum of the counts of the blocks before it,
+// plus its offset in its own block.
+class ZIndex : public ZSetEngine {
+ public:
+  // a block is split into two when it has 2 * BLOCK_SIZE entries
+  static constexpr uint32_t BLOCK_SIZE = 128;
+
+  ZIndex(uint32_t chunkId,
+         uint32_t dbId,
+         const std::string& pk,
+         const ZSlMetaValue& meta,
+         PStore store,
+         uint64_t version = 0);
+  // write the first block of an empty zset
+  Status init(Transaction* txn);
+
+  uint8_t getEngine() const override {
+    return ZSlMetaValue::ENGINE_INDEX;
+  }
+  Expected<double> getScore(const std::string& subkey,
+                            Transaction* txn) override;
+  Status setScore(const std::string& subkey,
+                  double score,
+                  Transaction* txn) override;
+  Status delScore(const std::string& subkey, Transaction* txn) override;
+
+  Status insert(double score,
+                const std::string& subkey,
+                Transaction* txn) override;
+  // The caller should guarantee the (score, subkey) exists
+  Status remove(double score,
+                const std::string& subkey,
+                Transaction* txn) override;
+  Expected<uint32_t> rank(double score,
+                          const std::string& subkey,
+                          Transaction* txn) override;
+  Expected<uint32_t> countInRange(const Zrangespec& range,
+                                  Transaction* txn) override;
+  Expected<uint32_t> countInLexRange(const Zlexrangespec& range,
+                                     Transaction* txn) override;
+  Expected<std::list<std::pair<double, std::string>>> scanByLex(
+    const Zlexrangespec& range,
+    uint64_t offset,
+    uint64_t limit,
+    bool rev,
+    Transaction* txn) override;
+  Expected<std::list<std::pair<double, std::string>>> scanByRank(
+    int64_t start, int64_t len, bool rev, Transaction* txn) override;
+  Expected<std::list<std::pair<double, std::string>>> scanByScore(
+    const Zrangespec& range,
+    uint64_t offset,
+    uint64_t limit,
+    bool rev,
+    Transaction* txn) override;
+  Expected<std::list<std::pair<double, std::string>>> removeRangeByScore(
+    const Zrangespec& range, Transaction* txn) override;
+  Expected<std::list<std::pair<double, std::string>>> removeRangeByLex(
+    const Zlexrangespec& range, Transaction* txn) override;
+  Expected<std::list<std::pair<double, std::string>>> removeRangeByRank(
+    uint32_t start, uint32_t end, Transaction* txn) override;
+  Status save(Transaction* txn,
+              const Expected<RecordValue>& oldValue,
+              uint64_t versionEP) override;
+  Status drop(Transaction* txn) override;
+  uint32_t getCount() const override;
+
+  static std::string encodeScore(double score);
+  static double decodeScore(const std::string& buf);
+  static std::string encodeEntry(double score, const std::string& subkey);
+  static Expected<std::pair<double, std::string>> decodeEntry(
+    const std::string& sk);
+
+ private:
+  // the block containing the entry, return its subkey and count
+  Expected<std::pair<std::string, uint32_t>> findBlock(
+    const std::string& entry, Transaction* txn);
+  Status setBlock(const std::string& block, uint32_t count, Transaction* txn);
+  Status delBlock(const std::string& block, Transaction* txn);
+  Status splitBlock(const std::string& block,
+                    uint32_t count,
+                    Transaction* txn);
+  // the number of entries less than bound
+  Expected<uint32_t> countBefore(const std::string& bound, Transaction* txn);
+  // the entries in [lo, hi), with offset and limit
+  Expected<std::list<std::pair<double, std::string>>> scanRange(
+    const std::string& lo,
+    const std::string& hi,
+    uint64_t offset,
+    uint64_t limit,
+    bool rev,
+    Transaction* txn);
+  // at most len entries from the 0-based rank start
+  Expected<std::list<std::pair<double, std::string>>> scanFromRank(
+    uint32_t start, uint32_t len, Transaction* txn);
+  Expected<std::pair<std::string, std::string>> lexBounds(
+    const Zlexrangespec& range, Transaction* txn);
+  Expected<std::list<std::pair<double, std::string>>> removeList(
+    std::list<std::pair<double, std::string>>&& eles, Transaction* txn);
+  RecordKey genKey(const std::string& sk) const;
+  // the subkey of a record of this zset, or ERR_EXHAUST
+  Expected<std::string> getSubKey(const Record& rcd) const;
+
+  uint32_t _chunkId;
+  uint32_t _dbId;
+  std::string _pk;
+  // the subkey version, see rcd_util::genSubKeyVersion()
+  uint64_t _version;
+  PStore _store;
+  // the head node of skiplist is included, see ZSetEngine
+  uint32_t _count;
+  std::string _prefix;
+};
+
+}  // namespace tendisplus
+
+#endif  // SRC_TENDISPLUS_STORAGE_ZINDEX_H_
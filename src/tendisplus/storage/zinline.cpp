@@ -0,0 +1,232 @@
+// Copyright (C) 2020 THL A29 Limited, a Tencent company.  All rights reserved.
+// Please refer to the license text that comes with this tendis open source
+// project for additional information.
+
+#include <algorithm>
+#include <list>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tendisplus/storage/zinline.h"
+#include "tendisplus/utils/invariant.h"
+
+namespace tendisplus {
+
+ZInline::ZInline(uint32_t chunkId,
+                 uint32_t dbId,
+                 const std::string& pk,
+                 const ZSlMetaValue& meta,
+                 PStore store,
+                 uint64_t version)
+  : _chunkId(chunkId),
+    _dbId(dbId),
+    _pk(pk),
+    _version(version),
+    _store(store),
+    _eles(meta.getInlineEles()) {
+  INVARIANT_D(meta.getEngine() == ZSlMetaValue::ENGINE_INLINE);
+}
+
+size_t ZInline::lowerBound(double score, const std::string& subkey) const {
+  auto it = std::lower_bound(
+    _eles.begin(),
+    _eles.end(),
+    std::make_pair(score, subkey),
+    [](const std::pair<double, std::string>& a,
+       const std::pair<double, std::string>& b) {
+      return a.first < b.first || (a.first == b.first && a.second < b.second);
+    });
+  return it - _eles.begin();
+}
+
+ZInline::Range ZInline::scoreRange(const Zrangespec& range) const {
+  size_t first = 0;
+  while (first < _eles.size() && !zslValueGteMin(_eles[first].first, range)) {
+    ++first;
+  }
+  size_t last = first;
+  while (last < _eles.size() && zslValueLteMax(_eles[last].first, range)) {
+    ++last;
+  }
+  return {first, last};
+}
+
+ZInline::Range ZInline::lexRange(const Zlexrangespec& range) const {
+  size_t first = 0;
+  while (first < _eles.size() &&
+         !zslLexValueGteMin(_eles[first].second, range)) {
+    ++first;
+  }
+  size_t last = first;
+  while (last < _eles.size() && zslLexValueLteMax(_eles[last].second, range)) {
+    ++last;
+  }
+  return {first, last};
+}
+
+std::list<std::pair<double, std::string>> ZInline::slice(const Range& r,
+                                                         uint64_t offset,
+                                                         uint64_t limit,
+                                                         bool rev) const {
+  std::list<std::pair<double, std::string>> result;
+  uint64_t cnt = r.second - r.first;
+  if (offset >= cnt) {
+    return result;
+  }
+  uint64_t n = std::min(limit, cnt - offset);
+  for (uint64_t i = 0; i < n; ++i) {
+    if (rev) {
+      result.push_back(_eles[r.second - 1 - offset - i]);
+    } else {
+      result.push_back(_eles[r.first + offset + i]);
+    }
+  }
+  return result;
+}
+
+std::list<std::pair<double, std::string>> ZInline::erase(const Range& r) {
+  std::list<std::pair<double, std::string>> result(
+    std::make_move_iterator(_eles.begin() + r.first),
+    std::make_move_iterator(_eles.begin() + r.second));
+  _eles.erase(_eles.begin() + r.first, _eles.begin() + r.second);
+  return result;
+}
+
+Expected<double> ZInline::getScore(const std::string& subkey,
+                                   Transaction* txn) {
+  for (const auto& v : _eles) {
+    if (v.second == subkey) {
+      return v.first;
+    }
+  }
+  return {ErrorCodes::ERR_NOTFOUND, ""};
+}
+
+Status ZInline::setScore(const std::string& subkey,
+                         double score,
+                         Transaction* txn) {
+  return {ErrorCodes::ERR_OK, ""};
+}
+
+Status ZInline::delScore(const std::string& subkey, Transaction* txn) {
+  return {ErrorCodes::ERR_OK, ""};
+}
+
+Status ZInline::insert(double score,
+                       const std::string& subkey,
+                       Transaction* txn) {
+  size_t i = lowerBound(score, subkey);
+  INVARIANT_D(i == _eles.size() || _eles[i].second != subkey);
+  _eles.emplace(_eles.begin() + i, score, subkey);
+  return {ErrorCodes::ERR_OK, ""};
+}
+
+Status ZInline::remove(double score,
+                       const std::string& subkey,
+                       Transaction* txn) {
+  size_t i = lowerBound(score, subkey);
+  if (i == _eles.size() || _eles[i].first != score ||
+      _eles[i].second != subkey) {
+    return {ErrorCodes::ERR_NOTFOUND, ""};
+  }
+  _eles.erase(_eles.begin() + i);
+  return {ErrorCodes::ERR_OK, ""};
+}
+
+Expected<uint32_t> ZInline::rank(double score,
+                                 const std::string& subkey,
+                                 Transaction* txn) {
+  return static_cast<uint32_t>(lowerBound(score, subkey) + 1);
+}
+
+Expected<uint32_t> ZInline::countInRange(const Zrangespec& range,
+                                         Transaction* txn) {
+  Range r = scoreRange(range);
+  return static_cast<uint32_t>(r.second - r.first);
+}
+
+Expected<uint32_t> ZInline::countInLexRange(const Zlexrangespec& range,
+                                            Transaction* txn) {
+  Range r = lexRange(range);
+  return static_cast<uint32_t>(r.second - r.first);
+}
+
+Expected<std::list<std::pair<double, std::string>>> ZInline::scanByLex(
+  const Zlexrangespec& range,
+  uint64_t offset,
+  uint64_t limit,
+  bool rev,
+  Transaction* txn) {
+  return slice(lexRange(range), offset, limit, rev);
+}
+
+Expected<std::list<std::pair<double, std::string>>> ZInline::scanByRank(
+  int64_t start, int64_t len, bool rev, Transaction* txn) {
+  int64_t total = _eles.size();
+  if (rev) {
+    start = total - start - len;
+  }
+  if (start < 0) {
+    len += start;
+    start = 0;
+  }
+  if (len <= 0 || start >= total) {
+    return std::list<std::pair<double, std::string>>();
+  }
+  Range r(start, std::min(start + len, total));
+  return slice(r, 0, r.second - r.first, rev);
+}
+
+Expected<std::list<std::pair<double, std::string>>> ZInline::scanByScore(
+  const Zrangespec& range,
+  uint64_t offset,
+  uint64_t limit,
+  bool rev,
+  Transaction* txn) {
+  return slice(scoreRange(range), offset, limit, rev);
+}
+
+Expected<std::list<std::pair<double, std::string>>>
+ZInline::removeRangeByScore(const Zrangespec& range, Transaction* txn) {
+  return erase(scoreRange(range));
+}
+
+Expected<std::list<std::pair<double, std::string>>> ZInline::removeRangeByLex(
+  const Zlexrangespec& range, Transaction* txn) {
+  return erase(lexRange(range));
+}
+
+Expected<std::list<std::pair<double, std::string>>>
+ZInline::removeRangeByRank(uint32_t start, uint32_t end, Transaction* txn) {
+  if (start == 0 || end < start || start > _eles.size()) {
+    return std::list<std::pair<double, std::string>>();
+  }
+  size_t last = std::min(static_cast<size_t>(end), _eles.size());
+  return erase(Range(start - 1, last));
+}
+
+Status ZInline::save(Transaction* txn,
+                     const Expected<RecordValue>& oldValue,
+                     uint64_t versionEP) {
+  RecordKey rk(_chunkId, _dbId, RecordType::RT_ZSET_META, _pk, "");
+  ZSlMetaValue mv(1 /*lvl*/, getCount(), 0 /*tail*/);
+  mv.setEngine(ZSlMetaValue::ENGINE_INLINE);
+  mv.setInlineEles(std::vector<std::pair<double, std::string>>(_eles));
+  uint64_t ttl = oldValue.ok() ? oldValue.value().getTtl() : 0;
+  RecordValue rv(
+    mv.encode(), RecordType::RT_ZSET_META, versionEP, ttl, oldValue);
+  rv.setVersion(_version);
+  return _store->setKV(rk, rv, txn);
+}
+
+Status ZInline::drop(Transaction* txn) {
+  INVARIANT_D(_eles.empty());
+  return {ErrorCodes::ERR_OK, ""};
+}
+
+uint32_t ZInline::getCount() const {
+  return _eles.size() + 1;
+}
+
+}  // namespace tendisplus
@@ -0,0 +1,112 @@
+// Copyright (C) 2020 THL A29 Limited, a Tencent company.  All rights reserved.
+// Please refer to the license text that comes with this tendis open source
+// project for additional information.
+
+#ifndef SRC_TENDISPLUS_STORAGE_ZINLINE_H_
+#define SRC_TENDISPLUS_STORAGE_ZINLINE_H_
+
+#include <list>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tendisplus/storage/skiplist.h"
+
+namespace tendisplus {
+
+// ZInline keeps the elements of a small zset in its meta, sorted by
+// (score, member), see ZSlMetaValue::getInlineEles(). There is no
+// subkey at all, so the scores are in the meta too, and setScore() and
+// delScore() do nothing since insert() and remove() already do the job.
+// A zset is spilled to the configured engine by convertZSet() once it
+// grows beyond zsetMaxInlineEntries/zsetMaxInlineValue, and never moves
+// back inline.
+class ZInline : public ZSetEngine {
+ public:
+  ZInline(uint32_t chunkId,
+          uint32_t dbId,
+          const std::string& pk,
+          const ZSlMetaValue& meta,
+          PStore store,
+          uint64_t version = 0);
+
+  uint8_t getEngine() const override {
+    return ZSlMetaValue::ENGINE_INLINE;
+  }
+  Expected<double> getScore(const std::string& subkey,
+                            Transaction* txn) override;
+  Status setScore(const std::string& subkey,
+                  double score,
+                  Transaction* txn) override;
+  Status delScore(const std::string& subkey, Transaction* txn) override;
+  Status insert(double score,
+                const std::string& subkey,
+                Transaction* txn) override;
+  // The caller should guarantee the (score, subkey) exists
+  Status remove(double score,
+                const std::string& subkey,
+                Transaction* txn) override;
+  Expected<uint32_t> rank(double score,
+                          const std::string& subkey,
+                          Transaction* txn) override;
+  Expected<uint32_t> countInRange(const Zrangespec& range,
+                                  Transaction* txn) override;
+  Expected<uint32_t> countInLexRange(const Zlexrangespec& range,
+                                     Transaction* txn) override;
+  Expected<std::list<std::pair<double, std::string>>> scanByLex(
+    const Zlexrangespec& range,
+    uint64_t offset,
+    uint64_t limit,
+    bool rev,
+    Transaction* txn) override;
+  Expected<std::list<std::pair<double, std::string>>> scanByRank(
+    int64_t start, int64_t len, bool rev, Transaction* txn) override;
+  Expected<std::list<std::pair<double, std::string>>> scanByScore(
+    const Zrangespec& range,
+    uint64_t offset,
+    uint64_t limit,
+    bool rev,
+    Transaction* txn) override;
+  Expected<std::list<std::pair<double, std::string>>> removeRangeByScore(
+    const Zrangespec& range, Transaction* txn) override;
+  Expected<std::list<std::pair<double, std::string>>> removeRangeByLex(
+    const Zlexrangespec& range, Transaction* txn) override;
+  Expected<std::list<std::pair<double, std::string>>> removeRangeByRank(
+    uint32_t start, uint32_t end, Transaction* txn) override;
+  Status save(Transaction* txn,
+              const Expected<RecordValue>& oldValue,
+              uint64_t versionEP) override;
+  Status drop(Transaction* txn) override;
+  uint32_t getCount() const override;
+
+  const std::vector<std::pair<double, std::string>>& getEles() const {
+    return _eles;
+  }
+
+ private:
+  using Range = std::pair<size_t, size_t>;
+  // the index of the first element not less than (score, subkey)
+  size_t lowerBound(double score, const std::string& subkey) const;
+  // the elements [first, second) in the range
+  Range scoreRange(const Zrangespec& range) const;
+  Range lexRange(const Zlexrangespec& range) const;
+  // the elements in r, with offset and limit
+  std::list<std::pair<double, std::string>> slice(const Range& r,
+                                                  uint64_t offset,
+                                                  uint64_t limit,
+                                                  bool rev) const;
+  std::list<std::pair<double, std::string>> erase(const Range& r);
+
+  uint32_t _chunkId;
+  uint32_t _dbId;
+  std::string _pk;
+  // the subkey version, see rcd_util::genSubKeyVersion()
+  uint64_t _version;
+  PStore _store;
+  std::vector<std::pair<double, std::string>> _eles;
+};
+
+}  // namespace tendisplus
+
+#endif  // SRC_TENDISPLUS_STORAGE_ZINLINE_H_
@@ -0,0 +1,90 @@
+// Copyright (C) 2020 THL A29 Limited, a Tencent company.  All rights reserved.
+// Please refer to the license text that comes with this tendis open source
+// project for additional information.
+
+#ifndef SRC_TENDISPLUS_UTILS_HISTOGRAM_H_
+#define SRC_TENDISPLUS_UTILS_HISTOGRAM_H_
+
+#include <atomic>
+#include <algorithm>
+
+namespace tendisplus {
+
+// A lock-free histogram of power-of-two buckets, the bucket i counts the
+// values in [2^(i-1), 2^i), and the bucket 0 counts the zeros.
+// The percentiles are approximated by the upper bounds of the buckets.
+class Histogram {
+ public:
+  static constexpr size_t BUCKETS = 65;
+
+  Histogram() : _count(0), _sum(0), _max(0) {
+    for (auto& b : _buckets) {
+      b.store(0, RLX);
+    }
+  }
+
+  void add(uint64_t v) {
+    _buckets[bucketOf(v)].fetch_add(1, RLX);
+    _count.fetch_add(1, RLX);
+    _sum.fetch_add(v, RLX);
+    auto max = _max.load(RLX);
+    while (v > max && !_max.compare_exchange_weak(max, v, RLX)) {
+    }
+  }
+
+  uint64_t count() const {
+    return _count.load(RLX);
+  }
+
+  uint64_t sum() const {
+    return _sum.load(RLX);
+  }
+
+  uint64_t max() const {
+    return _max.load(RLX);
+  }
+
+  uint64_t avg() const {
+    auto cnt = count();
+    return cnt ? sum() / cnt : 0;
+  }
+
+  // p in [0, 100]
+  uint64_t percentile(double p) const {
+    uint64_t total = count();
+    if (total == 0) {
+      return 0;
+    }
+    uint64_t target = std::max<uint64_t>(1, total * p / 100);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; i++) {
+      seen += _buckets[i].load(RLX);
+      if (seen >= target) {
+        return std::min(upperBound(i), max());
+      }
+    }
+    return max();
+  }
+
+  static size_t bucketOf(uint64_t v) {
+    return v == 0 ? 0 : 64 - __builtin_clzll(v);
+  }
+
+ private:
+  static uint64_t upperBound(size_t bucket) {
+    if (bucket == 0) {
+      return 0;
+    }
+    return bucket >= 64 ? UINT64_MAX : (1ULL << bucket) - 1;
+  }
+
+  std::atomic<uint64_t> _buckets[BUCKETS];
+  std::atomic<uint64_t> _count;
+  std::atomic<uint64_t> _sum;
+  std::atomic<uint64_t> _max;
+  static constexpr auto RLX = std::memory_order_relaxed;
+};
+
+}  // namespace tendisplus
+
+#endif  // SRC_TENDISPLUS_UTILS_HISTOGRAM_H_
@@ -40,6 +40,8 @@ enum class ErrorCodes {
   ERR_UNKNOWN,
   ERR_CLUSTER,
   ERR_CONNECT_TRY,
+  // the command waits for a key lock without holding the thread
+  ERR_LOCK_WAIT,
 
   // error from redis
   ERR_AUTH = 100,
@@ -19,6 +19,7 @@
 #include "tendisplus/utils/test_util.h"
 #include "tendisplus/cluster/cluster_manager.h"
 #include "tendisplus/utils/base64.h"
+#include "tendisplus/utils/histogram.h"
 #include "gtest/gtest.h"
 #include "glog/logging.h"
 
@@ -211,5 +212,26 @@ TEST(ParamManager, common) {
   EXPECT_EQ(pm.getUint64("ikey3", 1), 1);
 }
 
+TEST(Histogram, common) {
+  Histogram h;
+  EXPECT_EQ(h.percentile(99), 0);
+  EXPECT_EQ(Histogram::bucketOf(0), 0);
+  EXPECT_EQ(Histogram::bucketOf(1), 1);
+  EXPECT_EQ(Histogram::bucketOf(7), 3);
+  EXPECT_EQ(Histogram::bucketOf(8), 4);
+  EXPECT_EQ(Histogram::bucketOf(UINT64_MAX), 64);
+
+  for (uint64_t i = 1; i <= 100; i++) {
+    h.add(i);
+  }
+  EXPECT_EQ(h.count(), 100);
+  EXPECT_EQ(h.sum(), 5050);
+  EXPECT_EQ(h.avg(), 50);
+  EXPECT_EQ(h.max(), 100);
+  EXPECT_EQ(h.percentile(50), 63);
+  EXPECT_EQ(h.percentile(99), 100);
+  EXPECT_EQ(h.percentile(1), 1);
+}
+
 
 }  // namespace tendisplus
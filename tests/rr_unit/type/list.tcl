@@ -111,69 +111,68 @@ start_server {
         #assert_encoding linkedlist $key
     }
 
-    # TODO(vinchen)
-    #foreach {type large} [array get largevalue] {
-    #    test "BLPOP, BRPOP: single existing list - $type" {
-    #        set rd [redis_deferring_client]
-    #        create_$type blist "a b $large c d"
-
-    #        $rd blpop blist 1
-    #        assert_equal {blist a} [$rd read]
-    #        $rd brpop blist 1
-    #        assert_equal {blist d} [$rd read]
-
-    #        $rd blpop blist 1
-    #        assert_equal {blist b} [$rd read]
-    #        $rd brpop blist 1
-    #        assert_equal {blist c} [$rd read]
-    #    }
+    foreach {type large} [array get largevalue] {
+        test "BLPOP, BRPOP: single existing list - $type" {
+            set rd [redis_deferring_client]
+            create_$type blist "a b $large c d"
+
+            $rd blpop blist 1
+            assert_equal {blist a} [$rd read]
+            $rd brpop blist 1
+            assert_equal {blist d} [$rd read]
+
+            $rd blpop blist 1
+            assert_equal {blist b} [$rd read]
+            $rd brpop blist 1
+            assert_equal {blist c} [$rd read]
+        }
 
-    #    test "BLPOP, BRPOP: multiple existing lists - $type" {
-    #        set rd [redis_deferring_client]
-    #        create_$type blist1 "a $large c"
-    #        create_$type blist2 "d $large f"
-
-    #        $rd blpop blist1 blist2 1
-    #        assert_equal {blist1 a} [$rd read]
-    #        $rd brpop blist1 blist2 1
-    #        assert_equal {blist1 c} [$rd read]
-    #        assert_equal 1 [r llen blist1]
-    #        assert_equal 3 [r llen blist2]
-
-    #        $rd blpop blist2 blist1 1
-    #        assert_equal {blist2 d} [$rd read]
-    #        $rd brpop blist2 blist1 1
-    #        assert_equal {blist2 f} [$rd read]
-    #        assert_equal 1 [r llen blist1]
-    #        assert_equal 1 [r llen blist2]
-    #    }
+        test "BLPOP, BRPOP: multiple existing lists - $type" {
+            set rd [redis_deferring_client]
+            create_$type blist1 "a $large c"
+            create_$type blist2 "d $large f"
+
+            $rd blpop blist1 blist2 1
+            assert_equal {blist1 a} [$rd read]
+            $rd brpop blist1 blist2 1
+            assert_equal {blist1 c} [$rd read]
+            assert_equal 1 [r llen blist1]
+            assert_equal 3 [r llen blist2]
+
+            $rd blpop blist2 blist1 1
+            assert_equal {blist2 d} [$rd read]
+            $rd brpop blist2 blist1 1
+            assert_equal {blist2 f} [$rd read]
+            assert_equal 1 [r llen blist1]
+            assert_equal 1 [r llen blist2]
+        }
 
-    #    test "BLPOP, BRPOP: second list has an entry - $type" {
-    #        set rd [redis_deferring_client]
-    #        r del blist1
+        test "BLPOP, BRPOP: second list has an entry - $type" {
+            set rd [redis_deferring_client]
+            r del blist1
 
-    #        create_$type blist2 "d $large f"
+            create_$type blist2 "d $large f"
 
-    #        $rd blpop blist1 blist2 1
+            $rd blpop blist1 blist2 1
 
-    #        assert_equal {blist2 d} [$rd read]
-    #        $rd brpop blist1 blist2 1
+            assert_equal {blist2 d} [$rd read]
+            $rd brpop blist1 blist2 1
 
-    #        assert_equal {blist2 f} [$rd read]
-    #        assert_equal 0 [r llen blist1]
-    #        assert_equal 1 [r llen blist2]
-    #    }
+            assert_equal {blist2 f} [$rd read]
+            assert_equal 0 [r llen blist1]
+            assert_equal 1 [r llen blist2]
+        }
 
-    #    test "BRPOPLPUSH - $type" {
-    #        r del target
-    #        set rd [redis_deferring_client]
-    #        create_$type blist "a b $large c d"
-    #        $rd brpoplpush blist target 1
-    #        assert_equal d [$rd read]
-    #        assert_equal d [r rpop target]
-    #        assert_equal "a b $large c" [r lrange blist 0 -1]
-    #    }
-    #}
+        test "BRPOPLPUSH - $type" {
+            r del target
+            set rd [redis_deferring_client]
+            create_$type blist "a b $large c d"
+            $rd brpoplpush blist target 1
+            assert_equal d [$rd read]
+            assert_equal d [r rpop target]
+            assert_equal "a b $large c" [r lrange blist 0 -1]
+        }
+    }
 
     #test "BLPOP, LPUSH + DEL should not awake blocked client" {
     #    set rd [redis_deferring_client]
@@ -203,35 +202,35 @@ start_server {
     #    $rd read
     #} {list b}
 
-    #test "BLPOP with same key multiple times should work (issue #801)" {
-    #    set rd [redis_deferring_client]
-    #    r del list1 list2
+    test "BLPOP with same key multiple times should work (issue #801)" {
+        set rd [redis_deferring_client]
+        r del list1 list2
 
 
-    #    # Data arriving after the BLPOP.
-    #    $rd blpop list1 list2 list2 list1 0
+        # Data arriving after the BLPOP.
+        $rd blpop list1 list2 list2 list1 0
 
-    #    r lpush list1 a
+        r lpush list1 a
 
-    #    assert_equal [$rd read] {list1 a}
-    #    $rd blpop list1 list2 list2 list1 0
+        assert_equal [$rd read] {list1 a}
+        $rd blpop list1 list2 list2 list1 0
 
-    #    r lpush list2 b
+        r lpush list2 b
 
-    #    assert_equal [$rd read] {list2 b}
+        assert_equal [$rd read] {list2 b}
 
-    #    # Data already there.
-    #    r lpush list1 a
+        # Data already there.
+        r lpush list1 a
 
-    #    r lpush list2 b
+        r lpush list2 b
 
-    #    $rd blpop list1 list2 list2 list1 0
+        $rd blpop list1 list2 list2 list1 0
 
-    #    assert_equal [$rd read] {list1 a}
-    #    $rd blpop list1 list2 list2 list1 0
+        assert_equal [$rd read] {list1 a}
+        $rd blpop list1 list2 list2 list1 0
 
-    #    assert_equal [$rd read] {list2 b}
-    #}
+        assert_equal [$rd read] {list2 b}
+    }
 
     #test "MULTI/EXEC is isolated from the point of view of BLPOP" {
     #    set rd [redis_deferring_client]
@@ -250,59 +249,70 @@ start_server {
     #    $rd read
     #} {list c}
 
-    #test "BLPOP with variadic LPUSH" {
-    #    set rd [redis_deferring_client]
-    #    r del blist target
+    test "BLPOP: closing with pipelined commands doesn't lose a push" {
+        set rd [redis_deferring_client]
+        r del blist
+        $rd blpop blist 0
+        $rd ping
+        after 100
+        $rd close
+        after 100
+        r lpush blist foo
+        assert_equal foo [r lpop blist]
+    }
+    test "BLPOP with variadic LPUSH" {
+        set rd [redis_deferring_client]
+        r del blist target
 
-    #    if {$::valgrind} {after 100}
-    #    $rd blpop blist 0
+        if {$::valgrind} {after 100}
+        $rd blpop blist 0
 
-    #    if {$::valgrind} {after 100}
-    #    assert_equal 2 [r lpush blist foo bar]
+        if {$::valgrind} {after 100}
+        assert_equal 2 [r lpush blist foo bar]
 
-    #    if {$::valgrind} {after 100}
-    #    assert_equal {blist bar} [$rd read]
-    #    assert_equal foo [lindex [r lrange blist 0 -1] 0]
-    #}
+        if {$::valgrind} {after 100}
+        assert_equal {blist bar} [$rd read]
+        assert_equal foo [lindex [r lrange blist 0 -1] 0]
+    }
 
-    #test "BRPOPLPUSH with zero timeout should block indefinitely" {
-    #    set rd [redis_deferring_client]
-    #    r del blist target
+    test "BRPOPLPUSH with zero timeout should block indefinitely" {
+        set rd [redis_deferring_client]
+        r del blist target
 
-    #    $rd brpoplpush blist target 0
-    #    after 1000
-    #    r rpush blist foo
+        $rd brpoplpush blist target 0
+        after 1000
+        r rpush blist foo
 
-    #    assert_equal foo [$rd read]
-    #    assert_equal {foo} [r lrange target 0 -1]
-    #}
+        assert_equal foo [$rd read]
+        assert_equal {foo} [r lrange target 0 -1]
+    }
 
-    #test "BRPOPLPUSH with a client BLPOPing the target list" {
-    #    set rd [redis_deferring_client]
-    #    set rd2 [redis_deferring_client]
-    #    r del blist target
+    test "BRPOPLPUSH with a client BLPOPing the target list" {
+        set rd [redis_deferring_client]
+        set rd2 [redis_deferring_client]
+        r del blist target
 
-    #    $rd2 blpop target 0
+        $rd2 blpop target 0
 
-    #    $rd brpoplpush blist target 0
+        $rd brpoplpush blist target 0
 
-    #    after 1000
-    #    r rpush blist foo
+        after 1000
+        r rpush blist foo
 
-    #    assert_equal foo [$rd read]
-    #    assert_equal {target foo} [$rd2 read]
-    #    assert_equal 0 [r exists target]
-    #}
+        assert_equal foo [$rd read]
+        assert_equal {target foo} [$rd2 read]
+        assert_equal 0 [r exists target]
+    }
 
-    #test "BRPOPLPUSH with wrong source type" {
-    #    set rd [redis_deferring_client]
-    #    r del blist target
+    test "BRPOPLPUSH with wrong source type" {
+        set rd [redis_deferring_client]
+        r del blist target
 
-    #    r set blist nolist
-    #    $rd brpoplpush blist target 1
+        r set blist nolist
+        $rd brpoplpush blist target 1
 
-    #    assert_error "WRONGTYPE*" {$rd read}
-    #}
+        assert_error "WRONGTYPE*" {$rd read}
+    }
 
     #test "BRPOPLPUSH with wrong destination type" {
     #    set rd [redis_deferring_client]
@@ -389,14 +399,14 @@ start_server {
     #  assert_equal {} [r lrange list2 0 -1]
     #}
 
-    #test "Self-referential BRPOPLPUSH" {
-    #  set rd [redis_deferring_client]
-    #  r del blist
-    #  $rd brpoplpush blist blist 0
-    #  r rpush blist foo
-    #  assert_equal {foo} [r lrange blist 0 -1]
-    #  r lrange blist 0 -1
-    #} {foo}
+    test "Self-referential BRPOPLPUSH" {
+      set rd [redis_deferring_client]
+      r del blist
+      $rd brpoplpush blist blist 0
+      r rpush blist foo
+      assert_equal {foo} [r lrange blist 0 -1]
+      r lrange blist 0 -1
+    } {foo}
 
     #test "BRPOPLPUSH inside a transaction" {
     #    #r del xlist target